@@ -0,0 +1,121 @@
+//
+// Counts heap allocations, to check that a steady state frame makes none.
+// Define ALLOCATIONTRACKER_IMPLEMENTATION before including this in the one
+// source file of a program (like STB_IMAGE_IMPLEMENTATION) to replace the
+// global operator new and delete with versions that count every call.
+// Without it the counters stay at 0.
+//
+//     unsigned long long before = heapAllocations();
+//     ... frame ...
+//     framesAllocations += heapAllocations() - before;
+//
+// Memory from malloc directly (drivers, GLFW, stb_image) is not counted.
+//
+
+#ifndef PROJECT_ALLOCATIONTRACKER_H
+#define PROJECT_ALLOCATIONTRACKER_H
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+inline std::atomic<unsigned long long> &heapAllocationCounter()
+{
+    static std::atomic<unsigned long long> counter(0);
+    return counter;
+}
+
+inline std::atomic<unsigned long long> &heapBytesCounter()
+{
+    static std::atomic<unsigned long long> counter(0);
+    return counter;
+}
+
+// Calls of operator new (any form) so far, from every thread
+inline unsigned long long heapAllocations()
+{
+    return heapAllocationCounter().load(std::memory_order_relaxed);
+}
+
+inline unsigned long long heapBytes()
+{
+    return heapBytesCounter().load(std::memory_order_relaxed);
+}
+
+inline bool heapAllocationsTracked()
+{
+#ifdef ALLOCATIONTRACKER_IMPLEMENTATION
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef ALLOCATIONTRACKER_IMPLEMENTATION
+
+inline void *trackedAllocate(size_t size)
+{
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    heapBytesCounter().fetch_add(size, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(size_t size)
+{
+    return trackedAllocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return trackedAllocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    heapBytesCounter().fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+#endif
+
+#endif //PROJECT_ALLOCATIONTRACKER_H
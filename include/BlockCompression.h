@@ -0,0 +1,528 @@
+//
+// BC1, BC3, BC4 and BC5 block compression on the CPU.
+//
+// Every format works on blocks of 4x4 pixels, given as 16 RGBA8 pixels
+// row by row:
+//   - BC1 (DXT1, 8 bytes) stores two RGB565 endpoints and a 2 bit index
+//     per pixel into the endpoints and the two colors a third and two
+//     thirds of the way between them. The endpoints start on the principal
+//     axis of the block's colors, clipped to the colors on it and pulled in
+//     by a sixteenth; every pixel then picks the nearest of the four
+//     colors, four pixels per SSE instruction, and one least squares fit
+//     of the endpoints to those picks is kept when it lowers the error.
+//   - BC4 (RGTC1, 8 bytes) stores one channel as two 8 bit endpoints and a
+//     3 bit index into them and six values in between.
+//   - BC3 (DXT5) is a BC4 block for alpha followed by a BC1 block, BC5
+//     (RGTC2) two BC4 blocks for red and green.
+// Blocks on the right and bottom edge of images that are not a multiple
+// of 4 repeat the last column and row.
+//
+// The decoders follow the formats' interpolation with integer rounding,
+// close to but not always bit exact with what the GPU does, which is good
+// enough for the PSNR reported against the source image.
+//
+
+#ifndef PROJECT_BLOCKCOMPRESSION_H
+#define PROJECT_BLOCKCOMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BLOCKCOMPRESSION_USE_SSE
+#endif
+
+enum BlockFormat {
+    BLOCK_BC1,
+    BLOCK_BC3,
+    BLOCK_BC4,
+    BLOCK_BC5
+};
+
+inline int blockBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16;
+}
+
+inline const char *blockFormatName(BlockFormat format)
+{
+    static const char *names[] = { "BC1", "BC3", "BC4", "BC5" };
+    return names[format];
+}
+
+// Bytes of a width x height image in format, partial blocks rounded up
+inline size_t compressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// RGBA channels a format keeps, bit c for channel c
+inline int blockChannelMask(BlockFormat format)
+{
+    static const int masks[] = { 0x7, 0xF, 0x1, 0x3 };
+    return masks[format];
+}
+
+// OpenGL internal formats, as numbers so this header needs no GL
+inline unsigned int blockGlFormat(BlockFormat format)
+{
+    // COMPRESSED_RGB_S3TC_DXT1_EXT, COMPRESSED_RGBA_S3TC_DXT5_EXT,
+    // COMPRESSED_RED_RGTC1, COMPRESSED_RG_RGTC2
+    static const unsigned int formats[] = { 0x83F0, 0x83F3, 0x8DBB, 0x8DBD };
+    return formats[format];
+}
+
+// Base formats the KTX header wants next to the internal format
+inline unsigned int blockGlBaseFormat(BlockFormat format)
+{
+    // RGB, RGBA, RED, RG
+    static const unsigned int formats[] = { 0x1907, 0x1908, 0x1903, 0x8227 };
+    return formats[format];
+}
+
+// False when glFormat is none of the four
+inline bool blockFormatFromGl(unsigned int glFormat, BlockFormat &format)
+{
+    for (int f = BLOCK_BC1; f <= BLOCK_BC5; ++f) {
+        if (blockGlFormat((BlockFormat)f) == glFormat) {
+            format = (BlockFormat)f;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline uint16_t packRgb565(const float color[3])
+{
+    int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * (31.0f / 255.0f) + 0.5f);
+    int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * (63.0f / 255.0f) + 0.5f);
+    int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * (31.0f / 255.0f) + 0.5f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+// 8 bit channels with the high bits repeated in the low ones
+inline void unpackRgb565(uint16_t packed, int color[3])
+{
+    int r = packed >> 11, g = packed >> 5 & 0x3F, b = packed & 0x1F;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// The colors of a BC1 block, four color mode unless threeColor and
+// c0 <= c1, where the last one is transparent black
+inline void bc1Palette(uint16_t c0, uint16_t c1, bool allowThreeColor, int palette[4][4])
+{
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+    bool fourColor = c0 > c1 || !allowThreeColor;
+    for (int c = 0; c < 3; ++c) {
+        if (fourColor) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = fourColor ? 255 : 0;
+}
+
+// The values of a BC4 block, eight interpolated levels when e0 > e1,
+// otherwise six with 0 and 255 as the last two
+inline void bc4Palette(int e0, int e1, int palette[8])
+{
+    palette[0] = e0;
+    palette[1] = e1;
+    if (e0 > e1) {
+        for (int k = 1; k <= 6; ++k)
+            palette[k + 1] = ((7 - k) * e0 + k * e1 + 3) / 7;
+    } else {
+        for (int k = 1; k <= 4; ++k)
+            palette[k + 1] = ((5 - k) * e0 + k * e1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Pixels of one block as floats, channel by channel, for the BC1 search
+struct Bc1Pixels {
+    alignas(16) float r[16];
+    alignas(16) float g[16];
+    alignas(16) float b[16];
+};
+
+// Picks the nearest of the four colors of (c0, c1) for every pixel and
+// returns the summed squared error, indices as codes 0 to 3
+inline float bc1SelectIndices(const Bc1Pixels &pixels, uint16_t c0, uint16_t c1, int indices[16])
+{
+    int palette[4][4];
+    bc1Palette(c0, c1, false, palette);
+    float error = 0.0f;
+#ifdef BLOCKCOMPRESSION_USE_SSE
+    __m128 pr[4], pg[4], pb[4];
+    for (int k = 0; k < 4; ++k) {
+        pr[k] = _mm_set1_ps((float)palette[k][0]);
+        pg[k] = _mm_set1_ps((float)palette[k][1]);
+        pb[k] = _mm_set1_ps((float)palette[k][2]);
+    }
+    __m128 total = _mm_setzero_ps();
+    for (int i = 0; i < 16; i += 4) {
+        __m128 r = _mm_load_ps(pixels.r + i), g = _mm_load_ps(pixels.g + i), b = _mm_load_ps(pixels.b + i);
+        __m128 best = _mm_set1_ps(1e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int k = 0; k < 4; ++k) {
+            __m128 dr = _mm_sub_ps(r, pr[k]), dg = _mm_sub_ps(g, pg[k]), db = _mm_sub_ps(b, pb[k]);
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+            // Strictly nearer, so ties keep the lower code like the scalar loop
+            __m128i nearer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            bestIndex = _mm_or_si128(_mm_andnot_si128(nearer, bestIndex),
+                                     _mm_and_si128(nearer, _mm_set1_epi32(k)));
+            best = _mm_min_ps(best, d);
+        }
+        total = _mm_add_ps(total, best);
+        _mm_storeu_si128((__m128i *)(indices + i), bestIndex);
+    }
+    alignas(16) float sums[4];
+    _mm_store_ps(sums, total);
+    error = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+    float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        float best = 1e30f;
+        int bestIndex = 0;
+        for (int k = 0; k < 4; ++k) {
+            float dr = pixels.r[i] - palette[k][0], dg = pixels.g[i] - palette[k][1];
+            float db = pixels.b[i] - palette[k][2];
+            float d = dr * dr + dg * dg + db * db;
+            if (d < best) {
+                best = d;
+                bestIndex = k;
+            }
+        }
+        sums[i % 4] += best;
+        indices[i] = bestIndex;
+    }
+    error = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+    return error;
+}
+
+// Endpoints in four color order (c0 > c1) with indices to match; equal
+// endpoints can only use code 0
+inline void bc1Order(uint16_t &c0, uint16_t &c1, int indices[16])
+{
+    static const int swapped[4] = { 1, 0, 3, 2 };
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (int i = 0; i < 16; ++i)
+            indices[i] = swapped[indices[i]];
+    } else if (c0 == c1) {
+        for (int i = 0; i < 16; ++i)
+            indices[i] = 0;
+    }
+}
+
+// Least squares endpoints for fixed indices, false when the indices do
+// not pin both down (every pixel on the same code)
+inline bool bc1FitEndpoints(const Bc1Pixels &pixels, const int indices[16], float e0[3], float e1[3])
+{
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        float a = weights[indices[i]], b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        const float x[3] = { pixels.r[i], pixels.g[i], pixels.b[i] };
+        for (int c = 0; c < 3; ++c) {
+            ax[c] += a * x[c];
+            bx[c] += b * x[c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+inline void writeBc1(uint16_t c0, uint16_t c1, const int indices[16], uint8_t *out)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint32_t)indices[i] << (2 * i);
+    out[0] = (uint8_t)c0;
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)c1;
+    out[3] = (uint8_t)(c1 >> 8);
+    for (int k = 0; k < 4; ++k)
+        out[4 + k] = (uint8_t)(bits >> (8 * k));
+}
+
+// Colors only, always in four color mode so the block is also valid as
+// the color half of BC3
+inline void encodeBc1(const uint8_t *rgba, uint8_t *out)
+{
+    Bc1Pixels pixels;
+    float mean[3] = { 0.0f, 0.0f, 0.0f }, lo[3], hi[3];
+    for (int c = 0; c < 3; ++c)
+        lo[c] = hi[c] = rgba[c];
+    for (int i = 0; i < 16; ++i) {
+        const float x[3] = { (float)rgba[4 * i], (float)rgba[4 * i + 1], (float)rgba[4 * i + 2] };
+        pixels.r[i] = x[0];
+        pixels.g[i] = x[1];
+        pixels.b[i] = x[2];
+        for (int c = 0; c < 3; ++c) {
+            mean[c] += x[c] / 16.0f;
+            lo[c] = std::min(lo[c], x[c]);
+            hi[c] = std::max(hi[c], x[c]);
+        }
+    }
+    int indices[16];
+    if (lo[0] == hi[0] && lo[1] == hi[1] && lo[2] == hi[2]) {
+        uint16_t c = packRgb565(lo);
+        for (int i = 0; i < 16; ++i)
+            indices[i] = 0;
+        writeBc1(c, c, indices, out);
+        return;
+    }
+
+    // Principal axis by power iteration on the covariance, starting from
+    // the diagonal of the bounding box
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        float r = pixels.r[i] - mean[0], g = pixels.g[i] - mean[1], b = pixels.b[i] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+    float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float t = ((pixels.r[i] - mean[0]) * axis[0] + (pixels.g[i] - mean[1]) * axis[1] +
+                   (pixels.b[i] - mean[2]) * axis[2]) / axisLength2;
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float inset = (maxT - minT) / 16.0f;
+    minT += inset;
+    maxT -= inset;
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = mean[c] + axis[c] * maxT;
+        e1[c] = mean[c] + axis[c] * minT;
+    }
+    uint16_t c0 = packRgb565(e0), c1 = packRgb565(e1);
+    float error = bc1SelectIndices(pixels, c0, c1, indices);
+
+    if (bc1FitEndpoints(pixels, indices, e0, e1)) {
+        int refinedIndices[16];
+        uint16_t r0 = packRgb565(e0), r1 = packRgb565(e1);
+        float refinedError = bc1SelectIndices(pixels, r0, r1, refinedIndices);
+        if (refinedError < error) {
+            c0 = r0;
+            c1 = r1;
+            std::memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+    bc1Order(c0, c1, indices);
+    writeBc1(c0, c1, indices, out);
+}
+
+// Channel channel (0 to 3) of the block
+inline void encodeBc4(const uint8_t *rgba, int channel, uint8_t *out)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, (int)rgba[4 * i + channel]);
+        hi = std::max(hi, (int)rgba[4 * i + channel]);
+    }
+    out[0] = (uint8_t)hi;
+    out[1] = (uint8_t)lo;
+    // Level 0 is lo and 7 is hi, codes count down from hi after the ends
+    static const int codes[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+    int indices[16];
+    if (hi == lo) {
+        for (int i = 0; i < 16; ++i)
+            indices[i] = 0;
+    } else {
+        float scale = 7.0f / (float)(hi - lo);
+#ifdef BLOCKCOMPRESSION_USE_SSE
+        alignas(16) float values[16];
+        alignas(16) int levels[16];
+        for (int i = 0; i < 16; ++i)
+            values[i] = rgba[4 * i + channel];
+        __m128 offset = _mm_set1_ps((float)lo), factor = _mm_set1_ps(scale);
+        for (int i = 0; i < 16; i += 4) {
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(values + i), offset), factor);
+            // Rounds to nearest, t is never negative
+            _mm_store_si128((__m128i *)(levels + i), _mm_cvtps_epi32(t));
+        }
+        for (int i = 0; i < 16; ++i)
+            indices[i] = codes[levels[i]];
+#else
+        for (int i = 0; i < 16; ++i)
+            indices[i] = codes[(int)std::nearbyint((rgba[4 * i + channel] - lo) * scale)];
+#endif
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint64_t)indices[i] << (3 * i);
+    for (int k = 0; k < 6; ++k)
+        out[2 + k] = (uint8_t)(bits >> (8 * k));
+}
+
+inline void encodeBlock(BlockFormat format, const uint8_t *rgba, uint8_t *out)
+{
+    switch (format) {
+    case BLOCK_BC1:
+        encodeBc1(rgba, out);
+        break;
+    case BLOCK_BC3:
+        encodeBc4(rgba, 3, out);
+        encodeBc1(rgba, out + 8);
+        break;
+    case BLOCK_BC4:
+        encodeBc4(rgba, 0, out);
+        break;
+    case BLOCK_BC5:
+        encodeBc4(rgba, 0, out);
+        encodeBc4(rgba, 1, out + 8);
+        break;
+    }
+}
+
+inline void decodeBc1(const uint8_t *block, bool allowThreeColor, uint8_t *rgba)
+{
+    uint16_t c0 = (uint16_t)(block[0] | block[1] << 8), c1 = (uint16_t)(block[2] | block[3] << 8);
+    uint32_t bits = (uint32_t)block[4] | (uint32_t)block[5] << 8 | (uint32_t)block[6] << 16 |
+                    (uint32_t)block[7] << 24;
+    int palette[4][4];
+    bc1Palette(c0, c1, allowThreeColor, palette);
+    for (int i = 0; i < 16; ++i) {
+        const int *color = palette[bits >> (2 * i) & 3];
+        for (int c = 0; c < 4; ++c)
+            rgba[4 * i + c] = (uint8_t)color[c];
+    }
+}
+
+inline void decodeBc4(const uint8_t *block, int channel, uint8_t *rgba)
+{
+    int palette[8];
+    bc4Palette(block[0], block[1], palette);
+    uint64_t bits = 0;
+    for (int k = 0; k < 6; ++k)
+        bits |= (uint64_t)block[2 + k] << (8 * k);
+    for (int i = 0; i < 16; ++i)
+        rgba[4 * i + channel] = (uint8_t)palette[bits >> (3 * i) & 7];
+}
+
+// RGBA as the GPU samples it without swizzles: BC4 is (r, 0, 0, 1) and
+// BC5 (r, g, 0, 1)
+inline void decodeBlock(BlockFormat format, const uint8_t *block, uint8_t *rgba)
+{
+    switch (format) {
+    case BLOCK_BC1:
+        decodeBc1(block, true, rgba);
+        break;
+    case BLOCK_BC3:
+        decodeBc1(block + 8, false, rgba);
+        decodeBc4(block, 3, rgba);
+        break;
+    case BLOCK_BC4:
+    case BLOCK_BC5:
+        for (int i = 0; i < 16; ++i) {
+            rgba[4 * i + 1] = rgba[4 * i + 2] = 0;
+            rgba[4 * i + 3] = 255;
+        }
+        decodeBc4(block, 0, rgba);
+        if (format == BLOCK_BC5)
+            decodeBc4(block + 8, 1, rgba);
+        break;
+    }
+}
+
+// Compresses a width x height RGBA8 image into compressedSize bytes
+inline void compressImage(BlockFormat format, const uint8_t *rgba, int width, int height, uint8_t *out)
+{
+    uint8_t block[64];
+    int bytes = blockBytes(format);
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            for (int y = 0; y < 4; ++y) {
+                const uint8_t *row = rgba + (size_t)std::min(by + y, height - 1) * width * 4;
+                for (int x = 0; x < 4; ++x)
+                    std::memcpy(block + 16 * y + 4 * x, row + (size_t)std::min(bx + x, width - 1) * 4, 4);
+            }
+            encodeBlock(format, block, out);
+            out += bytes;
+        }
+    }
+}
+
+inline void decompressImage(BlockFormat format, const uint8_t *blocks, int width, int height, uint8_t *rgba)
+{
+    uint8_t block[64];
+    int bytes = blockBytes(format);
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            decodeBlock(format, blocks, block);
+            blocks += bytes;
+            for (int y = 0; y < 4 && by + y < height; ++y) {
+                uint8_t *row = rgba + (size_t)(by + y) * width * 4;
+                int columns = std::min(4, width - bx);
+                std::memcpy(row + (size_t)bx * 4, block + 16 * y, (size_t)columns * 4);
+            }
+        }
+    }
+}
+
+// Peak signal to noise ratio in dB of two RGBA8 images over the channels
+// in channelMask, 99 for identical images
+inline double rgbaPsnr(const uint8_t *a, const uint8_t *b, size_t pixels, int channelMask)
+{
+    double squared = 0.0;
+    size_t samples = 0;
+    for (int c = 0; c < 4; ++c) {
+        if (!(channelMask & 1 << c))
+            continue;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < pixels; ++i) {
+            int d = (int)a[4 * i + c] - (int)b[4 * i + c];
+            sum += (uint64_t)(d * d);
+        }
+        squared += (double)sum;
+        samples += pixels;
+    }
+    if (samples == 0 || squared == 0.0)
+        return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 * samples / squared);
+}
+
+#endif //PROJECT_BLOCKCOMPRESSION_H
@@ -0,0 +1,166 @@
+//
+// Gaussian blur with a radius given in framebuffer pixels.
+//   radius <= BlurKernel::MAX_DIRECT_RADIUS: two separable passes at full
+//       resolution with linear sampled taps.
+//   larger radii: dual Kawase downsample by 2 until the radius fits, run the
+//       separable Gaussian there, then Kawase upsample back to full size.
+// All offsets are derived from the size of the texture being read, so the
+// result does not change with the window size. Intermediate targets are
+// RGBA16F to avoid banding across the extra passes.
+// See BlurKernel.h for the CPU reference of every pass.
+//
+
+#ifndef PROJECT_BLUREFFECT_H
+#define PROJECT_BLUREFFECT_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <iostream>
+
+#include "Shader.h"
+#include "BlurKernel.h"
+#include "PostProcessChain.h"
+
+class BlurEffect : public PostProcessEffect
+{
+public:
+    float radius;
+
+    explicit BlurEffect(float radius_ = 8.0f)
+            : radius(radius_), width(0), height(0),
+              gaussianShader("shaders/ScreenShaderDefault.vert", "shaders/GaussianBlur.frag"),
+              downShader("shaders/ScreenShaderDefault.vert", "shaders/KawaseDown.frag"),
+              upShader("shaders/ScreenShaderDefault.vert", "shaders/KawaseUp.frag")
+    {
+        gaussianShader.use();
+        gaussianShader.setInt("screenTexture", 0);
+        downShader.use();
+        downShader.setInt("screenTexture", 0);
+        upShader.use();
+        upShader.setInt("screenTexture", 0);
+    }
+
+    ~BlurEffect() override
+    {
+        releaseTargets();
+        glDeleteProgram(gaussianShader.ID);
+        glDeleteProgram(downShader.ID);
+        glDeleteProgram(upShader.ID);
+    }
+
+    // Expects a full screen quad VAO to be bound, like PostProcessChain does
+    void apply(unsigned int inputTexture, unsigned int outputFBO, int width_, int height_) override
+    {
+        int levels = BlurKernel::pyramidLevels(radius);
+        ensureTargets(width_, height_, levels);
+
+        // Downsample, level i + 1 is half of level i
+        unsigned int source = inputTexture;
+        downShader.use();
+        for (int i = 1; i <= levels; ++i) {
+            downShader.setVec2("texelSize", texelSize(i - 1));
+            drawInto(targets[i].fbo[0], i, source);
+            source = targets[i].texture[0];
+        }
+
+        // Separable Gaussian on the smallest level
+        int levelRadius = (int)std::ceil(radius / (1 << levels));
+        if (kernel.offsets.empty() || levelRadius != kernel.radius)
+            kernel = BlurKernel::linearSampled(levelRadius);
+        gaussianShader.use();
+        gaussianShader.setInt("tapCount", (int)kernel.offsets.size());
+        glUniform1fv(glGetUniformLocation(gaussianShader.ID, "offsets"),
+                     (GLsizei)kernel.offsets.size(), kernel.offsets.data());
+        glUniform1fv(glGetUniformLocation(gaussianShader.ID, "weights"),
+                     (GLsizei)kernel.weights.size(), kernel.weights.data());
+        gaussianShader.setVec2("direction", glm::vec2(texelSize(levels).x, 0.0f));
+        drawInto(targets[levels].fbo[1], levels, source);
+        gaussianShader.setVec2("direction", glm::vec2(0.0f, texelSize(levels).y));
+        if (levels == 0) {
+            drawInto(outputFBO, 0, targets[0].texture[1]);
+            return;
+        }
+        drawInto(targets[levels].fbo[0], levels, targets[levels].texture[1]);
+
+        // Upsample back, the last step writes the output
+        upShader.use();
+        for (int i = levels; i > 0; --i) {
+            upShader.setVec2("texelSize", texelSize(i));
+            drawInto(i == 1 ? outputFBO : targets[i - 1].fbo[0], i - 1, targets[i].texture[0]);
+        }
+    }
+
+private:
+    // Level 0 only uses index 1, the full size input comes from outside
+    struct Level {
+        int width, height;
+        unsigned int fbo[2], texture[2];
+    };
+
+    int width, height;
+    std::vector<Level> targets;
+    Shader gaussianShader, downShader, upShader;
+    BlurKernel kernel;
+
+    glm::vec2 texelSize(int level) const
+    {
+        return glm::vec2(1.0f / targets[level].width, 1.0f / targets[level].height);
+    }
+
+    void drawInto(unsigned int fbo, int level, unsigned int source)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, targets[level].width, targets[level].height);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    void ensureTargets(int width_, int height_, int levels)
+    {
+        if (width_ != width || height_ != height)
+            releaseTargets();
+        width = width_;
+        height = height_;
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        while ((int)targets.size() <= levels) {
+            int i = (int)targets.size();
+            Level level;
+            level.width = std::max(width >> i, 1);
+            level.height = std::max(height >> i, 1);
+            glGenFramebuffers(2, level.fbo);
+            glGenTextures(2, level.texture);
+            for (int j = 0; j < 2; ++j) {
+                glBindTexture(GL_TEXTURE_2D, level.texture[j]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, level.width, level.height, 0,
+                             GL_RGBA, GL_FLOAT, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glBindFramebuffer(GL_FRAMEBUFFER, level.fbo[j]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                       level.texture[j], 0);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                    std::cout << "Error: Incomplete blur framebuffer!" << std::endl;
+                }
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            targets.push_back(level);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    }
+
+    void releaseTargets()
+    {
+        for (unsigned int i = 0; i < targets.size(); ++i) {
+            glDeleteFramebuffers(2, targets[i].fbo);
+            glDeleteTextures(2, targets[i].texture);
+        }
+        targets.clear();
+    }
+};
+
+#endif //PROJECT_BLUREFFECT_H
@@ -0,0 +1,224 @@
+//
+// Gaussian blur kernels and a CPU reference of the GPU blur in BlurEffect.h.
+//
+// A discrete Gaussian of radius R needs 2R + 1 taps per axis. With bilinear
+// filtering two neighbouring taps can be fetched at once by sampling between
+// them at an offset weighted by their coefficients, so a pass only needs
+// 1 + ceil(R / 2) fetches per side. Radii above a threshold are blurred on a
+// downsampled copy instead (dual Kawase down/up filters around the Gaussian).
+// This file does not touch OpenGL, so the reference can run anywhere.
+//
+
+#ifndef PROJECT_BLURKERNEL_H
+#define PROJECT_BLURKERNEL_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+struct BlurKernel {
+    // Must match MAX_TAPS in shaders/GaussianBlur.frag
+    static const int MAX_TAPS = 16;
+    // Larger radii go through the downsampled pyramid
+    static const int MAX_DIRECT_RADIUS = 16;
+
+    int radius;
+    // Tap 0 is the center, every other tap is applied at +offset and -offset
+    std::vector<float> offsets;
+    std::vector<float> weights;
+
+    // Normalized weights of a discrete Gaussian for 0..radius, sigma = radius / 3
+    static std::vector<float> gaussianWeights(int radius)
+    {
+        std::vector<float> w(radius + 1);
+        float sigma = std::max(radius / 3.0f, 0.5f);
+        float sum = 0.0f;
+        for (int i = 0; i <= radius; ++i) {
+            w[i] = std::exp(-0.5f * i * i / (sigma * sigma));
+            sum += i == 0 ? w[i] : 2.0f * w[i];
+        }
+        for (int i = 0; i <= radius; ++i)
+            w[i] /= sum;
+        return w;
+    }
+
+    // Kernel for a pixel radius up to MAX_DIRECT_RADIUS, with pairs of taps
+    // merged into a single bilinear fetch
+    static BlurKernel linearSampled(int radius)
+    {
+        BlurKernel kernel;
+        kernel.radius = radius;
+        std::vector<float> w = gaussianWeights(radius);
+        kernel.offsets.push_back(0.0f);
+        kernel.weights.push_back(w[0]);
+        for (int i = 1; i <= radius; i += 2) {
+            float w1 = w[i];
+            float w2 = i + 1 <= radius ? w[i + 1] : 0.0f;
+            kernel.offsets.push_back((i * w1 + (i + 1) * w2) / (w1 + w2));
+            kernel.weights.push_back(w1 + w2);
+        }
+        return kernel;
+    }
+
+    // Number of half resolution levels needed so that the remaining radius
+    // fits in a direct pass
+    static int pyramidLevels(float radius)
+    {
+        int levels = 0;
+        while (radius > MAX_DIRECT_RADIUS) {
+            radius *= 0.5f;
+            ++levels;
+        }
+        return levels;
+    }
+};
+
+// RGB float image with the same sampling rules as a GL_LINEAR,
+// GL_CLAMP_TO_EDGE texture
+class CpuImage
+{
+public:
+    int width, height;
+    std::vector<glm::vec3> pixels;
+
+    CpuImage(int width_ = 0, int height_ = 0)
+            : width(width_), height(height_), pixels(width_ * height_, glm::vec3(0.0f)) {}
+
+    glm::vec3 &at(int x, int y)
+    {
+        return pixels[y * width + x];
+    }
+
+    glm::vec3 texel(int x, int y) const
+    {
+        x = std::min(std::max(x, 0), width - 1);
+        y = std::min(std::max(y, 0), height - 1);
+        return pixels[y * width + x];
+    }
+
+    // Bilinear fetch at normalized coordinates, texel centers at (i + 0.5) / size
+    glm::vec3 sample(glm::vec2 uv) const
+    {
+        float x = uv.x * width - 0.5f, y = uv.y * height - 0.5f;
+        int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+        float fx = x - x0, fy = y - y0;
+        glm::vec3 top = glm::mix(texel(x0, y0), texel(x0 + 1, y0), fx);
+        glm::vec3 bottom = glm::mix(texel(x0, y0 + 1), texel(x0 + 1, y0 + 1), fx);
+        return glm::mix(top, bottom, fy);
+    }
+
+    glm::vec2 uvOf(int x, int y) const
+    {
+        return glm::vec2((x + 0.5f) / width, (y + 0.5f) / height);
+    }
+};
+
+// Exact separable Gaussian with 2R + 1 taps per axis
+inline CpuImage blurReference(const CpuImage &src, int radius)
+{
+    std::vector<float> w = BlurKernel::gaussianWeights(radius);
+    CpuImage tmp(src.width, src.height), dst(src.width, src.height);
+    for (int y = 0; y < src.height; ++y)
+        for (int x = 0; x < src.width; ++x) {
+            glm::vec3 c = src.texel(x, y) * w[0];
+            for (int i = 1; i <= radius; ++i)
+                c += (src.texel(x - i, y) + src.texel(x + i, y)) * w[i];
+            tmp.at(x, y) = c;
+        }
+    for (int y = 0; y < src.height; ++y)
+        for (int x = 0; x < src.width; ++x) {
+            glm::vec3 c = tmp.texel(x, y) * w[0];
+            for (int i = 1; i <= radius; ++i)
+                c += (tmp.texel(x, y - i) + tmp.texel(x, y + i)) * w[i];
+            dst.at(x, y) = c;
+        }
+    return dst;
+}
+
+// One pass of shaders/GaussianBlur.frag. direction is (1, 0) or (0, 1).
+inline CpuImage gaussianPass(const CpuImage &src, const BlurKernel &kernel, glm::vec2 direction)
+{
+    CpuImage dst(src.width, src.height);
+    glm::vec2 step = direction / glm::vec2(src.width, src.height);
+    for (int y = 0; y < src.height; ++y)
+        for (int x = 0; x < src.width; ++x) {
+            glm::vec2 uv = src.uvOf(x, y);
+            glm::vec3 c = src.sample(uv) * kernel.weights[0];
+            for (unsigned int i = 1; i < kernel.offsets.size(); ++i)
+                c += (src.sample(uv + step * kernel.offsets[i]) +
+                      src.sample(uv - step * kernel.offsets[i])) * kernel.weights[i];
+            dst.at(x, y) = c;
+        }
+    return dst;
+}
+
+// shaders/KawaseDown.frag: half resolution, center plus four diagonal taps
+inline CpuImage kawaseDown(const CpuImage &src)
+{
+    CpuImage dst(std::max(src.width / 2, 1), std::max(src.height / 2, 1));
+    glm::vec2 texel = 1.0f / glm::vec2(src.width, src.height);
+    for (int y = 0; y < dst.height; ++y)
+        for (int x = 0; x < dst.width; ++x) {
+            glm::vec2 uv = dst.uvOf(x, y);
+            glm::vec3 c = src.sample(uv) * 4.0f;
+            c += src.sample(uv + glm::vec2(-texel.x, -texel.y));
+            c += src.sample(uv + glm::vec2( texel.x, -texel.y));
+            c += src.sample(uv + glm::vec2(-texel.x,  texel.y));
+            c += src.sample(uv + glm::vec2( texel.x,  texel.y));
+            dst.at(x, y) = c / 8.0f;
+        }
+    return dst;
+}
+
+// shaders/KawaseUp.frag: upsample to the given size with eight taps
+inline CpuImage kawaseUp(const CpuImage &src, int width, int height)
+{
+    CpuImage dst(width, height);
+    glm::vec2 texel = 1.0f / glm::vec2(src.width, src.height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            glm::vec2 uv = dst.uvOf(x, y);
+            glm::vec3 c(0.0f);
+            c += src.sample(uv + glm::vec2(-texel.x, 0.0f));
+            c += src.sample(uv + glm::vec2( texel.x, 0.0f));
+            c += src.sample(uv + glm::vec2(0.0f, -texel.y));
+            c += src.sample(uv + glm::vec2(0.0f,  texel.y));
+            c += src.sample(uv + 0.5f * glm::vec2(-texel.x, -texel.y)) * 2.0f;
+            c += src.sample(uv + 0.5f * glm::vec2( texel.x, -texel.y)) * 2.0f;
+            c += src.sample(uv + 0.5f * glm::vec2(-texel.x,  texel.y)) * 2.0f;
+            c += src.sample(uv + 0.5f * glm::vec2( texel.x,  texel.y)) * 2.0f;
+            dst.at(x, y) = c / 12.0f;
+        }
+    return dst;
+}
+
+// The full BlurEffect pipeline for a radius in full resolution pixels
+inline CpuImage blurPyramid(const CpuImage &src, float radius)
+{
+    int levels = BlurKernel::pyramidLevels(radius);
+    std::vector<CpuImage> pyramid(1, src);
+    for (int i = 0; i < levels; ++i)
+        pyramid.push_back(kawaseDown(pyramid.back()));
+    BlurKernel kernel = BlurKernel::linearSampled((int)std::ceil(radius / (1 << levels)));
+    CpuImage image = gaussianPass(pyramid.back(), kernel, glm::vec2(1.0f, 0.0f));
+    image = gaussianPass(image, kernel, glm::vec2(0.0f, 1.0f));
+    for (int i = levels - 1; i >= 0; --i)
+        image = kawaseUp(image, pyramid[i].width, pyramid[i].height);
+    return image;
+}
+
+// Peak signal to noise ratio in dB for images in [0, 1]
+inline double imagePSNR(const CpuImage &a, const CpuImage &b)
+{
+    double mse = 0.0;
+    for (unsigned int i = 0; i < a.pixels.size(); ++i) {
+        glm::vec3 d = a.pixels[i] - b.pixels[i];
+        mse += (d.x * d.x + d.y * d.y + d.z * d.z) / 3.0;
+    }
+    mse /= a.pixels.size();
+    return mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : 999.0;
+}
+
+#endif //PROJECT_BLURKERNEL_H
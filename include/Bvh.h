@@ -0,0 +1,505 @@
+//
+// Bounding volume hierarchy over object AABBs, without any OpenGL calls.
+//
+// build() splits top down with the surface area heuristic over
+// BUILD_BINS centroid bins per axis. update() moves one object's box, and
+// refit() then recomputes the node bounds bottom up in one backwards sweep
+// (children always come after their parent), which keeps the topology.
+// Rebuild once sahCost() has grown too far from the built tree.
+//
+// Nodes are 32 bytes, the two children of a node are next to each other
+// and the object boxes are copied into leaf order in the same format, so
+// a leaf's objects are contiguous. Queries pop up to four nodes (or leaf
+// objects) at a time, transpose their bounds into SSE registers and test
+// all four at once against the frustum, sphere or ray.
+//
+
+#ifndef PROJECT_BVH_H
+#define PROJECT_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "InstanceCulling.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define BVH_USE_SSE
+#endif
+
+struct Aabb {
+    glm::vec3 lo;
+    glm::vec3 hi;
+};
+
+// Inner nodes: count = 0, children at leftFirst and leftFirst + 1.
+// Leaves: count objects starting at leftFirst in the leaf ordered boxes.
+// Leaf ordered boxes use the same layout with the object index in
+// leftFirst.
+struct BvhNode {
+    glm::vec3 lo;
+    uint32_t leftFirst;
+    glm::vec3 hi;
+    uint32_t count;
+};
+
+static_assert(sizeof(BvhNode) == 32, "BVH nodes are expected to be 32 bytes");
+
+class Bvh
+{
+public:
+    static const int BUILD_BINS = 16;
+    static const unsigned int MAX_LEAF_SIZE = 8;
+
+    std::vector<BvhNode> nodes;
+
+    void build(const std::vector<Aabb> &boxes)
+    {
+        unsigned int count = (unsigned int)boxes.size();
+        items.resize(count);
+        itemOfObject.resize(count);
+        centroids.resize(count);
+        for (unsigned int i = 0; i < count; ++i) {
+            items[i].lo = boxes[i].lo;
+            items[i].hi = boxes[i].hi;
+            items[i].leftFirst = i;
+            items[i].count = 1;
+            centroids[i] = 0.5f * (boxes[i].lo + boxes[i].hi);
+        }
+        nodes.clear();
+        if (count == 0)
+            return;
+        // Node 1 stays unused so sibling pairs start on even indices
+        nodes.reserve(2 * count);
+        nodes.resize(2);
+        nodes[0].leftFirst = 0;
+        nodes[0].count = count;
+        nodes[1] = nodes[0];
+        nodes[1].count = 0;
+        splitNode(0);
+        for (unsigned int i = 0; i < count; ++i)
+            itemOfObject[items[i].leftFirst] = i;
+        std::vector<glm::vec3>().swap(centroids);
+    }
+
+    unsigned int objectCount() const
+    {
+        return (unsigned int)items.size();
+    }
+
+    // Takes effect in the bounds after the next refit()
+    void update(unsigned int object, const Aabb &box)
+    {
+        BvhNode &item = items[itemOfObject[object]];
+        item.lo = box.lo;
+        item.hi = box.hi;
+    }
+
+    void refit()
+    {
+        for (size_t n = nodes.size(); n-- > 0;) {
+            if (n == 1)
+                continue;
+            BvhNode &node = nodes[n];
+            if (node.count > 0) {
+                glm::vec3 lo = items[node.leftFirst].lo, hi = items[node.leftFirst].hi;
+                for (unsigned int i = 1; i < node.count; ++i) {
+                    lo = glm::min(lo, items[node.leftFirst + i].lo);
+                    hi = glm::max(hi, items[node.leftFirst + i].hi);
+                }
+                node.lo = lo;
+                node.hi = hi;
+            } else {
+                const BvhNode &left = nodes[node.leftFirst], &right = nodes[node.leftFirst + 1];
+                node.lo = glm::min(left.lo, right.lo);
+                node.hi = glm::max(left.hi, right.hi);
+            }
+        }
+    }
+
+    // Expected cost of a random ray relative to the root: sum of node
+    // areas (inner) and area times object count (leaves), over root area
+    float sahCost() const
+    {
+        if (nodes.empty())
+            return 0.0f;
+        float cost = 0.0f;
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            if (n == 1)
+                continue;
+            float area = surfaceArea(nodes[n].lo, nodes[n].hi);
+            cost += nodes[n].count > 0 ? area * nodes[n].count : area;
+        }
+        return cost / std::max(surfaceArea(nodes[0].lo, nodes[0].hi), 1.0e-20f);
+    }
+
+    // Objects whose box is at least partly inside the frustum
+    void queryFrustum(const Frustum &frustum, std::vector<unsigned int> &objects) const
+    {
+        objects.clear();
+        FrustumTest test(frustum);
+        traverse(test, [&](unsigned int object) { objects.push_back(object); });
+    }
+
+    // Objects whose box overlaps the sphere (xyz center, w radius), e.g. the
+    // objects a point light reaches
+    void querySphere(const glm::vec4 &sphere, std::vector<unsigned int> &objects) const
+    {
+        objects.clear();
+        SphereTest test(sphere);
+        traverse(test, [&](unsigned int object) { objects.push_back(object); });
+    }
+
+    // Nearest object box hit by the ray within (0, t], -1 if none. t is set
+    // to the hit distance in units of direction.
+    int raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &t) const
+    {
+        int nearest = -1;
+        RayTest test(origin, direction, t);
+        traverse(test, [&](unsigned int object) {
+            float hit = test.distance(items[itemOfObject[object]]);
+            if (hit >= 0.0f && hit < test.tMax) {
+                test.tMax = hit;
+                nearest = (int)object;
+            }
+        });
+        t = test.tMax;
+        return nearest;
+    }
+
+    static float surfaceArea(const glm::vec3 &lo, const glm::vec3 &hi)
+    {
+        glm::vec3 d = glm::max(hi - lo, glm::vec3(0.0f));
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+private:
+    std::vector<BvhNode> items;
+    std::vector<unsigned int> itemOfObject;
+    // Build only
+    std::vector<glm::vec3> centroids;
+
+    void boundsOf(unsigned int first, unsigned int count, glm::vec3 &lo, glm::vec3 &hi,
+                  glm::vec3 &centroidLo, glm::vec3 &centroidHi) const
+    {
+        lo = centroidLo = glm::vec3(1.0e30f);
+        hi = centroidHi = glm::vec3(-1.0e30f);
+        for (unsigned int i = first; i < first + count; ++i) {
+            lo = glm::min(lo, items[i].lo);
+            hi = glm::max(hi, items[i].hi);
+            const glm::vec3 &c = centroids[items[i].leftFirst];
+            centroidLo = glm::min(centroidLo, c);
+            centroidHi = glm::max(centroidHi, c);
+        }
+    }
+
+    // Iterative so a degenerate input cannot overflow the call stack
+    void splitNode(unsigned int root)
+    {
+        std::vector<unsigned int> pending(1, root);
+        while (!pending.empty()) {
+            unsigned int n = pending.back();
+            pending.pop_back();
+            unsigned int first = nodes[n].leftFirst, count = nodes[n].count;
+            glm::vec3 lo, hi, centroidLo, centroidHi;
+            boundsOf(first, count, lo, hi, centroidLo, centroidHi);
+            nodes[n].lo = lo;
+            nodes[n].hi = hi;
+
+            int axis;
+            // First bin of the right side until partitioned
+            unsigned int leftCount;
+            if (count <= 2 || !findSplit(first, count, lo, hi, centroidLo, centroidHi, axis, leftCount))
+                continue;
+
+            // Partition by bin, the same mapping findSplit used
+            float scale = BUILD_BINS / (centroidHi[axis] - centroidLo[axis]);
+            int split = (int)leftCount;
+            BvhNode *begin = &items[first];
+            BvhNode *middle = std::partition(begin, begin + count, [&](const BvhNode &item) {
+                return std::min(BUILD_BINS - 1,
+                                (int)((centroids[item.leftFirst][axis] - centroidLo[axis]) * scale)) < split;
+            });
+            leftCount = (unsigned int)(middle - begin);
+            if (leftCount == 0 || leftCount == count)
+                continue;
+
+            unsigned int left = (unsigned int)nodes.size();
+            nodes.resize(left + 2);
+            nodes[left].leftFirst = first;
+            nodes[left].count = leftCount;
+            nodes[left + 1].leftFirst = first + leftCount;
+            nodes[left + 1].count = count - leftCount;
+            nodes[n].leftFirst = left;
+            nodes[n].count = 0;
+            // Right first so the left subtree is laid out right after
+            pending.push_back(left + 1);
+            pending.push_back(left);
+        }
+    }
+
+    // Best binned SAH split, bestSplit is the first bin of the right side.
+    // False when staying a leaf is cheaper (and allowed).
+    bool findSplit(unsigned int first, unsigned int count, const glm::vec3 &lo, const glm::vec3 &hi,
+                   const glm::vec3 &centroidLo, const glm::vec3 &centroidHi, int &bestAxis,
+                   unsigned int &bestSplit) const
+    {
+        float bestCost = 1.0e30f;
+        bestAxis = -1;
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = centroidHi[axis] - centroidLo[axis];
+            if (extent <= 0.0f)
+                continue;
+            glm::vec3 binLo[BUILD_BINS], binHi[BUILD_BINS];
+            unsigned int binCount[BUILD_BINS] = {};
+            for (int b = 0; b < BUILD_BINS; ++b) {
+                binLo[b] = glm::vec3(1.0e30f);
+                binHi[b] = glm::vec3(-1.0e30f);
+            }
+            float scale = BUILD_BINS / extent;
+            for (unsigned int i = first; i < first + count; ++i) {
+                int b = std::min(BUILD_BINS - 1,
+                                 (int)((centroids[items[i].leftFirst][axis] - centroidLo[axis]) * scale));
+                ++binCount[b];
+                binLo[b] = glm::min(binLo[b], items[i].lo);
+                binHi[b] = glm::max(binHi[b], items[i].hi);
+            }
+            // Sweep from the right to get the area of every right side
+            float rightArea[BUILD_BINS];
+            unsigned int rightCount[BUILD_BINS];
+            glm::vec3 accLo(1.0e30f), accHi(-1.0e30f);
+            unsigned int acc = 0;
+            for (int b = BUILD_BINS - 1; b > 0; --b) {
+                acc += binCount[b];
+                accLo = glm::min(accLo, binLo[b]);
+                accHi = glm::max(accHi, binHi[b]);
+                rightCount[b] = acc;
+                rightArea[b] = surfaceArea(accLo, accHi);
+            }
+            accLo = glm::vec3(1.0e30f);
+            accHi = glm::vec3(-1.0e30f);
+            acc = 0;
+            for (int b = 0; b < BUILD_BINS - 1; ++b) {
+                acc += binCount[b];
+                accLo = glm::min(accLo, binLo[b]);
+                accHi = glm::max(accHi, binHi[b]);
+                if (acc == 0 || rightCount[b + 1] == 0)
+                    continue;
+                float cost = acc * surfaceArea(accLo, accHi) + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = (unsigned int)(b + 1);
+                }
+            }
+        }
+        if (bestAxis < 0)
+            return false;
+        // One traversal step costs about as much as one box test
+        float leafCost = count * surfaceArea(lo, hi);
+        return count > MAX_LEAF_SIZE || bestCost + surfaceArea(lo, hi) < leafCost;
+    }
+
+#ifdef BVH_USE_SSE
+    // Bounds of four boxes as x, y and z of the low and high corners, one
+    // box per lane
+    struct Boxes4 {
+        __m128 loX, loY, loZ, hiX, hiY, hiZ;
+    };
+
+    static void load4(const BvhNode *const boxes[4], Boxes4 &out)
+    {
+        __m128 r0 = _mm_loadu_ps(&boxes[0]->lo.x), r1 = _mm_loadu_ps(&boxes[1]->lo.x);
+        __m128 r2 = _mm_loadu_ps(&boxes[2]->lo.x), r3 = _mm_loadu_ps(&boxes[3]->lo.x);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        out.loX = r0;
+        out.loY = r1;
+        out.loZ = r2;
+        r0 = _mm_loadu_ps(&boxes[0]->hi.x);
+        r1 = _mm_loadu_ps(&boxes[1]->hi.x);
+        r2 = _mm_loadu_ps(&boxes[2]->hi.x);
+        r3 = _mm_loadu_ps(&boxes[3]->hi.x);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        out.hiX = r0;
+        out.hiY = r1;
+        out.hiZ = r2;
+    }
+#endif
+
+    // Bit i set when boxes[i] passes, count up to four
+    template <typename Test>
+    static int test4(const Test &test, const BvhNode *boxes[4], int count)
+    {
+#ifdef BVH_USE_SSE
+        for (int i = count; i < 4; ++i)
+            boxes[i] = boxes[0];
+        Boxes4 soa;
+        load4(boxes, soa);
+        return test.test4(soa) & ((1 << count) - 1);
+#else
+        int mask = 0;
+        for (int i = 0; i < count; ++i)
+            mask |= test.test(*boxes[i]) ? 1 << i : 0;
+        return mask;
+#endif
+    }
+
+    template <typename Test, typename Emit>
+    void traverse(const Test &test, Emit emit) const
+    {
+        if (nodes.empty())
+            return;
+        std::vector<unsigned int> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        const BvhNode *batch[4];
+        unsigned int indices[4];
+        while (!stack.empty()) {
+            int count = 0;
+            while (count < 4 && !stack.empty()) {
+                indices[count] = stack.back();
+                stack.pop_back();
+                batch[count] = &nodes[indices[count]];
+                ++count;
+            }
+            int mask = test4(test, batch, count);
+            for (int i = 0; i < count; ++i) {
+                if (!(mask & (1 << i)))
+                    continue;
+                const BvhNode &node = nodes[indices[i]];
+                if (node.count == 0) {
+                    stack.push_back(node.leftFirst + 1);
+                    stack.push_back(node.leftFirst);
+                    continue;
+                }
+                for (unsigned int j = 0; j < node.count; j += 4) {
+                    const BvhNode *objects[4];
+                    int objectCount = (int)std::min(4u, node.count - j);
+                    for (int k = 0; k < objectCount; ++k)
+                        objects[k] = &items[node.leftFirst + j + k];
+                    int hits = test4(test, objects, objectCount);
+                    for (int k = 0; k < objectCount; ++k) {
+                        if (hits & (1 << k))
+                            emit(items[node.leftFirst + j + k].leftFirst);
+                    }
+                }
+            }
+        }
+    }
+
+    struct FrustumTest {
+        Frustum frustum;
+
+        explicit FrustumTest(const Frustum &frustum_) : frustum(frustum_) {}
+
+        // Outside when the corner furthest along a plane normal is behind it
+        bool test(const BvhNode &box) const
+        {
+            for (int p = 0; p < 6; ++p) {
+                const glm::vec4 &plane = frustum.planes[p];
+                glm::vec3 corner(plane.x >= 0.0f ? box.hi.x : box.lo.x, plane.y >= 0.0f ? box.hi.y : box.lo.y,
+                                 plane.z >= 0.0f ? box.hi.z : box.lo.z);
+                if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                    return false;
+            }
+            return true;
+        }
+
+#ifdef BVH_USE_SSE
+        int test4(const Boxes4 &b) const
+        {
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < 6; ++p) {
+                const glm::vec4 &plane = frustum.planes[p];
+                __m128 x = plane.x >= 0.0f ? b.hiX : b.loX;
+                __m128 y = plane.y >= 0.0f ? b.hiY : b.loY;
+                __m128 z = plane.z >= 0.0f ? b.hiZ : b.loZ;
+                // Same order of operations as the scalar test
+                __m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+                d = _mm_add_ps(_mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(plane.z))), _mm_set1_ps(plane.w));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+            }
+            return ~_mm_movemask_ps(outside) & 15;
+        }
+#endif
+    };
+
+    struct SphereTest {
+        glm::vec4 sphere;
+
+        explicit SphereTest(const glm::vec4 &sphere_) : sphere(sphere_) {}
+
+        bool test(const BvhNode &box) const
+        {
+            glm::vec3 c(sphere);
+            glm::vec3 d = glm::max(glm::max(box.lo - c, c - box.hi), glm::vec3(0.0f));
+            return glm::dot(d, d) <= sphere.w * sphere.w;
+        }
+
+#ifdef BVH_USE_SSE
+        int test4(const Boxes4 &b) const
+        {
+            __m128 zero = _mm_setzero_ps();
+            __m128 cx = _mm_set1_ps(sphere.x), cy = _mm_set1_ps(sphere.y), cz = _mm_set1_ps(sphere.z);
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(b.loX, cx), _mm_sub_ps(cx, b.hiX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(b.loY, cy), _mm_sub_ps(cy, b.hiY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(b.loZ, cz), _mm_sub_ps(cz, b.hiZ)), zero);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            return _mm_movemask_ps(_mm_cmple_ps(d2, _mm_set1_ps(sphere.w * sphere.w)));
+        }
+#endif
+    };
+
+    // Slab test. tMax shrinks as closer hits are found, so boxes behind the
+    // nearest hit so far are skipped.
+    struct RayTest {
+        glm::vec3 origin, inverse;
+        float tMax;
+
+        RayTest(const glm::vec3 &origin_, const glm::vec3 &direction, float tMax_)
+                : origin(origin_), tMax(tMax_)
+        {
+            // Zero components become huge rather than infinite so 0 * inf
+            // never turns into NaN
+            for (int i = 0; i < 3; ++i)
+                inverse[i] = 1.0f / (std::fabs(direction[i]) > 1.0e-20f ? direction[i] : 1.0e-20f);
+        }
+
+        // Entry distance (0 from inside), negative for a miss
+        float distance(const BvhNode &box) const
+        {
+            glm::vec3 t0 = (box.lo - origin) * inverse, t1 = (box.hi - origin) * inverse;
+            glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+            float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+            float exit = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+            return enter <= exit ? enter : -1.0f;
+        }
+
+        bool test(const BvhNode &box) const
+        {
+            return distance(box) >= 0.0f;
+        }
+
+#ifdef BVH_USE_SSE
+        int test4(const Boxes4 &b) const
+        {
+            __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+            __m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+            __m128 x0 = _mm_mul_ps(_mm_sub_ps(b.loX, ox), ix), x1 = _mm_mul_ps(_mm_sub_ps(b.hiX, ox), ix);
+            __m128 y0 = _mm_mul_ps(_mm_sub_ps(b.loY, oy), iy), y1 = _mm_mul_ps(_mm_sub_ps(b.hiY, oy), iy);
+            __m128 z0 = _mm_mul_ps(_mm_sub_ps(b.loZ, oz), iz), z1 = _mm_mul_ps(_mm_sub_ps(b.hiZ, oz), iz);
+            __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                                      _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+            __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                                     _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(tMax)));
+            return _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+        }
+#endif
+    };
+};
+
+#endif //PROJECT_BVH_H
@@ -79,6 +79,17 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // Returns the direction of the ray from Position through the window
+    // coordinates (x, y), with the origin at the top left like GLFW cursor
+    // positions, for a perspective projection with Zoom as vertical fov
+    glm::vec3 GetCursorRay(double x, double y, int width, int height)
+    {
+        float tanHalfFov = tan(glm::radians(Zoom) * 0.5f);
+        float ndcX = (float)(2.0 * x / width - 1.0);
+        float ndcY = (float)(1.0 - 2.0 * y / height);
+        return glm::normalize(Front + Right * (ndcX * tanHalfFov * width / height) + Up * (ndcY * tanHalfFov));
+    }
+
     // Processes input received from any keyboard-like input system.
     // Accepts input parameter in the form of camera defined ENUM
     // (to abstract it from windowing systems)
@@ -0,0 +1,119 @@
+//
+// Clustered forward lighting: bins point lights with LightClusterGrid and
+// uploads the result into three texture buffers for the fragment shader
+// (see shaders/ClusteredLighting.frag).
+//   lightData     RGBA32F, four texels per ClusterLight
+//   clusterRanges RG32UI, (offset, count) per cluster
+//   lightIndices  R32UI, indices into lightData
+//
+
+#ifndef PROJECT_CLUSTEREDLIGHTING_H
+#define PROJECT_CLUSTEREDLIGHTING_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "Shader.h"
+#include "LightCluster.h"
+
+class ClusteredLighting
+{
+public:
+    LightClusterGrid grid;
+    std::vector<ClusterLight> lights;
+
+    ClusteredLighting()
+    {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        // Texture buffers must have storage before they are bound to a texture
+        for (int i = 0; i < 3; ++i) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        attachTextures();
+    }
+
+    // Add a point light. The cluster radius is derived from the attenuation.
+    int addPointLightSource(glm::vec3 position, glm::vec3 ambient, glm::vec3 diffuse,
+                            glm::vec3 specular,
+                            float constant = 1.0, float linear = 0.09, float quadratic = 0.032)
+    {
+        ClusterLight light;
+        light.position = position;
+        light.radius = LightClusterGrid::attenuationRadius(constant, linear, quadratic);
+        light.ambient = ambient;
+        light.diffuse = diffuse;
+        light.specular = specular;
+        light.constant = constant;
+        light.linear = linear;
+        light.quadratic = quadratic;
+        lights.push_back(light);
+        return (int)lights.size() - 1;
+    }
+
+    void setProjection(float fovY, float aspect, float near, float far)
+    {
+        grid.setProjection(fovY, aspect, near, far);
+    }
+
+    // Bin the lights for this frame and upload everything the shader needs
+    void update(const glm::mat4 &view)
+    {
+        grid.build(view, lights);
+        upload(buffers[0], lights.size() * sizeof(ClusterLight),
+               lights.empty() ? nullptr : &lights[0]);
+        upload(buffers[1], grid.clusterRanges.size() * sizeof(unsigned int),
+               &grid.clusterRanges[0]);
+        upload(buffers[2], grid.lightIndices.size() * sizeof(unsigned int),
+               grid.lightIndices.empty() ? nullptr : &grid.lightIndices[0]);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Bind the three buffer textures to firstUnit .. firstUnit + 2 and set the
+    // uniforms that describe the grid. screenWidth/Height are framebuffer pixels.
+    void bind(Shader &shader, int firstUnit, int screenWidth, int screenHeight)
+    {
+        static const char *names[3] = { "lightData", "clusterRanges", "lightIndices" };
+        for (int i = 0; i < 3; ++i) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            shader.setInt(names[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        shader.setVec3("clusterGrid", glm::vec3(LightClusterGrid::TILES_X,
+                                                LightClusterGrid::TILES_Y,
+                                                LightClusterGrid::SLICES));
+        shader.setVec2("clusterTileSize", glm::vec2((float)screenWidth / LightClusterGrid::TILES_X,
+                                                    (float)screenHeight / LightClusterGrid::TILES_Y));
+        shader.setFloat("clusterSliceScale", grid.sliceScale);
+        shader.setFloat("clusterSliceBias", grid.sliceBias);
+    }
+
+private:
+    unsigned int buffers[3];
+    unsigned int textures[3];
+
+    void attachTextures()
+    {
+        static const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        for (int i = 0; i < 3; ++i) {
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    static void upload(unsigned int buffer, size_t size, const void *data)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // Orphan the old storage so we never wait for the previous frame
+        glBufferData(GL_TEXTURE_BUFFER, size ? size : 16, nullptr, GL_STREAM_DRAW);
+        if (size)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+};
+
+#endif //PROJECT_CLUSTEREDLIGHTING_H
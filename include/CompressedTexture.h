@@ -0,0 +1,115 @@
+//
+// Uploads a CompressedImage (TextureCache.h) with glCompressedTexImage2D,
+// every mip level as it was built on the CPU, so nothing is generated on
+// the GPU. RGTC (BC4, BC5) is core since OpenGL 3.0; S3TC (BC1, BC3) is
+// an extension that every desktop driver has but the core profile does
+// not promise, so without it the levels are decoded on the CPU and
+// uploaded uncompressed instead.
+//
+// BC4 textures hold grey specular maps in red; the green and blue
+// swizzles repeat red so shaders that read .rgb get grey back.
+//
+
+#ifndef PROJECT_COMPRESSEDTEXTURE_H
+#define PROJECT_COMPRESSEDTEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <vector>
+
+#include "TextureCache.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+inline bool s3tcSupported()
+{
+    static int supported = -1;
+    if (supported < 0) {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count && !supported; ++i) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+            supported = name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+        }
+    }
+    return supported == 1;
+}
+
+// Whether format goes up compressed, otherwise it is decoded first
+inline bool uploadsCompressed(BlockFormat format)
+{
+    return format == BLOCK_BC4 || format == BLOCK_BC5 || s3tcSupported();
+}
+
+// Bytes one level takes on the GPU, uncompressed when the upload has to
+// fall back
+inline size_t uploadedLevelBytes(BlockFormat format, int width, int height)
+{
+    return uploadsCompressed(format) ? compressedSize(format, width, height) : (size_t)width * height * 4;
+}
+
+inline size_t compressedTextureBytes(const CompressedImage &image)
+{
+    size_t total = 0;
+    for (unsigned int i = 0; i < image.levels.size(); ++i)
+        total += uploadedLevelBytes(image.format, std::max(image.width >> i, 1), std::max(image.height >> i, 1));
+    return total;
+}
+
+// One level of a texture bound to target, which is GL_TEXTURE_2D or a
+// cube map face. scratch holds the decoded pixels of the fallback.
+inline void uploadCompressedLevel(GLenum target, int level, BlockFormat format, int width, int height,
+                                  const std::vector<uint8_t> &blocks, std::vector<uint8_t> &scratch)
+{
+    if (uploadsCompressed(format)) {
+        glCompressedTexImage2D(target, level, blockGlFormat(format), width, height, 0, (GLsizei)blocks.size(),
+                               blocks.data());
+    } else {
+        scratch.resize((size_t)width * height * 4);
+        decompressImage(format, blocks.data(), width, height, scratch.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(target, level, format == BLOCK_BC1 ? GL_RGB : GL_RGBA, width, height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, scratch.data());
+    }
+}
+
+// Grey BC4 specular maps read back as grey
+inline void setCompressedSwizzle(GLenum target, BlockFormat format)
+{
+    if (format == BLOCK_BC4) {
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+}
+
+// Texture with repeat wrapping and trilinear filtering, like TextureFromData
+inline unsigned int TextureFromCompressed(const CompressedImage &image)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    std::vector<uint8_t> scratch;
+    for (unsigned int level = 0; level < image.levels.size(); ++level) {
+        uploadCompressedLevel(GL_TEXTURE_2D, (int)level, image.format, std::max(image.width >> level, 1),
+                              std::max(image.height >> level, 1), image.levels[level], scratch);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    setCompressedSwizzle(GL_TEXTURE_2D, image.format);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+#endif //PROJECT_COMPRESSEDTEXTURE_H
@@ -0,0 +1,205 @@
+//
+// Linear allocators for data that only lives for a frame.
+//
+// LinearArena hands out memory by bumping an offset through one block and
+// frees all of it at once in reset(). An allocation that does not fit
+// goes to the heap instead of failing, and the next reset() grows the
+// block to the peak use of the frame, so after the first few frames a
+// steady state frame never touches the heap.
+//
+// FrameArena keeps two arenas. beginFrame() switches to the other one and
+// resets it, so whatever was built last frame stays valid while this
+// frame is built (e.g. for a pass that consumes it one frame late).
+//
+// ArenaAllocator<T> lets STL containers allocate from an arena. Its
+// deallocate does nothing, memory only comes back in reset(), so reserve
+// containers up front (a growing vector leaves its old buffers behind) and
+// never keep one across the reset of its arena.
+//
+
+#ifndef PROJECT_FRAMEARENA_H
+#define PROJECT_FRAMEARENA_H
+
+#include <vector>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+class LinearArena
+{
+public:
+    explicit LinearArena(size_t capacity_ = 0)
+            : block(nullptr), capacity(0), offset(0), overflow(nullptr), overflowBytes(0), overflowCount(0)
+    {
+        reserve(capacity_);
+    }
+
+    ~LinearArena()
+    {
+        releaseOverflow();
+        std::free(block);
+    }
+
+    LinearArena(const LinearArena &) = delete;
+    LinearArena &operator=(const LinearArena &) = delete;
+
+    // alignment has to be a power of two, at most alignof(std::max_align_t)
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + size <= capacity) {
+            offset = start + size;
+            return block + start;
+        }
+        // Chained in front of the memory so release needs no container
+        Overflow *node = (Overflow *)std::malloc(sizeof(Overflow) + size);
+        node->next = overflow;
+        overflow = node;
+        overflowBytes += size + alignment;
+        ++overflowCount;
+        return node + 1;
+    }
+
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Frees everything allocated since the last reset, growing the block
+    // when it overflowed
+    void reset()
+    {
+        if (overflowBytes > 0) {
+            size_t peak = offset + overflowBytes;
+            releaseOverflow();
+            reserve(peak + peak / 2);
+        }
+        offset = 0;
+    }
+
+    // Grows the block. Only right after a reset, nothing may point into
+    // the old block.
+    void reserve(size_t bytes)
+    {
+        if (bytes <= capacity)
+            return;
+        std::free(block);
+        block = (char *)std::malloc(bytes);
+        capacity = bytes;
+        offset = 0;
+    }
+
+    // Bytes used this frame including overflow, the block size and how
+    // many allocations missed the block since the last reset
+    size_t used() const
+    {
+        return offset + overflowBytes;
+    }
+
+    size_t blockSize() const
+    {
+        return capacity;
+    }
+
+    unsigned int overflowed() const
+    {
+        return overflowCount;
+    }
+
+private:
+    struct Overflow {
+        Overflow *next;
+        // Keeps the memory after the header aligned
+        std::max_align_t padding;
+    };
+
+    char *block;
+    size_t capacity, offset;
+    Overflow *overflow;
+    size_t overflowBytes;
+    unsigned int overflowCount;
+
+    void releaseOverflow()
+    {
+        while (overflow) {
+            Overflow *next = overflow->next;
+            std::free(overflow);
+            overflow = next;
+        }
+        overflowBytes = 0;
+        overflowCount = 0;
+    }
+};
+
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(LinearArena &arena_) : arena(&arena_) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count)
+    {
+        return arena->template allocateArray<T>(count);
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const
+    {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const
+    {
+        return arena != other.arena;
+    }
+
+private:
+    template <typename U> friend class ArenaAllocator;
+    LinearArena *arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T> >;
+
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = 1 << 20) : current(0)
+    {
+        arenas[0].reserve(capacity);
+        arenas[1].reserve(capacity);
+    }
+
+    void beginFrame()
+    {
+        current ^= 1;
+        arenas[current].reset();
+    }
+
+    LinearArena &arena()
+    {
+        return arenas[current];
+    }
+
+    // Empty vector of this frame, reserve before filling it
+    template <typename T>
+    FrameVector<T> vector()
+    {
+        return FrameVector<T>(ArenaAllocator<T>(arenas[current]));
+    }
+
+private:
+    LinearArena arenas[2];
+    unsigned int current;
+};
+
+#endif //PROJECT_FRAMEARENA_H
@@ -0,0 +1,364 @@
+//
+// Screenshots and frame capture without stalling the frame.
+//
+// FrameCapture::capture() starts an asynchronous glReadPixels of the
+// current read framebuffer (the back buffer of a window or any FBO, so it
+// works the same headless) into one of a ring of pixel pack buffers and
+// puts a fence behind it. poll(), once per frame, looks at the fences
+// without waiting: reads the GPU has finished, normally one or two frames
+// later, are mapped, copied out and handed to CaptureWriter, whose threads
+// encode PNG or dump raw pixels while the next frames render. Only when
+// every buffer of the ring is still in flight does capture() wait for the
+// oldest (counted in stalls()).
+//
+// CaptureWriter keeps its frames and their pixel memory for reuse, so
+// capturing every frame does not allocate once it runs. When its writers
+// fall behind and maxQueued frames wait, new frames are dropped (counted)
+// rather than letting memory grow or the renderer wait on the disk.
+//
+//     FrameCapture capture;
+//     ... draw ...
+//     capture.capture(width, height, "screenshots/frame.png");
+//     capture.poll();
+//     swap buffers
+//     ...
+//     capture.finish();   // before the context goes, waits for the files
+//
+
+#ifndef PROJECT_FRAMECAPTURE_H
+#define PROJECT_FRAMECAPTURE_H
+
+#include <glad/glad.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <iostream>
+
+#include "ImageWriter.h"
+
+enum CaptureFormat { CAPTURE_PNG, CAPTURE_RAW };
+
+// RGBA pixels, bottom row first as glReadPixels returns them
+struct CapturedFrame {
+    std::string path;
+    int width, height;
+    CaptureFormat format;
+    std::vector<unsigned char> pixels;
+};
+
+class CaptureWriter
+{
+public:
+    explicit CaptureWriter(unsigned int threads = 2, unsigned int maxQueued_ = 8)
+            : maxQueued(maxQueued_ < 1 ? 1 : maxQueued_), inUse(0), quit(false), writtenCount(0),
+              droppedCount(0), failedCount(0), writeTime(0.0), queue(maxQueued), queueFirst(0), queueCount(0)
+    {
+        for (unsigned int i = 0; i < threads; ++i)
+            writers.emplace_back(&CaptureWriter::writerLoop, this);
+    }
+
+    ~CaptureWriter()
+    {
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        queueChanged.notify_all();
+        for (unsigned int i = 0; i < writers.size(); ++i)
+            writers[i].join();
+        for (unsigned int i = 0; i < freeFrames.size(); ++i)
+            delete freeFrames[i];
+    }
+
+    CaptureWriter(const CaptureWriter &) = delete;
+    CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+    // A frame to fill in and submit, nullptr (and one more dropped frame)
+    // when maxQueued are waiting or being written already
+    CapturedFrame *acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (inUse >= maxQueued) {
+            ++droppedCount;
+            return nullptr;
+        }
+        ++inUse;
+        if (freeFrames.empty())
+            return new CapturedFrame;
+        CapturedFrame *frame = freeFrames.back();
+        freeFrames.pop_back();
+        return frame;
+    }
+
+    void submit(CapturedFrame *frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue[(queueFirst + queueCount++) % queue.size()] = frame;
+        }
+        queueChanged.notify_one();
+    }
+
+    // Gives back a frame that will not be submitted
+    void discard(CapturedFrame *frame)
+    {
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeFrames.push_back(frame);
+            done = --inUse == 0;
+        }
+        if (done)
+            idle.notify_all();
+    }
+
+    // Waits until every submitted frame is on disk
+    void finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return inUse == 0; });
+    }
+
+    unsigned long long written()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return writtenCount;
+    }
+
+    unsigned long long dropped()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return droppedCount;
+    }
+
+    unsigned long long failed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return failedCount;
+    }
+
+    // Time the writer threads spent encoding and writing, added up
+    double writeMilliseconds()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return writeTime;
+    }
+
+private:
+    unsigned int maxQueued, inUse;
+    bool quit;
+    unsigned long long writtenCount, droppedCount, failedCount;
+    double writeTime;
+    std::vector<std::thread> writers;
+    // Ring of submitted frames, never more than maxQueued
+    std::vector<CapturedFrame *> queue;
+    size_t queueFirst, queueCount;
+    std::vector<CapturedFrame *> freeFrames;
+    std::mutex mutex;
+    std::condition_variable queueChanged, idle;
+
+    void writerLoop()
+    {
+        for (;;) {
+            CapturedFrame *frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [this]() { return quit || queueCount > 0; });
+                if (queueCount == 0)
+                    return;
+                frame = queue[queueFirst];
+                queueFirst = (queueFirst + 1) % queue.size();
+                --queueCount;
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            bool ok;
+            if (frame->format == CAPTURE_PNG)
+                ok = writePng(frame->path.c_str(), frame->width, frame->height, 4, frame->pixels.data(), true, 3);
+            else
+                ok = writeRaw(frame->path.c_str(), frame->width, frame->height, 4, frame->pixels.data());
+            double milliseconds = std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            if (!ok)
+                std::cout << "Failed to write " << frame->path << std::endl;
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++(ok ? writtenCount : failedCount);
+                writeTime += milliseconds;
+                freeFrames.push_back(frame);
+                done = --inUse == 0;
+            }
+            if (done)
+                idle.notify_all();
+        }
+    }
+};
+
+class FrameCapture
+{
+public:
+    // ring: reads in flight at once. 3 leaves the GPU two frames to finish
+    // one before capture() has to wait for it.
+    explicit FrameCapture(unsigned int ring = 3, unsigned int writerThreads = 2, unsigned int maxQueued = 8)
+            : slots(ring < 2 ? 2 : ring), first(0), pending(0), stallCount(0), capturedCount(0),
+              copyTime(0.0), writer(writerThreads, maxQueued)
+    {
+    }
+
+    // Needs the context still current, call finish() first
+    ~FrameCapture()
+    {
+        for (unsigned int i = 0; i < slots.size(); ++i) {
+            if (slots[i].fence)
+                glDeleteSync(slots[i].fence);
+            if (slots[i].buffer)
+                glDeleteBuffers(1, &slots[i].buffer);
+        }
+    }
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    // Queue a read of the lower left width x height pixels of the read
+    // framebuffer, to be written to path
+    void capture(int width, int height, const char *path, CaptureFormat format = CAPTURE_PNG)
+    {
+        if (pending == slots.size()) {
+            // Every buffer still in flight, the oldest has to come back now
+            ++stallCount;
+            collect(slots[first], true);
+            first = (first + 1) % slots.size();
+            --pending;
+        }
+        Slot &slot = slots[(first + pending) % slots.size()];
+        size_t bytes = (size_t)width * height * 4;
+        if (!slot.buffer)
+            glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (bytes > slot.capacity) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            slot.capacity = bytes;
+        }
+        // RGBA rows are always 4 byte aligned, the default pack alignment
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        slot.format = format;
+        slot.path = path;
+        ++pending;
+        ++capturedCount;
+    }
+
+    // Hand every finished read to the writers, oldest first, without
+    // waiting for the GPU
+    void poll()
+    {
+        while (pending > 0 && collect(slots[first], false)) {
+            first = (first + 1) % slots.size();
+            --pending;
+        }
+    }
+
+    // Waits for the GPU and then for the files
+    void finish()
+    {
+        while (pending > 0) {
+            collect(slots[first], true);
+            first = (first + 1) % slots.size();
+            --pending;
+        }
+        writer.finish();
+    }
+
+    unsigned long long captured() const
+    {
+        return capturedCount;
+    }
+
+    // Captures that had to wait for the GPU
+    unsigned long long stalls() const
+    {
+        return stallCount;
+    }
+
+    // Milliseconds spent copying out of mapped buffers on this thread
+    double copyMilliseconds() const
+    {
+        return copyTime;
+    }
+
+    CaptureWriter &writers()
+    {
+        return writer;
+    }
+
+private:
+    struct Slot {
+        unsigned int buffer;
+        size_t capacity;
+        GLsync fence;
+        int width, height;
+        CaptureFormat format;
+        std::string path;
+
+        Slot() : buffer(0), capacity(0), fence(nullptr), width(0), height(0), format(CAPTURE_PNG) {}
+    };
+
+    std::vector<Slot> slots;
+    // Oldest read in flight and how many there are
+    size_t first, pending;
+    unsigned long long stallCount, capturedCount;
+    double copyTime;
+    CaptureWriter writer;
+
+    // False when wait is false and the read is not finished yet
+    bool collect(Slot &slot, bool wait)
+    {
+        GLuint64 timeout = wait ? 1000000000ull : 0;
+        GLenum status;
+        do {
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        } while (wait && status == GL_TIMEOUT_EXPIRED);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        CapturedFrame *frame = writer.acquire();
+        if (!frame)
+            return true;
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t bytes = (size_t)slot.width * slot.height * 4;
+        frame->path = slot.path;
+        frame->width = slot.width;
+        frame->height = slot.height;
+        frame->format = slot.format;
+        frame->pixels.resize(bytes);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (pixels) {
+            std::memcpy(frame->pixels.data(), pixels, bytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        copyTime += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        if (pixels) {
+            writer.submit(frame);
+        } else {
+            std::cout << "Failed to map capture buffer for " << slot.path << std::endl;
+            writer.discard(frame);
+        }
+        return true;
+    }
+};
+
+#endif //PROJECT_FRAMECAPTURE_H
@@ -0,0 +1,134 @@
+//
+// Hands frames from a simulation thread to a render thread. The pipeline
+// owns a ring of packets, everything one frame needs to be drawn (camera,
+// transforms, light parameters, draw lists), so the simulation can build
+// frame N + 1 while the render thread issues the GL calls of frame N.
+//
+// Producer (simulation):              Consumer (render, owns the context):
+//     Packet *p = pipeline.beginWrite();  while (Packet *p = pipeline.beginRead()) {
+//     ... fill *p ...                         ... draw *p, swap ...
+//     pipeline.endWrite();                    pipeline.endRead();
+//                                         }
+//
+// beginWrite blocks while every packet is queued or being drawn, so the
+// simulation never runs more than depth - 1 frames ahead of the screen.
+// Packets are reused in turn and never cleared: vectors inside keep their
+// capacity, so a steady state frame does not allocate. close() lets the
+// consumer draw what is queued, then beginRead returns nullptr; open()
+// starts over with an empty ring.
+//
+
+#ifndef PROJECT_FRAMEPIPELINE_H
+#define PROJECT_FRAMEPIPELINE_H
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+
+template <typename Packet>
+class FramePipeline
+{
+public:
+    // depth 2 is double buffering, one packet drawn while the next is built
+    explicit FramePipeline(unsigned int depth = 2)
+            : packets(depth < 2 ? 2 : depth), first(0), queued(0), reading(0), closed(false),
+              producerWait(0.0), consumerWait(0.0)
+    {
+    }
+
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+
+    unsigned int depth() const
+    {
+        return (unsigned int)packets.size();
+    }
+
+    // Free packet for the next frame, nullptr once closed
+    Packet *beginWrite()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return closed || queued + reading < packets.size(); });
+        producerWait += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        if (closed)
+            return nullptr;
+        return &packets[(first + reading + queued) % packets.size()];
+    }
+
+    void endWrite()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++queued;
+        }
+        changed.notify_all();
+    }
+
+    // Oldest queued packet, nullptr when closed and nothing is left
+    Packet *beginRead()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return closed || queued > 0; });
+        consumerWait += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        if (queued == 0)
+            return nullptr;
+        --queued;
+        reading = 1;
+        return &packets[first];
+    }
+
+    void endRead()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            reading = 0;
+            first = (first + 1) % packets.size();
+        }
+        changed.notify_all();
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+    // Only after the consumer has seen nullptr and the producer has no
+    // packet open
+    void open()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        first = queued = reading = 0;
+        closed = false;
+    }
+
+    // Milliseconds each side spent blocked since the last call: a
+    // simulation that keeps waiting is render bound and the other way round
+    void takeWaitTimes(double &producerMilliseconds, double &consumerMilliseconds)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        producerMilliseconds = producerWait;
+        consumerMilliseconds = consumerWait;
+        producerWait = consumerWait = 0.0;
+    }
+
+private:
+    std::vector<Packet> packets;
+    // Index of the packet being drawn or next to draw, packets queued after
+    // it and whether the consumer holds it
+    size_t first, queued, reading;
+    bool closed;
+    double producerWait, consumerWait;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#endif //PROJECT_FRAMEPIPELINE_H
@@ -0,0 +1,122 @@
+//
+// Render targets for deferred shading.
+//   albedoSpec   RGBA8    diffuse color, specular intensity
+//   normal       RGBA16F  octahedral encoded normal (xy), shininess (z)
+//   accumulation RGBA16F  emission from the geometry pass, then every light
+//   depth        DEPTH24_STENCIL8, used to rebuild the world position
+// The light accumulation pass renders through a second framebuffer that only
+// has the accumulation texture attached, so the G-buffer can be sampled
+// while lights are blended on top.
+//
+
+#ifndef PROJECT_GBUFFER_H
+#define PROJECT_GBUFFER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+class GBuffer
+{
+public:
+    unsigned int geometryFBO, lightFBO;
+    unsigned int albedoSpec, normal, accumulation, depth;
+    int width, height;
+
+    GBuffer(int width_, int height_)
+            : width(0), height(0)
+    {
+        glGenFramebuffers(1, &geometryFBO);
+        glGenFramebuffers(1, &lightFBO);
+        glGenTextures(1, &albedoSpec);
+        glGenTextures(1, &normal);
+        glGenTextures(1, &accumulation);
+        glGenTextures(1, &depth);
+        resize(width_, height_);
+    }
+
+    // (Re)allocate all targets. Cheap to call every frame, it only does
+    // work when the size changes.
+    void resize(int width_, int height_)
+    {
+        if (width_ == width && height_ == height)
+            return;
+        width = width_;
+        height = height_;
+
+        allocate(albedoSpec, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        allocate(normal, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        allocate(accumulation, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        allocate(depth, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, geometryFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpec, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, accumulation, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                        GL_COLOR_ATTACHMENT2 };
+        glDrawBuffers(3, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Error: Incomplete G-buffer!" << std::endl;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Error: Incomplete light accumulation framebuffer!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void beginGeometryPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, geometryFBO);
+        glViewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Lights are summed with additive blending and no depth test
+    void beginLightPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
+    void endLightPass()
+    {
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Bind albedoSpec, normal and depth to firstUnit .. firstUnit + 2
+    void bindTextures(int firstUnit)
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_2D, albedoSpec);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_2D, normal);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    void allocate(unsigned int texture, GLint internalFormat, GLenum format, GLenum type)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+
+#endif //PROJECT_GBUFFER_H
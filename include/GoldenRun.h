@@ -0,0 +1,209 @@
+//
+// Golden image mode for the demos. Started with
+//
+//     Phong --golden out.png [--frames N] [--time T] [--name value ...]
+//
+// a demo renders N frames (30 by default) with the clock stopped at T
+// seconds (1 by default), so animations and the camera are the same on
+// every run, writes the last frame to out.png and quits. The frames go to
+// an sRGB framebuffer object of the window's size, not to the window: the
+// window is hidden, and the pixels of a hidden window's back buffer are
+// whatever the driver makes of them.
+// The frames after the first are timed with glFinish, which takes shader
+// compilation and uploads out of the numbers, and the result is printed as
+//
+//     golden frame time: <mean> ms (min <min> ms, N frames)
+//
+// for the GoldenImages runner (src/Benchmarks/GoldenImages.cpp) to pick
+// up. Without --golden nothing changes: time() is glfwGetTime(),
+// framebuffer() is 0 and frameDone() returns false right away.
+//
+//     GoldenRun gGolden;
+//     main: gGolden.parse(argc, argv); before init()
+//     init: gGolden.hintWindow(samples); before glfwCreateWindow, with the
+//           GLFW_SAMPLES of the demo
+//           gGolden.begin(window); once glad has loaded
+//     draw: glBindFramebuffer(GL_FRAMEBUFFER, gGolden.framebuffer());
+//           wherever the demo would bind 0
+//     loop: auto currentFrame = gGolden.time();
+//           ... draw ...
+//           if (gGolden.frameDone()) break;
+//           glfwSwapBuffers(window);
+//
+
+#ifndef PROJECT_GOLDENRUN_H
+#define PROJECT_GOLDENRUN_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+#include "FrameCapture.h"
+
+class GoldenRun
+{
+public:
+    static const int DEFAULT_FRAMES = 30;
+
+    GoldenRun()
+            : frames(DEFAULT_FRAMES), fixedTime(1.0f), samples(0), width(0), height(0), FBO(0), resolveFBO(0),
+              colorRBO(0), depthRBO(0), resolveRBO(0), rendered(0), totalTime(0.0), minTime(0.0)
+    {
+    }
+
+    GoldenRun(const GoldenRun &) = delete;
+    GoldenRun &operator=(const GoldenRun &) = delete;
+
+    void parse(int argc, char *argv[])
+    {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strncmp(argv[i], "--", 2) != 0 || i + 1 == argc) {
+                std::cout << "Ignoring argument " << argv[i] << std::endl;
+                continue;
+            }
+            const char *name = argv[i] + 2;
+            const char *value = argv[++i];
+            if (std::strcmp(name, "golden") == 0)
+                output = value;
+            else if (std::strcmp(name, "frames") == 0)
+                frames = std::max(1, std::atoi(value));
+            else if (std::strcmp(name, "time") == 0)
+                fixedTime = (float)std::atof(value);
+            else
+                options.emplace_back(name, value);
+        }
+    }
+
+    bool active() const
+    {
+        return !output.empty();
+    }
+
+    // Value of --name, nullptr when it was not given
+    const char *option(const char *name) const
+    {
+        for (unsigned int i = 0; i < options.size(); ++i) {
+            if (options[i].first == name)
+                return options[i].second.c_str();
+        }
+        return nullptr;
+    }
+
+    // samples_ is the GLFW_SAMPLES the demo asks for; the golden
+    // framebuffer gets as many, whatever visual GLFW ends up with
+    void hintWindow(int samples_ = 0)
+    {
+        samples = samples_;
+        if (active())
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
+    // Create the golden framebuffer and bind it in place of the window's
+    void begin(GLFWwindow *window)
+    {
+        if (!active())
+            return;
+        glfwGetFramebufferSize(window, &width, &height);
+        glGenFramebuffers(1, &FBO);
+        glGenRenderbuffers(1, &colorRBO);
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_SRGB8_ALPHA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Error: Incomplete golden framebuffer!" << std::endl;
+        }
+
+        // Multisampled pixels are resolved into a plain one before reading
+        if (samples > 0) {
+            glGenFramebuffers(1, &resolveFBO);
+            glGenRenderbuffers(1, &resolveRBO);
+            glBindRenderbuffer(GL_RENDERBUFFER, resolveRBO);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveRBO);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "Error: Incomplete golden resolve framebuffer!" << std::endl;
+            }
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    }
+
+    // What the demo binds to draw to the screen: 0, or in golden mode the
+    // golden framebuffer
+    unsigned int framebuffer() const
+    {
+        return FBO;
+    }
+
+    float time() const
+    {
+        return active() ? fixedTime : (float)glfwGetTime();
+    }
+
+    // Call after drawing, before the swap. True once the last frame has
+    // been written and the demo should quit.
+    bool frameDone()
+    {
+        if (!active())
+            return false;
+        glFinish();
+        auto now = std::chrono::high_resolution_clock::now();
+        if (rendered == 0) {
+            // Timing against a vsync would measure the display
+            glfwSwapInterval(0);
+        } else {
+            double milliseconds = std::chrono::duration<double, std::milli>(now - lastFinish).count();
+            totalTime += milliseconds;
+            minTime = rendered == 1 ? milliseconds : std::min(minTime, milliseconds);
+        }
+        lastFinish = now;
+        if (++rendered < frames)
+            return false;
+
+        if (samples > 0) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, samples > 0 ? resolveFBO : FBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        {
+            FrameCapture capture(2, 1, 1);
+            capture.capture(width, height, output.c_str());
+            capture.finish();
+            if (capture.writers().written() != 1)
+                std::cout << "golden: failed to write " << output << std::endl;
+        }
+        int timed = rendered - 1;
+        std::cout << "golden frame time: " << (timed > 0 ? totalTime / timed : 0.0) << " ms (min " << minTime
+                  << " ms, " << timed << " frames)" << std::endl;
+        return true;
+    }
+
+private:
+    std::string output;
+    int frames;
+    float fixedTime;
+    std::vector<std::pair<std::string, std::string>> options;
+    int samples, width, height;
+    // Not deleted: they go with the context when the demo quits
+    unsigned int FBO, resolveFBO, colorRBO, depthRBO, resolveRBO;
+    int rendered;
+    double totalTime, minTime;
+    std::chrono::high_resolution_clock::time_point lastFinish;
+};
+
+#endif //PROJECT_GOLDENRUN_H
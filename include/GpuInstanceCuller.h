@@ -0,0 +1,217 @@
+//
+// GPU driven frustum culling of instances, using only GL 4.0 features.
+// One pass over the instance bounding spheres (one point each):
+//   - a geometry shader drops the spheres outside the frustum and emits the
+//     index of each survivor, which transform feedback appends to
+//     visibleBuffer in instance order,
+//   - every survivor is also rasterized to the single pixel of a R32F
+//     target with additive blending, each adding 2^-32, so the pixel ends
+//     up holding the survivor count as a fraction of 2^32.
+// glReadPixels with a GL_UNSIGNED_INT type converts that back to the exact
+// count (up to 2^24 instances) and, with the indirect buffer bound as the
+// pixel pack buffer, writes it straight into instanceCount of the
+// DrawElementsIndirectCommands. Nothing is read back to the CPU, so the
+// CPU cost per frame does not depend on the number of instances.
+// Instance shaders take the survivor index as an integer instance
+// attribute (see bindVisibleIndices) and fetch their data themselves.
+// InstanceCulling.h has the CPU reference of the test.
+//
+
+#ifndef PROJECT_GPUINSTANCECULLER_H
+#define PROJECT_GPUINSTANCECULLER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+#include "Shader.h"
+#include "InstanceCulling.h"
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    // baseInstance before GL 4.2
+    GLuint reservedMustBeZero;
+};
+
+class GpuInstanceCuller
+{
+public:
+    unsigned int visibleBuffer, indirectBuffer;
+
+    // spheres: world space bounding sphere of every instance. commands: one
+    // per mesh drawn with the visible instances, instanceCount is ignored.
+    GpuInstanceCuller(const std::vector<glm::vec4> &spheres,
+                      const std::vector<DrawElementsIndirectCommand> &commands)
+            : cullShader("shaders/InstanceCull.vert", "shaders/InstanceCull.frag",
+                         "shaders/InstanceCull.geom"),
+              instanceCount((unsigned int)spheres.size()),
+              commandCount((unsigned int)commands.size())
+    {
+        // Varyings have to be declared before linking, so link again
+        const char *varyings[] = { "visibleIndex" };
+        glTransformFeedbackVaryings(cullShader.ID, 1, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(cullShader.ID);
+        int success;
+        glGetProgramiv(cullShader.ID, GL_LINK_STATUS, &success);
+        if (!success)
+            std::cout << "Failed to link instance culling shader!" << std::endl;
+
+        glGenVertexArrays(1, &sphereVAO);
+        glGenBuffers(1, &sphereBuffer);
+        glBindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, sphereBuffer);
+        glBufferData(GL_ARRAY_BUFFER, spheres.size() * sizeof(glm::vec4), spheres.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glBindVertexArray(0);
+
+        glGenBuffers(1, &visibleBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+        glBufferData(GL_ARRAY_BUFFER, spheres.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                     commands.data(), GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        glGenTextures(1, &countTexture);
+        glBindTexture(GL_TEXTURE_2D, countTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &countFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, countFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, countTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Instance count framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~GpuInstanceCuller()
+    {
+        glDeleteProgram(cullShader.ID);
+        glDeleteVertexArrays(1, &sphereVAO);
+        glDeleteBuffers(1, &sphereBuffer);
+        glDeleteBuffers(1, &visibleBuffer);
+        glDeleteBuffers(1, &indirectBuffer);
+        glDeleteFramebuffers(1, &countFBO);
+        glDeleteTextures(1, &countTexture);
+    }
+
+    // True when the context has what cull() and glDrawElementsIndirect need
+    static bool supported()
+    {
+        return GLAD_GL_VERSION_4_0 != 0;
+    }
+
+    // Fill visibleBuffer and the instance counts of the indirect commands.
+    // Leaves the default framebuffer bound with the previous viewport.
+    void cull(const glm::mat4 &viewProjection)
+    {
+        Frustum frustum = extractFrustum(viewProjection);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, countFBO);
+        glViewport(0, 0, 1, 1);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        cullShader.use();
+        glUniform4fv(glGetUniformLocation(cullShader.ID, "planes"), 6, &frustum.planes[0][0]);
+        glBindVertexArray(sphereVAO);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, visibleBuffer);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)instanceCount);
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+
+        // Count into the first command, then copy it to the others
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, indirectBuffer);
+        glReadPixels(0, 0, 1, 1, GL_RED, GL_UNSIGNED_INT,
+                     (void*)offsetof(DrawElementsIndirectCommand, instanceCount));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (commandCount > 1) {
+            glBindBuffer(GL_COPY_READ_BUFFER, indirectBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, indirectBuffer);
+            for (unsigned int i = 1; i < commandCount; ++i)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                    offsetof(DrawElementsIndirectCommand, instanceCount),
+                                    i * sizeof(DrawElementsIndirectCommand) +
+                                    offsetof(DrawElementsIndirectCommand, instanceCount),
+                                    sizeof(GLuint));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        glDisable(GL_BLEND);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // Bounding spheres of moving instances, as many as at construction
+    void updateSpheres(const std::vector<glm::vec4> &spheres)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, sphereBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(glm::vec4), spheres.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Feed visibleBuffer to `location` of the currently bound VAO as a per
+    // instance unsigned int
+    void bindVisibleIndices(unsigned int location)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+        glEnableVertexAttribArray(location);
+        glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(location, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Draw command `command` with the VAO (set up with bindVisibleIndices)
+    // and program the caller has bound
+    void draw(unsigned int command)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                               (void*)(command * sizeof(DrawElementsIndirectCommand)));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // Read the result of the last cull() back. Waits for the GPU, only for
+    // validation.
+    void readVisible(std::vector<unsigned int> &visible)
+    {
+        DrawElementsIndirectCommand command;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        visible.resize(std::min(command.instanceCount, instanceCount));
+        glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(GLuint), visible.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    Shader cullShader;
+    unsigned int sphereVAO, sphereBuffer;
+    unsigned int countFBO, countTexture;
+    unsigned int instanceCount, commandCount;
+};
+
+#endif //PROJECT_GPUINSTANCECULLER_H
@@ -0,0 +1,79 @@
+//
+// A small wrapper around GL_TIME_ELAPSED queries.
+// Queries are kept in a ring so that reading a result never stalls
+// the pipeline: the value returned is from a few frames ago.
+//
+
+#ifndef PROJECT_GPUTIMER_H
+#define PROJECT_GPUTIMER_H
+
+#include <glad/glad.h>
+
+class GpuTimer
+{
+public:
+    static const int QUERY_COUNT = 4;
+
+    // Latest finished measurement, in milliseconds
+    double lastMilliseconds;
+    // Running sum and count since the last call to reset()
+    double totalMilliseconds;
+    unsigned int sampleCount;
+
+    GpuTimer()
+            : lastMilliseconds(0.0), totalMilliseconds(0.0), sampleCount(0),
+              current(0), issued(0)
+    {
+        glGenQueries(QUERY_COUNT, queries);
+    }
+
+    void begin()
+    {
+        // Collect the oldest query before we reuse its slot
+        if (issued >= QUERY_COUNT)
+            collect(queries[current]);
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        current = (current + 1) % QUERY_COUNT;
+        if (issued < QUERY_COUNT)
+            ++issued;
+    }
+
+    double averageMilliseconds() const
+    {
+        return sampleCount ? totalMilliseconds / sampleCount : 0.0;
+    }
+
+    void reset()
+    {
+        totalMilliseconds = 0.0;
+        sampleCount = 0;
+    }
+
+    void release()
+    {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+
+private:
+    unsigned int queries[QUERY_COUNT];
+    int current;
+    int issued;
+
+    void collect(unsigned int query)
+    {
+        GLuint64 elapsed = 0;
+        // The query is QUERY_COUNT - 1 frames old, so the result is normally
+        // available and this does not block
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        lastMilliseconds = elapsed / 1.0e6;
+        totalMilliseconds += lastMilliseconds;
+        ++sampleCount;
+    }
+};
+
+#endif //PROJECT_GPUTIMER_H
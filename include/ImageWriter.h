@@ -0,0 +1,277 @@
+//
+// Writes 8 bit images without any library.
+//
+// writePng stores the image data in uncompressed deflate blocks: no zlib,
+// very little CPU per byte (one CRC and one Adler checksum pass), and
+// every viewer, browser and stb_image reads the files. They are about as
+// large as the raw pixels, which is the trade made for capturing every
+// frame. writeRaw dumps the pixels with no header at all, the fastest
+// path when something else converts the frames later.
+//
+// flipRows writes the last row first, which turns glReadPixels output
+// (bottom row first) the right way up. outChannels 3 drops the alpha of
+// RGBA pixels, 0 keeps the channels of the input.
+//
+
+#ifndef PROJECT_IMAGEWRITER_H
+#define PROJECT_IMAGEWRITER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Slicing by 8: table k advances the CRC of a byte by k more bytes
+struct Crc32Tables {
+    uint32_t tables[8][256];
+
+    Crc32Tables()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            tables[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int t = 1; t < 8; ++t)
+                tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+        }
+    }
+};
+
+inline const uint32_t *crc32Tables()
+{
+    // Built once, also when the first calls come from several threads
+    static const Crc32Tables crc;
+    return &crc.tables[0][0];
+}
+
+// Running CRC-32 (PNG chunks) and Adler-32 (zlib stream) of what goes to
+// a file, through a small buffer
+class PngStream
+{
+public:
+    explicit PngStream(FILE *file_)
+            : file(file_), tables(crc32Tables()), crc(0xFFFFFFFFu), adlerA(1), adlerB(0), used(0), ok(true)
+    {
+    }
+
+    void startChunk(const char *type, uint32_t length)
+    {
+        unsigned char header[8];
+        putBigEndian(header, length);
+        for (int i = 0; i < 4; ++i)
+            header[4 + i] = (unsigned char)type[i];
+        put(header, 4);
+        crc = 0xFFFFFFFFu;
+        write(header + 4, 4);
+    }
+
+    void endChunk()
+    {
+        unsigned char value[4];
+        putBigEndian(value, crc ^ 0xFFFFFFFFu);
+        put(value, 4);
+    }
+
+    // Chunk data, counted in the CRC
+    void write(const unsigned char *data, size_t size)
+    {
+        const uint32_t *t = tables;
+        uint32_t c = crc;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint32_t low = c ^ ((uint32_t)data[i] | (uint32_t)data[i + 1] << 8 | (uint32_t)data[i + 2] << 16 |
+                                (uint32_t)data[i + 3] << 24);
+            uint32_t high = (uint32_t)data[i + 4] | (uint32_t)data[i + 5] << 8 | (uint32_t)data[i + 6] << 16 |
+                            (uint32_t)data[i + 7] << 24;
+            c = t[7 * 256 + (low & 0xFF)] ^ t[6 * 256 + ((low >> 8) & 0xFF)] ^
+                t[5 * 256 + ((low >> 16) & 0xFF)] ^ t[4 * 256 + (low >> 24)] ^
+                t[3 * 256 + (high & 0xFF)] ^ t[2 * 256 + ((high >> 8) & 0xFF)] ^
+                t[256 + ((high >> 16) & 0xFF)] ^ t[high >> 24];
+        }
+        for (; i < size; ++i)
+            c = t[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        crc = c;
+        put(data, size);
+    }
+
+    // Deflated data, counted in the Adler checksum as well
+    void writeData(const unsigned char *data, size_t size)
+    {
+        // 5552 bytes is the most that cannot overflow before the modulo
+        size_t done = 0;
+        while (done < size) {
+            size_t n = size - done < 5552 ? size - done : 5552;
+            uint32_t a = adlerA, b = adlerB;
+            const unsigned char *d = data + done;
+            size_t i = 0;
+            // Four bytes at a time: b gains 4a plus the bytes weighted by
+            // how many of the four sums they are part of
+            for (; i + 4 <= n; i += 4) {
+                b += 4 * a + 4 * d[i] + 3 * d[i + 1] + 2 * d[i + 2] + d[i + 3];
+                a += d[i] + d[i + 1] + d[i + 2] + d[i + 3];
+            }
+            for (; i < n; ++i) {
+                a += d[i];
+                b += a;
+            }
+            adlerA = a % 65521;
+            adlerB = b % 65521;
+            done += n;
+        }
+        write(data, size);
+    }
+
+    uint32_t adler() const
+    {
+        return adlerB << 16 | adlerA;
+    }
+
+    bool finish()
+    {
+        flush();
+        return ok;
+    }
+
+    static void putBigEndian(unsigned char *out, uint32_t value)
+    {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    FILE *file;
+    const uint32_t *tables;
+    uint32_t crc, adlerA, adlerB;
+    size_t used;
+    bool ok;
+    unsigned char buffer[BUFFER_SIZE];
+
+    void put(const unsigned char *data, size_t size)
+    {
+        if (used + size > BUFFER_SIZE)
+            flush();
+        if (size >= BUFFER_SIZE) {
+            ok = ok && fwrite(data, 1, size, file) == size;
+            return;
+        }
+        std::memcpy(buffer + used, data, size);
+        used += size;
+    }
+
+    void flush()
+    {
+        if (used > 0)
+            ok = ok && fwrite(buffer, 1, used, file) == used;
+        used = 0;
+    }
+};
+
+inline bool writePng(const char *path, int width, int height, int channels, const unsigned char *pixels,
+                     bool flipRows = false, int outChannels = 0)
+{
+    if (outChannels == 0)
+        outChannels = channels;
+    if (width <= 0 || height <= 0 || channels < 3 || channels > 4 || outChannels < 3 || outChannels > channels)
+        return false;
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, 8, file);
+    PngStream png(file);
+    unsigned char header[13];
+    PngStream::putBigEndian(header, (uint32_t)width);
+    PngStream::putBigEndian(header + 4, (uint32_t)height);
+    header[8] = 8;
+    // Truecolour, or truecolour with alpha
+    header[9] = outChannels == 4 ? 6 : 2;
+    header[10] = header[11] = header[12] = 0;
+    png.startChunk("IHDR", 13);
+    png.write(header, 13);
+    png.endChunk();
+
+    // One filter byte (none) in front of every row, cut into stored
+    // blocks of at most 65535 bytes
+    const size_t rowBytes = 1 + (size_t)width * outChannels;
+    const size_t dataBytes = rowBytes * height;
+    const size_t blocks = (dataBytes + 65534) / 65535;
+    png.startChunk("IDAT", (uint32_t)(2 + blocks * 5 + dataBytes + 4));
+    // zlib header: deflate with a 32K window, no preset dictionary
+    static const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+    png.write(zlibHeader, 2);
+
+    unsigned char row[1 + 4 * 8192];
+    size_t blockLeft = 0, written = 0;
+    // Pixels are converted a run at a time so the row buffer stays small
+    const int runPixels = 8192;
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *source = pixels + (size_t)(flipRows ? height - 1 - y : y) * width * channels;
+        for (int x = -1; x < width;) {
+            size_t size = 0;
+            if (x < 0) {
+                row[size++] = 0;
+                x = 0;
+            }
+            int run = width - x < runPixels ? width - x : runPixels;
+            if (outChannels == channels) {
+                for (size_t i = 0; i < (size_t)run * channels; ++i)
+                    row[size + i] = source[(size_t)x * channels + i];
+                size += (size_t)run * channels;
+            } else {
+                for (int i = 0; i < run; ++i) {
+                    const unsigned char *p = source + (size_t)(x + i) * channels;
+                    row[size++] = p[0];
+                    row[size++] = p[1];
+                    row[size++] = p[2];
+                }
+            }
+            x += run;
+            // The run may straddle the end of a stored block
+            size_t offset = 0;
+            while (offset < size) {
+                if (blockLeft == 0) {
+                    size_t length = dataBytes - written < 65535 ? dataBytes - written : 65535;
+                    unsigned char block[5] = { (unsigned char)(written + length == dataBytes ? 1 : 0),
+                                               (unsigned char)length, (unsigned char)(length >> 8),
+                                               (unsigned char)~length, (unsigned char)(~length >> 8) };
+                    png.write(block, 5);
+                    blockLeft = length;
+                }
+                size_t n = size - offset < blockLeft ? size - offset : blockLeft;
+                png.writeData(row + offset, n);
+                offset += n;
+                blockLeft -= n;
+                written += n;
+            }
+        }
+    }
+    unsigned char adler[4];
+    PngStream::putBigEndian(adler, png.adler());
+    png.write(adler, 4);
+    png.endChunk();
+
+    png.startChunk("IEND", 0);
+    png.endChunk();
+    bool ok = png.finish();
+    return fclose(file) == 0 && ok;
+}
+
+// The pixels as they are, width * height * channels bytes
+inline bool writeRaw(const char *path, int width, int height, int channels, const unsigned char *pixels)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    size_t size = (size_t)width * height * channels;
+    bool ok = fwrite(pixels, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+#endif //PROJECT_IMAGEWRITER_H
@@ -0,0 +1,115 @@
+//
+// CPU side of instance frustum culling, without any OpenGL calls.
+// Every instance is a world space bounding sphere (xyz center, w radius)
+// tested against the six planes of the view frustum. GpuInstanceCuller.h
+// runs the same test in a geometry shader, this is the reference it is
+// validated against.
+//
+
+#ifndef PROJECT_INSTANCECULLING_H
+#define PROJECT_INSTANCECULLING_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Planes point inwards: dot(xyz, p) + w >= 0 inside
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Gribb/Hartmann plane extraction, normalized so the plane distance is in
+// world units
+inline Frustum extractFrustum(const glm::mat4 &viewProjection)
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                            viewProjection[2][i], viewProjection[3][i]);
+    Frustum frustum;
+    for (int i = 0; i < 3; ++i) {
+        frustum.planes[2 * i] = rows[3] + rows[i];
+        frustum.planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (int i = 0; i < 6; ++i)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    return frustum;
+}
+
+// Signed distance of the sphere surface to the closest plane, negative
+// means culled
+inline float sphereFrustumDistance(const Frustum &frustum, const glm::vec4 &sphere)
+{
+    float distance = 1.0e30f;
+    for (int i = 0; i < 6; ++i) {
+        const glm::vec4 &p = frustum.planes[i];
+        distance = std::min(distance, p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w + sphere.w);
+    }
+    return distance;
+}
+
+inline bool sphereInFrustum(const Frustum &frustum, const glm::vec4 &sphere)
+{
+    return sphereFrustumDistance(frustum, sphere) >= 0.0f;
+}
+
+// Indices of the visible spheres in increasing order, which is also the
+// order transform feedback writes them in. Any allocator, so per frame
+// lists can come from a FrameArena.
+template <typename Allocator>
+void cullSpheres(const std::vector<glm::vec4> &spheres, const Frustum &frustum,
+                 std::vector<unsigned int, Allocator> &visible)
+{
+    visible.clear();
+    for (unsigned int i = 0; i < spheres.size(); ++i) {
+        if (sphereInFrustum(frustum, spheres[i]))
+            visible.push_back(i);
+    }
+}
+
+// Sphere around the vertex positions, centered on their bounding box
+template <typename V>
+glm::vec4 boundingSphere(const std::vector<V> &vertices)
+{
+    if (vertices.empty())
+        return glm::vec4(0.0f);
+    glm::vec3 lo = vertices[0].position, hi = vertices[0].position;
+    for (unsigned int i = 1; i < vertices.size(); ++i) {
+        lo = glm::min(lo, vertices[i].position);
+        hi = glm::max(hi, vertices[i].position);
+    }
+    glm::vec3 center = 0.5f * (lo + hi);
+    float radius2 = 0.0f;
+    for (unsigned int i = 0; i < vertices.size(); ++i) {
+        glm::vec3 d = vertices[i].position - center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    return glm::vec4(center, std::sqrt(radius2));
+}
+
+inline glm::vec4 mergeSpheres(const glm::vec4 &a, const glm::vec4 &b)
+{
+    glm::vec3 d = glm::vec3(b) - glm::vec3(a);
+    float distance = glm::length(d);
+    if (distance + b.w <= a.w)
+        return a;
+    if (distance + a.w <= b.w)
+        return b;
+    float radius = 0.5f * (distance + a.w + b.w);
+    glm::vec3 center = glm::vec3(a) + d * ((radius - a.w) / distance);
+    return glm::vec4(center, radius);
+}
+
+// The sphere after model, scaled by the largest axis scale so it stays
+// conservative under non uniform scale
+inline glm::vec4 transformSphere(const glm::mat4 &model, const glm::vec4 &sphere)
+{
+    glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+    float scale = std::max(glm::length(glm::vec3(model[0])),
+                           std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return glm::vec4(center, sphere.w * scale);
+}
+
+#endif //PROJECT_INSTANCECULLING_H
@@ -0,0 +1,390 @@
+//
+// Work stealing job system. Every thread of the pool owns a Chase-Lev
+// deque (WorkStealingDeque.h): it pushes and takes its own jobs at the
+// bottom, newest first, and when it runs dry it steals the oldest job of
+// another thread, which for split ranges is the largest piece left.
+// Threads that do not belong to the pool submit through a locked inbox.
+//
+// run(counter, f) adds a job to counter and counter drops back when the
+// job has returned, so a job that runs children on the counter it was
+// started with keeps its parent's wait going until the children are done
+// too. wait(counter) does not block while jobs are left, it runs them
+// (wait by helping), which also makes waiting inside a job safe.
+//
+// parallelFor(count, grain, f) splits [0, count) in halves down to grain
+// iterations, forEach(count, f) calls f(i) for every index with grain 1.
+// Both return when everything is done, idle workers sleep in between.
+// The free parallelFor(pool, ...) is for code that takes an optional
+// JobPool *, without one it runs on the calling thread.
+//
+// Callables up to JOB_STORAGE bytes live inside the job and finished jobs
+// are recycled, so once the pool has warmed up running jobs does not
+// allocate.
+//
+
+#ifndef PROJECT_JOBPOOL_H
+#define PROJECT_JOBPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "WorkStealingDeque.h"
+
+// Unfinished jobs started with JobPool::run on this counter
+class JobCounter
+{
+public:
+    JobCounter() : pending(0) {}
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    bool done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobPool;
+    std::atomic<unsigned int> pending;
+};
+
+class JobPool
+{
+public:
+    // Failed steal rounds before an idle worker goes to sleep
+    static const int SPIN_ROUNDS = 64;
+    static const size_t JOB_STORAGE = 48;
+    // Finished jobs a thread keeps for itself, the rest are shared. The
+    // shared list starts with PREALLOCATED_JOBS per thread.
+    static const size_t LOCAL_FREE_JOBS = 16;
+    static const size_t PREALLOCATED_JOBS = 64;
+
+    // threads counts the calling thread, 0 uses every hardware thread.
+    // The constructing thread owns the first deque.
+    explicit JobPool(unsigned int threads = 0)
+            : owner(std::this_thread::get_id()), inboxSize(0), sleeping(0), signal(0), quit(false)
+    {
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        freeJobs.resize(threads);
+        for (unsigned int i = 0; i < threads; ++i) {
+            queues.emplace_back(new WorkStealingDeque<Job *>());
+            freeJobs[i].reserve(LOCAL_FREE_JOBS);
+        }
+        sharedFreeJobs.reserve(threads * PREALLOCATED_JOBS);
+        for (unsigned int i = 0; i < threads * PREALLOCATED_JOBS; ++i)
+            sharedFreeJobs.push_back(new Job);
+        for (unsigned int i = 1; i < threads; ++i)
+            workers.emplace_back(&JobPool::workerLoop, this, i);
+    }
+
+    ~JobPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (unsigned int i = 0; i < workers.size(); ++i)
+            workers[i].join();
+        for (unsigned int i = 0; i < freeJobs.size(); ++i) {
+            for (unsigned int j = 0; j < freeJobs[i].size(); ++j)
+                delete freeJobs[i][j];
+        }
+        for (unsigned int i = 0; i < sharedFreeJobs.size(); ++i)
+            delete sharedFreeJobs[i];
+    }
+
+    unsigned int threadCount() const
+    {
+        return (unsigned int)workers.size() + 1;
+    }
+
+    template <typename F>
+    void run(JobCounter &counter, F f)
+    {
+        typedef typename std::decay<F>::type Callable;
+        int index = queueIndex();
+        Job *job = allocateJob(index);
+        if (sizeof(Callable) <= JOB_STORAGE && alignof(Callable) <= alignof(std::max_align_t)) {
+            job->callable = new (job->storage) Callable(std::move(f));
+            job->invoke = &invokeStored<Callable>;
+        } else {
+            job->callable = new Callable(std::move(f));
+            job->invoke = &invokeAllocated<Callable>;
+        }
+        job->counter = &counter;
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        if (index >= 0) {
+            queues[index]->push(job);
+        } else {
+            std::lock_guard<std::mutex> lock(mutex);
+            inbox.push_back(job);
+            inboxSize.store(inbox.size(), std::memory_order_relaxed);
+        }
+        notifyWorkers();
+    }
+
+    void wait(JobCounter &counter)
+    {
+        int index = queueIndex();
+        uint32_t random = (uint32_t)(size_t)&counter | 1u;
+        while (!counter.done()) {
+            Job *job = findJob(index, random);
+            if (job)
+                execute(job, index);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // f(begin, end) for pieces of at most grain indices, in parallel
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, F f)
+    {
+        grain = std::max<size_t>(grain, 1);
+        if (count <= grain || workers.empty()) {
+            if (count > 0)
+                f((size_t)0, count);
+            return;
+        }
+        struct Split {
+            JobPool *pool;
+            JobCounter *counter;
+            F *f;
+            size_t grain;
+
+            void operator()(size_t begin, size_t end) const
+            {
+                // Hand the upper half to the thieves, keep splitting the lower
+                while (end - begin > grain) {
+                    size_t middle = begin + (end - begin) / 2;
+                    const Split *split = this;
+                    pool->run(*counter, [split, middle, end]() { (*split)(middle, end); });
+                    end = middle;
+                }
+                (*f)(begin, end);
+            }
+        };
+        JobCounter counter;
+        Split split = { this, &counter, &f, grain };
+        split(0, count);
+        wait(counter);
+    }
+
+    template <typename F>
+    void forEach(size_t count, F f)
+    {
+        parallelFor(count, 1, [&f](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                f(i);
+        });
+    }
+
+private:
+    struct Job {
+        void (*invoke)(Job *);
+        void *callable;
+        JobCounter *counter;
+        alignas(std::max_align_t) unsigned char storage[JOB_STORAGE];
+    };
+
+    std::thread::id owner;
+    std::vector<std::unique_ptr<WorkStealingDeque<Job *> > > queues;
+    std::vector<std::thread> workers;
+    // Jobs from threads outside the pool
+    std::deque<Job *> inbox;
+    std::atomic<size_t> inboxSize;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<unsigned int> sleeping;
+    unsigned int signal;
+    bool quit;
+    // Per thread, only touched by the thread itself
+    std::vector<std::vector<Job *> > freeJobs;
+    std::vector<Job *> sharedFreeJobs;
+    std::mutex freeMutex;
+
+    template <typename C>
+    static void invokeStored(Job *job)
+    {
+        C *callable = static_cast<C *>(job->callable);
+        (*callable)();
+        callable->~C();
+    }
+
+    template <typename C>
+    static void invokeAllocated(Job *job)
+    {
+        C *callable = static_cast<C *>(job->callable);
+        (*callable)();
+        delete callable;
+    }
+
+    Job *allocateJob(int index)
+    {
+        if (index >= 0) {
+            std::vector<Job *> &local = freeJobs[index];
+            if (local.empty()) {
+                std::lock_guard<std::mutex> lock(freeMutex);
+                size_t moved = std::min(sharedFreeJobs.size(), LOCAL_FREE_JOBS / 2);
+                local.insert(local.end(), sharedFreeJobs.end() - moved, sharedFreeJobs.end());
+                sharedFreeJobs.resize(sharedFreeJobs.size() - moved);
+            }
+            if (!local.empty()) {
+                Job *job = local.back();
+                local.pop_back();
+                return job;
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(freeMutex);
+            if (!sharedFreeJobs.empty()) {
+                Job *job = sharedFreeJobs.back();
+                sharedFreeJobs.pop_back();
+                return job;
+            }
+        }
+        return new Job;
+    }
+
+    void freeJob(int index, Job *job)
+    {
+        if (index >= 0 && freeJobs[index].size() < LOCAL_FREE_JOBS) {
+            freeJobs[index].push_back(job);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(freeMutex);
+        sharedFreeJobs.push_back(job);
+    }
+
+    struct ThreadSlot {
+        const JobPool *pool;
+        int index;
+    };
+
+    static ThreadSlot &threadSlot()
+    {
+        static thread_local ThreadSlot slot = { nullptr, -1 };
+        return slot;
+    }
+
+    // Deque of the calling thread, -1 outside the pool
+    int queueIndex() const
+    {
+        const ThreadSlot &slot = threadSlot();
+        if (slot.pool == this)
+            return slot.index;
+        return std::this_thread::get_id() == owner ? 0 : -1;
+    }
+
+    void execute(Job *job, int index)
+    {
+        job->invoke(job);
+        job->counter->pending.fetch_sub(1, std::memory_order_release);
+        freeJob(index, job);
+    }
+
+    // Own deque first, then the inbox, then one steal attempt per other
+    // thread starting at a random one
+    Job *findJob(int index, uint32_t &random)
+    {
+        Job *job = nullptr;
+        if (index >= 0 && queues[index]->take(job))
+            return job;
+        if (inboxSize.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!inbox.empty()) {
+                job = inbox.front();
+                inbox.pop_front();
+                inboxSize.store(inbox.size(), std::memory_order_relaxed);
+                return job;
+            }
+        }
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        unsigned int count = (unsigned int)queues.size();
+        for (unsigned int i = 0, victim = random % count; i < count; ++i, victim = (victim + 1) % count) {
+            if ((int)victim != index && queues[victim]->steal(job))
+                return job;
+        }
+        return nullptr;
+    }
+
+    void notifyWorkers()
+    {
+        // Pairs with the increment of sleeping before the last look for
+        // work in workerLoop: either that look finds the job or this sees
+        // the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++signal;
+        }
+        wake.notify_all();
+    }
+
+    void workerLoop(int index)
+    {
+        threadSlot().pool = this;
+        threadSlot().index = index;
+        uint32_t random = 2654435761u * (uint32_t)(index + 1);
+        int idle = 0;
+        for (;;) {
+            Job *job = findJob(index, random);
+            if (job) {
+                execute(job, index);
+                idle = 0;
+                continue;
+            }
+            if (++idle < SPIN_ROUNDS) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (quit)
+                return;
+            unsigned int seen = signal;
+            lock.unlock();
+            sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            job = findJob(index, random);
+            if (!job) {
+                lock.lock();
+                wake.wait(lock, [&]() { return quit || signal != seen; });
+                lock.unlock();
+            }
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            if (job)
+                execute(job, index);
+            idle = 0;
+        }
+    }
+};
+
+// pool->parallelFor(count, grain, f), or f(0, count) on the calling thread
+// without a pool
+template <typename F>
+void parallelFor(JobPool *pool, size_t count, size_t grain, F f)
+{
+    if (pool)
+        pool->parallelFor(count, grain, f);
+    else if (count > 0)
+        f((size_t)0, count);
+}
+
+#endif //PROJECT_JOBPOOL_H
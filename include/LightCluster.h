@@ -0,0 +1,221 @@
+//
+// CPU side of clustered forward shading.
+// The view frustum is split into TILES_X * TILES_Y screen tiles and SLICES
+// exponentially spaced depth slices. Every frame each point light is tested
+// against the clusters it may touch and the result is stored as a flat list
+// of light indices plus an (offset, count) pair per cluster.
+// This file does not touch OpenGL, see ClusteredLighting.h for the upload.
+//
+
+#ifndef PROJECT_LIGHTCLUSTER_H
+#define PROJECT_LIGHTCLUSTER_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIGHTCLUSTER_USE_SSE
+#endif
+
+// Point light as stored in the light texture buffer: four RGBA32F texels.
+// Uses the same attenuation parameters as BlinnPhongShader::PointLight.
+struct ClusterLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+class LightClusterGrid
+{
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    // Two entries per cluster: offset into lightIndices and light count.
+    // Clusters are ordered x first, then y, then slice.
+    std::vector<unsigned int> clusterRanges;
+    std::vector<unsigned int> lightIndices;
+
+    // slice = log(viewDepth) * sliceScale + sliceBias
+    float sliceScale;
+    float sliceBias;
+    float nearPlane, farPlane;
+
+    LightClusterGrid()
+            : clusterRanges(2 * CLUSTER_COUNT, 0),
+              sliceScale(0.0f), sliceBias(0.0f), nearPlane(0.0f), farPlane(0.0f)
+    {
+        int total = SLICES * SLICE_STRIDE;
+        minX.resize(total); minY.resize(total); minZ.resize(total);
+        maxX.resize(total); maxY.resize(total); maxZ.resize(total);
+    }
+
+    // Distance at which a light with the given attenuation falls below
+    // threshold of its peak intensity. Matches the falloff used by the shaders.
+    static float attenuationRadius(float constant, float linear, float quadratic,
+                                   float threshold = 5.0f / 256.0f)
+    {
+        float c = 1.0f + constant - 1.0f / threshold;
+        if (quadratic <= 0.0f)
+            return linear > 0.0f ? -c / linear : 1.0e6f;
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    }
+
+    // Recompute the view space bounds of every cluster. Only needed when the
+    // projection changes.
+    void setProjection(float fovY, float aspect, float near, float far)
+    {
+        nearPlane = near;
+        farPlane = far;
+        float logRatio = std::log(far / near);
+        sliceScale = SLICES / logRatio;
+        sliceBias = -SLICES * std::log(near) / logRatio;
+
+        glm::mat4 invProjection = glm::inverse(glm::perspective(fovY, aspect, near, far));
+        for (int z = 0; z < SLICES; ++z) {
+            float sliceNear = near * std::pow(far / near, (float)z / SLICES);
+            float sliceFar = near * std::pow(far / near, (float)(z + 1) / SLICES);
+            for (int i = 0; i < SLICE_STRIDE; ++i) {
+                int cluster = z * SLICE_STRIDE + i;
+                if (i >= TILES_X * TILES_Y) {
+                    // Padding so the SIMD loop can run in groups of four,
+                    // placed far away so no light ever touches it
+                    minX[cluster] = minY[cluster] = minZ[cluster] = 1.0e30f;
+                    maxX[cluster] = maxY[cluster] = maxZ[cluster] = 1.0e30f;
+                    continue;
+                }
+                int x = i % TILES_X, y = i / TILES_X;
+                glm::vec3 lo(1.0e30f), hi(-1.0e30f);
+                for (int corner = 0; corner < 4; ++corner) {
+                    float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / TILES_X;
+                    float ndcY = -1.0f + 2.0f * (y + (corner >> 1)) / TILES_Y;
+                    glm::vec4 p = invProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                    // Direction through this corner, scaled so that z == -1
+                    glm::vec3 dir = glm::vec3(p) / -p.z;
+                    lo = glm::min(lo, glm::min(dir * sliceNear, dir * sliceFar));
+                    hi = glm::max(hi, glm::max(dir * sliceNear, dir * sliceFar));
+                }
+                minX[cluster] = lo.x; minY[cluster] = lo.y; minZ[cluster] = lo.z;
+                maxX[cluster] = hi.x; maxY[cluster] = hi.y; maxZ[cluster] = hi.z;
+            }
+        }
+    }
+
+    // Bin all lights for the given view matrix
+    void build(const glm::mat4 &view, const std::vector<ClusterLight> &lights)
+    {
+        pairs.clear();
+        for (unsigned int i = 0; i < lights.size(); ++i) {
+            glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            float radius = lights[i].radius;
+            float depth = -center.z;
+            if (depth + radius < nearPlane || depth - radius > farPlane)
+                continue;
+            int firstSlice = sliceOf(depth - radius);
+            int lastSlice = sliceOf(depth + radius);
+            for (int z = firstSlice; z <= lastSlice; ++z)
+                binSlice(z, center, radius, i);
+        }
+
+        // Counting sort of the (cluster, light) pairs into per cluster ranges
+        std::fill(clusterRanges.begin(), clusterRanges.end(), 0u);
+        for (unsigned int i = 0; i < pairs.size(); ++i)
+            ++clusterRanges[2 * pairs[i].cluster + 1];
+        unsigned int offset = 0;
+        for (int c = 0; c < CLUSTER_COUNT; ++c) {
+            clusterRanges[2 * c] = offset;
+            offset += clusterRanges[2 * c + 1];
+            clusterRanges[2 * c + 1] = 0;
+        }
+        lightIndices.resize(pairs.size());
+        for (unsigned int i = 0; i < pairs.size(); ++i) {
+            unsigned int c = pairs[i].cluster;
+            lightIndices[clusterRanges[2 * c] + clusterRanges[2 * c + 1]++] = pairs[i].light;
+        }
+    }
+
+    int sliceOf(float depth) const
+    {
+        if (depth <= nearPlane)
+            return 0;
+        int slice = (int)(std::log(depth) * sliceScale + sliceBias);
+        return std::min(std::max(slice, 0), SLICES - 1);
+    }
+
+private:
+    // Clusters per slice rounded up to a multiple of four
+    static const int SLICE_STRIDE = (TILES_X * TILES_Y + 3) & ~3;
+
+    struct Pair {
+        unsigned int cluster;
+        unsigned int light;
+    };
+    std::vector<Pair> pairs;
+
+    // Cluster bounds in view space, structure of arrays for SIMD tests
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    void addPair(int z, int i, unsigned int light)
+    {
+        Pair p;
+        p.cluster = (unsigned int)(z * TILES_X * TILES_Y + i);
+        p.light = light;
+        pairs.push_back(p);
+    }
+
+    // Sphere against every cluster AABB of one depth slice
+    void binSlice(int z, glm::vec3 center, float radius, unsigned int light)
+    {
+        int base = z * SLICE_STRIDE;
+#ifdef LIGHTCLUSTER_USE_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 cx = _mm_set1_ps(center.x);
+        const __m128 cy = _mm_set1_ps(center.y);
+        const __m128 cz = _mm_set1_ps(center.z);
+        const __m128 r2 = _mm_set1_ps(radius * radius);
+        for (int i = 0; i < SLICE_STRIDE; i += 4) {
+            int c = base + i;
+            // Per axis distance from the center to the box, 0 when inside
+            __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), cx), zero),
+                                   _mm_max_ps(_mm_sub_ps(cx, _mm_loadu_ps(&maxX[c])), zero));
+            __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), cy), zero),
+                                   _mm_max_ps(_mm_sub_ps(cy, _mm_loadu_ps(&maxY[c])), zero));
+            __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), cz), zero),
+                                   _mm_max_ps(_mm_sub_ps(cz, _mm_loadu_ps(&maxZ[c])), zero));
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                   _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+            while (mask) {
+                int bit = 0;
+                while (!(mask & (1 << bit)))
+                    ++bit;
+                mask &= ~(1 << bit);
+                addPair(z, i + bit, light);
+            }
+        }
+#else
+        for (int i = 0; i < TILES_X * TILES_Y; ++i) {
+            int c = base + i;
+            float dx = std::max(minX[c] - center.x, 0.0f) + std::max(center.x - maxX[c], 0.0f);
+            float dy = std::max(minY[c] - center.y, 0.0f) + std::max(center.y - maxY[c], 0.0f);
+            float dz = std::max(minZ[c] - center.z, 0.0f) + std::max(center.z - maxZ[c], 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= radius * radius)
+                addPair(z, i, light);
+        }
+#endif
+    }
+};
+
+#endif //PROJECT_LIGHTCLUSTER_H
@@ -0,0 +1,119 @@
+//
+// Picks a level of detail per instance from the projected size of its
+// bounding sphere and sorts the visible instances into one list per level,
+// ready for one instanced draw per level.
+// Level i is used while the projected radius is at least thresholds[i]
+// pixels. To avoid instances flickering between two levels at a boundary
+// an instance only moves to a coarser level once it is hysteresis (a
+// fraction) below the threshold, and to a finer one once it is that far
+// above it, so every instance remembers its level.
+//
+
+#ifndef PROJECT_LODSELECTOR_H
+#define PROJECT_LODSELECTOR_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+
+#include "InstanceCulling.h"
+#include "JobPool.h"
+
+class LodSelector
+{
+public:
+    static const size_t INSTANCES_PER_JOB = 4096;
+
+    // thresholds[i] is the smallest projected radius in pixels for level i,
+    // decreasing, one fewer than there are levels
+    std::vector<float> thresholds;
+    float hysteresis;
+    // Level of every instance, kept between frames
+    std::vector<uint8_t> levels;
+    // Instances that changed level in the last update
+    unsigned int switches;
+    // Instances inside the frustum that visible skipped in the last update
+    unsigned int hidden;
+
+    LodSelector(unsigned int instanceCount, const std::vector<float> &thresholds_, float hysteresis_ = 0.15f)
+            : thresholds(thresholds_), hysteresis(hysteresis_), levels(instanceCount, 0), switches(0), hidden(0) {}
+
+    // Radius in pixels of a sphere of radius 1 at distance 1
+    static float pixelScale(float fovyRadians, int viewportHeight)
+    {
+        return 0.5f * viewportHeight / std::tan(0.5f * fovyRadians);
+    }
+
+    unsigned int levelCount() const
+    {
+        return (unsigned int)thresholds.size() + 1;
+    }
+
+    // Frustum cull the spheres and write the visible instances into order,
+    // grouped by level: level l is order[start[l]] .. order[start[l + 1] - 1].
+    // Instances with a 0 in visible (e.g. from OcclusionCuller) are skipped.
+    // With a pool the levels are picked in parallel, the order is the same.
+    void update(const std::vector<glm::vec4> &spheres, const Frustum &frustum, const glm::vec3 &cameraPosition,
+                float pixelScale_, std::vector<unsigned int> &order, std::vector<unsigned int> &start,
+                const std::vector<uint8_t> *visible = nullptr, JobPool *pool = nullptr)
+    {
+        unsigned int count = levelCount();
+        selected.assign(spheres.size(), 0xFF);
+        std::atomic<unsigned int> switched(0), skipped(0);
+        auto selectRange = [&](size_t begin, size_t end) {
+            unsigned int local = 0, localSkipped = 0;
+            for (size_t i = begin; i < end; ++i) {
+                if (!sphereInFrustum(frustum, spheres[i]))
+                    continue;
+                if (visible && !(*visible)[i]) {
+                    ++localSkipped;
+                    continue;
+                }
+                float distance = std::max(glm::length(glm::vec3(spheres[i]) - cameraPosition), 1.0e-4f);
+                unsigned int level = nextLevel(levels[i], spheres[i].w * pixelScale_ / distance);
+                local += level != levels[i];
+                levels[i] = (uint8_t)level;
+                selected[i] = (uint8_t)level;
+            }
+            switched.fetch_add(local, std::memory_order_relaxed);
+            skipped.fetch_add(localSkipped, std::memory_order_relaxed);
+        };
+        parallelFor(pool, spheres.size(), INSTANCES_PER_JOB, selectRange);
+        switches = switched.load();
+        hidden = skipped.load();
+
+        start.assign(count + 1, 0);
+        for (unsigned int i = 0; i < spheres.size(); ++i) {
+            if (selected[i] != 0xFF)
+                ++start[selected[i] + 1];
+        }
+        for (unsigned int l = 0; l < count; ++l)
+            start[l + 1] += start[l];
+        order.resize(start[count]);
+        cursor.assign(start.begin(), start.end() - 1);
+        for (unsigned int i = 0; i < spheres.size(); ++i) {
+            if (selected[i] != 0xFF)
+                order[cursor[selected[i]]++] = i;
+        }
+    }
+
+private:
+    // Scratch space kept between updates
+    std::vector<uint8_t> selected;
+    std::vector<unsigned int> cursor;
+
+    unsigned int nextLevel(unsigned int level, float projectedRadius) const
+    {
+        while (level < thresholds.size() && projectedRadius < thresholds[level] * (1.0f - hysteresis))
+            ++level;
+        while (level > 0 && projectedRadius > thresholds[level - 1] * (1.0f + hysteresis))
+            --level;
+        return level;
+    }
+};
+
+#endif //PROJECT_LODSELECTOR_H
@@ -8,6 +8,7 @@
 
 #include <string>
 #include <vector>
+#include <cstdio>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -15,12 +16,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
-
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoord;
-};
+#include "Vertex.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
 
 struct Texture {
     unsigned int id;
@@ -28,41 +26,117 @@ struct Texture {
     std::string path;
 };
 
+// Normal maps always go to this unit, the others are numbered in order
+const int NORMAL_MAP_UNIT = 3;
+
+// Bind textures to the units named material.texture_diffuseN,
+// material.texture_specularN and material.normalMap
+inline void bindMeshTextures(Shader &shader, const std::vector<Texture> &textures)
+{
+    unsigned int diffuseNr = 1;
+    unsigned int specularNr = 1;
+    unsigned int unit = 0;
+    bool hasNormalMap = false;
+    for(unsigned int i = 0; i < textures.size(); i++)
+    {
+        if (textures[i].type == "texture_normal") {
+            glActiveTexture(GL_TEXTURE0 + NORMAL_MAP_UNIT);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            hasNormalMap = true;
+            continue;
+        }
+        glActiveTexture(GL_TEXTURE0 + unit); // activate proper texture unit before binding
+        // retrieve texture number (the N in diffuse_textureN), the name is
+        // built on the stack since this runs for every mesh every frame
+        unsigned int number;
+        const std::string &type = textures[i].type;
+        if(type == "texture_specular")
+            number = specularNr++;
+        else
+            number = diffuseNr++;
+        char name[64];
+        snprintf(name, sizeof(name), "material.%s%u", type.c_str(), number);
+
+        shader.setFloat(name, unit);
+        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        ++unit;
+    }
+    glActiveTexture(GL_TEXTURE0);
+    shader.setInt("material.normalMap", NORMAL_MAP_UNIT);
+    shader.setBool("material.hasNormalMap", hasNormalMap);
+}
+
+// Attribute layout of Vertex for the currently bound VAO and GL_ARRAY_BUFFER
+inline void setVertexAttributes()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Vertex),
+                          (void*)offsetof(Vertex, tangent));
+}
+
 class Mesh {
 public:
     unsigned int VAO, VBO, EBO;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
-    Mesh(std::vector<Vertex> &vertices_, std::vector<unsigned int> &indices_, std::vector<Texture> &textures_);
-    void draw(Shader shader)
+    // Index ranges of the levels of detail, empty if indices is all level 0
+    std::vector<MeshLod> lods;
+    // Clusters of level 0 for cullMeshlets, may be empty
+    std::vector<Meshlet> meshlets;
+    Mesh(std::vector<Vertex> &vertices_, std::vector<unsigned int> &indices_, std::vector<Texture> &textures_,
+         const std::vector<MeshLod> &lods_ = std::vector<MeshLod>(),
+         const std::vector<Meshlet> &meshlets_ = std::vector<Meshlet>());
+    unsigned int lodCount() const
     {
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            std::string number;
-            std::string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++);
-            else
-                number = std::to_string(diffuseNr++);
-
-            shader.setFloat(("material." + name + number).c_str(), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        return lods.empty() ? 1 : (unsigned int)lods.size();
+    }
+    // Levels past the last one give the coarsest
+    MeshLod lod(unsigned int level) const
+    {
+        if (lods.empty()) {
+            MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+            return full;
         }
-        glActiveTexture(GL_TEXTURE0);
+        return lods[std::min(level, (unsigned int)lods.size() - 1)];
+    }
+    void draw(Shader shader)
+    {
+        bindMeshTextures(shader, textures);
 
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, lod(0).indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+    // Draw only the given index ranges, e.g. the meshlets left by
+    // cullMeshlets, in one call
+    void drawRanges(Shader shader, const std::vector<IndexRange> &ranges)
+    {
+        if (ranges.empty())
+            return;
+        rangeCounts.resize(ranges.size());
+        rangeOffsets.resize(ranges.size());
+        for (unsigned int i = 0; i < ranges.size(); ++i) {
+            rangeCounts[i] = (GLsizei)ranges[i].indexCount;
+            rangeOffsets[i] = (const void *)(ranges[i].firstIndex * sizeof(unsigned int));
+        }
+        bindMeshTextures(shader, textures);
+        glBindVertexArray(VAO);
+        glMultiDrawElements(GL_TRIANGLES, rangeCounts.data(), GL_UNSIGNED_INT, rangeOffsets.data(),
+                            (GLsizei)ranges.size());
         glBindVertexArray(0);
     }
 private:
+    std::vector<GLsizei> rangeCounts;
+    std::vector<const void *> rangeOffsets;
+
     void setupMesh()
     {
         glGenVertexArrays(1, &VAO);
@@ -78,22 +152,20 @@ private:
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
             &indices[0], GL_STATIC_DRAW);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+        setVertexAttributes();
 
         glBindVertexArray(0);
     }
 };
 
-Mesh::Mesh(std::vector<Vertex> &vertices_, std::vector<unsigned int> &indices_, std::vector<Texture> &textures_)
+Mesh::Mesh(std::vector<Vertex> &vertices_, std::vector<unsigned int> &indices_, std::vector<Texture> &textures_,
+           const std::vector<MeshLod> &lods_, const std::vector<Meshlet> &meshlets_)
 {
     vertices = vertices_;
     indices = indices_;
     textures = textures_;
+    lods = lods_;
+    meshlets = meshlets_;
     setupMesh();
 }
 
@@ -0,0 +1,197 @@
+//
+// Static batch of the meshes of one or more Models in one vertex buffer and
+// one index buffer behind a single VAO. Every mesh keeps its own indices
+// and is addressed by (first index, base vertex), so nothing is rebased.
+// Meshes are grouped by their texture set and each group is one
+// glMultiDrawElementsBaseVertex call, which replaces a VAO bind and a draw
+// call per mesh with one texture bind and one call per material.
+//
+// Node transforms and the transform passed to addModel are baked into the
+// vertices, so the whole batch shares the "model" matrix given to draw.
+//
+
+#ifndef PROJECT_MESHBATCH_H
+#define PROJECT_MESHBATCH_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "Model.h"
+#include "NormalMatrix.h"
+#include "TangentSpace.h"
+
+class MeshBatch
+{
+public:
+    unsigned int VAO, VBO, EBO;
+
+    MeshBatch() : VAO(0), VBO(0), EBO(0), vertexCount(0), indexCount(0) {}
+
+    // Owns its GL objects, a copy would delete them twice
+    MeshBatch(const MeshBatch &) = delete;
+    MeshBatch &operator=(const MeshBatch &) = delete;
+
+    ~MeshBatch()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    // Append every mesh of model, placed at transform. Call build() once
+    // all models are added.
+    void addModel(Model &model, const glm::mat4 &transform = glm::mat4(1.0f))
+    {
+        model.nodes.update();
+        for (unsigned int i = 0; i < model.meshes.size(); ++i) {
+            const Mesh &mesh = model.meshes[i];
+            glm::mat4 meshTransform = transform * model.nodes.world[model.meshNodes[i]];
+            Range range;
+            range.firstIndex = (unsigned int)indices.size();
+            // Level 0 only, it starts at index 0
+            range.indexCount = mesh.lod(0).indexCount;
+            range.baseVertex = (int)vertices.size();
+            ranges.push_back(range);
+            materialOfRange.push_back(materialIndex(mesh.textures));
+
+            appendVertices(mesh.vertices, meshTransform);
+            indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.begin() + range.indexCount);
+        }
+    }
+
+    // Upload everything added so far and build the per material draw lists.
+    // The CPU copies are released.
+    void build()
+    {
+        if (VAO == 0) {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+            glGenBuffers(1, &EBO);
+        }
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                     indices.data(), GL_STATIC_DRAW);
+        setVertexAttributes();
+        glBindVertexArray(0);
+
+        for (unsigned int m = 0; m < materials.size(); ++m) {
+            Material &material = materials[m];
+            material.counts.clear();
+            material.offsets.clear();
+            material.baseVertices.clear();
+            for (unsigned int i = 0; i < ranges.size(); ++i) {
+                if (materialOfRange[i] != m)
+                    continue;
+                material.counts.push_back((GLsizei)ranges[i].indexCount);
+                material.offsets.push_back((const void *)(ranges[i].firstIndex * sizeof(unsigned int)));
+                material.baseVertices.push_back(ranges[i].baseVertex);
+            }
+        }
+
+        vertexCount = (unsigned int)vertices.size();
+        indexCount = (unsigned int)indices.size();
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+    }
+
+    void draw(Shader shader, const glm::mat4 &model)
+    {
+        shader.setModelMatrix(model);
+        glBindVertexArray(VAO);
+        for (unsigned int m = 0; m < materials.size(); ++m) {
+            const Material &material = materials[m];
+            bindMeshTextures(shader, material.textures);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, material.counts.data(), GL_UNSIGNED_INT,
+                                          material.offsets.data(), (GLsizei)material.counts.size(),
+                                          material.baseVertices.data());
+        }
+        glBindVertexArray(0);
+    }
+
+    unsigned int meshCount() const
+    {
+        return (unsigned int)ranges.size();
+    }
+
+    // One multi draw call per material
+    unsigned int drawCallCount() const
+    {
+        return (unsigned int)materials.size();
+    }
+
+    unsigned int vertexTotal() const
+    {
+        return vertexCount;
+    }
+
+    unsigned int indexTotal() const
+    {
+        return indexCount;
+    }
+
+private:
+    struct Range {
+        unsigned int firstIndex, indexCount;
+        int baseVertex;
+    };
+    struct Material {
+        std::vector<Texture> textures;
+        std::vector<GLsizei> counts;
+        std::vector<const void *> offsets;
+        std::vector<GLint> baseVertices;
+    };
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Range> ranges;
+    std::vector<unsigned int> materialOfRange;
+    std::vector<Material> materials;
+    unsigned int vertexCount, indexCount;
+
+    // Meshes with the same textures in the same roles share a material
+    unsigned int materialIndex(const std::vector<Texture> &textures)
+    {
+        for (unsigned int m = 0; m < materials.size(); ++m) {
+            const std::vector<Texture> &other = materials[m].textures;
+            if (other.size() != textures.size())
+                continue;
+            bool same = true;
+            for (unsigned int i = 0; i < textures.size() && same; ++i)
+                same = other[i].id == textures[i].id && other[i].type == textures[i].type;
+            if (same)
+                return m;
+        }
+        Material material;
+        material.textures = textures;
+        materials.push_back(material);
+        return (unsigned int)materials.size() - 1;
+    }
+
+    void appendVertices(const std::vector<Vertex> &source, const glm::mat4 &transform)
+    {
+        glm::mat3 normalTransform = normalMatrix(transform);
+        glm::mat3 tangentTransform(transform);
+        // A mirroring transform flips the bitangent
+        float mirror = glm::determinant(tangentTransform) < 0.0f ? -1.0f : 1.0f;
+        vertices.reserve(vertices.size() + source.size());
+        for (unsigned int i = 0; i < source.size(); ++i) {
+            Vertex vertex = source[i];
+            vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+            glm::vec3 normal = normalTransform * vertex.normal;
+            if (glm::dot(normal, normal) > 0.0f)
+                vertex.normal = glm::normalize(normal);
+            glm::vec4 tangent = unpackTangent(vertex.tangent);
+            glm::vec3 t = tangentTransform * glm::vec3(tangent);
+            if (glm::dot(t, t) > 0.0f)
+                vertex.tangent = packTangent(glm::normalize(t), tangent.w * mirror);
+            vertices.push_back(vertex);
+        }
+    }
+};
+
+#endif //PROJECT_MESHBATCH_H
@@ -0,0 +1,386 @@
+//
+// Quadric error edge collapse (Garland & Heckbert) producing levels of
+// detail that share the vertex buffer of the full mesh: every level is just
+// another index list into the same vertices.
+//   - vertices with the same position are welded, the error quadric of
+//     each position is the area weighted sum of its triangle planes,
+//   - an edge collapses onto one of its endpoints, so no new vertices are
+//     made and attributes never need interpolating,
+//   - vertices with the same position and UV form a wedge. A position can
+//     only collapse if every one of its wedges shares a triangle with a
+//     wedge of the target, which keeps UV seams intact; border positions
+//     never move,
+//   - collapses that flip a triangle are rejected.
+// Collapses run in passes of independent edges, cheapest first.
+// No OpenGL, so the importer can run it on worker threads.
+//
+
+#ifndef PROJECT_MESHSIMPLIFIER_H
+#define PROJECT_MESHSIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <cmath>
+#include <algorithm>
+
+// Index range of one level of detail inside a mesh's index buffer
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    // Largest distance, in model units, the surface moved to get here
+    float error;
+};
+
+class MeshSimplifier
+{
+public:
+    template <typename V>
+    MeshSimplifier(const std::vector<V> &vertices, const std::vector<unsigned int> &indices)
+            : maxError(0.0f)
+    {
+        positions.resize(vertices.size());
+        std::vector<glm::vec2> texCoords(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); ++i) {
+            positions[i] = vertices[i].position;
+            texCoords[i] = vertices[i].texCoord;
+        }
+        weld(texCoords);
+
+        triangles.reserve(indices.size() - indices.size() % 3);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            unsigned int a = wedgeOf[indices[i]], b = wedgeOf[indices[i + 1]], c = wedgeOf[indices[i + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] ||
+                positionOf[c] == positionOf[a])
+                continue;
+            triangles.push_back(a);
+            triangles.push_back(b);
+            triangles.push_back(c);
+        }
+        computeQuadrics();
+    }
+
+    size_t triangleCount() const
+    {
+        return triangles.size() / 3;
+    }
+
+    // Largest error of any collapse so far, see MeshLod::error
+    float error() const
+    {
+        return maxError;
+    }
+
+    // Collapse until at most targetTriangles are left or nothing more can
+    // collapse. Can be called again with a smaller target to continue.
+    // Returns the indices of the result, into the original vertices.
+    std::vector<unsigned int> simplify(size_t targetTriangles)
+    {
+        while (triangleCount() > targetTriangles) {
+            if (!collapsePass(targetTriangles))
+                break;
+        }
+        return triangles;
+    }
+
+private:
+    struct Quadric {
+        // Upper triangle of the symmetric 4x4 matrix
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+        // Total area, to turn the error back into a distance
+        double weight;
+
+        Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+        void addPlane(const glm::dvec3 &n, double d, double w)
+        {
+            a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+            b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+            c2 += w * n.z * n.z; cd += w * n.z * d;
+            d2 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+            weight += q.weight;
+        }
+
+        // Weighted sum of squared distances of p to the planes
+        double evaluate(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+                       b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+                       c2 * z * z + 2.0 * cd * z + d2;
+            return std::max(r, 0.0);
+        }
+    };
+
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+
+        bool operator<(const Collapse &other) const
+        {
+            // Index tie break keeps the result independent of the sort
+            return std::tie(cost, from, to) < std::tie(other.cost, other.from, other.to);
+        }
+    };
+
+    std::vector<glm::vec3> positions;
+    // Per vertex: the first vertex with the same position and UV
+    std::vector<unsigned int> wedgeOf;
+    // Per vertex: the first vertex with the same position
+    std::vector<unsigned int> positionOf;
+    // Where a wedge / position went after collapsing, itself if it is alive
+    std::vector<unsigned int> wedgeTarget, positionTarget;
+    std::vector<Quadric> quadrics;
+    std::vector<bool> border;
+    // Live triangles as wedge indices
+    std::vector<unsigned int> triangles;
+    float maxError;
+
+    void weld(const std::vector<glm::vec2> &texCoords)
+    {
+        typedef std::tuple<float, float, float> PositionKey;
+        typedef std::tuple<float, float, float, float, float> WedgeKey;
+        std::map<PositionKey, unsigned int> positionIds;
+        std::map<WedgeKey, unsigned int> wedgeIds;
+        wedgeOf.resize(positions.size());
+        positionOf.resize(positions.size());
+        for (unsigned int i = 0; i < positions.size(); ++i) {
+            const glm::vec3 &p = positions[i];
+            positionOf[i] = positionIds.insert(std::make_pair(PositionKey(p.x, p.y, p.z), i)).first->second;
+            WedgeKey key(p.x, p.y, p.z, texCoords[i].x, texCoords[i].y);
+            wedgeOf[i] = wedgeIds.insert(std::make_pair(key, i)).first->second;
+        }
+        wedgeTarget.resize(positions.size());
+        positionTarget.resize(positions.size());
+        for (unsigned int i = 0; i < positions.size(); ++i)
+            wedgeTarget[i] = positionTarget[i] = i;
+    }
+
+    void computeQuadrics()
+    {
+        quadrics.assign(positions.size(), Quadric());
+        border.assign(positions.size(), false);
+        std::map<std::pair<unsigned int, unsigned int>, int> edgeUse;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            unsigned int p[3];
+            for (int k = 0; k < 3; ++k)
+                p[k] = positionOf[triangles[t + k]];
+            glm::dvec3 a(positions[p[0]]), b(positions[p[1]]), c(positions[p[2]]);
+            glm::dvec3 n = glm::cross(b - a, c - a);
+            double area = 0.5 * glm::length(n);
+            if (area > 0.0) {
+                n = glm::normalize(n);
+                for (int k = 0; k < 3; ++k)
+                    quadrics[p[k]].addPlane(n, -glm::dot(n, a), area);
+            }
+            for (int k = 0; k < 3; ++k) {
+                unsigned int u = p[k], v = p[(k + 1) % 3];
+                ++edgeUse[std::make_pair(std::min(u, v), std::max(u, v))];
+            }
+        }
+        for (auto it = edgeUse.begin(); it != edgeUse.end(); ++it) {
+            if (it->second != 2)
+                border[it->first.first] = border[it->first.second] = true;
+        }
+    }
+
+    static unsigned int root(std::vector<unsigned int> &target, unsigned int i)
+    {
+        while (target[i] != i) {
+            target[i] = target[target[i]];
+            i = target[i];
+        }
+        return i;
+    }
+
+    unsigned int positionOfWedge(unsigned int wedge)
+    {
+        return root(positionTarget, positionOf[wedge]);
+    }
+
+    // Drop triangles that collapsed, point the rest at live wedges
+    void compactTriangles()
+    {
+        size_t out = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            unsigned int w[3], p[3];
+            for (int k = 0; k < 3; ++k) {
+                w[k] = root(wedgeTarget, triangles[t + k]);
+                p[k] = positionOfWedge(w[k]);
+            }
+            if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0])
+                continue;
+            for (int k = 0; k < 3; ++k)
+                triangles[out++] = w[k];
+        }
+        triangles.resize(out);
+    }
+
+    // One pass of independent collapses. Returns false if none was possible.
+    bool collapsePass(size_t targetTriangles)
+    {
+        // Triangles around every live position
+        std::vector<unsigned int> first(positions.size() + 1, 0);
+        for (size_t i = 0; i < triangles.size(); ++i)
+            ++first[positionOfWedge(triangles[i]) + 1];
+        for (size_t i = 0; i < positions.size(); ++i)
+            first[i + 1] += first[i];
+        std::vector<unsigned int> around(triangles.size()), cursor(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < triangles.size(); ++i)
+            around[cursor[positionOfWedge(triangles[i])]++] = (unsigned int)(i / 3);
+
+        std::vector<Collapse> candidates;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int u = positionOfWedge(triangles[t + k]);
+                unsigned int v = positionOfWedge(triangles[t + (k + 1) % 3]);
+                // Every interior edge is seen twice, keep one
+                if (u > v)
+                    continue;
+                Quadric q = quadrics[u];
+                q.add(quadrics[v]);
+                if (!border[u]) {
+                    Collapse c = { u, v, q.evaluate(positions[v]) };
+                    candidates.push_back(c);
+                }
+                if (!border[v]) {
+                    Collapse c = { v, u, q.evaluate(positions[u]) };
+                    candidates.push_back(c);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        size_t remaining = triangleCount();
+        std::vector<bool> touched(positions.size(), false);
+        std::vector<std::pair<unsigned int, unsigned int> > wedgeMoves;
+        bool collapsed = false;
+        for (size_t i = 0; i < candidates.size() && remaining > targetTriangles; ++i) {
+            const Collapse &c = candidates[i];
+            if (touched[c.from] || touched[c.to])
+                continue;
+            if (!collapseAllowed(c, first, around, wedgeMoves))
+                continue;
+
+            size_t removed = 0;
+            for (unsigned int j = first[c.from]; j < first[c.from + 1]; ++j) {
+                const unsigned int *tri = &triangles[3 * around[j]];
+                touched[positionOfWedge(tri[0])] = true;
+                touched[positionOfWedge(tri[1])] = true;
+                touched[positionOfWedge(tri[2])] = true;
+                for (int k = 0; k < 3; ++k) {
+                    if (positionOfWedge(tri[k]) == c.to)
+                        ++removed;
+                }
+            }
+            for (unsigned int j = 0; j < wedgeMoves.size(); ++j)
+                wedgeTarget[wedgeMoves[j].first] = wedgeMoves[j].second;
+            positionTarget[c.from] = c.to;
+            quadrics[c.to].add(quadrics[c.from]);
+            if (quadrics[c.to].weight > 0.0)
+                maxError = std::max(maxError, (float)std::sqrt(c.cost / quadrics[c.to].weight));
+            remaining -= std::min(removed, remaining);
+            collapsed = true;
+        }
+        compactTriangles();
+        return collapsed;
+    }
+
+    // Checks the seam and flip rules and lists where every wedge of
+    // c.from goes
+    bool collapseAllowed(const Collapse &c, const std::vector<unsigned int> &first,
+                         const std::vector<unsigned int> &around,
+                         std::vector<std::pair<unsigned int, unsigned int> > &wedgeMoves)
+    {
+        wedgeMoves.clear();
+        for (unsigned int j = first[c.from]; j < first[c.from + 1]; ++j) {
+            const unsigned int *tri = &triangles[3 * around[j]];
+            int self = -1, other = -1;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int p = positionOfWedge(tri[k]);
+                if (p == c.from)
+                    self = k;
+                else if (p == c.to)
+                    other = k;
+            }
+            unsigned int wedge = root(wedgeTarget, tri[self]);
+            bool known = false;
+            for (unsigned int m = 0; m < wedgeMoves.size() && !known; ++m)
+                known = wedgeMoves[m].first == wedge;
+
+            if (other >= 0) {
+                if (!known)
+                    wedgeMoves.push_back(std::make_pair(wedge, root(wedgeTarget, tri[other])));
+                continue;
+            }
+            // The triangle stays, its normal must not flip
+            glm::vec3 p0 = positions[positionOfWedge(tri[0])];
+            glm::vec3 p1 = positions[positionOfWedge(tri[1])];
+            glm::vec3 p2 = positions[positionOfWedge(tri[2])];
+            glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+            glm::vec3 moved[3] = { p0, p1, p2 };
+            moved[self] = positions[c.to];
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0f)
+                return false;
+        }
+        // Every wedge needs a destination on the other end of the edge
+        for (unsigned int j = first[c.from]; j < first[c.from + 1]; ++j) {
+            const unsigned int *tri = &triangles[3 * around[j]];
+            for (int k = 0; k < 3; ++k) {
+                if (positionOfWedge(tri[k]) != c.from)
+                    continue;
+                unsigned int wedge = root(wedgeTarget, tri[k]);
+                bool known = false;
+                for (unsigned int m = 0; m < wedgeMoves.size() && !known; ++m)
+                    known = wedgeMoves[m].first == wedge;
+                if (!known)
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Append levels - 1 simplified index lists to indices, each with about
+// ratio times the triangles of the previous one. Returns the ranges, level
+// 0 being the original indices. Stops early once a level would not be
+// noticeably smaller than the one before.
+template <typename V>
+std::vector<MeshLod> generateLods(const std::vector<V> &vertices, std::vector<unsigned int> &indices,
+                                  unsigned int levels, float ratio = 0.5f)
+{
+    std::vector<MeshLod> lods;
+    MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+    lods.push_back(full);
+    if (levels <= 1 || indices.size() < 3)
+        return lods;
+
+    MeshSimplifier simplifier(vertices, indices);
+    size_t previous = indices.size() / 3;
+    for (unsigned int level = 1; level < levels; ++level) {
+        size_t target = (size_t)(previous * ratio);
+        std::vector<unsigned int> lodIndices = simplifier.simplify(target);
+        size_t triangleCount = lodIndices.size() / 3;
+        if (triangleCount == 0 || triangleCount > previous * 0.9)
+            break;
+        MeshLod lod = { (unsigned int)indices.size(), (unsigned int)lodIndices.size(), simplifier.error() };
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        lods.push_back(lod);
+        previous = triangleCount;
+    }
+    return lods;
+}
+
+#endif //PROJECT_MESHSIMPLIFIER_H
@@ -0,0 +1,234 @@
+//
+// Splits a triangle list into meshlets of at most MESHLET_MAX_VERTICES
+// vertices and MESHLET_MAX_TRIANGLES triangles and culls them per frame.
+// Building is greedy and deterministic: a meshlet starts at the first
+// unassigned triangle and grows by the unassigned neighbour that adds the
+// fewest new vertices (lowest index on ties). The index buffer is rewritten
+// so every meshlet is one contiguous index range.
+// Every meshlet gets a bounding sphere and a normal cone (apex, axis,
+// cutoff): seen from any point p with dot(normalize(apex - p), axis) >=
+// cutoff all of its triangles face away. cullMeshlets rejects meshlets
+// outside the frustum or facing away and merges the survivors into as few
+// index ranges as possible.
+// No OpenGL, Mesh.h draws the ranges.
+//
+
+#ifndef PROJECT_MESHLETS_H
+#define PROJECT_MESHLETS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "InstanceCulling.h"
+
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    unsigned int vertexCount;
+    // xyz center, w radius
+    glm::vec4 sphere;
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    // Above 1 when the triangles face too many ways to ever cull
+    float coneCutoff;
+};
+
+// Contiguous run of indices to draw
+struct IndexRange {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+template <typename V>
+void computeMeshletBounds(const std::vector<V> &vertices, const unsigned int *triangles,
+                          const std::vector<unsigned int> &meshletVertices, Meshlet &meshlet)
+{
+    glm::vec3 lo = vertices[meshletVertices[0]].position, hi = lo;
+    for (unsigned int i = 1; i < meshletVertices.size(); ++i) {
+        lo = glm::min(lo, vertices[meshletVertices[i]].position);
+        hi = glm::max(hi, vertices[meshletVertices[i]].position);
+    }
+    glm::vec3 center = 0.5f * (lo + hi);
+    float radius2 = 0.0f;
+    for (unsigned int i = 0; i < meshletVertices.size(); ++i) {
+        glm::vec3 d = vertices[meshletVertices[i]].position - center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    meshlet.sphere = glm::vec4(center, std::sqrt(radius2));
+
+    // Cone around the face normals, degenerate triangles do not count
+    unsigned int triangleCount = meshlet.indexCount / 3;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> faces;
+    glm::vec3 axis(0.0f);
+    for (unsigned int t = 0; t < triangleCount; ++t) {
+        glm::vec3 a = vertices[triangles[3 * t]].position;
+        glm::vec3 b = vertices[triangles[3 * t + 1]].position;
+        glm::vec3 c = vertices[triangles[3 * t + 2]].position;
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+            continue;
+        normals.push_back(n / length);
+        faces.push_back(t);
+        axis += n / length;
+    }
+    meshlet.coneApex = center;
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 2.0f;
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 0.0f)
+        return;
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (unsigned int i = 0; i < normals.size(); ++i)
+        minDot = std::min(minDot, glm::dot(normals[i], axis));
+    // Wider than about 84 degrees is rarely culled and makes the apex unstable
+    if (minDot <= 0.1f) {
+        meshlet.coneAxis = axis;
+        return;
+    }
+    // Move the apex back along the axis until it is behind every triangle
+    // plane, so a viewer inside the cone sees all of them from behind
+    float maxT = 0.0f;
+    for (unsigned int i = 0; i < normals.size(); ++i) {
+        glm::vec3 p = vertices[triangles[3 * faces[i]]].position;
+        float t = glm::dot(center - p, normals[i]) / glm::dot(axis, normals[i]);
+        maxT = std::max(maxT, t);
+    }
+    meshlet.coneApex = center - axis * maxT;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// Reorders indices[first, first + count) meshlet by meshlet and returns the
+// meshlets, whose ranges are relative to the start of indices
+template <typename V>
+std::vector<Meshlet> buildMeshlets(const std::vector<V> &vertices, std::vector<unsigned int> &indices,
+                                   unsigned int first = 0, unsigned int count = ~0u)
+{
+    count = std::min(count, (unsigned int)indices.size() - first);
+    const unsigned int triangleCount = count / 3;
+    const unsigned int *source = &indices[first];
+
+    // Triangles around every vertex
+    std::vector<unsigned int> firstTriangle(vertices.size() + 1, 0), around(triangleCount * 3);
+    for (unsigned int i = 0; i < triangleCount * 3; ++i)
+        ++firstTriangle[source[i] + 1];
+    for (size_t v = 0; v < vertices.size(); ++v)
+        firstTriangle[v + 1] += firstTriangle[v];
+    std::vector<unsigned int> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (unsigned int i = 0; i < triangleCount * 3; ++i)
+        around[cursor[source[i]]++] = i / 3;
+
+    std::vector<bool> assigned(triangleCount, false);
+    // Meshlet a vertex was last added to, to count new vertices quickly
+    std::vector<unsigned int> vertexMeshlet(vertices.size(), ~0u);
+    std::vector<unsigned int> reordered;
+    reordered.reserve(triangleCount * 3);
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> meshletVertices, meshletTriangles;
+
+    unsigned int nextSeed = 0;
+    while (true) {
+        while (nextSeed < triangleCount && assigned[nextSeed])
+            ++nextSeed;
+        if (nextSeed == triangleCount)
+            break;
+
+        unsigned int id = (unsigned int)meshlets.size();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        unsigned int triangle = nextSeed;
+        while (true) {
+            assigned[triangle] = true;
+            meshletTriangles.push_back(triangle);
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = source[3 * triangle + k];
+                if (vertexMeshlet[v] != id) {
+                    vertexMeshlet[v] = id;
+                    meshletVertices.push_back(v);
+                }
+            }
+            if (meshletTriangles.size() == MESHLET_MAX_TRIANGLES)
+                break;
+
+            // Neighbour adding the fewest vertices that still fits
+            unsigned int best = ~0u, bestNew = 4;
+            for (unsigned int i = 0; i < meshletVertices.size(); ++i) {
+                unsigned int v = meshletVertices[i];
+                for (unsigned int j = firstTriangle[v]; j < firstTriangle[v + 1]; ++j) {
+                    unsigned int t = around[j];
+                    if (assigned[t])
+                        continue;
+                    unsigned int added = 0;
+                    for (int k = 0; k < 3; ++k)
+                        added += vertexMeshlet[source[3 * t + k]] != id;
+                    if (meshletVertices.size() + added > MESHLET_MAX_VERTICES)
+                        continue;
+                    if (added < bestNew || (added == bestNew && t < best)) {
+                        best = t;
+                        bestNew = added;
+                    }
+                }
+            }
+            if (best == ~0u)
+                break;
+            triangle = best;
+        }
+
+        Meshlet meshlet;
+        meshlet.firstIndex = first + (unsigned int)reordered.size();
+        meshlet.indexCount = (unsigned int)meshletTriangles.size() * 3;
+        meshlet.vertexCount = (unsigned int)meshletVertices.size();
+        for (unsigned int i = 0; i < meshletTriangles.size(); ++i) {
+            for (int k = 0; k < 3; ++k)
+                reordered.push_back(source[3 * meshletTriangles[i] + k]);
+        }
+        computeMeshletBounds(vertices, &reordered[meshlet.firstIndex - first], meshletVertices, meshlet);
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(reordered.begin(), reordered.end(), indices.begin() + first);
+    return meshlets;
+}
+
+inline bool meshletFacesAway(const Meshlet &meshlet, const glm::vec3 &cameraPosition)
+{
+    glm::vec3 d = meshlet.coneApex - cameraPosition;
+    float length = glm::length(d);
+    if (length <= 0.0f)
+        return false;
+    return glm::dot(d / length, meshlet.coneAxis) >= meshlet.coneCutoff;
+}
+
+// frustum and cameraPosition in the space of the meshlets (model space,
+// extractFrustum(projection * view * model) gives that). Adjacent
+// survivors are merged into one range. Returns how many meshlets survived.
+inline unsigned int cullMeshlets(const std::vector<Meshlet> &meshlets, const Frustum &frustum,
+                                 const glm::vec3 &cameraPosition, std::vector<IndexRange> &ranges)
+{
+    ranges.clear();
+    unsigned int visible = 0;
+    for (unsigned int i = 0; i < meshlets.size(); ++i) {
+        const Meshlet &meshlet = meshlets[i];
+        if (!sphereInFrustum(frustum, meshlet.sphere) || meshletFacesAway(meshlet, cameraPosition))
+            continue;
+        ++visible;
+        if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == meshlet.firstIndex) {
+            ranges.back().indexCount += meshlet.indexCount;
+        } else {
+            IndexRange range = { meshlet.firstIndex, meshlet.indexCount };
+            ranges.push_back(range);
+        }
+    }
+    return visible;
+}
+
+#endif //PROJECT_MESHLETS_H
@@ -0,0 +1,351 @@
+//
+// Mip levels of RGBA8 images built on the CPU, for the texture cache, the
+// texture packer and uploads that used to call glGenerateMipmap.
+//
+//   - Color channels of sRGB images are decoded to linear light before
+//     filtering and encoded again after it. Averaging the stored values
+//     instead darkens every level below 0, most where bright and dark
+//     texels meet.
+//   - Colors are filtered premultiplied by alpha, so fully transparent
+//     texels (the black around grass.png) do not bleed into the edges.
+//   - Levels are filtered from the float level above, not from its 8 bit
+//     copy, so rounding does not add up down the chain.
+//   - MIP_BOX averages 2x2 texels; MIP_KAISER is a separable 6x6 tap
+//     Kaiser windowed sinc, sharper, with the edge texels repeated. Box
+//     keeps every texel of a level inside its 2x2 parents, which atlases
+//     rely on (TexturePacker.h).
+//   - With an alpha cutoff, the alpha of each level is scaled so the share
+//     of texels that pass an alpha test at that cutoff stays what it is in
+//     level 0; otherwise alpha tested foliage thins out into nothing in the
+//     distance.
+// One pixel is one SSE register, four floats. With a JobPool the rows of
+// each level are split across it; an image that is a job of its own (the
+// image jobs of ModelImporter) is built without one.
+//
+//     std::vector<std::vector<uint8_t> > levels;
+//     MipOptions options = { MIP_KAISER, true, 0.1f };
+//     buildMipChain(rgba.data(), width, height, options, levels);
+//
+
+#ifndef PROJECT_MIPCHAIN_H
+#define PROJECT_MIPCHAIN_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#include "JobPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPCHAIN_USE_SSE
+#endif
+
+enum MipFilter {
+    MIP_BOX,
+    MIP_KAISER
+};
+
+struct MipOptions {
+    MipFilter filter;
+    // Color channels hold sRGB encoded values
+    bool srgb;
+    // Above 0, alpha test coverage at this cutoff is kept level to level
+    float alphaCutoff;
+};
+
+// sRGB 8 bit values to linear light
+inline const float *srgbToLinearTable()
+{
+    static const std::vector<float> table = [] {
+        std::vector<float> values(256);
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Linear light in 1/65535 steps to sRGB 8 bit values. The steps are
+// finer than the difference between the two darkest sRGB values.
+inline const uint8_t *linearToSrgbTable()
+{
+    static const std::vector<uint8_t> table = [] {
+        std::vector<uint8_t> values(65536);
+        for (int i = 0; i < 65536; ++i) {
+            float c = i / 65535.0f;
+            float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            values[i] = (uint8_t)std::min(std::max(s * 255.0f + 0.5f, 0.0f), 255.0f);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Share of the texels of a w x h rectangle of an image rowPixels wide that
+// have alpha above cutoff (0 to 1) once scaled by scale
+inline float alphaCoverage(const uint8_t *rgba, size_t rowPixels, int w, int h, float cutoff, float scale = 1.0f)
+{
+    size_t passed = 0;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *row = rgba + y * rowPixels * 4;
+        for (int x = 0; x < w; ++x)
+            passed += row[x * 4 + 3] * scale > cutoff * 255.0f ? 1 : 0;
+    }
+    return w * h > 0 ? (float)passed / ((size_t)w * h) : 0.0f;
+}
+
+// Scales alpha of the rectangle so its coverage at cutoff comes as close
+// to coverage as it can
+inline void scaleAlphaToCoverage(uint8_t *rgba, size_t rowPixels, int w, int h, float cutoff, float coverage)
+{
+    // A histogram makes each step of the search 256 multiplies
+    size_t histogram[256] = {};
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *row = rgba + y * rowPixels * 4;
+        for (int x = 0; x < w; ++x)
+            ++histogram[row[x * 4 + 3]];
+    }
+    auto covered = [&](float scale) {
+        size_t passed = 0;
+        for (int a = 0; a < 256; ++a)
+            passed += a * scale > cutoff * 255.0f ? histogram[a] : 0;
+        return (float)passed / ((size_t)w * h);
+    };
+    float lo = 0.0f, hi = 4.0f, scale = 1.0f;
+    for (int step = 0; step < 16; ++step) {
+        scale = (lo + hi) * 0.5f;
+        if (covered(scale) < coverage)
+            lo = scale;
+        else
+            hi = scale;
+    }
+    scale = hi;
+    for (int y = 0; y < h; ++y) {
+        uint8_t *row = rgba + y * rowPixels * 4;
+        for (int x = 0; x < w; ++x)
+            row[x * 4 + 3] = (uint8_t)std::min(row[x * 4 + 3] * scale + 0.5f, 255.0f);
+    }
+}
+
+// Kaiser windowed sinc taps for halving, source texels 2x - 2 to 2x + 3
+inline const float *mipKaiserTaps()
+{
+    static const std::vector<float> taps = [] {
+        auto besselI0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 20; ++k) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        const double alpha = 4.0, width = 3.0, pi = 3.14159265358979323846;
+        std::vector<float> values(6);
+        double total = 0.0;
+        for (int i = 0; i < 6; ++i) {
+            double d = std::fabs(i - 2.5), t = d / width;
+            double sinc = std::sin(pi * d / 2.0) / (pi * d / 2.0);
+            double window = besselI0(alpha * std::sqrt(std::max(1.0 - t * t, 0.0))) / besselI0(alpha);
+            values[i] = (float)(sinc * window);
+            total += values[i];
+        }
+        for (int i = 0; i < 6; ++i)
+            values[i] = (float)(values[i] / total);
+        return values;
+    }();
+    return taps.data();
+}
+
+// One pixel, four floats
+#ifdef MIPCHAIN_USE_SSE
+typedef __m128 MipPixel;
+
+inline MipPixel mipLoad(const float *p)
+{
+    return _mm_loadu_ps(p);
+}
+
+inline void mipStore(float *p, MipPixel v)
+{
+    _mm_storeu_ps(p, v);
+}
+
+inline MipPixel mipAdd(MipPixel a, MipPixel b)
+{
+    return _mm_add_ps(a, b);
+}
+
+inline MipPixel mipScale(MipPixel a, float s)
+{
+    return _mm_mul_ps(a, _mm_set1_ps(s));
+}
+
+inline MipPixel mipZero()
+{
+    return _mm_setzero_ps();
+}
+#else
+struct MipPixel {
+    float v[4];
+};
+
+inline MipPixel mipLoad(const float *p)
+{
+    MipPixel r = { { p[0], p[1], p[2], p[3] } };
+    return r;
+}
+
+inline void mipStore(float *p, MipPixel a)
+{
+    std::copy(a.v, a.v + 4, p);
+}
+
+inline MipPixel mipAdd(MipPixel a, MipPixel b)
+{
+    MipPixel r = { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+    return r;
+}
+
+inline MipPixel mipScale(MipPixel a, float s)
+{
+    MipPixel r = { { a.v[0] * s, a.v[1] * s, a.v[2] * s, a.v[3] * s } };
+    return r;
+}
+
+inline MipPixel mipZero()
+{
+    MipPixel r = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+    return r;
+}
+#endif
+
+// Rows [begin, end) of the next level with the 2x2 box; odd sizes drop the
+// last row or column like downsampling always did here
+inline void mipBoxRows(const float *source, int width, int height, float *destination, size_t begin, size_t end)
+{
+    int w = std::max(width / 2, 1);
+    for (size_t y = begin; y < end; ++y) {
+        const float *row0 = source + (size_t)std::min(2 * (int)y, height - 1) * width * 4;
+        const float *row1 = source + (size_t)std::min(2 * (int)y + 1, height - 1) * width * 4;
+        float *out = destination + y * w * 4;
+        for (int x = 0; x < w; ++x) {
+            int x0 = std::min(2 * x, width - 1) * 4, x1 = std::min(2 * x + 1, width - 1) * 4;
+            MipPixel top = mipAdd(mipLoad(row0 + x0), mipLoad(row0 + x1));
+            MipPixel sum = mipAdd(top, mipAdd(mipLoad(row1 + x0), mipLoad(row1 + x1)));
+            mipStore(out + x * 4, mipScale(sum, 0.25f));
+        }
+    }
+}
+
+// Rows [begin, end) of the source halved horizontally with the Kaiser taps
+inline void mipKaiserColumns(const float *source, int width, float *destination, size_t begin, size_t end)
+{
+    const float *taps = mipKaiserTaps();
+    int w = std::max(width / 2, 1);
+    for (size_t y = begin; y < end; ++y) {
+        const float *row = source + y * width * 4;
+        float *out = destination + y * w * 4;
+        for (int x = 0; x < w; ++x) {
+            MipPixel sum = mipZero();
+            for (int k = 0; k < 6; ++k) {
+                int sx = std::min(std::max(2 * x - 2 + k, 0), width - 1);
+                sum = mipAdd(sum, mipScale(mipLoad(row + sx * 4), taps[k]));
+            }
+            mipStore(out + x * 4, sum);
+        }
+    }
+}
+
+// Rows [begin, end) of the next level from the horizontally halved rows
+inline void mipKaiserRows(const float *source, int width, int height, float *destination, size_t begin, size_t end)
+{
+    const float *taps = mipKaiserTaps();
+    for (size_t y = begin; y < end; ++y) {
+        const float *rows[6];
+        for (int k = 0; k < 6; ++k)
+            rows[k] = source + (size_t)std::min(std::max(2 * (int)y - 2 + k, 0), height - 1) * width * 4;
+        float *out = destination + y * width * 4;
+        for (int x = 0; x < width * 4; x += 4) {
+            MipPixel sum = mipZero();
+            for (int k = 0; k < 6; ++k)
+                sum = mipAdd(sum, mipScale(mipLoad(rows[k] + x), taps[k]));
+            mipStore(out + x, sum);
+        }
+    }
+}
+
+// Premultiplied linear floats back to 8 bits
+inline void mipEncodeRows(const float *source, int width, bool srgb, uint8_t *destination, size_t begin, size_t end)
+{
+    const uint8_t *toSrgb = linearToSrgbTable();
+    for (size_t i = begin * width; i < end * width; ++i) {
+        const float *p = source + i * 4;
+        float alpha = std::min(std::max(p[3], 0.0f), 1.0f);
+        float unpremultiply = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+        uint8_t *out = destination + i * 4;
+        for (int c = 0; c < 3; ++c) {
+            float value = std::min(std::max(p[c] * unpremultiply, 0.0f), 1.0f);
+            out[c] = srgb ? toSrgb[(int)(value * 65535.0f + 0.5f)] : (uint8_t)(value * 255.0f + 0.5f);
+        }
+        out[3] = (uint8_t)(alpha * 255.0f + 0.5f);
+    }
+}
+
+// Every level of a width x height RGBA8 image down to 1x1, level 0 a copy
+// of the image
+inline void buildMipChain(const uint8_t *rgba, int width, int height, const MipOptions &options,
+                          std::vector<std::vector<uint8_t> > &levels, JobPool *pool = nullptr)
+{
+    // Rows per range, below that a level is not worth splitting
+    const size_t MIN_ROWS = 32;
+    size_t pixels = (size_t)width * height;
+    levels.assign(1, std::vector<uint8_t>(rgba, rgba + pixels * 4));
+
+    const float *toLinear = srgbToLinearTable();
+    std::vector<float> level(pixels * 4), next, halved;
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint8_t *in = rgba + i * 4;
+        float *out = &level[i * 4];
+        out[3] = in[3] / 255.0f;
+        for (int c = 0; c < 3; ++c)
+            out[c] = (options.srgb ? toLinear[in[c]] : in[c] / 255.0f) * out[3];
+    }
+    float coverage = 0.0f;
+    if (options.alphaCutoff > 0.0f)
+        coverage = alphaCoverage(rgba, width, width, height, options.alphaCutoff);
+
+    while (width > 1 || height > 1) {
+        int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+        next.resize((size_t)w * h * 4);
+        if (options.filter == MIP_BOX) {
+            parallelFor(pool, (size_t)h, MIN_ROWS, [&](size_t begin, size_t end) {
+                mipBoxRows(level.data(), width, height, next.data(), begin, end);
+            });
+        } else {
+            halved.resize((size_t)w * height * 4);
+            parallelFor(pool, (size_t)height, MIN_ROWS, [&](size_t begin, size_t end) {
+                mipKaiserColumns(level.data(), width, halved.data(), begin, end);
+            });
+            parallelFor(pool, (size_t)h, MIN_ROWS, [&](size_t begin, size_t end) {
+                mipKaiserRows(halved.data(), w, height, next.data(), begin, end);
+            });
+        }
+        levels.push_back(std::vector<uint8_t>((size_t)w * h * 4));
+        std::vector<uint8_t> &encoded = levels.back();
+        parallelFor(pool, (size_t)h, MIN_ROWS, [&](size_t begin, size_t end) {
+            mipEncodeRows(next.data(), w, options.srgb, encoded.data(), begin, end);
+        });
+        if (options.alphaCutoff > 0.0f)
+            scaleAlphaToCoverage(encoded.data(), w, w, h, options.alphaCutoff, coverage);
+        level.swap(next);
+        width = w;
+        height = h;
+    }
+}
+
+#endif //PROJECT_MIPCHAIN_H
@@ -0,0 +1,254 @@
+//
+// Which mip levels of streamed textures stay on the GPU, without any GL.
+//
+// Every texture has a tail of small levels that is loaded up front and
+// never leaves. Each frame the renderer requests the finest level a
+// texture needs where it is seen (mipForDistance estimates it from the
+// texel density of the surface and its distance), then plan() starts
+// loads one level at a time, coarse to fine, the textures furthest from
+// what they need first. Bytes of loads in flight count as resident from
+// the moment they start, so the budget holds at all times.
+//
+// When a load does not fit, levels are evicted finest first, least
+// recently used texture first. Only textures not seen this frame and
+// levels finer than what a seen texture needs can go; a load that would
+// need more than that waits, so two textures that both want more than the
+// budget allows do not keep evicting each other.
+//
+
+#ifndef PROJECT_MIPRESIDENCY_H
+#define PROJECT_MIPRESIDENCY_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "Vertex.h"
+
+struct MipLoad {
+    int texture;
+    // Level being loaded, or for an eviction the finest level left
+    int level;
+};
+
+class MipResidency
+{
+public:
+    explicit MipResidency(size_t budgetBytes)
+            : budget(budgetBytes), resident(0), frame(1), loadsStarted(0), levelsEvicted(0)
+    {
+    }
+
+    // levelBytes[i] is the size of level i; levels from tailLevel on are
+    // resident from the start. Returns the texture's index.
+    int add(const std::vector<size_t> &levelBytes, int tailLevel)
+    {
+        Entry entry;
+        entry.levelBytes = levelBytes;
+        entry.tail = std::max(0, std::min(tailLevel, (int)levelBytes.size() - 1));
+        entry.resident = entry.tail;
+        entry.wanted = (int)levelBytes.size();
+        entry.loading = -1;
+        entry.lastUsed = 0;
+        for (unsigned int i = entry.tail; i < levelBytes.size(); ++i)
+            resident += levelBytes[i];
+        entries.push_back(entry);
+        return (int)entries.size() - 1;
+    }
+
+    // The texture is seen this frame and needs level or finer
+    void request(int texture, int level)
+    {
+        Entry &entry = entries[texture];
+        entry.wanted = std::min(entry.wanted, std::max(level, 0));
+        entry.lastUsed = frame;
+    }
+
+    // Up to maxLoads new loads, after the evictions that make room for them
+    void plan(unsigned int maxLoads, std::vector<MipLoad> &loads, std::vector<MipLoad> &evictions)
+    {
+        loads.clear();
+        evictions.clear();
+        candidates.clear();
+        for (unsigned int i = 0; i < entries.size(); ++i) {
+            if (entries[i].loading < 0 && entries[i].wanted < entries[i].resident)
+                candidates.push_back((int)i);
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+            const Entry &ea = entries[a], &eb = entries[b];
+            if (ea.resident - ea.wanted != eb.resident - eb.wanted)
+                return ea.resident - ea.wanted > eb.resident - eb.wanted;
+            return ea.lastUsed != eb.lastUsed ? ea.lastUsed > eb.lastUsed : a < b;
+        });
+        for (unsigned int c = 0; c < candidates.size() && loads.size() < maxLoads; ++c) {
+            Entry &entry = entries[candidates[c]];
+            size_t need = entry.levelBytes[entry.resident - 1];
+            if (!makeRoom(need, candidates[c], evictions))
+                continue;
+            resident += need;
+            entry.loading = entry.resident - 1;
+            MipLoad load = { candidates[c], entry.loading };
+            loads.push_back(load);
+            ++loadsStarted;
+        }
+    }
+
+    // The load plan() started for texture is on the GPU
+    void loaded(int texture)
+    {
+        Entry &entry = entries[texture];
+        entry.resident = entry.loading;
+        entry.loading = -1;
+    }
+
+    // The load could not be done; the texture stays at the levels it has
+    // and is not streamed any further
+    void failed(int texture)
+    {
+        Entry &entry = entries[texture];
+        resident -= entry.levelBytes[entry.loading];
+        entry.loading = -1;
+        entry.tail = entry.resident;
+    }
+
+    void endFrame()
+    {
+        for (unsigned int i = 0; i < entries.size(); ++i)
+            entries[i].wanted = (int)entries[i].levelBytes.size();
+        ++frame;
+    }
+
+    // Finest level on the GPU or on its way there
+    int residentLevel(int texture) const
+    {
+        return entries[texture].resident;
+    }
+
+    bool loading(int texture) const
+    {
+        return entries[texture].loading >= 0;
+    }
+
+    size_t residentBytes() const
+    {
+        return resident;
+    }
+
+    size_t budgetBytes() const
+    {
+        return budget;
+    }
+
+    // Every level of every texture
+    size_t fullBytes() const
+    {
+        size_t total = 0;
+        for (unsigned int i = 0; i < entries.size(); ++i) {
+            for (unsigned int j = 0; j < entries[i].levelBytes.size(); ++j)
+                total += entries[i].levelBytes[j];
+        }
+        return total;
+    }
+
+    unsigned long long loadCount() const
+    {
+        return loadsStarted;
+    }
+
+    unsigned long long evictionCount() const
+    {
+        return levelsEvicted;
+    }
+
+private:
+    struct Entry {
+        std::vector<size_t> levelBytes;
+        int tail, resident, wanted, loading;
+        unsigned long long lastUsed;
+    };
+
+    size_t budget, resident;
+    unsigned long long frame;
+    unsigned long long loadsStarted, levelsEvicted;
+    std::vector<Entry> entries;
+    std::vector<int> candidates;
+
+    // Finest level of entry that may be evicted now, tail when none
+    int evictableUntil(const Entry &entry) const
+    {
+        if (entry.loading >= 0)
+            return entry.resident;
+        if (entry.lastUsed < frame)
+            return entry.tail;
+        return std::min(entry.wanted, entry.tail);
+    }
+
+    // Evicts until need more bytes fit, false (and nothing evicted) when
+    // that is not possible
+    bool makeRoom(size_t need, int except, std::vector<MipLoad> &evictions)
+    {
+        if (resident + need <= budget)
+            return true;
+        size_t evictable = 0;
+        for (unsigned int i = 0; i < entries.size(); ++i) {
+            if ((int)i == except)
+                continue;
+            for (int level = entries[i].resident; level < evictableUntil(entries[i]); ++level)
+                evictable += entries[i].levelBytes[level];
+        }
+        if (resident + need > budget + evictable)
+            return false;
+        while (resident + need > budget) {
+            int victim = -1;
+            for (unsigned int i = 0; i < entries.size(); ++i) {
+                const Entry &entry = entries[i];
+                if ((int)i == except || entry.resident >= evictableUntil(entry))
+                    continue;
+                if (victim < 0 || entry.lastUsed < entries[victim].lastUsed)
+                    victim = (int)i;
+            }
+            Entry &entry = entries[victim];
+            resident -= entry.levelBytes[entry.resident];
+            ++entry.resident;
+            MipLoad eviction = { victim, entry.resident };
+            evictions.push_back(eviction);
+            ++levelsEvicted;
+        }
+        return true;
+    }
+};
+
+// Pixels one world unit covers at distance 1 straight ahead
+inline float screenPixelsPerUnit(int screenHeight, float fovyRadians)
+{
+    return screenHeight / (2.0f * std::tan(fovyRadians / 2.0f));
+}
+
+// Texture coordinate units per world unit of a mesh, the square root of
+// its UV area over its surface area. Times the texture size it gives
+// texels per world unit.
+inline float meshUvDensity(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                           size_t indexCount)
+{
+    double area = 0.0, uvArea = 0.0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+        area += 0.5 * glm::length(glm::cross(b.position - a.position, c.position - a.position));
+        glm::vec2 u = b.texCoord - a.texCoord, v = c.texCoord - a.texCoord;
+        uvArea += 0.5 * std::fabs(u.x * v.y - u.y * v.x);
+    }
+    return area > 0.0 ? (float)std::sqrt(uvArea / area) : 0.0f;
+}
+
+// Finest level a texture of textureSize texels needs on a surface of
+// uvDensity seen from distance, where one texel per pixel is level 0
+inline int mipForDistance(float uvDensity, int textureSize, float distance, float pixelsPerUnitAtOne)
+{
+    float texelsPerPixel = uvDensity * textureSize * distance / pixelsPerUnitAtOne;
+    return texelsPerPixel > 1.0f ? (int)std::floor(std::log2(texelsPerPixel)) : 0;
+}
+
+#endif //PROJECT_MIPRESIDENCY_H
@@ -5,183 +5,285 @@
 #ifndef PROJECT_MODEL_H
 #define PROJECT_MODEL_H
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <cfloat>
 
+#include "ModelImporter.h"
 #include "Mesh.h"
+#include "CompressedTexture.h"
+#include "TextureStreamer.h"
 
-unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false)
+// Create a texture from decoded pixels, nrComponents is 1, 3 or 4, and
+// their mip levels from buildMipChain. Without levels they are built here,
+// on pool when there is one.
+unsigned int TextureFromData(const unsigned char *data, int width, int height, int nrComponents,
+                             TextureUsage usage = TEXTURE_COLOR,
+                             const std::vector<std::vector<uint8_t> > &mipLevels = {}, JobPool *pool = nullptr)
 {
-    std::string filename = std::string(path);
-    filename = directory + '/' + filename;
-
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
+    GLenum format = GL_RGB;
+    if (nrComponents == 1)
+        format = GL_RED;
+    else if (nrComponents == 3)
+        format = GL_RGB;
+    else if (nrComponents == 4)
+        format = GL_RGBA;
+
+    std::vector<std::vector<uint8_t> > built;
+    if (mipLevels.empty()) {
+        std::vector<uint8_t> rgba = expandToRgba(data, width, height, nrComponents);
+        buildMipChain(rgba.data(), width, height, mipOptionsFor(usage), built, pool);
+    }
+    const std::vector<std::vector<uint8_t> > &levels = mipLevels.empty() ? built : mipLevels;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (unsigned int level = 0; level < levels.size(); ++level) {
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, std::max(width >> level, 1), std::max(height >> level, 1),
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false,
+                             JobPool *pool = nullptr)
+{
+    std::string filename = std::string(path);
+    filename = directory + '/' + filename;
+
     int width, height, nrComponents;
     unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned int textureID;
     if (data)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        textureID = TextureFromData(data, width, height, nrComponents, TEXTURE_COLOR, {}, pool);
     }
     else
     {
+        glGenTextures(1, &textureID);
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
+    stbi_image_free(data);
 
     return textureID;
 }
 
+// How Model loads a file. Meshes and images are converted on pool (on the
+// calling thread without one), the GL objects are created on the calling
+// thread afterwards.
+struct ModelOptions {
+    JobPool *pool;
+    // Above 1, every mesh also gets simplified levels of detail
+    unsigned int lodLevels;
+    // Split every mesh into clusters for DrawCulled
+    bool meshlets;
+    // Upload block compressed textures from the texture cache
+    bool compressTextures;
+    // Compress the textures and stream them instead, see RequestTextures
+    TextureStreamer *streamer;
+
+    explicit ModelOptions(JobPool *pool_ = nullptr)
+            : pool(pool_), lodLevels(1), meshlets(false), compressTextures(false), streamer(nullptr)
+    {
+    }
+};
+
 class Model
 {
 public:
     std::vector<Mesh> meshes;
     std::vector<Texture> textures_loaded;
     std::string directory;
-    Model(const char *path)
+    // Node hierarchy of the file, meshNodes[i] is the node of meshes[i]
+    SceneGraph nodes;
+    std::vector<int> meshNodes;
+    // Time spent generating tangents, summed over all meshes
+    double tangentMilliseconds;
+    // Wall clock time of the CPU side of loading and of the GL upload
+    double importMilliseconds, uploadMilliseconds;
+    // Meshlets and triangles in total and drawn by the last DrawCulled
+    unsigned int meshletTotal, meshletsDrawn;
+    unsigned int triangleTotal, trianglesDrawn;
+    // GPU memory of all textures with their mip levels, uncompressed ones
+    // counted at 4 bytes per pixel
+    size_t textureBytes;
+
+    // Where a mesh is and how densely its textures cover it, in the
+    // mesh's own space, for choosing the mip levels to stream
+    struct MeshTexels {
+        glm::vec3 center;
+        float radius;
+        float uvDensity;
+        // Indices into textures_loaded
+        std::vector<unsigned int> textures;
+    };
+    std::vector<MeshTexels> meshTexels;
+    // TextureStreamer handle of every texture in textures_loaded, -1 for
+    // textures that are not streamed
+    std::vector<int> streamedTextures;
+
+    explicit Model(const char *path, const ModelOptions &options = ModelOptions())
+            : tangentMilliseconds(0.0), importMilliseconds(0.0), uploadMilliseconds(0.0),
+              meshletTotal(0), meshletsDrawn(0), triangleTotal(0), trianglesDrawn(0), textureBytes(0)
     {
-        loadModel(path);
+        loadModel(path, options);
     }
+    // Draws every mesh with whatever "model" the caller has set, ignoring
+    // the node transforms
     void Draw(Shader shader)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].draw(shader);
     }
-private:
-    void loadModel(std::string path)
+    // Draws every mesh at model * its node's world transform. Change node
+    // transforms through nodes.setLocal, they are propagated here.
+    void Draw(Shader shader, const glm::mat4 &model)
     {
-        Assimp::Importer importer;
-        const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-        {
-            std::cout << "Assimp Error:" << importer.GetErrorString() << std::endl;
-            return;
+        nodes.update();
+        for(unsigned int i = 0; i < meshes.size(); i++) {
+            shader.setModelMatrix(model * nodes.world[meshNodes[i]]);
+            meshes[i].draw(shader);
         }
-        directory = path.substr(0, path.find_last_of('/'));
-
-        processNode(scene->mRootNode, scene);
     }
-    void processNode(aiNode *node, const aiScene *scene)
+    // Like Draw, but only the meshlets inside the frustum that face the
+    // camera. Meshes without meshlets are drawn whole.
+    void DrawCulled(Shader shader, const glm::mat4 &model, const glm::mat4 &viewProjection,
+                    const glm::vec3 &cameraPosition)
     {
-        // process all the node's meshes (if any)
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
-        {
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
-        }
-        // then do the same for each of its children
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
-        {
-            processNode(node->mChildren[i], scene);
+        nodes.update();
+        meshletsDrawn = 0;
+        trianglesDrawn = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++) {
+            Mesh &mesh = meshes[i];
+            glm::mat4 meshModel = model * nodes.world[meshNodes[i]];
+            shader.setModelMatrix(meshModel);
+            if (mesh.meshlets.empty()) {
+                mesh.draw(shader);
+                trianglesDrawn += mesh.lod(0).indexCount / 3;
+                continue;
+            }
+            // Cull in model space, the bounds stay as they are
+            Frustum frustum = extractFrustum(viewProjection * meshModel);
+            glm::vec3 camera = glm::vec3(glm::inverse(meshModel) * glm::vec4(cameraPosition, 1.0f));
+            meshletsDrawn += cullMeshlets(mesh.meshlets, frustum, camera, visibleRanges);
+            mesh.drawRanges(shader, visibleRanges);
+            for (unsigned int r = 0; r < visibleRanges.size(); ++r)
+                trianglesDrawn += visibleRanges[r].indexCount / 3;
         }
     }
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // Requests the mip levels of the streamed textures that the meshes in
+    // the frustum need, drawn at model * their node's world transform.
+    // pixelsPerUnitAtOne comes from screenPixelsPerUnit.
+    void RequestTextures(TextureStreamer &streamer, const glm::mat4 &model, const glm::mat4 &viewProjection,
+                         const glm::vec3 &cameraPosition, float pixelsPerUnitAtOne)
     {
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
-
-        for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
-        {
-            Vertex vertex;
-            // process vertex positions, normals and texture coordinates
-            glm::vec3 v;
-            v.x = mesh->mVertices[i].x;
-            v.y = mesh->mVertices[i].y;
-            v.z = mesh->mVertices[i].z;
-            vertex.position = v;
-            v.x = mesh->mNormals[i].x;
-            v.y = mesh->mNormals[i].y;
-            v.z = mesh->mNormals[i].z;
-            vertex.normal = v;
-            if (mesh->mTextureCoords[0])
-            { // contain texture coordinates
-                glm::vec2 vec;
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.texCoord = vec;
-            }
-            else
-            {
-                vertex.texCoord = glm::vec2(0.0f, 0.0f);
-            }
-
-            vertices.push_back(vertex);
-        }
-        // process indices
-        for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
-        {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; ++j)
-            {
-                indices.push_back(face.mIndices[j]);
+        nodes.update();
+        Frustum frustum = extractFrustum(viewProjection);
+        for (unsigned int i = 0; i < meshTexels.size(); ++i) {
+            const MeshTexels &texels = meshTexels[i];
+            glm::mat4 meshModel = model * nodes.world[meshNodes[i]];
+            float scale = std::max(std::max(glm::length(glm::vec3(meshModel[0])), glm::length(glm::vec3(meshModel[1]))),
+                                   glm::length(glm::vec3(meshModel[2])));
+            glm::vec4 sphere(glm::vec3(meshModel * glm::vec4(texels.center, 1.0f)), texels.radius * scale);
+            if (!sphereInFrustum(frustum, sphere))
+                continue;
+            // The nearest point of the bounds, inside them the finest level
+            float distance = std::max(glm::length(cameraPosition - glm::vec3(sphere)) - sphere.w, 0.0f);
+            for (unsigned int j = 0; j < texels.textures.size(); ++j) {
+                int handle = streamedTextures[texels.textures[j]];
+                if (handle >= 0)
+                    streamer.request(handle, mipForDistance(texels.uvDensity / scale, streamer.size(handle),
+                                                            distance, pixelsPerUnitAtOne));
             }
         }
-        // process materials
-        if (mesh->mMaterialIndex >= 0)
-        {
-            aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-            std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-                                                               aiTextureType_DIFFUSE, "texture_diffuse");
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            std::vector<Texture> specularMaps = loadMaterialTextures(material,
-                                                                aiTextureType_SPECULAR, "texture_specular");
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        }
-        return Mesh(vertices, indices, textures);
     }
-    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
-                                         std::string typeName)
+private:
+    std::vector<IndexRange> visibleRanges;
+
+    void loadModel(std::string path, const ModelOptions &options)
     {
-        std::vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    break;
-                }
+        auto start = std::chrono::high_resolution_clock::now();
+        ModelImporter importer;
+        ImageLoading imageLoading = IMAGES_MIPMAPPED;
+        if (options.streamer)
+            imageLoading = IMAGES_CACHED;
+        else if (options.compressTextures)
+            imageLoading = IMAGES_COMPRESSED;
+        if (!importer.import(path, options.pool, options.lodLevels, options.meshlets, imageLoading))
+            return;
+        directory = importer.directory;
+        nodes = importer.nodes;
+        tangentMilliseconds = importer.tangentMilliseconds;
+        auto imported = std::chrono::high_resolution_clock::now();
+        importMilliseconds = std::chrono::duration<double, std::milli>(imported - start).count();
+
+        upload(importer, options.pool, options.streamer);
+        uploadMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - imported).count();
+    }
+
+    // Create every texture once, then the meshes that reference them
+    void upload(ModelImporter &importer, JobPool *pool, TextureStreamer *streamer)
+    {
+        textures_loaded.reserve(importer.images.size());
+        for (unsigned int i = 0; i < importer.images.size(); ++i) {
+            const ImportedImage &image = importer.images[i];
+            Texture texture;
+            int handle = streamer ? streamer->add(directory + '/' + image.path, image.usage) : -1;
+            streamedTextures.push_back(handle);
+            if (handle >= 0) {
+                texture.id = streamer->id(handle);
+            } else if (!image.compressed.empty()) {
+                texture.id = TextureFromCompressed(image.compressed);
+                textureBytes += compressedTextureBytes(image.compressed);
+            } else if (image.data) {
+                texture.id = TextureFromData(image.data, image.width, image.height, image.components, image.usage,
+                                             image.mipLevels, pool);
+                textureBytes += (size_t)image.width * image.height * 4 * 4 / 3;
+            } else {
+                glGenTextures(1, &texture.id);
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
+            texture.path = image.path;
+            textures_loaded.push_back(texture);
+        }
+        importer.releaseImages();
+
+        meshes.reserve(importer.meshes.size());
+        for (unsigned int i = 0; i < importer.meshes.size(); ++i) {
+            ImportedMesh &source = importer.meshes[i];
+            std::vector<Texture> textures;
+            MeshTexels texels;
+            for (unsigned int j = 0; j < source.textures.size(); ++j) {
+                Texture texture = textures_loaded[source.textures[j].first];
+                texture.type = source.textures[j].second;
                 textures.push_back(texture);
-                textures_loaded.push_back(texture); // add to loaded textures
+                texels.textures.push_back(source.textures[j].first);
+            }
+            if (streamer) {
+                glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+                for (unsigned int j = 0; j < source.vertices.size(); ++j) {
+                    lo = glm::min(lo, source.vertices[j].position);
+                    hi = glm::max(hi, source.vertices[j].position);
+                }
+                texels.center = (lo + hi) * 0.5f;
+                texels.radius = 0.0f;
+                for (unsigned int j = 0; j < source.vertices.size(); ++j)
+                    texels.radius = std::max(texels.radius, glm::length(source.vertices[j].position - texels.center));
+                texels.uvDensity = meshUvDensity(source.vertices, source.indices, source.lods[0].indexCount);
+                meshTexels.push_back(texels);
             }
+            meshes.push_back(Mesh(source.vertices, source.indices, textures, source.lods, source.meshlets));
+            meshNodes.push_back(source.node);
+            meshletTotal += (unsigned int)source.meshlets.size();
+            triangleTotal += source.lods[0].indexCount / 3;
         }
-        return textures;
     }
 };
 
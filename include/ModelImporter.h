@@ -0,0 +1,286 @@
+//
+// The CPU side of Model loading, without any OpenGL calls:
+//   1. assimp reads the file (single threaded),
+//   2. the node tree is walked once to list meshes and their textures, and
+//      to copy the node transforms into a SceneGraph,
+//   3. every aiMesh conversion (vertices, indices, tangents, levels of
+//      detail, meshlets) and every image decode is a job on a JobPool, writing into
+//      arrays sized up front. Image jobs decode, build mip levels, load block
+//      compressed mip chains through the texture cache, or only bring the
+//      cache up to date for TextureStreamer, see ImageLoading.
+// Model.h then creates the GL buffers and textures on the context thread.
+//
+
+#ifndef PROJECT_MODELIMPORTER_H
+#define PROJECT_MODELIMPORTER_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <iostream>
+
+#include "Vertex.h"
+#include "TangentSpace.h"
+#include "JobPool.h"
+#include "SceneGraph.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "TextureCache.h"
+
+// What the image jobs leave in ImportedImage
+enum ImageLoading {
+    // data, the decoded pixels
+    IMAGES_DECODED,
+    // data and mipLevels, from buildMipChain
+    IMAGES_MIPMAPPED,
+    // compressed, from loadCompressedTexture
+    IMAGES_COMPRESSED,
+    // Nothing, the cache files are made up to date for streaming
+    IMAGES_CACHED
+};
+
+// A decoded image, data is owned by the importer until released. Unless
+// images are decoded data stays null.
+struct ImportedImage {
+    std::string path;
+    int width, height, components;
+    unsigned char *data;
+    // From the texture type that references it, picks the block format
+    TextureUsage usage;
+    CompressedImage compressed;
+    // RGBA8 levels, level 0 first
+    std::vector<std::vector<uint8_t> > mipLevels;
+};
+
+struct ImportedMesh {
+    std::vector<Vertex> vertices;
+    // Level 0 followed by the simplified levels, see lods
+    std::vector<unsigned int> indices;
+    std::vector<MeshLod> lods;
+    // Clusters of level 0, which is ordered meshlet by meshlet. Empty
+    // unless asked for.
+    std::vector<Meshlet> meshlets;
+    // (index into ModelImporter::images, texture type) pairs
+    std::vector<std::pair<unsigned int, std::string> > textures;
+    // Scene graph node the mesh hangs off
+    int node;
+    double tangentMilliseconds;
+};
+
+class ModelImporter
+{
+public:
+    std::string directory;
+    std::vector<ImportedMesh> meshes;
+    std::vector<ImportedImage> images;
+    SceneGraph nodes;
+    // Wall clock time of each stage, tangent time is summed over all jobs
+    double readMilliseconds, convertMilliseconds, tangentMilliseconds;
+
+    ModelImporter()
+            : readMilliseconds(0.0), convertMilliseconds(0.0), tangentMilliseconds(0.0) {}
+
+    ~ModelImporter()
+    {
+        releaseImages();
+    }
+
+    // Images and meshes are jobs on pool, or converted one after the other
+    // on the calling thread without one. lodLevels > 1 adds that many
+    // levels of detail in total to every mesh, each with half the triangles.
+    // With withMeshlets level 0 is split into clusters for cullMeshlets,
+    // imageLoading says what becomes of the images.
+    bool import(const std::string &path, JobPool *pool = nullptr, unsigned int lodLevels = 1,
+                bool withMeshlets = false, ImageLoading imageLoading = IMAGES_DECODED)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        Assimp::Importer importer;
+        // Shared vertices keep meshlets and the vertex cache small
+        const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs |
+                                                       aiProcess_JoinIdenticalVertices);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cout << "Assimp Error:" << importer.GetErrorString() << std::endl;
+            return false;
+        }
+        directory = path.substr(0, path.find_last_of('/'));
+        auto read = std::chrono::high_resolution_clock::now();
+        readMilliseconds = std::chrono::duration<double, std::milli>(read - start).count();
+
+        // Meshes in the order the node tree references them
+        std::vector<const aiMesh *> sources;
+        std::vector<int> sourceNodes;
+        collectMeshes(scene->mRootNode, -1, scene, sources, sourceNodes);
+        nodes.update();
+        meshes.resize(sources.size());
+        for (unsigned int i = 0; i < sources.size(); ++i) {
+            meshes[i].textures = materialTextures(scene->mMaterials[sources[i]->mMaterialIndex]);
+            meshes[i].node = sourceNodes[i];
+        }
+
+        // Images first, they are the largest jobs
+        size_t imageCount = images.size(), jobCount = imageCount + sources.size();
+        auto convertRange = [&](size_t begin, size_t end) {
+            for (size_t job = begin; job < end; ++job) {
+                if (job < imageCount && imageLoading == IMAGES_COMPRESSED)
+                    loadCompressedImage(images[job]);
+                else if (job < imageCount && imageLoading == IMAGES_CACHED)
+                    cacheImage(images[job]);
+                else if (job < imageCount && imageLoading == IMAGES_MIPMAPPED)
+                    mipmapImage(images[job]);
+                else if (job < imageCount)
+                    decodeImage(images[job]);
+                else
+                    convertMesh(*sources[job - imageCount], meshes[job - imageCount], lodLevels, withMeshlets);
+            }
+        };
+        parallelFor(pool, jobCount, 1, convertRange);
+
+        convertMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - read).count();
+        tangentMilliseconds = 0.0;
+        for (unsigned int i = 0; i < meshes.size(); ++i)
+            tangentMilliseconds += meshes[i].tangentMilliseconds;
+        return true;
+    }
+
+    void releaseImages()
+    {
+        for (unsigned int i = 0; i < images.size(); ++i) {
+            stbi_image_free(images[i].data);
+            images[i].data = nullptr;
+            images[i].compressed = CompressedImage();
+            std::vector<std::vector<uint8_t> >().swap(images[i].mipLevels);
+        }
+    }
+
+private:
+    // Depth first, which is the order SceneGraph wants
+    void collectMeshes(const aiNode *node, int parentIndex, const aiScene *scene,
+                       std::vector<const aiMesh *> &sources, std::vector<int> &sourceNodes)
+    {
+        // aiMatrix4x4 is row major
+        const aiMatrix4x4 &m = node->mTransformation;
+        glm::mat4 transform(m.a1, m.b1, m.c1, m.d1,
+                            m.a2, m.b2, m.c2, m.d2,
+                            m.a3, m.b3, m.c3, m.d3,
+                            m.a4, m.b4, m.c4, m.d4);
+        int index = nodes.addNode(parentIndex, transform);
+        for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+            sources.push_back(scene->mMeshes[node->mMeshes[i]]);
+            sourceNodes.push_back(index);
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; ++i)
+            collectMeshes(node->mChildren[i], index, scene, sources, sourceNodes);
+    }
+
+    // Index of the image for path, adding it the first time it is seen
+    unsigned int imageIndex(const std::string &path, TextureUsage usage)
+    {
+        for (unsigned int i = 0; i < images.size(); ++i) {
+            if (images[i].path == path)
+                return i;
+        }
+        ImportedImage image = { path, 0, 0, 0, nullptr, usage, CompressedImage(), {} };
+        images.push_back(image);
+        return (unsigned int)images.size() - 1;
+    }
+
+    void addTextures(aiMaterial *material, aiTextureType type, const std::string &typeName, TextureUsage usage,
+                     std::vector<std::pair<unsigned int, std::string> > &textures)
+    {
+        for (unsigned int i = 0; i < material->GetTextureCount(type); ++i) {
+            aiString str;
+            material->GetTexture(type, i, &str);
+            textures.push_back(std::make_pair(imageIndex(str.C_Str(), usage), typeName));
+        }
+    }
+
+    std::vector<std::pair<unsigned int, std::string> > materialTextures(aiMaterial *material)
+    {
+        std::vector<std::pair<unsigned int, std::string> > textures;
+        addTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", TEXTURE_COLOR, textures);
+        addTextures(material, aiTextureType_SPECULAR, "texture_specular", TEXTURE_SPECULAR, textures);
+        // OBJ files store normal maps as map_Bump, which assimp reports as a height map
+        size_t before = textures.size();
+        addTextures(material, aiTextureType_NORMALS, "texture_normal", TEXTURE_NORMAL, textures);
+        if (textures.size() == before)
+            addTextures(material, aiTextureType_HEIGHT, "texture_normal", TEXTURE_NORMAL, textures);
+        return textures;
+    }
+
+    void decodeImage(ImportedImage &image)
+    {
+        std::string filename = directory + '/' + image.path;
+        image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+        if (!image.data)
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    // One image per job already keeps the workers busy, so the chain is
+    // built on this thread
+    void mipmapImage(ImportedImage &image)
+    {
+        decodeImage(image);
+        if (!image.data)
+            return;
+        std::vector<uint8_t> rgba = expandToRgba(image.data, image.width, image.height, image.components);
+        buildMipChain(rgba.data(), image.width, image.height, mipOptionsFor(image.usage), image.mipLevels);
+    }
+
+    void loadCompressedImage(ImportedImage &image)
+    {
+        if (!loadCompressedTexture(directory + '/' + image.path, image.usage, false, image.compressed))
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        image.width = image.compressed.width;
+        image.height = image.compressed.height;
+    }
+
+    void cacheImage(ImportedImage &image)
+    {
+        if (!updateTextureCache(directory + '/' + image.path, image.usage, false))
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    static void convertMesh(const aiMesh &mesh, ImportedMesh &out, unsigned int lodLevels, bool withMeshlets)
+    {
+        out.vertices.resize(mesh.mNumVertices);
+        for (unsigned int i = 0; i < mesh.mNumVertices; ++i) {
+            Vertex &vertex = out.vertices[i];
+            vertex.position = glm::vec3(mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z);
+            vertex.normal = mesh.mNormals ? glm::vec3(mesh.mNormals[i].x, mesh.mNormals[i].y,
+                                                      mesh.mNormals[i].z)
+                                          : glm::vec3(0.0f, 1.0f, 0.0f);
+            vertex.texCoord = mesh.mTextureCoords[0] ? glm::vec2(mesh.mTextureCoords[0][i].x,
+                                                                 mesh.mTextureCoords[0][i].y)
+                                                     : glm::vec2(0.0f);
+            vertex.tangent = 0;
+        }
+        // Triangulated, so three indices per face except for stray points and lines
+        out.indices.reserve(mesh.mNumFaces * 3);
+        for (unsigned int i = 0; i < mesh.mNumFaces; ++i) {
+            const aiFace &face = mesh.mFaces[i];
+            out.indices.insert(out.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+        }
+
+        // Already running on a worker, so tangents stay on this thread
+        auto start = std::chrono::high_resolution_clock::now();
+        generateTangents(out.vertices, out.indices);
+        out.tangentMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+
+        out.lods = generateLods(out.vertices, out.indices, lodLevels);
+        // Reorders level 0 only, the simplified levels were made from it already
+        if (withMeshlets)
+            out.meshlets = buildMeshlets(out.vertices, out.indices, 0, out.lods[0].indexCount);
+    }
+};
+
+#endif //PROJECT_MODELIMPORTER_H
@@ -0,0 +1,93 @@
+//
+// Normal matrices (inverse transpose of the upper 3x3 of a model matrix)
+// computed on the CPU, so vertex shaders don't invert a matrix per vertex.
+//
+// The inverse transpose of a 3x3 matrix with columns c0, c1, c2 has the
+// columns (c1 x c2, c2 x c0, c0 x c1) / det, which is a handful of cross
+// products. The batch version does four matrices at a time with SSE and
+// writes them in the padded layout used by per instance vertex attributes.
+//
+
+#ifndef PROJECT_NORMALMATRIX_H
+#define PROJECT_NORMALMATRIX_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define NORMALMATRIX_USE_SSE
+#endif
+
+// One normal matrix as three vec4 columns (w unused), 48 bytes.
+// Bind it as an instance attribute of three vec3 with a stride of 48.
+struct PackedNormalMatrix {
+    glm::vec4 columns[3];
+
+    glm::mat3 toMat3() const
+    {
+        return glm::mat3(glm::vec3(columns[0]), glm::vec3(columns[1]), glm::vec3(columns[2]));
+    }
+};
+
+inline glm::mat3 normalMatrix(const glm::mat4 &model)
+{
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 n0 = glm::cross(c1, c2);
+    float invDet = 1.0f / glm::dot(c0, n0);
+    return glm::mat3(n0 * invDet, glm::cross(c2, c0) * invDet, glm::cross(c0, c1) * invDet);
+}
+
+inline void computeNormalMatrices(const glm::mat4 *models, PackedNormalMatrix *out, size_t count)
+{
+    size_t i = 0;
+#ifdef NORMALMATRIX_USE_SSE
+    for (; i + 4 <= count; i += 4) {
+        // Transpose the first three columns of four matrices, so each
+        // register holds one element of all four
+        __m128 c[3][3];
+        for (int col = 0; col < 3; ++col) {
+            __m128 m0 = _mm_loadu_ps(&models[i][col][0]);
+            __m128 m1 = _mm_loadu_ps(&models[i + 1][col][0]);
+            __m128 m2 = _mm_loadu_ps(&models[i + 2][col][0]);
+            __m128 m3 = _mm_loadu_ps(&models[i + 3][col][0]);
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+            c[col][0] = m0;
+            c[col][1] = m1;
+            c[col][2] = m2;
+        }
+
+        // n[j] = c[j + 1] x c[j + 2]
+        __m128 n[3][3];
+        for (int j = 0; j < 3; ++j) {
+            const __m128 *a = c[(j + 1) % 3], *b = c[(j + 2) % 3];
+            n[j][0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+            n[j][1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+            n[j][2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+        }
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0][0], n[0][0]), _mm_mul_ps(c[0][1], n[0][1])),
+                                _mm_mul_ps(c[0][2], n[0][2]));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        for (int j = 0; j < 3; ++j) {
+            __m128 x = _mm_mul_ps(n[j][0], invDet);
+            __m128 y = _mm_mul_ps(n[j][1], invDet);
+            __m128 z = _mm_mul_ps(n[j][2], invDet);
+            __m128 w = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(&out[i].columns[j][0], x);
+            _mm_storeu_ps(&out[i + 1].columns[j][0], y);
+            _mm_storeu_ps(&out[i + 2].columns[j][0], z);
+            _mm_storeu_ps(&out[i + 3].columns[j][0], w);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        glm::mat3 n = normalMatrix(models[i]);
+        for (int j = 0; j < 3; ++j)
+            out[i].columns[j] = glm::vec4(n[j], 0.0f);
+    }
+}
+
+#endif //PROJECT_NORMALMATRIX_H
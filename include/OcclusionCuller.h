@@ -0,0 +1,530 @@
+//
+// Software occlusion culling on the CPU, without any OpenGL calls.
+// A few large occluders (planet, cubes, ground) are rasterized into a small
+// depth buffer, a Hi-Z pyramid is built from it and the bounds of
+// everything else are tested against the pyramid before it is submitted.
+//
+// Every frame:
+//   - beginFrame sets the view projection matrix,
+//   - addOccluder queues triangle lists (the data has to stay alive until
+//     render returns),
+//   - render transforms, near clips and sets up the triangles in chunks of
+//     TRIANGLES_PER_CHUNK, each chunk binning its triangles into its own
+//     list per TILE_SIZE x TILE_SIZE tile, then rasterizes every tile with
+//     four pixels per SSE instruction, keeping the nearest depth. Chunks
+//     and tiles are jobs on a JobPool, a tile reads the bins of every chunk
+//     in order so the result does not depend on the thread count. Each
+//     tile job also reduces its tile down to one texel, the few levels
+//     above tile size are built afterwards.
+//   - boxVisible / sphereVisible / cullSpheres project the bounds, pick
+//     the pyramid level where they cover at most 2x2 texels and compare
+//     the nearest depth of the bounds with the farthest occluder depth
+//     there.
+// Depth is NDC z, 1 is the far plane. Occluders are back face culled
+// (closed meshes wound counter clockwise) unless added as two sided.
+//
+
+#ifndef PROJECT_OCCLUSIONCULLER_H
+#define PROJECT_OCCLUSIONCULLER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include "JobPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSIONCULLER_USE_SSE
+#endif
+
+class OcclusionCuller
+{
+public:
+    static const int TILE_SIZE = 32;
+    // log2(TILE_SIZE), the levels each tile job reduces itself
+    static const int TILE_LEVELS = 5;
+    static const unsigned int TRIANGLES_PER_CHUNK = 1024;
+    static const unsigned int SPHERES_PER_JOB = 4096;
+
+    // Occluder triangles after back face and near plane culling, and the
+    // wall clock time of the last render
+    unsigned int trianglesRasterized;
+    double renderMilliseconds;
+
+    // width and height are rounded up to whole tiles. The jobs run on pool,
+    // which has to outlive the culler.
+    explicit OcclusionCuller(JobPool &pool, int width = 256, int height = 192)
+            : trianglesRasterized(0), renderMilliseconds(0.0), pool(pool),
+              viewProjection(1.0f)
+    {
+        tilesX = std::max(1, (width + TILE_SIZE - 1) / TILE_SIZE);
+        tilesY = std::max(1, (height + TILE_SIZE - 1) / TILE_SIZE);
+        int w = tilesX * TILE_SIZE, h = tilesY * TILE_SIZE;
+        while (true) {
+            levelWidths.push_back(w);
+            levelHeights.push_back(h);
+            levels.push_back(std::vector<float>((size_t)w * h, 1.0f));
+            if (w == 1 && h == 1)
+                break;
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+    }
+
+    int width() const
+    {
+        return levelWidths[0];
+    }
+
+    int height() const
+    {
+        return levelHeights[0];
+    }
+
+    unsigned int levelCount() const
+    {
+        return (unsigned int)levels.size();
+    }
+
+    unsigned int threadCount() const
+    {
+        return pool.threadCount();
+    }
+
+    // Row major, row 0 at the bottom of the screen
+    const std::vector<float> &level(unsigned int l) const
+    {
+        return levels[l];
+    }
+
+    int levelWidth(unsigned int l) const
+    {
+        return levelWidths[l];
+    }
+
+    int levelHeight(unsigned int l) const
+    {
+        return levelHeights[l];
+    }
+
+    void beginFrame(const glm::mat4 &viewProjection_)
+    {
+        viewProjection = viewProjection_;
+        draws.clear();
+    }
+
+    // positions: the first float of the first position, strideBytes apart.
+    // With indices indexCount indices are read, without them indexCount
+    // positions in order. Two sided occluders rasterize both windings, for
+    // meshes whose winding is not consistent.
+    void addOccluder(const void *positions, size_t strideBytes, const unsigned int *indices,
+                     unsigned int indexCount, const glm::mat4 &model, bool twoSided = false)
+    {
+        OccluderDraw draw;
+        draw.positions = (const char *)positions;
+        draw.stride = strideBytes;
+        draw.indices = indices;
+        draw.triangleCount = indexCount / 3;
+        draw.transform = viewProjection * model;
+        draw.twoSided = twoSided;
+        draws.push_back(draw);
+    }
+
+    // Vertices with a glm::vec3 position, like Vertex
+    template <typename V>
+    void addOccluder(const std::vector<V> &vertices, const std::vector<unsigned int> &indices,
+                     unsigned int indexCount, const glm::mat4 &model)
+    {
+        addOccluder(&vertices[0].position.x, sizeof(V), indices.data(), indexCount, model);
+    }
+
+    void render()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        unsigned int triangleTotal = 0;
+        drawStart.resize(draws.size() + 1);
+        for (unsigned int d = 0; d < draws.size(); ++d) {
+            drawStart[d] = triangleTotal;
+            triangleTotal += draws[d].triangleCount;
+        }
+        drawStart[draws.size()] = triangleTotal;
+
+        unsigned int tileCount = (unsigned int)(tilesX * tilesY);
+        chunkCount = (triangleTotal + TRIANGLES_PER_CHUNK - 1) / TRIANGLES_PER_CHUNK;
+        if (chunks.size() < chunkCount)
+            chunks.resize(chunkCount);
+        for (unsigned int c = 0; c < chunkCount; ++c)
+            chunks[c].bins.resize(tileCount);
+
+        pool.forEach(chunkCount, [&](size_t c) { setupChunk((unsigned int)c); });
+        pool.forEach(tileCount, [&](size_t t) { rasterTile((unsigned int)t); });
+        for (unsigned int l = TILE_LEVELS + 1; l < levels.size(); ++l)
+            downsample(l, 0, levelWidths[l], 0, levelHeights[l]);
+
+        trianglesRasterized = 0;
+        for (unsigned int c = 0; c < chunkCount; ++c)
+            trianglesRasterized += (unsigned int)chunks[c].triangles.size();
+        renderMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // World space box, after the last render. Boxes crossing the near plane
+    // are always visible, boxes entirely off screen never.
+    bool boxVisible(const glm::vec3 &lo, const glm::vec3 &hi) const
+    {
+        // Corners are the clip space minimum corner plus any mix of the
+        // three edge vectors. Track the smallest (x/w, y/w, z/w, w) and the
+        // largest x/w, y/w over the eight corners.
+        glm::vec4 base = viewProjection * glm::vec4(lo, 1.0f);
+        glm::vec4 edges[3];
+        for (int i = 0; i < 3; ++i)
+            edges[i] = viewProjection[i] * (hi[i] - lo[i]);
+        float minX, minY, minZ, maxX, maxY, minW;
+#ifdef OCCLUSIONCULLER_USE_SSE
+        __m128 b = _mm_loadu_ps(&base.x), ex = _mm_loadu_ps(&edges[0].x);
+        __m128 ey = _mm_loadu_ps(&edges[1].x), ez = _mm_loadu_ps(&edges[2].x);
+        __m128 lowest = _mm_set1_ps(1.0e30f), highest = _mm_set1_ps(-1.0e30f), lowestW = lowest;
+        for (int corner = 0; corner < 8; ++corner) {
+            __m128 p = b;
+            if (corner & 1)
+                p = _mm_add_ps(p, ex);
+            if (corner & 2)
+                p = _mm_add_ps(p, ey);
+            if (corner & 4)
+                p = _mm_add_ps(p, ez);
+            __m128 w = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3));
+            lowestW = _mm_min_ps(lowestW, w);
+            __m128 projected = _mm_div_ps(p, _mm_max_ps(w, _mm_set1_ps(1.0e-6f)));
+            lowest = _mm_min_ps(lowest, projected);
+            highest = _mm_max_ps(highest, projected);
+        }
+        float low[4], high[4];
+        _mm_storeu_ps(low, lowest);
+        _mm_storeu_ps(high, highest);
+        minX = low[0];
+        minY = low[1];
+        minZ = low[2];
+        maxX = high[0];
+        maxY = high[1];
+        minW = _mm_cvtss_f32(lowestW);
+#else
+        minX = minY = minZ = minW = 1.0e30f;
+        maxX = maxY = -1.0e30f;
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec4 p = base;
+            for (int i = 0; i < 3; ++i) {
+                if (corner & (1 << i))
+                    p += edges[i];
+            }
+            minW = std::min(minW, p.w);
+            p /= std::max(p.w, 1.0e-6f);
+            minX = std::min(minX, p.x);
+            minY = std::min(minY, p.y);
+            minZ = std::min(minZ, p.z);
+            maxX = std::max(maxX, p.x);
+            maxY = std::max(maxY, p.y);
+        }
+#endif
+        if (minW <= 1.0e-6f || minZ < -1.0f)
+            return true;
+
+        // Pixels whose centers the projected rectangle can touch
+        int x0 = std::max(0, (int)std::floor((minX * 0.5f + 0.5f) * levelWidths[0]));
+        int y0 = std::max(0, (int)std::floor((minY * 0.5f + 0.5f) * levelHeights[0]));
+        int x1 = std::min(levelWidths[0] - 1, (int)std::floor((maxX * 0.5f + 0.5f) * levelWidths[0]));
+        int y1 = std::min(levelHeights[0] - 1, (int)std::floor((maxY * 0.5f + 0.5f) * levelHeights[0]));
+        if (x0 > x1 || y0 > y1)
+            return false;
+
+        unsigned int l = 0;
+        while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1))
+            ++l;
+        const std::vector<float> &depth = levels[l];
+        int w = levelWidths[l];
+        float farthest = 0.0f;
+        for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+            for (int x = x0 >> l; x <= (x1 >> l); ++x)
+                farthest = std::max(farthest, depth[(size_t)y * w + x]);
+        }
+        return minZ <= farthest;
+    }
+
+    bool sphereVisible(const glm::vec4 &sphere) const
+    {
+        glm::vec3 center(sphere), extent(sphere.w);
+        return boxVisible(center - extent, center + extent);
+    }
+
+    // visible[i] = 0 for spheres hidden behind the occluders (or off
+    // screen), 1 otherwise. Runs on the pool.
+    void cullSpheres(const std::vector<glm::vec4> &spheres, std::vector<uint8_t> &visible)
+    {
+        visible.resize(spheres.size());
+        size_t jobs = (spheres.size() + SPHERES_PER_JOB - 1) / SPHERES_PER_JOB;
+        pool.forEach(jobs, [&](size_t job) {
+            size_t end = std::min(spheres.size(), (job + 1) * SPHERES_PER_JOB);
+            for (size_t i = job * SPHERES_PER_JOB; i < end; ++i)
+                visible[i] = sphereVisible(spheres[i]) ? 1 : 0;
+        });
+    }
+
+private:
+    struct OccluderDraw {
+        const char *positions;
+        size_t stride;
+        const unsigned int *indices;
+        unsigned int triangleCount;
+        glm::mat4 transform;
+        bool twoSided;
+    };
+    // Edge functions a * x + b * y + c >= 0 inside, depth = plane, and the
+    // pixels whose centers the triangle can cover
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+    struct Chunk {
+        std::vector<Triangle> triangles;
+        // Triangle indices per tile
+        std::vector<std::vector<unsigned int> > bins;
+    };
+
+    JobPool &pool;
+    glm::mat4 viewProjection;
+    int tilesX, tilesY;
+    std::vector<std::vector<float> > levels;
+    std::vector<int> levelWidths, levelHeights;
+    std::vector<OccluderDraw> draws;
+    std::vector<unsigned int> drawStart;
+    std::vector<Chunk> chunks;
+    unsigned int chunkCount;
+
+    glm::vec4 clipPosition(const OccluderDraw &draw, unsigned int corner) const
+    {
+        unsigned int index = draw.indices ? draw.indices[corner] : corner;
+        const float *p = (const float *)(draw.positions + index * draw.stride);
+        return draw.transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+    }
+
+    void setupChunk(unsigned int c)
+    {
+        Chunk &chunk = chunks[c];
+        chunk.triangles.clear();
+        for (unsigned int t = 0; t < chunk.bins.size(); ++t)
+            chunk.bins[t].clear();
+
+        unsigned int first = c * TRIANGLES_PER_CHUNK;
+        unsigned int last = std::min(first + TRIANGLES_PER_CHUNK, drawStart.back());
+        unsigned int d = (unsigned int)(std::upper_bound(drawStart.begin(), drawStart.end(), first) -
+                                        drawStart.begin()) - 1;
+        for (unsigned int triangle = first; triangle < last; ++triangle) {
+            while (triangle >= drawStart[d + 1])
+                ++d;
+            const OccluderDraw &draw = draws[d];
+            unsigned int local = triangle - drawStart[d];
+            glm::vec4 v[3];
+            for (int k = 0; k < 3; ++k)
+                v[k] = clipPosition(draw, 3 * local + k);
+            clipAndBin(chunk, v, draw.twoSided);
+        }
+    }
+
+    // Clip against the near plane (z >= -w), which turns the triangle into
+    // none, one or two
+    void clipAndBin(Chunk &chunk, const glm::vec4 *v, bool twoSided)
+    {
+        float distance[3];
+        int inside = 0;
+        for (int k = 0; k < 3; ++k) {
+            distance[k] = v[k].z + v[k].w;
+            inside += distance[k] >= 0.0f;
+        }
+        if (inside == 3) {
+            binTriangle(chunk, v[0], v[1], v[2], twoSided);
+            return;
+        }
+        if (inside == 0)
+            return;
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int k = 0; k < 3; ++k) {
+            int next = (k + 1) % 3;
+            if (distance[k] >= 0.0f)
+                polygon[count++] = v[k];
+            if ((distance[k] >= 0.0f) != (distance[next] >= 0.0f)) {
+                float t = distance[k] / (distance[k] - distance[next]);
+                polygon[count++] = v[k] + (v[next] - v[k]) * t;
+            }
+        }
+        for (int k = 2; k < count; ++k)
+            binTriangle(chunk, polygon[0], polygon[k - 1], polygon[k], twoSided);
+    }
+
+    void binTriangle(Chunk &chunk, const glm::vec4 &c0, const glm::vec4 &c1, const glm::vec4 &c2,
+                     bool twoSided)
+    {
+        const glm::vec4 *clip[3] = { &c0, &c1, &c2 };
+        float x[3], y[3], z[3];
+        float w = (float)levelWidths[0], h = (float)levelHeights[0];
+        for (int k = 0; k < 3; ++k) {
+            float invW = 1.0f / std::max(clip[k]->w, 1.0e-6f);
+            x[k] = (clip[k]->x * invW * 0.5f + 0.5f) * w;
+            y[k] = (clip[k]->y * invW * 0.5f + 0.5f) * h;
+            z[k] = clip[k]->z * invW;
+        }
+
+        // Turn clockwise two sided triangles around
+        if (twoSided && (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]) < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+        }
+
+        Triangle triangle;
+        for (int k = 0; k < 3; ++k) {
+            int next = (k + 1) % 3;
+            triangle.edgeA[k] = y[k] - y[next];
+            triangle.edgeB[k] = x[next] - x[k];
+            triangle.edgeC[k] = (y[next] - y[k]) * x[k] - (x[next] - x[k]) * y[k];
+        }
+        // Counter clockwise is front facing, the area is E01(v2)
+        float area = triangle.edgeA[0] * x[2] + triangle.edgeB[0] * y[2] + triangle.edgeC[0];
+        if (!(area > 0.0f))
+            return;
+        // Depth gradient from the differences to vertex 0, which keeps the
+        // precision where z is close to 1
+        float scale = 1.0f / area;
+        triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * scale;
+        triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * scale;
+        triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+        float lowX = std::min(x[0], std::min(x[1], x[2])), highX = std::max(x[0], std::max(x[1], x[2]));
+        float lowY = std::min(y[0], std::min(y[1], y[2])), highY = std::max(y[0], std::max(y[1], y[2]));
+        triangle.minX = std::max(0, (int)std::ceil(std::max(lowX, -1.0f) - 0.5f));
+        triangle.minY = std::max(0, (int)std::ceil(std::max(lowY, -1.0f) - 0.5f));
+        triangle.maxX = std::min(levelWidths[0] - 1, (int)std::floor(std::min(highX, w + 1.0f) - 0.5f));
+        triangle.maxY = std::min(levelHeights[0] - 1, (int)std::floor(std::min(highY, h + 1.0f) - 0.5f));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        unsigned int index = (unsigned int)chunk.triangles.size();
+        chunk.triangles.push_back(triangle);
+        for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ++ty) {
+            for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; ++tx)
+                chunk.bins[ty * tilesX + tx].push_back(index);
+        }
+    }
+
+    void rasterTile(unsigned int tile)
+    {
+        int tileX = (int)(tile % tilesX) * TILE_SIZE, tileY = (int)(tile / tilesX) * TILE_SIZE;
+        int width = levelWidths[0];
+        float *depth = levels[0].data();
+        for (int y = tileY; y < tileY + TILE_SIZE; ++y)
+            std::fill(depth + (size_t)y * width + tileX, depth + (size_t)y * width + tileX + TILE_SIZE, 1.0f);
+
+        for (unsigned int c = 0; c < chunkCount; ++c) {
+            const Chunk &chunk = chunks[c];
+            const std::vector<unsigned int> &bin = chunk.bins[tile];
+            for (unsigned int i = 0; i < bin.size(); ++i)
+                rasterTriangle(chunk.triangles[bin[i]], tileX, tileY, depth, width);
+        }
+
+        for (int l = 1; l <= TILE_LEVELS && l < (int)levels.size(); ++l)
+            downsample(l, tileX >> l, (tileX + TILE_SIZE) >> l, tileY >> l, (tileY + TILE_SIZE) >> l);
+    }
+
+    // Every pixel center inside all three edges keeps the nearest depth.
+    // Edges and depth are evaluated directly at each pixel center rather
+    // than stepped, so the SSE and scalar paths give the same bits.
+    static void rasterTriangle(const Triangle &t, int tileX, int tileY, float *depth, int width)
+    {
+        int x0 = std::max(t.minX, tileX), x1 = std::min(t.maxX, tileX + TILE_SIZE - 1);
+        int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + TILE_SIZE - 1);
+        if (x0 > x1 || y0 > y1)
+            return;
+#ifdef OCCLUSIONCULLER_USE_SSE
+        // Groups of four pixels starting on a multiple of four, tiles are
+        // whole groups so the stores stay inside the tile
+        x0 &= ~3;
+        __m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+        __m128 b0 = _mm_set1_ps(t.edgeB[0]), b1 = _mm_set1_ps(t.edgeB[1]), b2 = _mm_set1_ps(t.edgeB[2]);
+        __m128 c0 = _mm_set1_ps(t.edgeC[0]), c1 = _mm_set1_ps(t.edgeC[1]), c2 = _mm_set1_ps(t.edgeC[2]);
+        __m128 za = _mm_set1_ps(t.depthA), zb = _mm_set1_ps(t.depthB), zc = _mm_set1_ps(t.depthC);
+        __m128 zero = _mm_setzero_ps();
+        for (int y = y0; y <= y1; ++y) {
+            __m128 py = _mm_set1_ps(y + 0.5f);
+            __m128 rowE0 = _mm_add_ps(_mm_mul_ps(b0, py), c0);
+            __m128 rowE1 = _mm_add_ps(_mm_mul_ps(b1, py), c1);
+            __m128 rowE2 = _mm_add_ps(_mm_mul_ps(b2, py), c2);
+            __m128 rowZ = _mm_add_ps(_mm_mul_ps(zb, py), zc);
+            float *row = depth + (size_t)y * width;
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), rowE0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), rowE1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), rowE2);
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                           _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(za, px), rowZ);
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; ++y) {
+            float py = y + 0.5f;
+            float rowE[3] = { t.edgeB[0] * py + t.edgeC[0], t.edgeB[1] * py + t.edgeC[1],
+                              t.edgeB[2] * py + t.edgeC[2] };
+            float rowZ = t.depthB * py + t.depthC;
+            float *row = depth + (size_t)y * width;
+            for (int x = x0; x <= x1; ++x) {
+                float px = x + 0.5f;
+                if (t.edgeA[0] * px + rowE[0] >= 0.0f && t.edgeA[1] * px + rowE[1] >= 0.0f &&
+                    t.edgeA[2] * px + rowE[2] >= 0.0f)
+                    row[x] = std::min(row[x], t.depthA * px + rowZ);
+            }
+        }
+#endif
+    }
+
+    // Texels [x0, x1) x [y0, y1) of level l become the farthest depth of
+    // the up to 2x2 texels below them
+    void downsample(unsigned int l, int x0, int x1, int y0, int y1)
+    {
+        const std::vector<float> &source = levels[l - 1];
+        std::vector<float> &target = levels[l];
+        int sourceWidth = levelWidths[l - 1], sourceHeight = levelHeights[l - 1];
+        int targetWidth = levelWidths[l];
+        for (int y = y0; y < y1; ++y) {
+            const float *top = &source[(size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth];
+            const float *bottom = &source[(size_t)(2 * y) * sourceWidth];
+            float *out = &target[(size_t)y * targetWidth];
+            int x = x0;
+#ifdef OCCLUSIONCULLER_USE_SSE
+            for (; x + 4 <= x1 && 2 * x + 8 <= sourceWidth; x += 4) {
+                __m128 left = _mm_max_ps(_mm_loadu_ps(bottom + 2 * x), _mm_loadu_ps(top + 2 * x));
+                __m128 right = _mm_max_ps(_mm_loadu_ps(bottom + 2 * x + 4), _mm_loadu_ps(top + 2 * x + 4));
+                __m128 even = _mm_shuffle_ps(left, right, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 odd = _mm_shuffle_ps(left, right, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_ps(out + x, _mm_max_ps(even, odd));
+            }
+#endif
+            for (; x < x1; ++x) {
+                int right = std::min(2 * x + 1, sourceWidth - 1);
+                out[x] = std::max(std::max(bottom[2 * x], bottom[right]), std::max(top[2 * x], top[right]));
+            }
+        }
+    }
+};
+
+#endif //PROJECT_OCCLUSIONCULLER_H
@@ -0,0 +1,51 @@
+//
+// Uploads the layers of a TexturePacker as one GL_TEXTURE_2D_ARRAY with
+// every mip level built on the CPU, and hands its regions to shaders.
+// The sampler repeats and filters trilinearly; atlas images get clamp to
+// edge and their level limit in the shader (see shaders/PackedMaterial.frag).
+//
+
+#ifndef PROJECT_PACKEDTEXTURE_H
+#define PROJECT_PACKEDTEXTURE_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+#include "Shader.h"
+#include "TexturePacker.h"
+
+inline unsigned int TextureArrayFromPacked(const TexturePacker &packer)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int level = 0, size = packer.layerSize(); level < packer.levelCount(); ++level, size = std::max(size / 2, 1)) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, packer.layerCount(), 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, packer.level(level).data());
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, packer.levelCount() - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+// Sets regionRect[i] and regionInfo[i] (layer, maxLevel, repeat) for every
+// region of packer, on the shader in use
+inline void setPackedRegions(const Shader &shader, const TexturePacker &packer)
+{
+    for (unsigned int i = 0; i < packer.regionCount(); ++i) {
+        const PackedRegion &region = packer.region((int)i);
+        std::string index = "[" + std::to_string(i) + "]";
+        shader.setVec4("regionRect" + index, region.rect);
+        shader.setVec4("regionInfo" + index, glm::vec4((float)region.layer, (float)region.maxLevel,
+                                                       region.repeat ? 1.0f : 0.0f, 0.0f));
+    }
+}
+
+#endif //PROJECT_PACKEDTEXTURE_H
@@ -0,0 +1,306 @@
+//
+// Runs an ordered list of full screen effects over a rendered scene.
+// The scene is drawn into an offscreen target, then every pass reads the
+// previous result and writes into one of two ping-pong targets; the last
+// pass writes straight to the framebuffer that was bound at beginScene(),
+// the default one unless the caller renders offscreen itself.
+//
+// There are three kinds of effects:
+//   pixel effects  - a GLSL snippet that rewrites `vec3 color` and only looks
+//                    at the current pixel (inversion, grayscale, tone curves).
+//                    Adjacent pixel effects are fused into one generated pass.
+//   shader effects - a full screen fragment shader file that may sample its
+//                    neighbours (kernels, edge detection).
+//   custom effects - a PostProcessEffect that runs its own passes and targets
+//                    (multi pass blur, see BlurEffect.h).
+// Every shader pass gets `screenTexture` on unit 0 and `texelSize` (1 / input size).
+//
+
+#ifndef PROJECT_POSTPROCESSCHAIN_H
+#define PROJECT_POSTPROCESSCHAIN_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "Shader.h"
+#include "GpuTimer.h"
+
+// An effect that needs more than one full screen pass. It reads inputTexture
+// and must leave its result in outputFBO (width x height). The chain's full
+// screen quad VAO is bound when apply is called.
+class PostProcessEffect
+{
+public:
+    virtual ~PostProcessEffect() {}
+    virtual void apply(unsigned int inputTexture, unsigned int outputFBO, int width, int height) = 0;
+};
+
+class PostProcessChain
+{
+public:
+    struct Effect {
+        std::string name;
+        // GLSL snippet for pixel effects, fragment shader path otherwise
+        std::string source;
+        bool perPixel;
+        // Not owned, only set for custom effects
+        PostProcessEffect *custom;
+    };
+
+    struct Pass {
+        std::string name;
+        Shader shader;
+        GpuTimer timer;
+        PostProcessEffect *custom;
+    };
+
+    std::vector<Effect> effects;
+    std::vector<Pass> passes;
+    int width, height;
+
+    PostProcessChain(int width_, int height_)
+            : width(0), height(0), outputFBO(0), dirty(true)
+    {
+        glGenFramebuffers(1, &sceneFBO);
+        glGenTextures(1, &sceneTexture);
+        glGenRenderbuffers(1, &sceneRBO);
+        glGenFramebuffers(2, pingPongFBO);
+        glGenTextures(2, pingPongTexture);
+        createQuad();
+        resize(width_, height_);
+    }
+
+    void addPixelEffect(const std::string &name, const std::string &glslCode)
+    {
+        Effect effect = { name, glslCode, true, nullptr };
+        effects.push_back(effect);
+        dirty = true;
+    }
+
+    void addShaderEffect(const std::string &name, const std::string &fragmentPath)
+    {
+        Effect effect = { name, fragmentPath, false, nullptr };
+        effects.push_back(effect);
+        dirty = true;
+    }
+
+    void addCustomEffect(const std::string &name, PostProcessEffect *custom)
+    {
+        Effect effect = { name, "", false, custom };
+        effects.push_back(effect);
+        dirty = true;
+    }
+
+    void clearEffects()
+    {
+        effects.clear();
+        dirty = true;
+    }
+
+    // Reallocate all targets when the framebuffer size changes
+    void resize(int width_, int height_)
+    {
+        if (width_ == width && height_ == height)
+            return;
+        width = width_;
+        height = height_;
+
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        allocateColor(sceneTexture);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, sceneRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Error: Incomplete framebuffer!" << std::endl;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            allocateColor(pingPongTexture[i]);
+            glBindFramebuffer(GL_FRAMEBUFFER, pingPongFBO[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   pingPongTexture[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "Error: Incomplete framebuffer!" << std::endl;
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    }
+
+    // Redirect scene rendering into the chain's input target. The bound
+    // framebuffer is where apply() puts the result.
+    void beginScene()
+    {
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        outputFBO = previous;
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glViewport(0, 0, width, height);
+    }
+
+    // Run every pass. The result ends up in the framebuffer that was bound
+    // at beginScene(), which is left bound.
+    void apply()
+    {
+        if (dirty)
+            buildPasses();
+
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(quadVAO);
+        glViewport(0, 0, width, height);
+        unsigned int input = sceneTexture;
+        for (unsigned int i = 0; i < passes.size(); ++i) {
+            bool last = i + 1 == passes.size();
+            unsigned int output = last ? outputFBO : pingPongFBO[i % 2];
+
+            passes[i].timer.begin();
+            if (passes[i].custom) {
+                passes[i].custom->apply(input, output, width, height);
+                glViewport(0, 0, width, height);
+            } else {
+                glBindFramebuffer(GL_FRAMEBUFFER, output);
+                passes[i].shader.use();
+                passes[i].shader.setVec2("texelSize", glm::vec2(1.0f / width, 1.0f / height));
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, input);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+            passes[i].timer.end();
+
+            input = pingPongTexture[i % 2];
+        }
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // Print the average GPU time of every pass since the last call
+    void printTimings()
+    {
+        double total = 0.0;
+        for (unsigned int i = 0; i < passes.size(); ++i) {
+            double ms = passes[i].timer.averageMilliseconds();
+            std::cout << "  " << passes[i].name << ": " << ms << " ms" << std::endl;
+            total += ms;
+            passes[i].timer.reset();
+        }
+        std::cout << "  total: " << total << " ms in " << passes.size() << " passes" << std::endl;
+    }
+
+private:
+    unsigned int sceneFBO, sceneTexture, sceneRBO;
+    unsigned int pingPongFBO[2], pingPongTexture[2];
+    unsigned int quadVAO, quadVBO;
+    unsigned int outputFBO;
+    bool dirty;
+
+    void allocateColor(unsigned int texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void createQuad()
+    {
+        float quadVertices[] = {
+                // positions   // texCoords
+                -1.0f,  1.0f,  0.0f, 1.0f,
+                -1.0f, -1.0f,  0.0f, 0.0f,
+                1.0f, -1.0f,  1.0f, 0.0f,
+
+                -1.0f,  1.0f,  0.0f, 1.0f,
+                1.0f, -1.0f,  1.0f, 0.0f,
+                1.0f,  1.0f,  1.0f, 1.0f
+        };
+        glGenBuffers(1, &quadVBO);
+        glGenVertexArrays(1, &quadVAO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2*sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+
+    static std::string readFile(const char *path)
+    {
+        std::ifstream file(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // Turn the effect list into passes, fusing runs of pixel effects
+    void buildPasses()
+    {
+        for (unsigned int i = 0; i < passes.size(); ++i) {
+            glDeleteProgram(passes[i].shader.ID);
+            passes[i].timer.release();
+        }
+        passes.clear();
+
+        static const std::string vertexCode = readFile("shaders/ScreenShaderDefault.vert");
+        unsigned int i = 0;
+        while (i < effects.size()) {
+            if (effects[i].custom) {
+                Pass pass = { effects[i].name, Shader(), GpuTimer(), effects[i].custom };
+                passes.push_back(pass);
+                ++i;
+                continue;
+            }
+            if (!effects[i].perPixel) {
+                Pass pass = { effects[i].name,
+                              Shader("shaders/ScreenShaderDefault.vert", effects[i].source.c_str()),
+                              GpuTimer(), nullptr };
+                pass.shader.use();
+                pass.shader.setInt("screenTexture", 0);
+                passes.push_back(pass);
+                ++i;
+                continue;
+            }
+            std::string name;
+            std::string fragmentCode =
+                    "#version 330 core\n"
+                    "out vec4 fragColor;\n"
+                    "in vec2 TexCoords;\n"
+                    "uniform sampler2D screenTexture;\n"
+                    "void main() {\n"
+                    "    vec3 color = texture(screenTexture, TexCoords).rgb;\n";
+            for (; i < effects.size() && effects[i].perPixel; ++i) {
+                name += name.empty() ? effects[i].name : " + " + effects[i].name;
+                fragmentCode += "    // " + effects[i].name + "\n";
+                fragmentCode += "    " + effects[i].source + "\n";
+            }
+            fragmentCode += "    fragColor = vec4(color, 1.0);\n}\n";
+            Pass pass = { name, Shader::fromSource(vertexCode, fragmentCode, name), GpuTimer(),
+                          nullptr };
+            pass.shader.use();
+            pass.shader.setInt("screenTexture", 0);
+            passes.push_back(pass);
+        }
+
+        // Without any effect the scene still has to reach the screen
+        if (passes.empty()) {
+            Pass pass = { "Copy", Shader("shaders/ScreenShaderDefault.vert",
+                                         "shaders/ScreenShaderDefault.frag"), GpuTimer(), nullptr };
+            pass.shader.use();
+            pass.shader.setInt("screenTexture", 0);
+            passes.push_back(pass);
+        }
+        dirty = false;
+    }
+};
+
+#endif //PROJECT_POSTPROCESSCHAIN_H
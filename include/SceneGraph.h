@@ -0,0 +1,132 @@
+//
+// Node hierarchy stored as flat arrays in depth first (pre)order, so every
+// parent comes before its children and every subtree is one contiguous
+// range [node, subtreeEnd[node]).
+//
+// setLocal only marks the node dirty. update() then walks the dirty nodes
+// in index order and recomputes each dirty subtree once, front to back,
+// which is a linear sweep over contiguous matrices. Clean parts of the
+// tree are never touched.
+//
+
+#ifndef PROJECT_SCENEGRAPH_H
+#define PROJECT_SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SCENEGRAPH_USE_SSE
+#endif
+
+// out = a * b, four columns as broadcasts of b times the columns of a
+inline void multiplyMat4(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out)
+{
+#ifdef SCENEGRAPH_USE_SSE
+    __m128 a0 = _mm_loadu_ps(&a[0][0]), a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]), a3 = _mm_loadu_ps(&a[3][0]);
+    for (int c = 0; c < 4; ++c) {
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&out[c][0], r);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+class SceneGraph
+{
+public:
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat4> world;
+    // -1 for roots
+    std::vector<int> parent;
+    // One past the last node of each subtree
+    std::vector<unsigned int> subtreeEnd;
+    std::vector<uint8_t> dirty;
+
+    unsigned int size() const
+    {
+        return (unsigned int)local.size();
+    }
+
+    // Nodes must be added in depth first order: parent has to be -1, the
+    // last node added, or one of its ancestors. Returns the new index.
+    int addNode(int parentIndex, const glm::mat4 &localTransform)
+    {
+        unsigned int index = size();
+        if (parentIndex >= (int)index ||
+            (parentIndex >= 0 && subtreeEnd[parentIndex] != index)) {
+            std::cout << "Error: scene graph nodes must be added in depth first order!" << std::endl;
+            parentIndex = -1;
+        }
+        local.push_back(localTransform);
+        world.push_back(localTransform);
+        parent.push_back(parentIndex);
+        subtreeEnd.push_back(index + 1);
+        dirty.push_back(1);
+        dirtyNodes.push_back(index);
+        for (int p = parentIndex; p >= 0; p = parent[p])
+            subtreeEnd[p] = index + 1;
+        return (int)index;
+    }
+
+    void setLocal(unsigned int node, const glm::mat4 &localTransform)
+    {
+        local[node] = localTransform;
+        if (!dirty[node]) {
+            dirty[node] = 1;
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    // Recompute world matrices of every dirty subtree. Returns how many
+    // nodes were recomputed.
+    unsigned int update()
+    {
+        std::sort(dirtyNodes.begin(), dirtyNodes.end());
+        unsigned int updated = 0, coveredEnd = 0;
+        for (unsigned int i = 0; i < dirtyNodes.size(); ++i) {
+            unsigned int root = dirtyNodes[i];
+            // Already recomputed as part of a dirty ancestor
+            if (root < coveredEnd)
+                continue;
+            coveredEnd = subtreeEnd[root];
+            updateRange(root, coveredEnd);
+            updated += coveredEnd - root;
+        }
+        dirtyNodes.clear();
+        return updated;
+    }
+
+    // Recompute everything, for reference and after bulk edits
+    void updateAll()
+    {
+        updateRange(0, size());
+        dirtyNodes.clear();
+    }
+
+private:
+    std::vector<unsigned int> dirtyNodes;
+
+    void updateRange(unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i) {
+            if (parent[i] < 0)
+                world[i] = local[i];
+            else
+                multiplyMat4(world[parent[i]], local[i], world[i]);
+            dirty[i] = 0;
+        }
+    }
+};
+
+#endif //PROJECT_SCENEGRAPH_H
@@ -20,6 +20,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "NormalMatrix.h"
+
 class Shader
 {
 public:
@@ -74,10 +76,118 @@ public:
             std::cout << "You may want to adjust the shader file path in the source code. " << std::endl;
         }
 
+        compile(vertexCode, fragmentCode, geometryPath ? &geometryCode : nullptr,
+                vertexPath, fragmentPath);
+    }
+
+    // Empty handle, for owners that only sometimes need a program
+    Shader() : ID(0) {}
+
+    // Build a shader program from source code generated at runtime.
+    // name is only used in error messages.
+    static Shader fromSource(const std::string &vertexCode, const std::string &fragmentCode,
+                             const std::string &name = "generated shader")
+    {
+        Shader shader;
+        shader.compile(vertexCode, fragmentCode, nullptr, name.c_str(), name.c_str());
+        return shader;
+    }
+
+    void use()
+    {
+        glUseProgram(ID);
+    }
+
+    // The const char * versions keep string literals from being copied
+    // into a std::string (a heap allocation for names over 15 characters)
+    // on every call
+    void setBool(const char *name, bool value) const
+    {
+        glUniform1i(glGetUniformLocation(ID, name), (int)value);
+    }
+    void setInt(const char *name, int value) const
+    {
+        glUniform1i(glGetUniformLocation(ID, name), value);
+    }
+    void setFloat(const char *name, float value) const
+    {
+        glUniform1f(glGetUniformLocation(ID, name), value);
+    }
+    void setMat4(const char *name, glm::mat4 mat4) const
+    {
+        int modelLoc = glGetUniformLocation(ID, name);
+        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(mat4));
+    }
+    void setMat3(const char *name, glm::mat3 mat3) const
+    {
+        int modelLoc = glGetUniformLocation(ID, name);
+        glUniformMatrix3fv(modelLoc, 1, GL_FALSE, glm::value_ptr(mat3));
+    }
+    // Set "model" and the "normalMatrix" that goes with it
+    void setModelMatrix(const glm::mat4 &model) const
+    {
+        setMat4("model", model);
+        setMat3("normalMatrix", normalMatrix(model));
+    }
+    void setVec2(const char *name, glm::vec2 vec2) const
+    {
+        int modelLoc = glGetUniformLocation(ID, name);
+        glUniform2fv(modelLoc, 1, glm::value_ptr(vec2));
+    }
+    void setVec3(const char *name, glm::vec3 vec3) const
+    {
+        int modelLoc = glGetUniformLocation(ID, name);
+        glUniform3fv(modelLoc, 1, glm::value_ptr(vec3));
+    }
+    void setVec4(const char *name, glm::vec4 vec4) const
+    {
+        int modelLoc = glGetUniformLocation(ID, name);
+        glUniform4fv(modelLoc, 1, glm::value_ptr(vec4));
+    }
+
+    void setBool(const std::string &name, bool value) const
+    {
+        setBool(name.c_str(), value);
+    }
+    void setInt(const std::string &name, int value) const
+    {
+        setInt(name.c_str(), value);
+    }
+    void setFloat(const std::string &name, float value) const
+    {
+        setFloat(name.c_str(), value);
+    }
+    void setMat4(const std::string &name, glm::mat4 mat4) const
+    {
+        setMat4(name.c_str(), mat4);
+    }
+    void setMat3(const std::string &name, glm::mat3 mat3) const
+    {
+        setMat3(name.c_str(), mat3);
+    }
+    void setVec2(const std::string &name, glm::vec2 vec2) const
+    {
+        setVec2(name.c_str(), vec2);
+    }
+    void setVec3(const std::string &name, glm::vec3 vec3) const
+    {
+        setVec3(name.c_str(), vec3);
+    }
+    void setVec4(const std::string &name, glm::vec4 vec4) const
+    {
+        setVec4(name.c_str(), vec4);
+    }
+
+private:
+    // Compile and link the program. geometryCode is optional.
+    void compile(const std::string &vertexCode, const std::string &fragmentCode,
+                 const std::string *geometryCode,
+                 const char *vertexName, const char *fragmentName)
+    {
         const char *vShaderCode = vertexCode.c_str();
         const char *fShaderCode = fragmentCode.c_str();
 
-        unsigned int vertex, fragment, geometry;
+        unsigned int vertex, fragment, geometry = 0;
         int success;
         char infoLog[512];
 
@@ -87,7 +197,7 @@ public:
         glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-            std::cout << "Failed to compile vertex shader " << vertexPath << std::endl
+            std::cout << "Failed to compile vertex shader " << vertexName << std::endl
                       << "Info: " << infoLog << std::endl;
         }
 
@@ -97,12 +207,12 @@ public:
         glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-            std::cout << "Failed to compile fragment shader " << fragmentPath << std::endl
+            std::cout << "Failed to compile fragment shader " << fragmentName << std::endl
                       << "Info: " << infoLog << std::endl;
         }
 
-        if (geometryPath) {
-            const char *gShaderCode = geometryCode.c_str();
+        if (geometryCode) {
+            const char *gShaderCode = geometryCode->c_str();
 
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, nullptr);
@@ -118,7 +228,7 @@ public:
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if (geometryPath) {
+        if (geometryCode) {
             glAttachShader(ID, geometry);
         }
         glLinkProgram(ID);
@@ -131,48 +241,10 @@ public:
 
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if (geometryPath) {
+        if (geometryCode) {
             glDeleteShader(geometry);
         }
     }
-
-    void use()
-    {
-        glUseProgram(ID);
-    }
-
-    void setBool(const std::string &name, bool value) const
-    {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-    }
-    void setInt(const std::string &name, int value) const
-    {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
-    }
-    void setFloat(const std::string &name, float value) const
-    {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
-    }
-    void setMat4(const std::string &name, glm::mat4 mat4) const
-    {
-        int modelLoc = glGetUniformLocation(ID, name.c_str());
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(mat4));
-    }
-    void setVec2(const std::string &name, glm::vec2 vec2) const
-    {
-        int modelLoc = glGetUniformLocation(ID, name.c_str());
-        glUniform2fv(modelLoc, 1, glm::value_ptr(vec2));
-    }
-    void setVec3(const std::string &name, glm::vec3 vec3) const
-    {
-        int modelLoc = glGetUniformLocation(ID, name.c_str());
-        glUniform3fv(modelLoc, 1, glm::value_ptr(vec3));
-    }
-    void setVec4(const std::string &name, glm::vec4 vec4) const
-    {
-        int modelLoc = glGetUniformLocation(ID, name.c_str());
-        glUniform4fv(modelLoc, 1, glm::value_ptr(vec4));
-    }
 };
 
 class BlinnPhongShader : public Shader
@@ -0,0 +1,125 @@
+//
+// Depth map for directional shadow mapping.
+// The depth texture is sampled through two sampler objects: one with
+// hardware depth comparison (sampler2DShadow, bilinear PCF for free) and
+// one returning raw depth, which PCSS needs for its blocker search.
+//
+
+#ifndef PROJECT_SHADOWMAP_H
+#define PROJECT_SHADOWMAP_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+class ShadowMap
+{
+public:
+    // Must match the shadowFilter values in shaders/ShadowMapping.frag
+    enum Filter {
+        PCF_4TAP = 0,
+        POISSON_16,
+        PCSS,
+        FILTER_COUNT
+    };
+
+    unsigned int FBO;
+    unsigned int depthMap;
+    unsigned int compareSampler;
+    unsigned int depthSampler;
+    unsigned int width, height;
+
+    explicit ShadowMap(unsigned int width_ = 1024, unsigned int height_ = 1024)
+            : width(width_), height(height_), previousFBO(0)
+    {
+        glGenTextures(1, &depthMap);
+        glBindTexture(GL_TEXTURE_2D, depthMap);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24,
+                     width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Everything outside the light frustum is treated as lit
+        float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        glGenSamplers(1, &compareSampler);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glSamplerParameterfv(compareSampler, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(compareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glGenSamplers(1, &depthSampler);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glSamplerParameterfv(depthSampler, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Error: Incomplete shadow map framebuffer!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    }
+
+    // Bind the depth framebuffer and clear it. The caller restores the
+    // viewport; endDepthPass() rebinds the framebuffer that was bound here.
+    void beginDepthPass()
+    {
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        previousFBO = previous;
+        glViewport(0, 0, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    void endDepthPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFBO);
+    }
+
+    // Bind the depth map to two texture units: one for the sampler2DShadow
+    // and one for the raw-depth sampler2D
+    void bindTextures(int compareUnit, int depthUnit)
+    {
+        glActiveTexture(GL_TEXTURE0 + compareUnit);
+        glBindTexture(GL_TEXTURE_2D, depthMap);
+        glBindSampler(compareUnit, compareSampler);
+        glActiveTexture(GL_TEXTURE0 + depthUnit);
+        glBindTexture(GL_TEXTURE_2D, depthMap);
+        glBindSampler(depthUnit, depthSampler);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void unbindTextures(int compareUnit, int depthUnit)
+    {
+        glBindSampler(compareUnit, 0);
+        glBindSampler(depthUnit, 0);
+    }
+
+    static const char *filterName(Filter filter)
+    {
+        switch (filter) {
+            case PCF_4TAP:   return "PCF 4-tap";
+            case POISSON_16: return "Poisson 16";
+            case PCSS:       return "PCSS";
+            default:         return "Unknown";
+        }
+    }
+
+private:
+    unsigned int previousFBO;
+};
+
+#endif //PROJECT_SHADOWMAP_H
@@ -0,0 +1,687 @@
+//
+// A CPU renderer for machines without a GPU. It draws the same Vertex
+// arrays Mesh and ModelImporter use, with the camera matrices of the
+// demos, and shades every pixel with a C++ port of
+// shaders/MultipleLights.frag, so the pictures it makes can be compared
+// with the GL ones.
+//
+// render() runs three stages on a JobPool:
+//   1. vertices are transformed, a few thousand per job,
+//   2. triangles are clipped to the near plane and a guard band, set up
+//      (edge functions, depth plane, bounding box) and binned into 64x64
+//      pixel tiles. Every job has bins of its own, so nothing is locked,
+//      and the tiles read them back in submission order.
+//   3. every tile is one job. It rasterizes its triangles four pixels
+//      at a time with SSE, depth testing into a tile sized visibility
+//      buffer that keeps the nearest triangle and its barycentrics per
+//      pixel. Then it shades each covered pixel once, with perspective
+//      correct attributes, so hidden surfaces cost no shading.
+//
+// Vertices are snapped to 1/256 of a pixel and the edge functions are
+// evaluated exactly, in double precision, so pixels on a shared edge or
+// vertex go to exactly one triangle by the top-left rule: meshes have
+// neither cracks nor pixels drawn twice. Textures are sampled bilinearly from level 0
+// with GL_REPEAT. There are no mipmaps, so minified textures shimmer more
+// than on the GPU.
+//
+//     JobPool jobs;
+//     SoftwareRasterizer raster(800, 600, jobs);
+//     raster.draw(mesh.vertices, mesh.indices.data(), mesh.indices.size(), model, material);
+//     raster.render(view, projection, lights, clearColor);
+//     writePng("frame.png", 800, 600, 4, (const unsigned char*)raster.pixels().data(), true, 3);
+//
+
+#ifndef PROJECT_SOFTWARERASTERIZER_H
+#define PROJECT_SOFTWARERASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "Vertex.h"
+#include "JobPool.h"
+#include "NormalMatrix.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARERASTERIZER_USE_SSE
+#endif
+
+// Pixels of a decoded image, borrowed (e.g. ImportedImage::data)
+struct SoftwareTexture {
+    int width, height, components;
+    const unsigned char *data;
+
+    // Bilinear with GL_REPEAT. One channel textures are GL_RED, the way
+    // TextureFromData uploads them, so they read as (r, 0, 0).
+    glm::vec3 sample(glm::vec2 uv) const
+    {
+        float x = uv.x * width - 0.5f, y = uv.y * height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float tx = x - fx, ty = y - fy;
+        int x0 = wrap((int)fx, width), x1 = wrap((int)fx + 1, width);
+        int y0 = wrap((int)fy, height), y1 = wrap((int)fy + 1, height);
+        glm::vec3 top = texel(x0, y0) * (1.0f - tx) + texel(x1, y0) * tx;
+        glm::vec3 bottom = texel(x0, y1) * (1.0f - tx) + texel(x1, y1) * tx;
+        return (top * (1.0f - ty) + bottom * ty) * (1.0f / 255.0f);
+    }
+
+private:
+    static int wrap(int i, int size)
+    {
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+
+    glm::vec3 texel(int x, int y) const
+    {
+        const unsigned char *p = data + ((size_t)y * width + x) * components;
+        if (components < 3)
+            return glm::vec3(p[0], 0.0f, 0.0f);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+};
+
+// The samplers of MultipleLights.frag, nullptr reads black like an
+// unbound texture unit
+struct SoftwareMaterial {
+    const SoftwareTexture *diffuse;
+    const SoftwareTexture *specular;
+    const SoftwareTexture *emission;
+    float shininess;
+};
+
+// The light uniforms of MultipleLights.frag, with the same names
+struct MultipleLights {
+    struct PointLight {
+        glm::vec3 position, ambient, diffuse, specular;
+        float constant, linear, quadratic;
+    };
+    struct DirLight {
+        glm::vec3 direction, ambient, diffuse, specular;
+    };
+    struct SpotLight {
+        glm::vec3 position, direction, ambient, diffuse, specular;
+        float constant, linear, quadratic, innerCone, outerCone;
+    };
+
+    glm::vec3 viewPos;
+    PointLight light;
+    DirLight dirLight;
+    SpotLight spotLight;
+
+    // Line by line the shader, including its use of light.diffuse and
+    // light.specular in calcDirLight and its spotlight falloff, so both
+    // renderers agree
+    glm::vec3 shade(const SoftwareMaterial &material, glm::vec3 position, glm::vec3 normal, glm::vec2 uv) const
+    {
+        glm::vec3 diffuseTexel = sample(material.diffuse, uv), specularTexel = sample(material.specular, uv);
+        glm::vec3 n = glm::normalize(normal);
+        glm::vec3 viewDir = glm::normalize(viewPos - position);
+        auto specularTerm = [&](glm::vec3 lightDir) {
+            glm::vec3 reflectDir = glm::normalize(glm::reflect(-lightDir, n));
+            return std::pow(std::max(glm::dot(reflectDir, viewDir), 0.0f), material.shininess);
+        };
+
+        glm::vec3 color(0.0f);
+        {
+            float distance = glm::length(position - light.position);
+            float attenuation = 1.0f / (1.0f + light.constant + light.linear * distance +
+                                        light.quadratic * distance * distance);
+            glm::vec3 lightDir = glm::normalize(light.position - position);
+            float diffuse = std::max(glm::dot(lightDir, n), 0.0f);
+            color += attenuation * (light.ambient * diffuseTexel + diffuse * diffuseTexel * light.diffuse +
+                                    specularTerm(lightDir) * specularTexel * light.specular);
+        }
+        {
+            glm::vec3 lightDir = glm::normalize(-dirLight.direction);
+            float diffuse = std::max(glm::dot(lightDir, n), 0.0f);
+            color += dirLight.ambient * diffuseTexel + diffuse * diffuseTexel * light.diffuse +
+                     specularTerm(lightDir) * specularTexel * light.specular;
+        }
+        {
+            float distance = glm::length(position - spotLight.position);
+            float attenuation = 1.0f / (1.0f + spotLight.constant + spotLight.linear * distance +
+                                        spotLight.quadratic * distance * distance);
+            glm::vec3 lightDir = glm::normalize(spotLight.position - position);
+            float diffuse = std::max(glm::dot(lightDir, n), 0.0f);
+            float angle = glm::dot(-lightDir, glm::normalize(spotLight.direction));
+            float spotStrength = glm::clamp((spotLight.outerCone - angle) /
+                                            (spotLight.outerCone - spotLight.innerCone), 0.0f, 1.0f);
+            color += attenuation * (spotLight.ambient * diffuseTexel +
+                                    spotStrength * (diffuse * diffuseTexel * spotLight.diffuse +
+                                                    specularTerm(lightDir) * specularTexel * spotLight.specular));
+        }
+        return color + sample(material.emission, uv);
+    }
+
+private:
+    static glm::vec3 sample(const SoftwareTexture *texture, glm::vec2 uv)
+    {
+        return texture ? texture->sample(uv) : glm::vec3(0.0f);
+    }
+};
+
+// What the last render() did
+struct SoftwareRasterStats {
+    size_t triangles;
+    // Triangles left after clipping and culling, set up and binned
+    size_t trianglesSetUp;
+    // Pixels that passed the depth test at some point, and pixels shaded
+    size_t fragments, pixelsShaded;
+    double vertexMilliseconds, setupMilliseconds, rasterMilliseconds;
+};
+
+class SoftwareRasterizer
+{
+public:
+    static const int TILE_SIZE = 64;
+    // Vertices transformed and triangles set up per job. Clipping makes
+    // at most six triangles of one, which keeps a job's triangles
+    // addressable with 16 bits.
+    static const size_t VERTEX_BATCH = 4096;
+    static const size_t TRIANGLE_BATCH = 4096;
+
+    // Back facing (clockwise on screen) triangles are dropped, like
+    // GL_CULL_FACE, when set
+    bool cullBackFaces;
+    SoftwareRasterStats stats;
+
+    // The stages run on pool, which has to outlive the rasterizer
+    SoftwareRasterizer(int width, int height, JobPool &pool)
+            : cullBackFaces(false), stats(), batchCount(0), pool(pool)
+    {
+        resize(width, height);
+    }
+
+    void resize(int width, int height)
+    {
+        frameWidth = std::max(width, 1);
+        frameHeight = std::max(height, 1);
+        tilesX = (frameWidth + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (frameHeight + TILE_SIZE - 1) / TILE_SIZE;
+        guardX = 2.0f * GUARD_BAND / frameWidth - 1.0f;
+        guardY = 2.0f * GUARD_BAND / frameHeight - 1.0f;
+        color.assign((size_t)frameWidth * frameHeight, 0);
+    }
+
+    int width() const
+    {
+        return frameWidth;
+    }
+
+    int height() const
+    {
+        return frameHeight;
+    }
+
+    unsigned int threadCount() const
+    {
+        return pool.threadCount();
+    }
+
+    // RGBA, 8 bits per channel, bottom row first like glReadPixels
+    const std::vector<uint32_t> &pixels() const
+    {
+        return color;
+    }
+
+    // Queues indexed triangles for the next render(). The vertices,
+    // indices and textures are read then, not copied.
+    void draw(const std::vector<Vertex> &vertices, const unsigned int *indices, size_t indexCount,
+              const glm::mat4 &model, const SoftwareMaterial &material)
+    {
+        DrawCall call;
+        call.vertices = vertices.data();
+        call.vertexCount = vertices.size();
+        call.indices = indices;
+        call.triangleCount = indexCount / 3;
+        call.model = model;
+        call.normalMatrix = normalMatrix(model);
+        call.material = material;
+        draws.push_back(call);
+    }
+
+    // Draws everything queued since the last render() into pixels()
+    void render(const glm::mat4 &view, const glm::mat4 &projection, const MultipleLights &lights,
+                glm::vec3 clearColor)
+    {
+        stats = SoftwareRasterStats();
+        auto start = std::chrono::high_resolution_clock::now();
+        transformVertices(projection * view);
+        auto transformed = std::chrono::high_resolution_clock::now();
+        setUpTriangles();
+        auto setUp = std::chrono::high_resolution_clock::now();
+        rasterizeTiles(lights, clearColor);
+        auto rasterized = std::chrono::high_resolution_clock::now();
+
+        for (size_t i = 0; i < draws.size(); ++i)
+            stats.triangles += draws[i].triangleCount;
+        for (size_t i = 0; i < batchCount; ++i)
+            stats.trianglesSetUp += batches[i].triangles.size();
+        for (size_t i = 0; i < tileStats.size(); ++i) {
+            stats.fragments += tileStats[i].fragments;
+            stats.pixelsShaded += tileStats[i].pixelsShaded;
+        }
+        stats.vertexMilliseconds = std::chrono::duration<double, std::milli>(transformed - start).count();
+        stats.setupMilliseconds = std::chrono::duration<double, std::milli>(setUp - transformed).count();
+        stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(rasterized - setUp).count();
+        draws.clear();
+    }
+
+private:
+    struct DrawCall {
+        const Vertex *vertices;
+        size_t vertexCount;
+        const unsigned int *indices;
+        size_t triangleCount;
+        glm::mat4 model;
+        glm::mat3 normalMatrix;
+        SoftwareMaterial material;
+        // Into transformedVertices
+        size_t firstVertex;
+    };
+
+    struct ShadedVertex {
+        glm::vec4 clip;
+        glm::vec3 world, normal;
+        glm::vec2 uv;
+    };
+
+    struct SetupTriangle {
+        // Edge i, opposite vertex i: a * x + (b * y + c), positive inside
+        double a[3], b[3], c[3];
+        bool topLeft[3];
+        // Window depth as a * x + (b * y + c)
+        float za, zb, zc;
+        float inverseArea;
+        int minX, minY, maxX, maxY;
+        glm::vec3 world[3], normal[3];
+        glm::vec2 uv[3];
+        float inverseW[3];
+        const SoftwareMaterial *material;
+    };
+
+    // Triangles set up by one job, with a list per tile of the ones that
+    // touch it
+    struct Batch {
+        size_t draw, firstTriangle, triangleCount;
+        std::vector<SetupTriangle> triangles;
+        std::vector<std::vector<uint16_t> > bins;
+    };
+
+    struct Range {
+        size_t draw, begin, end;
+    };
+
+    struct TileStats {
+        size_t fragments, pixelsShaded;
+    };
+
+    static const uint32_t NO_TRIANGLE = 0xFFFFFFFFu;
+    // Triangles are clipped to this many pixels around the origin, where
+    // edge functions of coordinates snapped to 1/256 of a pixel are exact
+    // in double precision
+    static const int GUARD_BAND = 16384;
+    static const int CLIP_PLANES = 5;
+
+    int frameWidth, frameHeight, tilesX, tilesY;
+    // The guard band in normalized device coordinates
+    float guardX, guardY;
+    std::vector<uint32_t> color;
+    std::vector<DrawCall> draws;
+    std::vector<ShadedVertex> transformedVertices;
+    std::vector<Range> vertexRanges;
+    // Only the first batchCount are used, the others keep their memory
+    std::vector<Batch> batches;
+    size_t batchCount;
+    std::vector<TileStats> tileStats;
+    glm::mat4 viewProjection;
+    JobPool &pool;
+
+    void transformVertices(const glm::mat4 &viewProjection_)
+    {
+        viewProjection = viewProjection_;
+        size_t total = 0;
+        vertexRanges.clear();
+        for (size_t d = 0; d < draws.size(); ++d) {
+            draws[d].firstVertex = total;
+            for (size_t begin = 0; begin < draws[d].vertexCount; begin += VERTEX_BATCH) {
+                Range range = { d, begin, std::min(begin + VERTEX_BATCH, draws[d].vertexCount) };
+                vertexRanges.push_back(range);
+            }
+            total += draws[d].vertexCount;
+        }
+        transformedVertices.resize(total);
+        pool.forEach(vertexRanges.size(), [this](size_t r) {
+            const Range &range = vertexRanges[r];
+            const DrawCall &call = draws[range.draw];
+            ShadedVertex *out = &transformedVertices[call.firstVertex];
+            for (size_t i = range.begin; i < range.end; ++i) {
+                const Vertex &v = call.vertices[i];
+                glm::vec4 world = call.model * glm::vec4(v.position, 1.0f);
+                out[i].clip = viewProjection * world;
+                out[i].world = glm::vec3(world);
+                out[i].normal = call.normalMatrix * v.normal;
+                out[i].uv = v.texCoord;
+            }
+        });
+    }
+
+    void setUpTriangles()
+    {
+        batchCount = 0;
+        for (size_t d = 0; d < draws.size(); ++d) {
+            for (size_t begin = 0; begin < draws[d].triangleCount; begin += TRIANGLE_BATCH) {
+                if (batchCount == batches.size())
+                    batches.emplace_back();
+                Batch &batch = batches[batchCount++];
+                batch.draw = d;
+                batch.firstTriangle = begin;
+                batch.triangleCount = std::min(begin + TRIANGLE_BATCH, draws[d].triangleCount) - begin;
+            }
+        }
+        const size_t tileCount = (size_t)tilesX * tilesY;
+        pool.forEach(batchCount, [this, tileCount](size_t b) {
+            Batch &batch = batches[b];
+            batch.triangles.clear();
+            batch.bins.resize(tileCount);
+            for (size_t t = 0; t < tileCount; ++t)
+                batch.bins[t].clear();
+            const DrawCall &call = draws[batch.draw];
+            const ShadedVertex *vertices = &transformedVertices[call.firstVertex];
+            for (size_t i = batch.firstTriangle; i < batch.firstTriangle + batch.triangleCount; ++i) {
+                const unsigned int *index = call.indices + i * 3;
+                clipTriangle(batch, vertices[index[0]], vertices[index[1]], vertices[index[2]], call.material);
+            }
+        });
+    }
+
+    // Distance of a vertex inside clip plane i: the near plane (z > -w)
+    // and the four sides of the guard band
+    float planeDistance(const glm::vec4 &clip, int plane) const
+    {
+        switch (plane) {
+        case 0:
+            return clip.z + clip.w;
+        case 1:
+            return guardX * clip.w - clip.x;
+        case 2:
+            return guardX * clip.w + clip.x;
+        case 3:
+            return guardY * clip.w - clip.y;
+        default:
+            return guardY * clip.w + clip.y;
+        }
+    }
+
+    // Rejects triangles entirely outside one side of the view volume and
+    // cuts the rest to the near plane and the guard band, which leaves a
+    // fan of up to six triangles
+    void clipTriangle(Batch &batch, const ShadedVertex &v0, const ShadedVertex &v1, const ShadedVertex &v2,
+                      const SoftwareMaterial &material)
+    {
+        const glm::vec4 &p0 = v0.clip, &p1 = v1.clip, &p2 = v2.clip;
+        if ((p0.x > p0.w && p1.x > p1.w && p2.x > p2.w) || (p0.x < -p0.w && p1.x < -p1.w && p2.x < -p2.w) ||
+            (p0.y > p0.w && p1.y > p1.w && p2.y > p2.w) || (p0.y < -p0.w && p1.y < -p1.w && p2.y < -p2.w) ||
+            (p0.z > p0.w && p1.z > p1.w && p2.z > p2.w) || (p0.z < -p0.w && p1.z < -p1.w && p2.z < -p2.w))
+            return;
+        int outside = 0;
+        for (int plane = 0; plane < CLIP_PLANES; ++plane) {
+            if (planeDistance(p0, plane) < 0.0f || planeDistance(p1, plane) < 0.0f ||
+                planeDistance(p2, plane) < 0.0f)
+                outside |= 1 << plane;
+        }
+        if (outside == 0) {
+            setUpTriangle(batch, v0, v1, v2, material);
+            return;
+        }
+        // Every plane adds at most one vertex
+        ShadedVertex polygons[2][3 + CLIP_PLANES];
+        ShadedVertex *in = polygons[0], *out = polygons[1];
+        in[0] = v0;
+        in[1] = v1;
+        in[2] = v2;
+        int count = 3;
+        for (int plane = 0; plane < CLIP_PLANES && count >= 3; ++plane) {
+            if (!(outside & 1 << plane))
+                continue;
+            int kept = 0;
+            for (int i = 0; i < count; ++i) {
+                const ShadedVertex &a = in[i], &b = in[(i + 1) % count];
+                float da = planeDistance(a.clip, plane), db = planeDistance(b.clip, plane);
+                if (da >= 0.0f)
+                    out[kept++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f)) {
+                    float t = da / (da - db);
+                    ShadedVertex &v = out[kept++];
+                    v.clip = a.clip + (b.clip - a.clip) * t;
+                    v.world = a.world + (b.world - a.world) * t;
+                    v.normal = a.normal + (b.normal - a.normal) * t;
+                    v.uv = a.uv + (b.uv - a.uv) * t;
+                }
+            }
+            std::swap(in, out);
+            count = kept;
+        }
+        for (int i = 2; i < count; ++i)
+            setUpTriangle(batch, in[0], in[i - 1], in[i], material);
+    }
+
+    void setUpTriangle(Batch &batch, const ShadedVertex &v0, const ShadedVertex &v1, const ShadedVertex &v2,
+                       const SoftwareMaterial &material)
+    {
+        const ShadedVertex *v[3] = { &v0, &v1, &v2 };
+        double x[3], y[3];
+        float z[3];
+        SetupTriangle t;
+        for (int i = 0; i < 3; ++i) {
+            t.inverseW[i] = 1.0f / v[i]->clip.w;
+            // Snapped to 1/256 of a pixel
+            x[i] = std::floor((v[i]->clip.x * t.inverseW[i] * 0.5f + 0.5f) * frameWidth * 256.0f + 0.5f) / 256.0;
+            y[i] = std::floor((v[i]->clip.y * t.inverseW[i] * 0.5f + 0.5f) * frameHeight * 256.0f + 0.5f) / 256.0;
+            z[i] = v[i]->clip.z * t.inverseW[i] * 0.5f + 0.5f;
+        }
+        for (int i = 0; i < 3; ++i) {
+            int j = (i + 1) % 3, k = (i + 2) % 3;
+            // Exact in double for coordinates in the guard band, and the
+            // edge j -> k of this triangle and k -> j of its neighbour give
+            // exactly opposite values
+            t.a[i] = y[j] - y[k];
+            t.b[i] = x[k] - x[j];
+            t.c[i] = x[j] * y[k] - y[j] * x[k];
+        }
+        double area = t.a[0] * x[0] + (t.b[0] * y[0] + t.c[0]);
+        if (area == 0.0 || (cullBackFaces && area < 0.0))
+            return;
+        if (area < 0.0) {
+            for (int i = 0; i < 3; ++i) {
+                t.a[i] = -t.a[i];
+                t.b[i] = -t.b[i];
+                t.c[i] = -t.c[i];
+            }
+            area = -area;
+        }
+        for (int i = 0; i < 3; ++i) {
+            // Counterclockwise with y up: left edges point down, top edges
+            // point left
+            t.topLeft[i] = t.a[i] > 0.0 || (t.a[i] == 0.0 && t.b[i] < 0.0);
+        }
+        t.inverseArea = (float)(1.0 / area);
+        t.za = (float)(t.a[0] * z[0] + t.a[1] * z[1] + t.a[2] * z[2]) * t.inverseArea;
+        t.zb = (float)(t.b[0] * z[0] + t.b[1] * z[1] + t.b[2] * z[2]) * t.inverseArea;
+        t.zc = (float)(t.c[0] * z[0] + t.c[1] * z[1] + t.c[2] * z[2]) * t.inverseArea;
+
+        // Pixel centres are at + 0.5
+        t.minX = std::max((int)std::floor(std::min(x[0], std::min(x[1], x[2])) - 0.5), 0);
+        t.minY = std::max((int)std::floor(std::min(y[0], std::min(y[1], y[2])) - 0.5), 0);
+        t.maxX = std::min((int)std::ceil(std::max(x[0], std::max(x[1], x[2])) - 0.5), frameWidth - 1);
+        t.maxY = std::min((int)std::ceil(std::max(y[0], std::max(y[1], y[2])) - 0.5), frameHeight - 1);
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+        for (int i = 0; i < 3; ++i) {
+            t.world[i] = v[i]->world;
+            t.normal[i] = v[i]->normal;
+            t.uv[i] = v[i]->uv;
+        }
+        t.material = &material;
+
+        uint16_t index = (uint16_t)batch.triangles.size();
+        batch.triangles.push_back(t);
+        for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ++ty) {
+            for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; ++tx)
+                batch.bins[(size_t)ty * tilesX + tx].push_back(index);
+        }
+    }
+
+    void rasterizeTiles(const MultipleLights &lights, glm::vec3 clearColor)
+    {
+        tileStats.resize((size_t)tilesX * tilesY);
+        const uint32_t clear = packColor(clearColor);
+        pool.forEach(tileStats.size(), [&](size_t tile) {
+            const int tileX = (int)(tile % tilesX) * TILE_SIZE, tileY = (int)(tile / tilesX) * TILE_SIZE;
+            alignas(16) float depth[TILE_SIZE * TILE_SIZE];
+            alignas(16) uint32_t ids[TILE_SIZE * TILE_SIZE];
+            alignas(16) float weights1[TILE_SIZE * TILE_SIZE], weights2[TILE_SIZE * TILE_SIZE];
+            std::fill(depth, depth + TILE_SIZE * TILE_SIZE, 1.0f);
+            // std::fill takes the value by reference, NO_TRIANGLE has no definition to bind to
+            const uint32_t noTriangle = NO_TRIANGLE;
+            std::fill(ids, ids + TILE_SIZE * TILE_SIZE, noTriangle);
+            TileStats &counts = tileStats[tile];
+            counts.fragments = counts.pixelsShaded = 0;
+
+            for (size_t b = 0; b < batchCount; ++b) {
+                const std::vector<uint16_t> &bin = batches[b].bins[tile];
+                for (size_t i = 0; i < bin.size(); ++i) {
+                    counts.fragments += rasterize(batches[b].triangles[bin[i]], (uint32_t)(b << 16 | bin[i]), tileX,
+                                                  tileY, depth, ids, weights1, weights2);
+                }
+            }
+
+            const int width = std::min(tileX + TILE_SIZE, frameWidth) - tileX;
+            const int height = std::min(tileY + TILE_SIZE, frameHeight) - tileY;
+            for (int y = 0; y < height; ++y) {
+                uint32_t *row = &color[(size_t)(tileY + y) * frameWidth + tileX];
+                for (int x = 0; x < width; ++x) {
+                    int p = y * TILE_SIZE + x;
+                    if (ids[p] == NO_TRIANGLE) {
+                        row[x] = clear;
+                        continue;
+                    }
+                    const SetupTriangle &t = batches[ids[p] >> 16].triangles[ids[p] & 0xFFFF];
+                    // Screen space weights to perspective correct ones
+                    float w1 = weights1[p] * t.inverseW[1], w2 = weights2[p] * t.inverseW[2];
+                    float w0 = (1.0f - weights1[p] - weights2[p]) * t.inverseW[0];
+                    float scale = 1.0f / (w0 + w1 + w2);
+                    w0 *= scale;
+                    w1 *= scale;
+                    w2 *= scale;
+                    glm::vec3 world = t.world[0] * w0 + t.world[1] * w1 + t.world[2] * w2;
+                    glm::vec3 normal = t.normal[0] * w0 + t.normal[1] * w1 + t.normal[2] * w2;
+                    glm::vec2 uv = t.uv[0] * w0 + t.uv[1] * w1 + t.uv[2] * w2;
+                    row[x] = packColor(lights.shade(*t.material, world, normal, uv));
+                    ++counts.pixelsShaded;
+                }
+            }
+        });
+    }
+
+    // Depth tests the pixels of the tile the triangle covers, returns how
+    // many passed
+    static size_t rasterize(const SetupTriangle &t, uint32_t id, int tileX, int tileY, float *depth, uint32_t *ids,
+                            float *weights1, float *weights2)
+    {
+        const int x0 = std::max(t.minX, tileX) & ~3, x1 = std::min(t.maxX, tileX + TILE_SIZE - 1);
+        const int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + TILE_SIZE - 1);
+        size_t passed = 0;
+#ifdef SOFTWARERASTERIZER_USE_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128d leftOffsets = _mm_set_pd(1.5, 0.5), rightOffsets = _mm_set_pd(3.5, 2.5);
+        const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128d a[3];
+        __m128 topLeft[3];
+        for (int i = 0; i < 3; ++i) {
+            a[i] = _mm_set1_pd(t.a[i]);
+            topLeft[i] = _mm_castsi128_ps(_mm_set1_epi32(t.topLeft[i] ? -1 : 0));
+        }
+        const __m128 za = _mm_set1_ps(t.za), inverseArea = _mm_set1_ps(t.inverseArea);
+        const __m128i idVector = _mm_set1_epi32((int)id);
+        for (int y = y0; y <= y1; ++y) {
+            double py = y + 0.5;
+            __m128d row[3];
+            for (int i = 0; i < 3; ++i)
+                row[i] = _mm_set1_pd(t.b[i] * py + t.c[i]);
+            const __m128 zRow = _mm_set1_ps(t.zb * (float)py + t.zc);
+            const int rowStart = (y - tileY) * TILE_SIZE - tileX;
+            for (int x = x0; x <= x1; x += 4) {
+                __m128d left = _mm_add_pd(_mm_set1_pd(x), leftOffsets);
+                __m128d right = _mm_add_pd(_mm_set1_pd(x), rightOffsets);
+                __m128 e[3], inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int i = 0; i < 3; ++i) {
+                    // Exact in double, and rounding to float keeps the sign
+                    e[i] = _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(a[i], left), row[i])),
+                                         _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(a[i], right), row[i])));
+                    __m128 covered = _mm_or_ps(_mm_cmpgt_ps(e[i], zero),
+                                               _mm_and_ps(_mm_cmpeq_ps(e[i], zero), topLeft[i]));
+                    inside = _mm_and_ps(inside, covered);
+                }
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                float *depthRow = depth + rowStart + x;
+                __m128 z = _mm_add_ps(_mm_mul_ps(za, _mm_add_ps(_mm_set1_ps((float)x), laneOffsets)), zRow);
+                __m128 oldDepth = _mm_load_ps(depthRow);
+                __m128 pass = _mm_and_ps(inside, _mm_and_ps(_mm_cmplt_ps(z, oldDepth), _mm_cmpge_ps(z, zero)));
+                int mask = _mm_movemask_ps(pass);
+                if (mask == 0)
+                    continue;
+                passed += (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3 & 1);
+                _mm_store_ps(depthRow, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, oldDepth)));
+                __m128i passInt = _mm_castps_si128(pass);
+                __m128i *idRow = (__m128i *)(ids + rowStart + x);
+                _mm_store_si128(idRow, _mm_or_si128(_mm_and_si128(passInt, idVector),
+                                                    _mm_andnot_si128(passInt, _mm_load_si128(idRow))));
+                float *w1Row = weights1 + rowStart + x, *w2Row = weights2 + rowStart + x;
+                __m128 w1 = _mm_mul_ps(e[1], inverseArea), w2 = _mm_mul_ps(e[2], inverseArea);
+                _mm_store_ps(w1Row, _mm_or_ps(_mm_and_ps(pass, w1), _mm_andnot_ps(pass, _mm_load_ps(w1Row))));
+                _mm_store_ps(w2Row, _mm_or_ps(_mm_and_ps(pass, w2), _mm_andnot_ps(pass, _mm_load_ps(w2Row))));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; ++y) {
+            double py = y + 0.5;
+            double row[3] = { t.b[0] * py + t.c[0], t.b[1] * py + t.c[1], t.b[2] * py + t.c[2] };
+            float zRow = t.zb * (float)py + t.zc;
+            for (int x = x0; x <= x1; ++x) {
+                float e[3];
+                bool inside = true;
+                for (int i = 0; i < 3; ++i) {
+                    e[i] = (float)(t.a[i] * (x + 0.5) + row[i]);
+                    inside = inside && (e[i] > 0.0f || (e[i] == 0.0f && t.topLeft[i]));
+                }
+                int p = (y - tileY) * TILE_SIZE + x - tileX;
+                float z = t.za * (x + 0.5f) + zRow;
+                if (!inside || !(z < depth[p]) || z < 0.0f)
+                    continue;
+                ++passed;
+                depth[p] = z;
+                ids[p] = id;
+                weights1[p] = e[1] * t.inverseArea;
+                weights2[p] = e[2] * t.inverseArea;
+            }
+        }
+#endif
+        return passed;
+    }
+
+    static uint32_t packColor(glm::vec3 c)
+    {
+        c = glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f;
+        return (uint32_t)c.r | (uint32_t)c.g << 8 | (uint32_t)c.b << 16 | 0xFF000000u;
+    }
+};
+
+#endif //PROJECT_SOFTWARERASTERIZER_H
@@ -0,0 +1,139 @@
+//
+// Per vertex tangents for normal mapping, generated the way MikkTSpace does
+// it so baked normal maps (like the nanosuit *_ddn.png) line up:
+//   - the face tangent and bitangent come from the UV derivatives and are
+//     normalized before they are accumulated,
+//   - every corner projects them onto the plane of its vertex normal and
+//     weights them by the corner angle,
+//   - the vertex tangent is the orthonormalized sum, and the bitangent is
+//     rebuilt in the shader as cross(normal, tangent) * handedness.
+// Unlike MikkTSpace vertices are never split, meshes that mirror UVs
+// inside one vertex get the handedness of the majority.
+//
+// The result is packed as GL_INT_2_10_10_10_REV (xyz tangent, w handedness).
+// Triangles and vertices are processed in ranges, on a JobPool when given
+// one.
+//
+
+#ifndef PROJECT_TANGENTSPACE_H
+#define PROJECT_TANGENTSPACE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+#include "JobPool.h"
+
+inline uint32_t packTangent(glm::vec3 tangent, float handedness)
+{
+    uint32_t packed = handedness < 0.0f ? 0x3u << 30 : 0x1u << 30;
+    for (int i = 0; i < 3; ++i) {
+        int value = (int)std::round(glm::clamp(tangent[i], -1.0f, 1.0f) * 511.0f);
+        packed |= ((uint32_t)value & 0x3FFu) << (10 * i);
+    }
+    return packed;
+}
+
+// Inverse of packTangent. Note that GL 3.3 normalizes a w of -1 to -1/3,
+// shaders should only look at its sign.
+inline glm::vec4 unpackTangent(uint32_t packed)
+{
+    glm::vec4 result;
+    for (int i = 0; i < 3; ++i) {
+        int value = (int)((packed >> (10 * i)) & 0x3FFu);
+        if (value & 0x200)
+            value -= 0x400;
+        result[i] = std::max(value / 511.0f, -1.0f);
+    }
+    result.w = (packed >> 31) ? -1.0f : 1.0f;
+    return result;
+}
+
+// Any unit vector perpendicular to n, for vertices without usable UVs
+inline glm::vec3 anyTangent(glm::vec3 n)
+{
+    glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::normalize(glm::cross(n, axis));
+}
+
+// V needs position, normal, texCoord and a uint32 tangent. Without a pool
+// everything runs on the calling thread.
+template <typename V>
+void generateTangents(std::vector<V> &vertices, const std::vector<unsigned int> &indices,
+                      JobPool *pool = nullptr)
+{
+    const size_t cornerCount = indices.size() - indices.size() % 3;
+    std::vector<glm::vec3> cornerTangent(cornerCount), cornerBitangent(cornerCount);
+
+    // Face tangent frames, projected and angle weighted per corner
+    parallelFor(pool, cornerCount / 3, 2048, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const unsigned int *tri = &indices[3 * t];
+            glm::vec3 e1 = vertices[tri[1]].position - vertices[tri[0]].position;
+            glm::vec3 e2 = vertices[tri[2]].position - vertices[tri[0]].position;
+            glm::vec2 d1 = vertices[tri[1]].texCoord - vertices[tri[0]].texCoord;
+            glm::vec2 d2 = vertices[tri[2]].texCoord - vertices[tri[0]].texCoord;
+            float det = d1.x * d2.y - d2.x * d1.y;
+            glm::vec3 faceT = e1 * d2.y - e2 * d1.y;
+            glm::vec3 faceB = e2 * d1.x - e1 * d2.x;
+            // Degenerate UVs contribute nothing
+            bool valid = std::abs(det) > 1.0e-12f && glm::dot(faceT, faceT) > 0.0f &&
+                         glm::dot(faceB, faceB) > 0.0f;
+            float orientation = det < 0.0f ? -1.0f : 1.0f;
+            if (valid) {
+                faceT = glm::normalize(faceT) * orientation;
+                faceB = glm::normalize(faceB) * orientation;
+            }
+
+            for (int k = 0; k < 3; ++k) {
+                size_t corner = 3 * t + k;
+                cornerTangent[corner] = cornerBitangent[corner] = glm::vec3(0.0f);
+                if (!valid)
+                    continue;
+                const V &v = vertices[tri[k]];
+                glm::vec3 a = vertices[tri[(k + 1) % 3]].position - v.position;
+                glm::vec3 b = vertices[tri[(k + 2) % 3]].position - v.position;
+                float la = glm::length(a), lb = glm::length(b);
+                if (la == 0.0f || lb == 0.0f)
+                    continue;
+                float angle = std::acos(glm::clamp(glm::dot(a, b) / (la * lb), -1.0f, 1.0f));
+                glm::vec3 n = glm::normalize(v.normal);
+                glm::vec3 t0 = faceT - n * glm::dot(n, faceT);
+                glm::vec3 b0 = faceB - n * glm::dot(n, faceB);
+                if (glm::dot(t0, t0) > 0.0f)
+                    cornerTangent[corner] = glm::normalize(t0) * angle;
+                if (glm::dot(b0, b0) > 0.0f)
+                    cornerBitangent[corner] = glm::normalize(b0) * angle;
+            }
+        }
+    });
+
+    // Corners of every vertex, so vertices can be summed without atomics
+    std::vector<unsigned int> firstCorner(vertices.size() + 1, 0), corners(cornerCount);
+    for (size_t i = 0; i < cornerCount; ++i)
+        ++firstCorner[indices[i] + 1];
+    for (size_t v = 0; v < vertices.size(); ++v)
+        firstCorner[v + 1] += firstCorner[v];
+    std::vector<unsigned int> cursor(firstCorner.begin(), firstCorner.end() - 1);
+    for (size_t i = 0; i < cornerCount; ++i)
+        corners[cursor[indices[i]]++] = (unsigned int)i;
+
+    parallelFor(pool, vertices.size(), 8192, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            glm::vec3 tangent(0.0f), bitangent(0.0f);
+            for (unsigned int c = firstCorner[v]; c < firstCorner[v + 1]; ++c) {
+                tangent += cornerTangent[corners[c]];
+                bitangent += cornerBitangent[corners[c]];
+            }
+            glm::vec3 n = glm::normalize(vertices[v].normal);
+            tangent -= n * glm::dot(n, tangent);
+            tangent = glm::dot(tangent, tangent) > 1.0e-20f ? glm::normalize(tangent) : anyTangent(n);
+            float handedness = glm::dot(glm::cross(n, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+            vertices[v].tangent = packTangent(tangent, handedness);
+        }
+    });
+}
+
+#endif //PROJECT_TANGENTSPACE_H
@@ -10,39 +10,58 @@
 #include <stb_image.h>
 #include <glad/glad.h>
 
+#include "CompressedTexture.h"
+
 class Texture
 {
 public:
     unsigned int ID;
 
-    explicit Texture(const char *imagePath)
+    // Level 0 and the mip levels below it built on the CPU in the space
+    // the usage says (MipChain.h), on pool when there is one, and sampled
+    // trilinearly. With compressed the levels are block compressed through
+    // the texture cache instead.
+    explicit Texture(const char *imagePath, TextureUsage usage = TEXTURE_COLOR, JobPool *pool = nullptr,
+                     bool compressed = false)
     {
+        if (compressed) {
+            CompressedImage image;
+            if (loadCompressedTexture(imagePath, usage, true, image)) {
+                ID = TextureFromCompressed(image);
+            } else {
+                glGenTextures(1, &ID);
+                std::cout << "Failed to load texture: " << imagePath << std::endl;
+            }
+            return;
+        }
+
         glGenTextures(1, &ID);
         glBindTexture(GL_TEXTURE_2D, ID);
 
         // Set default texture wrapping/filtering options
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         // Load and generate the texture
         int width, height, nrChannels;
-        stbi_set_flip_vertically_on_load(true);
         unsigned char *data = stbi_load(imagePath, &width, &height, &nrChannels, 0);
         if (data) {
-            if (nrChannels == 3) { // RGB
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
-                             0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            } else if (nrChannels == 4) { // RGBA
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height,
-                             0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            flipRows(data, width, height, nrChannels);
+            // Grey images are expanded to RGBA
+            std::vector<std::vector<uint8_t> > levels;
+            std::vector<uint8_t> rgba = expandToRgba(data, width, height, nrChannels);
+            buildMipChain(rgba.data(), width, height, mipOptionsFor(usage), levels, pool);
+            GLint format = nrChannels == 3 ? GL_RGB : GL_RGBA;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            for (unsigned int level = 0; level < levels.size(); ++level) {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, std::max(width >> level, 1),
+                             std::max(height >> level, 1), 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
             }
-            glGenerateMipmap(GL_TEXTURE_2D);
         } else {
             std::cout << "Failed to load texture: " << imagePath << std::endl;
         }
-        stbi_set_flip_vertically_on_load(false);
         stbi_image_free(data);
     }
 
@@ -0,0 +1,307 @@
+//
+// Block compressed textures with their mip chains, cached on disk.
+//
+// compressTexture turns decoded pixels into a CompressedImage: the full
+// mip chain down to 1x1, Kaiser filtered and in linear light for color
+// maps (buildMipChain with mipOptionsFor the usage; version 1 cache files
+// had box filtered chains), every level block compressed in the format
+// chooseBlockFormat picks for the usage:
+//   - color maps BC1, or BC3 when any pixel is not opaque,
+//   - specular maps BC4 when they are grey, which the upload swizzles
+//     back to grey, and like color maps otherwise,
+//   - normal maps BC5 with x and y only, the shader rebuilds z.
+//
+// loadCompressedTexture looks for the image in the cache directory first
+// and only decodes and compresses it when the cached copy is missing or
+// older than the source, writing the result back. Cache files are KTX 1.1
+// (https://registry.khronos.org/KTX/specs/1.0/ktxspec_v1.html) with no key
+// and value data, one face and every mip level, so other tools can open
+// them too, and readKtxLevels can pick single levels out of them for
+// streaming. No OpenGL here: CompressedTexture.h does the upload.
+//
+
+#ifndef PROJECT_TEXTURECACHE_H
+#define PROJECT_TEXTURECACHE_H
+
+// The implementation part of stb_image.h has no include guard, so it is
+// left out when the file that defines it has included it already
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <sys/stat.h>
+
+#include "BlockCompression.h"
+#include "MipChain.h"
+
+enum TextureUsage {
+    TEXTURE_COLOR,
+    TEXTURE_SPECULAR,
+    TEXTURE_NORMAL
+};
+
+struct CompressedImage {
+    BlockFormat format;
+    int width, height;
+    // Level 0 first, each level half the size of the one before down to 1x1
+    std::vector<std::vector<uint8_t> > levels;
+    // Of level 0 against the source over the channels the format keeps,
+    // 0 when the image came from the cache
+    double psnr;
+
+    CompressedImage() : format(BLOCK_BC1), width(0), height(0), psnr(0.0) {}
+
+    bool empty() const
+    {
+        return levels.empty();
+    }
+
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (unsigned int i = 0; i < levels.size(); ++i)
+            total += levels[i].size();
+        return total;
+    }
+};
+
+// Levels down to 1x1 for a width x height image
+inline int mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+// Turns decoded rows upside down in place, for the GL's bottom row first.
+// stb_image's flip setting is global, this is safe on several threads.
+inline void flipRows(unsigned char *data, int width, int height, int components)
+{
+    size_t rowBytes = (size_t)width * components;
+    for (int y = 0; y < height / 2; ++y)
+        std::swap_ranges(data + y * rowBytes, data + (y + 1) * rowBytes, data + (height - 1 - y) * rowBytes);
+}
+
+// 1, 2, 3 or 4 components to RGBA8, grey goes to all three colors
+inline std::vector<uint8_t> expandToRgba(const unsigned char *data, int width, int height, int components)
+{
+    size_t pixels = (size_t)width * height;
+    std::vector<uint8_t> rgba(pixels * 4);
+    for (size_t i = 0; i < pixels; ++i) {
+        const unsigned char *in = data + i * components;
+        uint8_t *out = &rgba[i * 4];
+        if (components < 3) {
+            out[0] = out[1] = out[2] = in[0];
+            out[3] = components == 2 ? in[1] : 255;
+        } else {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+            out[3] = components == 4 ? in[3] : 255;
+        }
+    }
+    return rgba;
+}
+
+// Color maps are sRGB images, specular and normal maps hold plain values
+inline MipOptions mipOptionsFor(TextureUsage usage)
+{
+    MipOptions options = { MIP_KAISER, usage == TEXTURE_COLOR, 0.0f };
+    return options;
+}
+
+inline BlockFormat chooseBlockFormat(const std::vector<uint8_t> &rgba, TextureUsage usage)
+{
+    if (usage == TEXTURE_NORMAL)
+        return BLOCK_BC5;
+    bool opaque = true, grey = true;
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        opaque = opaque && rgba[i + 3] == 255;
+        grey = grey && rgba[i] == rgba[i + 1] && rgba[i] == rgba[i + 2];
+    }
+    if (usage == TEXTURE_SPECULAR && grey && opaque)
+        return BLOCK_BC4;
+    return opaque ? BLOCK_BC1 : BLOCK_BC3;
+}
+
+// Compresses decoded pixels (1 to 4 components) with a full mip chain
+inline void compressTexture(const unsigned char *data, int width, int height, int components, TextureUsage usage,
+                            CompressedImage &out)
+{
+    std::vector<std::vector<uint8_t> > levels;
+    std::vector<uint8_t> rgba = expandToRgba(data, width, height, components);
+    buildMipChain(rgba.data(), width, height, mipOptionsFor(usage), levels);
+    out.format = chooseBlockFormat(rgba, usage);
+    out.width = width;
+    out.height = height;
+    out.levels.resize(levels.size());
+    for (unsigned int i = 0; i < out.levels.size(); ++i) {
+        std::vector<uint8_t> &blocks = out.levels[i];
+        blocks.resize(compressedSize(out.format, width, height));
+        compressImage(out.format, levels[i].data(), width, height, blocks.data());
+        if (i == 0) {
+            std::vector<uint8_t> decoded(rgba.size());
+            decompressImage(out.format, blocks.data(), width, height, decoded.data());
+            out.psnr = rgbaPsnr(rgba.data(), decoded.data(), (size_t)width * height, blockChannelMask(out.format));
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+static const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Written in the machine's byte order, the endianness field says which
+inline bool writeKtx(const std::string &path, const CompressedImage &image)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    uint32_t header[13] = {
+        0x04030201,                           // endianness
+        0, 1, 0,                              // glType, glTypeSize, glFormat: compressed
+        blockGlFormat(image.format), blockGlBaseFormat(image.format),
+        (uint32_t)image.width, (uint32_t)image.height, 0,
+        0, 1,                                 // array elements, faces
+        (uint32_t)image.levels.size(), 0      // mip levels, key and value bytes
+    };
+    bool ok = fwrite(KTX_IDENTIFIER, 1, sizeof(KTX_IDENTIFIER), file) == sizeof(KTX_IDENTIFIER) &&
+              fwrite(header, sizeof(header), 1, file) == 1;
+    // Block sizes are multiples of 8, so no level needs padding
+    for (unsigned int i = 0; i < image.levels.size() && ok; ++i) {
+        uint32_t size = (uint32_t)image.levels[i].size();
+        ok = fwrite(&size, sizeof(size), 1, file) == 1 &&
+             fwrite(image.levels[i].data(), 1, size, file) == size;
+    }
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+// Reads the header of a file writeKtx wrote and levels firstLevel to
+// lastLevel, skipping over the others, which stay empty. False for any
+// other file.
+inline bool readKtxLevels(const std::string &path, int firstLevel, int lastLevel, CompressedImage &image)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    uint8_t identifier[12];
+    uint32_t header[13];
+    bool ok = fread(identifier, 1, sizeof(identifier), file) == sizeof(identifier) &&
+              std::memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) == 0 &&
+              fread(header, sizeof(header), 1, file) == 1 && header[0] == 0x04030201 &&
+              blockFormatFromGl(header[4], image.format) && header[6] > 0 && header[7] > 0 &&
+              header[10] == 1 && header[11] == (uint32_t)mipLevelCount(header[6], header[7]) && header[12] == 0;
+    if (ok) {
+        image.width = (int)header[6];
+        image.height = (int)header[7];
+        image.psnr = 0.0;
+        image.levels.assign(header[11], std::vector<uint8_t>());
+        int width = image.width, height = image.height;
+        int last = std::min(lastLevel, (int)image.levels.size() - 1);
+        for (int i = 0; i <= last && ok; ++i) {
+            uint32_t size = 0;
+            ok = fread(&size, sizeof(size), 1, file) == 1 && size == compressedSize(image.format, width, height);
+            if (ok && i < firstLevel) {
+                ok = fseek(file, (long)size, SEEK_CUR) == 0;
+            } else if (ok) {
+                image.levels[i].resize(size);
+                ok = fread(image.levels[i].data(), 1, size, file) == size;
+            }
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+    }
+    fclose(file);
+    if (!ok)
+        image.levels.clear();
+    return ok;
+}
+
+inline bool readKtx(const std::string &path, CompressedImage &image)
+{
+    return readKtxLevels(path, 0, INT_MAX, image);
+}
+
+// Raised whenever what compressTexture writes changes, so older cache
+// files are not taken for fresh ones
+static const int TEXTURE_CACHE_VERSION = 2;
+
+// Cache file of a source image: its path with separators and dots
+// replaced, then the usage, whether it was flipped and the cache version
+inline std::string textureCachePath(const std::string &cacheDirectory, const std::string &path, TextureUsage usage,
+                                    bool flipVertically)
+{
+    static const char *usages[] = { "color", "specular", "normal" };
+    std::string name = path;
+    for (unsigned int i = 0; i < name.size(); ++i) {
+        if (name[i] == '/' || name[i] == '\\' || name[i] == '.' || name[i] == ':')
+            name[i] = '_';
+    }
+    return cacheDirectory + '/' + name + '.' + usages[usage] + (flipVertically ? ".flipped" : "") + ".v" +
+           std::to_string(TEXTURE_CACHE_VERSION) + ".ktx";
+}
+
+// True when the cache file exists and is not older than the source
+inline bool textureCacheFresh(const std::string &path, const std::string &cachePath)
+{
+    struct stat source, cached;
+    return stat(path.c_str(), &source) == 0 && stat(cachePath.c_str(), &cached) == 0 &&
+           cached.st_mtime >= source.st_mtime;
+}
+
+// Decodes, compresses and writes the cache file. Safe to call from
+// several threads.
+inline bool compressToCache(const std::string &path, TextureUsage usage, bool flipVertically,
+                            const std::string &cacheDirectory, CompressedImage &out)
+{
+    int width, height, components;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 0);
+    if (!data)
+        return false;
+    if (flipVertically)
+        flipRows(data, width, height, components);
+    compressTexture(data, width, height, components, usage, out);
+    stbi_image_free(data);
+
+    // Written next to the final name and renamed, so a reader never sees
+    // half a file
+    mkdir(cacheDirectory.c_str(), 0755);
+    std::string cachePath = textureCachePath(cacheDirectory, path, usage, flipVertically);
+    std::string temporary = cachePath + ".tmp";
+    if (!writeKtx(temporary, out) || std::rename(temporary.c_str(), cachePath.c_str()) != 0)
+        std::remove(temporary.c_str());
+    return true;
+}
+
+// From the cache when it is up to date, otherwise decoded, compressed and
+// cached
+inline bool loadCompressedTexture(const std::string &path, TextureUsage usage, bool flipVertically,
+                                  CompressedImage &out, const std::string &cacheDirectory = "texture_cache")
+{
+    std::string cachePath = textureCachePath(cacheDirectory, path, usage, flipVertically);
+    if (textureCacheFresh(path, cachePath) && readKtx(cachePath, out))
+        return true;
+    return compressToCache(path, usage, flipVertically, cacheDirectory, out);
+}
+
+// Only makes sure the cache file is up to date, for readers that take
+// single levels from it. False when the source does not load.
+inline bool updateTextureCache(const std::string &path, TextureUsage usage, bool flipVertically,
+                               const std::string &cacheDirectory = "texture_cache")
+{
+    if (textureCacheFresh(path, textureCachePath(cacheDirectory, path, usage, flipVertically)))
+        return true;
+    CompressedImage image;
+    return compressToCache(path, usage, flipVertically, cacheDirectory, image);
+}
+
+#endif //PROJECT_TEXTURECACHE_H
@@ -0,0 +1,285 @@
+//
+// Packs many small textures into the layers of one texture array, so
+// objects with different textures share one bind and can be drawn in one
+// call. No OpenGL here: PackedTexture.h does the upload.
+//
+// Images that repeat take a whole layer each, scaled to the layer size if
+// they are not that size already, and keep hardware wrapping. Every other
+// image goes into an atlas layer, shelf packed tallest first, inside a
+// cell with a border of its own edge texels around it. Cells start and end
+// on multiples of twice the border, so the 2x2 box filter that builds the
+// mip levels never mixes two cells down to level log2(border) + 1; at that
+// level half a texel of border is left, which is exactly what bilinear
+// filtering at the edge of the image reaches. Shaders clamp the level of
+// atlas images there (PackedRegion::maxLevel) and clamp their texture
+// coordinates to [0, 1], which gives clamp to edge. Images are color
+// images, their levels are filtered in linear light (MipChain.h).
+//
+//     TexturePacker packer;
+//     int grass = packer.add("textures/grass.png");
+//     int ground = packer.add("textures/ground.jpg", true);
+//     packer.pack();
+//     unsigned int id = TextureArrayFromPacked(packer);
+//
+
+#ifndef PROJECT_TEXTUREPACKER_H
+#define PROJECT_TEXTUREPACKER_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "TextureCache.h"
+
+struct PackedRegion {
+    int layer;
+    // Texture coordinates of the image map to rect.xy + uv * rect.zw
+    glm::vec4 rect;
+    // Coarsest level sampled without neighbours bleeding in
+    int maxLevel;
+    bool repeat;
+};
+
+// Bilinear resize of an RGBA8 image
+inline void resizeRgba(const std::vector<uint8_t> &source, int width, int height, std::vector<uint8_t> &destination,
+                       int newWidth, int newHeight)
+{
+    destination.resize((size_t)newWidth * newHeight * 4);
+    for (int y = 0; y < newHeight; ++y) {
+        float sy = std::max((y + 0.5f) * height / newHeight - 0.5f, 0.0f);
+        int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < newWidth; ++x) {
+            float sx = std::max((x + 0.5f) * width / newWidth - 0.5f, 0.0f);
+            int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+            float fx = sx - x0;
+            const uint8_t *a = &source[((size_t)y0 * width + x0) * 4], *b = &source[((size_t)y0 * width + x1) * 4];
+            const uint8_t *c = &source[((size_t)y1 * width + x0) * 4], *d = &source[((size_t)y1 * width + x1) * 4];
+            uint8_t *out = &destination[((size_t)y * newWidth + x) * 4];
+            for (int i = 0; i < 4; ++i) {
+                float top = a[i] + (b[i] - a[i]) * fx, bottom = c[i] + (d[i] - c[i]) * fx;
+                out[i] = (uint8_t)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+}
+
+class TexturePacker
+{
+public:
+    // layerSize is a power of two, border a power of two of at least 1
+    explicit TexturePacker(int layerSize = 1024, int border = 4)
+            : size(layerSize), border(border), align(2 * border), levels(mipLevelCount(layerSize, layerSize)),
+              atlasMaxLevel(0), layers(0)
+    {
+        while ((1 << atlasMaxLevel) < align)
+            ++atlasMaxLevel;
+    }
+
+    // Region index of the image, -1 when it does not load. Images drawn
+    // with an alpha test pass its cutoff to keep their coverage in the
+    // mip levels.
+    int add(const std::string &path, bool repeat = false, float alphaCutoff = 0.0f, bool flipVertically = true)
+    {
+        int width, height, components;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 0);
+        if (!data) {
+            std::cout << "Failed to load texture: " << path << std::endl;
+            return -1;
+        }
+        if (flipVertically)
+            flipRows(data, width, height, components);
+        int region = addImage(expandToRgba(data, width, height, components), width, height, repeat, alphaCutoff);
+        stbi_image_free(data);
+        return region;
+    }
+
+    int addImage(const std::vector<uint8_t> &rgba, int width, int height, bool repeat = false,
+                 float alphaCutoff = 0.0f)
+    {
+        Image image;
+        image.rgba = rgba;
+        image.width = width;
+        image.height = height;
+        image.alphaCutoff = alphaCutoff;
+        // Too large for a cell of its own, scaled down to fit one layer
+        int largest = size - 2 * border;
+        if (!repeat && (width > largest || height > largest)) {
+            float scale = (float)largest / std::max(width, height);
+            image.width = std::max((int)(width * scale), 1);
+            image.height = std::max((int)(height * scale), 1);
+        }
+        if (repeat) {
+            image.width = size;
+            image.height = size;
+        }
+        if (image.width != width || image.height != height)
+            resizeRgba(rgba, width, height, image.rgba, image.width, image.height);
+        images.push_back(image);
+        PackedRegion region = { -1, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), repeat ? levels - 1 : atlasMaxLevel,
+                                repeat };
+        regions.push_back(region);
+        return (int)regions.size() - 1;
+    }
+
+    // Places every image added and builds the layers with their mip levels.
+    // Call it once, after the last add.
+    void pack()
+    {
+        std::vector<int> order;
+        for (unsigned int i = 0; i < images.size(); ++i)
+            order.push_back((int)i);
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return regions[a].repeat != regions[b].repeat ? regions[a].repeat : images[a].height > images[b].height;
+        });
+        // Shelves of the atlas layer being filled
+        int x = 0, y = 0, shelfHeight = 0;
+        bool atlasOpen = false;
+        layers = 0;
+        std::vector<glm::ivec2> origins(images.size());
+        for (unsigned int i = 0; i < order.size(); ++i) {
+            PackedRegion &region = regions[order[i]];
+            const Image &image = images[order[i]];
+            if (region.repeat) {
+                origins[order[i]] = glm::ivec2(0, 0);
+                region.layer = layers++;
+                continue;
+            }
+            int cellWidth = cellSize(image.width), cellHeight = cellSize(image.height);
+            if (atlasOpen && x + cellWidth > size) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (!atlasOpen || y + cellHeight > size) {
+                atlasOpen = true;
+                ++layers;
+                x = y = shelfHeight = 0;
+            }
+            region.layer = layers - 1;
+            origins[order[i]] = glm::ivec2(x, y);
+            region.rect = glm::vec4((float)(x + border) / size, (float)(y + border) / size,
+                                    (float)image.width / size, (float)image.height / size);
+            x += cellWidth;
+            shelfHeight = std::max(shelfHeight, cellHeight);
+        }
+
+        // Level 0 of every layer, then the levels below it one layer at a time
+        std::vector<std::vector<uint8_t> > layerPixels(layers, std::vector<uint8_t>((size_t)size * size * 4, 0));
+        for (unsigned int i = 0; i < images.size(); ++i) {
+            if (regions[i].repeat)
+                layerPixels[regions[i].layer] = images[i].rgba;
+            else
+                copyWithBorder(images[i], origins[i], layerPixels[regions[i].layer]);
+        }
+        mipLevels.assign(levels, std::vector<uint8_t>());
+        std::vector<std::vector<uint8_t> > chain;
+        const MipOptions options = { MIP_BOX, true, 0.0f };
+        for (int layer = 0; layer < layers; ++layer) {
+            buildMipChain(layerPixels[layer].data(), size, size, options, chain);
+            for (unsigned int i = 0; i < images.size(); ++i) {
+                if (regions[i].layer == layer && images[i].alphaCutoff > 0.0f)
+                    keepAlphaCoverage(images[i], regions[i], origins[i], chain);
+            }
+            for (int l = 0; l < levels; ++l)
+                mipLevels[l].insert(mipLevels[l].end(), chain[l].begin(), chain[l].end());
+        }
+        images.clear();
+    }
+
+    const PackedRegion &region(int index) const
+    {
+        return regions[index];
+    }
+
+    unsigned int regionCount() const
+    {
+        return (unsigned int)regions.size();
+    }
+
+    int layerSize() const
+    {
+        return size;
+    }
+
+    int layerCount() const
+    {
+        return layers;
+    }
+
+    int levelCount() const
+    {
+        return levels;
+    }
+
+    // Every layer of one level, layer 0 first, as glTexImage3D takes them
+    const std::vector<uint8_t> &level(int index) const
+    {
+        return mipLevels[index];
+    }
+
+    // Share of the layer texels that images cover
+    float usage() const
+    {
+        float covered = 0.0f;
+        for (unsigned int i = 0; i < regions.size(); ++i)
+            covered += regions[i].rect.z * regions[i].rect.w;
+        return layers > 0 ? covered / layers : 0.0f;
+    }
+
+private:
+    struct Image {
+        std::vector<uint8_t> rgba;
+        int width, height;
+        float alphaCutoff;
+    };
+
+    int size, border, align, levels, atlasMaxLevel, layers;
+    std::vector<Image> images;
+    std::vector<PackedRegion> regions;
+    std::vector<std::vector<uint8_t> > mipLevels;
+
+    // The image, a border on both sides and the rest up to the alignment
+    int cellSize(int imageSize) const
+    {
+        return (imageSize + 2 * border + align - 1) / align * align;
+    }
+
+    // Scales alpha in the image's cell on every level it is sampled from, so
+    // alpha testing at its cutoff passes as many texels as on level 0
+    void keepAlphaCoverage(const Image &image, const PackedRegion &region, glm::ivec2 origin,
+                           std::vector<std::vector<uint8_t> > &chain) const
+    {
+        int cellWidth = region.repeat ? size : cellSize(image.width);
+        int cellHeight = region.repeat ? size : cellSize(image.height);
+        float coverage = alphaCoverage(&chain[0][((size_t)origin.y * size + origin.x) * 4], size, cellWidth,
+                                       cellHeight, image.alphaCutoff);
+        for (int l = 1; l <= region.maxLevel; ++l) {
+            int levelSize = std::max(size >> l, 1);
+            uint8_t *cell = &chain[l][((size_t)(origin.y >> l) * levelSize + (origin.x >> l)) * 4];
+            scaleAlphaToCoverage(cell, levelSize, std::max(cellWidth >> l, 1), std::max(cellHeight >> l, 1),
+                                 image.alphaCutoff, coverage);
+        }
+    }
+
+    // The whole cell is filled, each texel outside the image repeating the
+    // nearest edge texel
+    void copyWithBorder(const Image &image, glm::ivec2 origin, std::vector<uint8_t> &layer) const
+    {
+        int cellWidth = cellSize(image.width), cellHeight = cellSize(image.height);
+        for (int y = 0; y < cellHeight; ++y) {
+            int sy = std::min(std::max(y - border, 0), image.height - 1);
+            uint8_t *out = &layer[((size_t)(origin.y + y) * size + origin.x) * 4];
+            for (int x = 0; x < cellWidth; ++x) {
+                int sx = std::min(std::max(x - border, 0), image.width - 1);
+                const uint8_t *in = &image.rgba[((size_t)sy * image.width + sx) * 4];
+                std::copy(in, in + 4, out + x * 4);
+            }
+        }
+    }
+};
+
+#endif //PROJECT_TEXTUREPACKER_H
@@ -0,0 +1,293 @@
+//
+// Streams mip levels of block compressed textures from the texture cache
+// (TextureCache.h) under a fixed GPU memory budget. add() and addCubeMap()
+// upload only the levels of TAIL_SIZE texels and smaller; after that the
+// renderer requests the level each texture needs every frame and calls
+// update() once per frame on the GL thread, which
+//   1. uploads the levels the workers have read, at most UPLOAD_BYTES per
+//      frame (and always one), and lowers GL_TEXTURE_BASE_LEVEL to them,
+//   2. lets MipResidency decide the next loads and what to evict for
+//      them, raising the base level of evicted textures and freeing the
+//      level below it,
+//   3. hands the loads to the workers of a JobPool, which read single
+//      levels out of the cache files (readKtxLevels), so the GL thread
+//      never waits on the disk. A pool without workers reads them right
+//      there instead.
+// Texture names stay the same the whole time, only the base level moves,
+// so meshes and batches can keep them.
+//
+//     TextureStreamer streamer(16 << 20, jobs);
+//     int sky = streamer.addCubeMap(faces);
+//     loop: streamer.request(sky, level);  ... for everything drawn
+//           streamer.update();
+//
+
+#ifndef PROJECT_TEXTURESTREAMER_H
+#define PROJECT_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "CompressedTexture.h"
+#include "MipResidency.h"
+#include "JobPool.h"
+
+class TextureStreamer
+{
+public:
+    // Levels this size and smaller are uploaded by add and always kept
+    static const int TAIL_SIZE = 64;
+    // Level reads in flight at once
+    static const unsigned int MAX_LOADS = 4;
+    // Uploads per frame stop after this many bytes
+    static const size_t UPLOAD_BYTES = 4 << 20;
+
+    // The reads run on pool, which has to outlive the streamer and belong
+    // to the GL thread
+    TextureStreamer(size_t budgetBytes, JobPool &pool, const std::string &cacheDirectory = "texture_cache")
+            : residency(budgetBytes), pool(pool), cache(cacheDirectory), levelsUploaded(0),
+              uploadMilliseconds(0.0), readMilliseconds(0.0)
+    {
+    }
+
+    ~TextureStreamer()
+    {
+        pool.wait(counter);
+    }
+
+    // A 2D texture with repeat wrapping, -1 when the image does not load
+    int add(const std::string &path, TextureUsage usage, bool flipVertically = false)
+    {
+        return addTexture(GL_TEXTURE_2D, std::vector<std::string>(1, path), usage, flipVertically);
+    }
+
+    // A cube map of six color images in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+    int addCubeMap(const std::vector<std::string> &faces)
+    {
+        return addTexture(GL_TEXTURE_CUBE_MAP, faces, TEXTURE_COLOR, false);
+    }
+
+    unsigned int id(int texture) const
+    {
+        return textures[texture].id;
+    }
+
+    // Larger side of level 0 in texels
+    int size(int texture) const
+    {
+        return std::max(textures[texture].width, textures[texture].height);
+    }
+
+    // Needs level or finer this frame
+    void request(int texture, int level)
+    {
+        residency.request(texture, level);
+    }
+
+    void update()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t uploaded = 0;
+        for (unsigned int i = 0; i < pending.size();) {
+            PendingLoad &load = *pending[i];
+            if (!load.done.load(std::memory_order_acquire) || uploaded >= UPLOAD_BYTES) {
+                ++i;
+                continue;
+            }
+            if (load.failed) {
+                std::cout << "Failed to stream level " << load.level << " of " << load.paths[0] << std::endl;
+                residency.failed(load.texture);
+            } else {
+                uploaded += uploadLevel(load);
+                residency.loaded(load.texture);
+            }
+            readMilliseconds += load.milliseconds;
+            pending.erase(pending.begin() + i);
+        }
+
+        residency.plan(MAX_LOADS - (unsigned int)pending.size(), loads, evictions);
+        for (unsigned int i = 0; i < evictions.size(); ++i)
+            evict(evictions[i]);
+        for (unsigned int i = 0; i < loads.size(); ++i) {
+            const StreamedTexture &texture = textures[loads[i].texture];
+            pending.emplace_back(new PendingLoad(loads[i].texture, loads[i].level, texture.cachePaths));
+            PendingLoad *load = pending.back().get();
+            if (pool.threadCount() > 1)
+                pool.run(counter, [load]() { readLevel(*load); });
+            else
+                readLevel(*load);
+        }
+        residency.endFrame();
+        uploadMilliseconds += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    const MipResidency &state() const
+    {
+        return residency;
+    }
+
+    // Levels uploaded by update, time update spent on the GL thread and
+    // time the workers spent reading
+    unsigned long long streamedLevels() const
+    {
+        return levelsUploaded;
+    }
+
+    double updateMilliseconds() const
+    {
+        return uploadMilliseconds;
+    }
+
+    double diskMilliseconds() const
+    {
+        return readMilliseconds;
+    }
+
+private:
+    struct StreamedTexture {
+        unsigned int id;
+        GLenum target;
+        BlockFormat format;
+        int width, height;
+        std::vector<std::string> cachePaths;
+    };
+
+    struct PendingLoad {
+        int texture, level;
+        std::vector<std::string> paths;
+        // Level blocks of every face
+        std::vector<std::vector<uint8_t> > faces;
+        bool failed;
+        double milliseconds;
+        std::atomic<bool> done;
+
+        PendingLoad(int texture, int level, const std::vector<std::string> &paths)
+                : texture(texture), level(level), paths(paths), faces(paths.size()), failed(false),
+                  milliseconds(0.0), done(false)
+        {
+        }
+    };
+
+    MipResidency residency;
+    JobPool &pool;
+    JobCounter counter;
+    std::string cache;
+    std::vector<StreamedTexture> textures;
+    std::vector<std::unique_ptr<PendingLoad> > pending;
+    std::vector<MipLoad> loads, evictions;
+    std::vector<uint8_t> scratch;
+    unsigned long long levelsUploaded;
+    double uploadMilliseconds, readMilliseconds;
+
+    // On a worker, or in update when the pool has none
+    static void readLevel(PendingLoad &load)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        CompressedImage image;
+        for (unsigned int f = 0; f < load.paths.size() && !load.failed; ++f) {
+            load.failed = !readKtxLevels(load.paths[f], load.level, load.level, image);
+            if (!load.failed)
+                load.faces[f].swap(image.levels[load.level]);
+        }
+        load.milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        load.done.store(true, std::memory_order_release);
+    }
+
+    static GLenum faceTarget(const StreamedTexture &texture, unsigned int face)
+    {
+        return texture.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+    }
+
+    int addTexture(GLenum target, const std::vector<std::string> &paths, TextureUsage usage, bool flipVertically)
+    {
+        StreamedTexture texture;
+        texture.target = target;
+        std::vector<CompressedImage> tails(paths.size());
+        for (unsigned int f = 0; f < paths.size(); ++f) {
+            texture.cachePaths.push_back(textureCachePath(cache, paths[f], usage, flipVertically));
+            CompressedImage &tail = tails[f];
+            // The header says where the tail starts, the second read takes it
+            if (!updateTextureCache(paths[f], usage, flipVertically, cache) ||
+                !readKtxLevels(texture.cachePaths[f], INT_MAX, -1, tail) ||
+                !readKtxLevels(texture.cachePaths[f], tailLevel(tail.width, tail.height), INT_MAX, tail) ||
+                tail.width != tails[0].width || tail.height != tails[0].height || tail.format != tails[0].format) {
+                std::cout << "Failed to load streamed texture: " << paths[f] << std::endl;
+                return -1;
+            }
+        }
+        texture.format = tails[0].format;
+        texture.width = tails[0].width;
+        texture.height = tails[0].height;
+        int levels = (int)tails[0].levels.size(), tail = tailLevel(texture.width, texture.height);
+
+        glGenTextures(1, &texture.id);
+        glBindTexture(target, texture.id);
+        std::vector<size_t> levelBytes(levels);
+        for (int level = 0; level < levels; ++level) {
+            int width = std::max(texture.width >> level, 1), height = std::max(texture.height >> level, 1);
+            levelBytes[level] = uploadedLevelBytes(texture.format, width, height) * paths.size();
+            for (unsigned int f = 0; f < paths.size() && level >= tail; ++f)
+                uploadCompressedLevel(faceTarget(texture, f), level, texture.format, width, height,
+                                      tails[f].levels[level], scratch);
+        }
+        glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, tail);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        setCompressedSwizzle(target, texture.format);
+        GLint wrap = target == GL_TEXTURE_CUBE_MAP ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        textures.push_back(texture);
+        residency.add(levelBytes, tail);
+        return (int)textures.size() - 1;
+    }
+
+    static int tailLevel(int width, int height)
+    {
+        int level = 0;
+        for (int size = std::max(width, height); size > TAIL_SIZE; size /= 2)
+            ++level;
+        return level;
+    }
+
+    size_t uploadLevel(PendingLoad &load)
+    {
+        const StreamedTexture &texture = textures[load.texture];
+        int width = std::max(texture.width >> load.level, 1), height = std::max(texture.height >> load.level, 1);
+        glBindTexture(texture.target, texture.id);
+        size_t bytes = 0;
+        for (unsigned int f = 0; f < load.faces.size(); ++f) {
+            uploadCompressedLevel(faceTarget(texture, f), load.level, texture.format, width, height, load.faces[f],
+                                  scratch);
+            bytes += load.faces[f].size();
+        }
+        glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, load.level);
+        ++levelsUploaded;
+        return bytes;
+    }
+
+    // Raises the base level first, then redefines the level below it as
+    // empty, which releases its memory
+    void evict(const MipLoad &eviction)
+    {
+        const StreamedTexture &texture = textures[eviction.texture];
+        glBindTexture(texture.target, texture.id);
+        glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, eviction.level);
+        for (unsigned int f = 0; f < texture.cachePaths.size(); ++f)
+            glTexImage2D(faceTarget(texture, f), eviction.level - 1, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
+    }
+};
+
+#endif //PROJECT_TEXTURESTREAMER_H
@@ -0,0 +1,22 @@
+//
+// Vertex layout of Mesh, kept apart so CPU only code (ModelImporter.h)
+// can build vertices without pulling in OpenGL.
+//
+
+#ifndef PROJECT_VERTEX_H
+#define PROJECT_VERTEX_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+    // Tangent (xyz) and bitangent handedness (w) as GL_INT_2_10_10_10_REV,
+    // see TangentSpace.h
+    uint32_t tangent;
+};
+
+#endif //PROJECT_VERTEX_H
@@ -0,0 +1,138 @@
+//
+// Chase-Lev work stealing deque ("Dynamic Circular Work-Stealing Deque",
+// with the C11 memory orders of Le, Pop, Cohen and Zappa Nardelli).
+// One owner thread pushes and takes at the bottom, any other thread
+// steals from the top without locks. The ring grows when it is full,
+// the old rings are kept until the deque is destroyed because a thief may
+// still be reading from one.
+// T has to be trivially copyable, the job system stores pointers.
+//
+
+#ifndef PROJECT_WORKSTEALINGDEQUE_H
+#define PROJECT_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+template <typename T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024)
+            : top(0), bottom(0), ring(new Ring(capacity))
+    {
+    }
+
+    ~WorkStealingDeque()
+    {
+        delete ring.load(std::memory_order_relaxed);
+        for (unsigned int i = 0; i < retired.size(); ++i)
+            delete retired[i];
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only
+    void push(T item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Ring *r = ring.load(std::memory_order_relaxed);
+        if (b - t > r->capacity - 1) {
+            retired.push_back(r);
+            r = r->grow(t, b);
+            ring.store(r, std::memory_order_release);
+        }
+        r->put(b, item);
+        // Publishes the item (and what it points to) to thieves
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only, newest item first. Returns false when empty.
+    bool take(T &item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring *r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = r->get(b);
+        if (t == b) {
+            // Last item, race the thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread, oldest item first. Returns false when empty or when
+    // another thread got the item first.
+    bool steal(T &item)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        Ring *r = ring.load(std::memory_order_acquire);
+        item = r->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Approximate when other threads are pushing or taking
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring {
+        int64_t capacity;
+        std::atomic<T> *items;
+
+        // capacity has to be a power of two
+        explicit Ring(int64_t capacity_) : capacity(capacity_), items(new std::atomic<T>[capacity_]) {}
+
+        ~Ring()
+        {
+            delete[] items;
+        }
+
+        void put(int64_t i, T item)
+        {
+            items[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+
+        T get(int64_t i) const
+        {
+            return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        Ring *grow(int64_t t, int64_t b) const
+        {
+            Ring *bigger = new Ring(2 * capacity);
+            for (int64_t i = t; i < b; ++i)
+                bigger->put(i, get(i));
+            return bigger;
+        }
+    };
+
+    // Thieves and the owner hammer top and bottom, keep them on their own
+    // cache lines
+    std::atomic<int64_t> top;
+    char topPadding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom;
+    char bottomPadding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<Ring *> ring;
+    std::vector<Ring *> retired;
+};
+
+#endif //PROJECT_WORKSTEALINGDEQUE_H
@@ -4,6 +4,8 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+layout (location = 7) in mat3 normalMatrix;
 
 out vec3 normal;
 out vec4 fragPosition;
@@ -15,7 +17,7 @@ uniform mat4 projection;
 void main()
 {
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	normal = mat3(transpose(inverse(model))) * aNormal;
+	normal = normalMatrix * aNormal;
 	fragPosition = model * vec4(aPos, 1.0);
     texCoord = aTexCoord;
 }
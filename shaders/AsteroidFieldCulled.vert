@@ -0,0 +1,31 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// Index of a visible asteroid, written by the culling pass
+layout (location = 4) in uint instanceIndex;
+
+out vec3 normal;
+out vec4 fragPosition;
+out vec2 texCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+// Seven texels per asteroid: the model matrix columns, then the normal
+// matrix columns
+uniform samplerBuffer instanceData;
+
+void main()
+{
+    int base = int(instanceIndex) * 7;
+    mat4 model = mat4(texelFetch(instanceData, base), texelFetch(instanceData, base + 1),
+                      texelFetch(instanceData, base + 2), texelFetch(instanceData, base + 3));
+    mat3 normalMatrix = mat3(texelFetch(instanceData, base + 4).xyz,
+                             texelFetch(instanceData, base + 5).xyz,
+                             texelFetch(instanceData, base + 6).xyz);
+    fragPosition = model * vec4(aPos, 1.0);
+    gl_Position = projection * view * fragPosition;
+    normal = normalMatrix * aNormal;
+    texCoord = aTexCoord;
+}
@@ -0,0 +1,77 @@
+#version 330 core
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in vec3 normal;
+in vec2 texCoord;
+in vec4 fragPosition;
+
+out vec4 fragColor;
+
+uniform vec3 viewPos;
+uniform mat4 view;
+uniform Material material;
+
+// Filled by ClusteredLighting.h
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterGrid;
+uniform vec2 clusterTileSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+vec3 calcPointLight(int index, vec3 n, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
+{
+    vec4 positionRadius = texelFetch(lightData, 4 * index);
+    vec4 ambientConstant = texelFetch(lightData, 4 * index + 1);
+    vec4 diffuseLinear = texelFetch(lightData, 4 * index + 2);
+    vec4 specularQuadratic = texelFetch(lightData, 4 * index + 3);
+
+    vec3 lightVec = positionRadius.xyz - fragPosition.xyz;
+    float distance = length(lightVec);
+    // Lights are only binned up to their radius
+    if (distance > positionRadius.w)
+        return vec3(0.0);
+    float attenuation = 1.0f/(1.0f + ambientConstant.w + diffuseLinear.w*distance
+            + specularQuadratic.w*distance*distance);
+
+    vec3 ambientLight = attenuation * ambientConstant.rgb * diffuseColor;
+
+    vec3 lightDir = lightVec / distance;
+    float diffuse = max(dot(lightDir, n), 0.0f);
+    vec3 diffuseLight = attenuation * diffuse * diffuseColor * diffuseLinear.rgb;
+
+    vec3 reflectDir = normalize(reflect(-lightDir, n));
+    float specular = pow(max(dot(reflectDir, viewDir), 0.0f), material.shininess);
+    vec3 specularLight = attenuation * specular * specularColor * specularQuadratic.rgb;
+    return ambientLight + diffuseLight + specularLight;
+}
+
+void main()
+{
+    // Find the cluster of this fragment
+    float viewDepth = -(view * fragPosition).z;
+    ivec3 cluster;
+    cluster.xy = ivec2(gl_FragCoord.xy / clusterTileSize);
+    cluster.z = int(log(viewDepth) * clusterSliceScale + clusterSliceBias);
+    cluster = clamp(cluster, ivec3(0), ivec3(clusterGrid) - 1);
+    int clusterIndex = cluster.x + int(clusterGrid.x) * (cluster.y + int(clusterGrid.y) * cluster.z);
+    uvec2 range = texelFetch(clusterRanges, clusterIndex).rg;
+
+    vec3 n = normalize(normal);
+    vec3 viewDir = normalize(viewPos - fragPosition.xyz);
+    vec3 diffuseColor = vec3(texture(material.diffuse, texCoord));
+    vec3 specularColor = vec3(texture(material.specular, texCoord));
+
+    vec3 color = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+        color += calcPointLight(index, n, viewDir, diffuseColor, specularColor);
+    }
+    fragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,88 @@
+#version 330 core
+
+// type: 0 point light, 1 directional light, 2 spotlight
+struct Light {
+    int type;
+    vec3 position;
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float radius;
+    float innerCone;
+    float outerCone;
+};
+
+out vec4 fragColor;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform vec2 screenSize;
+uniform vec3 viewPos;
+uniform Light light;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    // Light volumes and the full screen quad both read the G-buffer
+    // at the pixel they cover
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(gDepth, uv).r;
+    // Nothing was drawn here
+    if (depth == 1.0)
+        discard;
+    vec4 clipPos = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 worldPos = inverseViewProjection * clipPos;
+    vec3 fragPosition = worldPos.xyz / worldPos.w;
+
+    vec4 albedoSpec = texture(gAlbedoSpec, uv);
+    vec4 normalShininess = texture(gNormal, uv);
+    vec3 n = octahedralDecode(normalShininess.xy);
+    float shininess = normalShininess.z;
+
+    vec3 lightDir;
+    float attenuation = 1.0;
+    if (light.type == 1) {
+        lightDir = normalize(-light.direction);
+    } else {
+        float distance = length(light.position - fragPosition);
+        if (distance > light.radius)
+            discard;
+        lightDir = (light.position - fragPosition) / distance;
+        attenuation = 1.0f/(1.0f + light.constant
+                + light.linear*distance + light.quadratic*distance*distance);
+    }
+
+    vec3 ambientLight = light.ambient * albedoSpec.rgb;
+
+    float diffuse = max(dot(lightDir, n), 0.0f);
+    vec3 diffuseLight = diffuse * albedoSpec.rgb * light.diffuse;
+
+    vec3 reflectDir = normalize(reflect(-lightDir, n));
+    vec3 viewDir = normalize(viewPos - fragPosition);
+    float specular = pow(max(dot(reflectDir, viewDir), 0.0f), shininess);
+    vec3 specularLight = specular * albedoSpec.a * light.specular;
+
+    vec3 color;
+    if (light.type == 2) {
+        float angle = dot(-lightDir, normalize(light.direction));
+        float spotStrength = clamp((light.outerCone - angle) /
+                (light.outerCone - light.innerCone), 0.0, 1.0);
+        color = attenuation * (ambientLight + spotStrength * (diffuseLight + specularLight));
+    } else {
+        color = attenuation * (ambientLight + diffuseLight + specularLight);
+    }
+    fragColor = vec4(color, 1.0);
+}
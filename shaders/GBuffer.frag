@@ -0,0 +1,36 @@
+#version 330 core
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    sampler2D emission;
+    float shininess;
+};
+
+in vec3 normal;
+in vec2 texCoord;
+in vec4 fragPosition;
+
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gAccumulation;
+
+uniform Material material;
+
+// Map a unit vector onto the octahedron and unfold it into [-1, 1]^2
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+void main()
+{
+    gAlbedoSpec.rgb = vec3(texture(material.diffuse, texCoord));
+    gAlbedoSpec.a = dot(vec3(texture(material.specular, texCoord)), vec3(1.0 / 3.0));
+    gNormal = vec4(octahedralEncode(normalize(normal)), material.shininess, 1.0);
+    // Emission does not depend on any light, so it seeds the accumulation buffer
+    gAccumulation = vec4(vec3(texture(material.emission, texCoord)), 1.0);
+}
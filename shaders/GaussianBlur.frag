@@ -0,0 +1,27 @@
+#version 330 core
+
+// One axis of a separable Gaussian. Every tap except the center sits
+// between two texels, so the bilinear filter weights both of them.
+#define MAX_TAPS 16
+
+out vec4 fragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+// One texel along the blur axis, (1 / width, 0) or (0, 1 / height)
+uniform vec2 direction;
+uniform int tapCount;
+uniform float offsets[MAX_TAPS];
+uniform float weights[MAX_TAPS];
+
+void main()
+{
+    vec3 color = texture(screenTexture, TexCoords).rgb * weights[0];
+    for (int i = 1; i < tapCount; ++i) {
+        vec2 offset = direction * offsets[i];
+        color += texture(screenTexture, TexCoords + offset).rgb * weights[i];
+        color += texture(screenTexture, TexCoords - offset).rgb * weights[i];
+    }
+    fragColor = vec4(color, 1.0);
+}
@@ -6,6 +6,8 @@ layout (location = 1) in vec3 aNormal;
 out vec4 color;
 
 uniform mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -19,7 +21,7 @@ void main()
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
 
 	// Do the lighting calculation here
-	vec3 normal = mat3(transpose(inverse(model))) * aNormal;
+	vec3 normal = normalMatrix * aNormal;
 	vec4 position = model * vec4(aPos, 1.0);
 
 	float ambient = 0.2f;
@@ -0,0 +1,10 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// Blended additively into a R32F pixel. 2^-32 per instance keeps the sum
+// exact and reads back as the instance count through GL_UNSIGNED_INT.
+void main()
+{
+    FragColor = vec4(exp2(-32.0), 0.0, 0.0, 0.0);
+}
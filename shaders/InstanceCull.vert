@@ -0,0 +1,15 @@
+#version 330 core
+
+// World space bounding sphere of one instance, xyz center and w radius
+layout (location = 0) in vec4 sphere;
+
+out vec4 vSphere;
+flat out uint vIndex;
+
+void main()
+{
+    vSphere = sphere;
+    vIndex = uint(gl_VertexID);
+    // Every survivor lands on the single pixel of the count target
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -9,13 +9,14 @@ out vec4 fragPosition;
 out vec2 texCoord;
 
 uniform mat4 model[5];
+uniform mat3 normalMatrix[5];
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
 	gl_Position = projection * view * model[gl_InstanceID] * vec4(aPos, 1.0);
-	normal = mat3(transpose(inverse(model[gl_InstanceID]))) * aNormal;
+	normal = normalMatrix[gl_InstanceID] * aNormal;
 	fragPosition = model[gl_InstanceID] * vec4(aPos, 1.0);
     texCoord = aTexCoord;
 }
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Dual Kawase downsample: renders at half the input size. The four diagonal
+// taps each average a 2x2 block of input texels.
+
+out vec4 fragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+// 1 / input size
+uniform vec2 texelSize;
+
+void main()
+{
+    vec3 color = texture(screenTexture, TexCoords).rgb * 4.0;
+    color += texture(screenTexture, TexCoords + vec2(-texelSize.x, -texelSize.y)).rgb;
+    color += texture(screenTexture, TexCoords + vec2( texelSize.x, -texelSize.y)).rgb;
+    color += texture(screenTexture, TexCoords + vec2(-texelSize.x,  texelSize.y)).rgb;
+    color += texture(screenTexture, TexCoords + vec2( texelSize.x,  texelSize.y)).rgb;
+    fragColor = vec4(color / 8.0, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+// Dual Kawase upsample: renders at twice the input size from a tent of
+// eight taps around the pixel.
+
+out vec4 fragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+// 1 / input size
+uniform vec2 texelSize;
+
+void main()
+{
+    vec2 halfTexel = texelSize * 0.5;
+    vec3 color = texture(screenTexture, TexCoords + vec2(-texelSize.x, 0.0)).rgb;
+    color += texture(screenTexture, TexCoords + vec2(texelSize.x, 0.0)).rgb;
+    color += texture(screenTexture, TexCoords + vec2(0.0, -texelSize.y)).rgb;
+    color += texture(screenTexture, TexCoords + vec2(0.0, texelSize.y)).rgb;
+    color += texture(screenTexture, TexCoords + vec2(-halfTexel.x, -halfTexel.y)).rgb * 2.0;
+    color += texture(screenTexture, TexCoords + vec2( halfTexel.x, -halfTexel.y)).rgb * 2.0;
+    color += texture(screenTexture, TexCoords + vec2(-halfTexel.x,  halfTexel.y)).rgb * 2.0;
+    color += texture(screenTexture, TexCoords + vec2( halfTexel.x,  halfTexel.y)).rgb * 2.0;
+    fragColor = vec4(color / 12.0, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+// Tangent and handedness from TangentSpace.h (GL_INT_2_10_10_10_REV)
+layout (location = 3) in vec4 aTangent;
+
+out vec3 normal;
+out vec3 tangent;
+flat out float handedness;
+out vec4 fragPosition;
+out vec2 texCoord;
+
+uniform mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+uniform mat3 normalMatrix;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	normal = normalMatrix * aNormal;
+	// Tangents lie in the surface, so they transform like positions
+	tangent = mat3(model) * aTangent.xyz;
+	// Only the sign is reliable, GL 3.3 maps a packed -1 to -1/3
+	handedness = aTangent.w < 0.0 ? -1.0 : 1.0;
+	fragPosition = model * vec4(aPos, 1.0);
+    texCoord = aTexCoord;
+}
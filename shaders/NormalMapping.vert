@@ -11,13 +11,15 @@ out VS_OUT {
 } vs_out;
 
 uniform mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	vs_out.normal = mat3(transpose(inverse(model))) * aNormal;
+	vs_out.normal = normalMatrix * aNormal;
 	vs_out.fragPos = model * vec4(aPos, 1.0);
     vs_out.texCoord = aTexCoord;
 }
@@ -0,0 +1,33 @@
+#version 330 core
+
+// Textures packed by TexturePacker into one array. Every region is a whole
+// layer (repeat) or a rectangle of an atlas layer, clamped to its edges and
+// to the levels its border keeps clean.
+const int MAX_REGIONS = 16;
+
+in vec2 texCoord;
+flat in int region;
+
+out vec4 fragColor;
+
+uniform sampler2DArray packedTexture;
+// Offset and scale into the layer
+uniform vec4 regionRect[MAX_REGIONS];
+// Layer, coarsest level, 1 when it repeats
+uniform vec4 regionInfo[MAX_REGIONS];
+// Fragments less opaque than this are discarded
+uniform float alphaCutoff;
+
+void main()
+{
+    vec4 rect = regionRect[region];
+    vec4 info = regionInfo[region];
+    vec2 uv = rect.xy + (info.z > 0.5 ? texCoord : clamp(texCoord, 0.0, 1.0)) * rect.zw;
+
+    // The level from the unclamped coordinates, so the edges keep theirs
+    vec2 texels = (rect.xy + texCoord * rect.zw) * vec2(textureSize(packedTexture, 0).xy);
+    vec2 dx = dFdx(texels), dy = dFdy(texels);
+    float level = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+    fragColor = textureLod(packedTexture, vec3(uv, info.x), min(level, info.y));
+    if (fragColor.a < alphaCutoff) discard;
+}
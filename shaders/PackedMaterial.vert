@@ -0,0 +1,19 @@
+#version 330 core
+
+// World space positions, the model transforms are baked into the batch
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in int aRegion;
+
+out vec2 texCoord;
+flat out int region;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	gl_Position = projection * view * vec4(aPos, 1.0);
+    texCoord = aTexCoord;
+    region = aRegion;
+}
@@ -7,12 +7,14 @@ out vec3 normal;
 out vec4 fragPosition;
 
 uniform mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	normal = mat3(transpose(inverse(model))) * aNormal;
+	normal = normalMatrix * aNormal;
 	fragPosition = model * vec4(aPos, 1.0);
 }
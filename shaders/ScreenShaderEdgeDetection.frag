@@ -5,19 +5,21 @@ out vec4 fragColor;
 in vec2 TexCoords;
 
 uniform sampler2D screenTexture;
+// 1 / framebuffer size, set by PostProcessChain
+uniform vec2 texelSize;
 
 void main() {
-	float offset = 1.0/300.0;
+	vec2 offset = texelSize;
 	vec2 offsets[] = vec2[](
-	    vec2(-offset, offset),
-	    vec2(0, offset),
-	    vec2(offset, offset),
-	    vec2(-offset, 0),
-	    vec2(0, 0),
-	    vec2(offset, 0),
-	    vec2(-offset, -offset),
-	    vec2(0, -offset),
-	    vec2(offset, -offset)
+	    vec2(-1, 1) * offset,
+	    vec2(0, 1) * offset,
+	    vec2(1, 1) * offset,
+	    vec2(-1, 0) * offset,
+	    vec2(0, 0) * offset,
+	    vec2(1, 0) * offset,
+	    vec2(-1, -1) * offset,
+	    vec2(0, -1) * offset,
+	    vec2(1, -1) * offset
 	);
 	float kernel[9] = float[](
 	    1, 1, 1,
@@ -29,37 +29,95 @@ uniform vec3 viewPos;
 uniform int lightCount;
 uniform Light light[10];
 uniform Material material;
-uniform sampler2D shadowMap;
 
-float calcShadow(vec4 lightSpacePos, Light l)
+// The same depth map bound twice, see ShadowMap.h
+uniform sampler2DShadow shadowMap;
+uniform sampler2D shadowDepthMap;
+// 0: 4-tap bilinear PCF, 1: Poisson 16, 2: PCSS
+uniform int shadowFilter;
+// Light size in shadow map uv units, only used by PCSS
+uniform float shadowLightSize = 0.02;
+
+const float SHADOW_BIAS = 0.005;
+
+const vec2 poissonDisk[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2( 0.94558609, -0.76890725),
+    vec2(-0.09418410, -0.92938870), vec2( 0.34495938,  0.29387760),
+    vec2(-0.91588581,  0.45771432), vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543,  0.27676845), vec2( 0.97484398,  0.75648379),
+    vec2( 0.44323325, -0.97511554), vec2( 0.53742981, -0.47373420),
+    vec2(-0.26496911, -0.41893023), vec2( 0.79197514,  0.19090188),
+    vec2(-0.24188840,  0.99706507), vec2(-0.81409955,  0.91437590),
+    vec2( 0.19984126,  0.78641367), vec2( 0.14383161, -0.14100790)
+);
+
+// Every tap on a sampler2DShadow is a hardware bilinear 2x2 compare,
+// so 4 half-texel-offset taps cover a 3x3 texel footprint, the middle
+// texels weighted most, like a tent filter.
+float pcf4Tap(vec3 projCoords, vec2 texelSize)
 {
-    // perform perspective divide
-    vec3 projCoords = lightSpacePos.xyz / fragPosLightSpace.w;
-    projCoords = projCoords * 0.5 + 0.5;
-    float closestDepth = texture(shadowMap, projCoords.xy).r;
-    float currentDepth = projCoords.z;
+    float shadow = 0.0;
+    shadow += texture(shadowMap, vec3(projCoords.xy + vec2(-0.5, -0.5) * texelSize, projCoords.z));
+    shadow += texture(shadowMap, vec3(projCoords.xy + vec2( 0.5, -0.5) * texelSize, projCoords.z));
+    shadow += texture(shadowMap, vec3(projCoords.xy + vec2(-0.5,  0.5) * texelSize, projCoords.z));
+    shadow += texture(shadowMap, vec3(projCoords.xy + vec2( 0.5,  0.5) * texelSize, projCoords.z));
+    return shadow * 0.25;
+}
 
+float pcfPoisson(vec3 projCoords, vec2 radius)
+{
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    for(int x = -1; x <= 1; ++x)
-    {
-        for(int y = -1; y <= 1; ++y)
-        {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += currentDepth - 0.005 > pcfDepth ? 0.0 : 1.0;
+    for (int i = 0; i < 16; ++i)
+        shadow += texture(shadowMap, vec3(projCoords.xy + poissonDisk[i] * radius, projCoords.z));
+    return shadow / 16.0;
+}
+
+float pcss(vec3 projCoords, vec2 texelSize)
+{
+    // Blocker search: average depth of the occluders inside the light footprint
+    float blockerDepth = 0.0;
+    int blockers = 0;
+    for (int i = 0; i < 16; ++i) {
+        float d = texture(shadowDepthMap, projCoords.xy + poissonDisk[i] * shadowLightSize).r;
+        if (d < projCoords.z) {
+            blockerDepth += d;
+            ++blockers;
         }
     }
-    shadow /= 9.0;
-    if(projCoords.z > 1.0)
-            shadow = 0.0;
-    return shadow;
+    if (blockers == 0)
+        return 1.0;
+    blockerDepth /= float(blockers);
+
+    // The similar triangles of a point-ish area light: the light size
+    // scaled by (receiver - blocker) / blocker. The light projection here
+    // is orthographic, so its depths are already linear and go into the
+    // ratio as they are.
+    float penumbra = (projCoords.z - blockerDepth) * shadowLightSize / blockerDepth;
+    vec2 radius = max(vec2(penumbra), texelSize);
+    return pcfPoisson(projCoords, radius);
 }
 
-vec3 calcPointLight(Light l)
+// Returns how much the fragment is lit: 1.0 fully lit, 0.0 fully in shadow
+float calcShadow(vec4 lightSpacePos)
 {
-    // Calculate shadows
-    float shadow = calcShadow(fragPosLightSpace, l);
+    // perform perspective divide
+    vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w;
+    projCoords = projCoords * 0.5 + 0.5;
+    // Beyond the far plane of the light frustum nothing can occlude us
+    if (projCoords.z > 1.0)
+        return 1.0;
+    projCoords.z -= SHADOW_BIAS;
+
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+    if (shadowFilter == 1)
+        return pcfPoisson(projCoords, 1.5 * texelSize);
+    if (shadowFilter == 2)
+        return pcss(projCoords, texelSize);
+    return pcf4Tap(projCoords, texelSize);
+}
 
+vec3 calcPointLight(Light l, float shadow)
+{
     float distance = length(vec3(fragPosition) - l.position);
     float attenuation = 1.0f/(1.0f + l.constant + l.linear*distance + l.quadratic*distance*distance);
 
@@ -79,10 +137,11 @@ vec3 calcPointLight(Light l)
 
 void main()
 {
+    // There is a single shadow map, so evaluate it once for all lights
+    float shadow = calcShadow(fragPosLightSpace);
+
     fragColor = vec4(0.0, 0.0, 0.0, 1.0);
     for (int i = 0; i < lightCount; ++i) {
-        fragColor += vec4(calcPointLight(light[i]), 1.0);
+        fragColor += vec4(calcPointLight(light[i], shadow), 1.0);
     }
 }
-
-
@@ -10,6 +10,8 @@ out vec2 texCoord;
 out vec4 fragPosLightSpace;
 
 uniform mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 uniform mat4 lightSpaceMatrix;
@@ -17,7 +19,7 @@ uniform mat4 lightSpaceMatrix;
 void main()
 {
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	normal = mat3(transpose(inverse(model))) * aNormal;
+	normal = normalMatrix * aNormal;
 	fragPosition = model * vec4(aPos, 1.0);
 	fragPosLightSpace = lightSpaceMatrix * fragPosition;
     texCoord = aTexCoord;
@@ -5,6 +5,8 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 
 uniform mat4 model;
+// Inverse transpose of mat3(model), computed on the CPU
+uniform mat3 normalMatrix;
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -13,6 +15,6 @@ out vec4 vFragPosition;
 
 void main() {
     gl_Position = model * vec4(aPos, 1.0);
-	vNormal = normalize(mat3(transpose(inverse(model))) * aNormal);
+	vNormal = normalize(normalMatrix * aNormal);
  	vFragPosition = model * vec4(aPos, 1.0);
 }
@@ -1,9 +1,11 @@
 //
-// Created by hehao on 18-2-5.
+// Clustered forward shading with a large number of point lights.
+// Lights are binned on the CPU every frame, see LightCluster.h.
 //
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -20,6 +22,8 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
+#include "ClusteredLighting.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -48,28 +52,17 @@ int main()
         return -1;
     }
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
 
-    // Load shaders
-    Shader objectShader("shaders/MultipleLights.vert", "shaders/Discard.frag");
+    // Load Object Shader
+    Shader objectShader("shaders/MultipleLights.vert", "shaders/ClusteredLighting.frag");
     objectShader.use();
     objectShader.setInt("material.diffuse", 0);
     objectShader.setInt("material.specular", 1);
-    objectShader.setInt("material.emission", 2);
-
-    Shader transparentWindowShader("shaders/MultipleLights.vert", "shaders/BasicFrag.frag");
-    transparentWindowShader.use();
-    transparentWindowShader.setInt("material.diffuse", 0);
-    transparentWindowShader.setInt("material.specular", 1);
-    transparentWindowShader.setInt("material.emission", 2);
-
-    Shader screenShader("shaders/ScreenShaderDefault.vert", "shaders/ScreenShaderInverse.frag");
-    screenShader.use();
-    screenShader.setInt("screenTexture", 0);
 
     // A set of cubeVertices to describe a cube(with normal vectors)
     float cubeVertices[] = {
@@ -139,8 +132,9 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // Vertices data to describe a ground
-    float groundVertices[] = {
+
+    // Vertices data to describe a plane
+    float planeVertices[] = {
             // Positions    // Normals        // Texture coordinates
             -0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
             0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 10.0f, 0.0f,
@@ -149,30 +143,6 @@ int main()
             0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 10.0f, 0.0f,
             0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 10.0f, 10.0f,
     };
-    unsigned int groundVBO;
-    glGenBuffers(1, &groundVBO);
-    unsigned int groundVAO;
-    glGenVertexArrays(1, &groundVAO);
-    glBindVertexArray(groundVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, groundVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3*sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    // texture coorinate to describe a plane
-    float planeVertices[] = {
-            // Positions    // Normals        // Texture coordinates
-            -0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-            0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-            -0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-            -0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-            0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-            0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
-    };
     unsigned int planeVBO;
     glGenBuffers(1, &planeVBO);
     unsigned int planeVAO;
@@ -187,65 +157,38 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
-    float quadVertices[] = {
-            // positions   // texCoords
-            -1.0f,  1.0f,  0.0f, 1.0f,
-            -1.0f, -1.0f,  0.0f, 0.0f,
-            1.0f, -1.0f,  1.0f, 0.0f,
+    glEnable(GL_DEPTH_TEST);
+    // Enable gamma correction
+    glEnable(GL_FRAMEBUFFER_SRGB);
 
-            -1.0f,  1.0f,  0.0f, 1.0f,
-            1.0f, -1.0f,  1.0f, 0.0f,
-            1.0f,  1.0f,  1.0f, 1.0f
+    gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
+    glm::vec3 cubePositions[5] = {
+            glm::vec3(0.0f,  0.5f, 0.0f),
+            glm::vec3(2.0f, 0.5f, 2.0f),
+            glm::vec3(2.0f, 0.5f, -2.0f),
+            glm::vec3(-2.0f, 0.5f, -2.0f),
+            glm::vec3(-2.0f, 0.5, 2.0f),
     };
-    unsigned int quadVBO;
-    glGenBuffers(1, &quadVBO);
-    unsigned int quadVAO;
-    glGenVertexArrays(1, &quadVAO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2*sizeof(float)));
-    glEnableVertexAttribArray(1);
 
-    // Initialize a customized frame buffer
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    // Generate texture;
-    unsigned int texColorBuffer;
-    glGenTextures(1, &texColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, gScreenWidth, gScreenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Attach it to currently bind framebuffer
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
-
-    // Create a render buffer object to store depth and stencil buffer
-    unsigned int RBO;
-    glGenRenderbuffers(1, &RBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, RBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, gScreenWidth, gScreenHeight);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    // Bind the render buffer object to framebuffer
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, RBO);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cout << "Error: Incomplete framebuffer!" << std::endl;
+    // Scatter small colored lights over the ground. They use a steep
+    // attenuation so each of them only reaches a few clusters.
+    ClusteredLighting lighting;
+    const int lightCount = 2048;
+    std::vector<glm::vec3> lightBase;
+    srand(1);
+    for (int i = 0; i < lightCount; ++i) {
+        glm::vec3 pos(rand() % 1000 / 100.0f - 5.0f, 0.2f + rand() % 100 / 200.0f,
+                      rand() % 1000 / 100.0f - 5.0f);
+        glm::vec3 color(rand() % 100 / 100.0f, rand() % 100 / 100.0f, rand() % 100 / 100.0f);
+        lightBase.push_back(pos);
+        lighting.addPointLightSource(pos, color * 0.01f, color * 0.8f, color, 1.0f, 0.7f, 1.8f);
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
 
+    // The cluster bounds only depend on the projection, rebuilt when the
+    // zoom or the aspect changes
+    float clusterZoom = 0.0f, clusterAspect = 0.0f;
+    double binningTime = 0.0;
+    int binningFrames = 0;
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
@@ -256,113 +199,75 @@ int main()
         // Handle user input
         processInput(window);
 
-        // All the rendering starts from here
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-        // We change to the custom framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        // All the rendering starts from here
+        glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
 
         // Set up view and projection matrix
         glm::mat4 view = gCamera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom),
-                                                (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
+        float aspect = (float)gScreenWidth / gScreenHeight;
+        glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), aspect, 0.1f, 100.0f);
+
+        // Let the lights wander around their start position
+        for (int i = 0; i < lightCount; ++i) {
+            float phase = currentFrame + i * 0.37f;
+            lighting.lights[i].position = lightBase[i] + glm::vec3(0.5f * sinf(phase), 0.0f,
+                                                                   0.5f * cosf(phase));
+        }
+
+        if (gCamera.Zoom != clusterZoom || aspect != clusterAspect) {
+            clusterZoom = gCamera.Zoom;
+            clusterAspect = aspect;
+            lighting.setProjection(glm::radians(clusterZoom), clusterAspect, 0.1f, 100.0f);
+        }
+
+        auto binStart = std::chrono::high_resolution_clock::now();
+        lighting.update(view);
+        auto binEnd = std::chrono::high_resolution_clock::now();
+        binningTime += std::chrono::duration<double, std::milli>(binEnd - binStart).count();
+        if (++binningFrames == 300) {
+            std::cout << lightCount << " lights, " << lighting.grid.lightIndices.size()
+                      << " cluster entries, binning + upload: "
+                      << binningTime / binningFrames << " ms" << std::endl;
+            binningTime = 0.0;
+            binningFrames = 0;
+        }
 
-        // Draw the cubes
         objectShader.use();
         objectShader.setMat4("view", view);
         objectShader.setMat4("projection", projection);
         objectShader.setVec3("viewPos", gCamera.Position);
+        objectShader.setFloat("material.shininess", 32.0f);
+        lighting.bind(objectShader, 2, framebufferWidth, framebufferHeight);
 
         ambientMap.useTextureUnit(0);
         specularMap.useTextureUnit(1);
 
         // Draw cubes
-        glm::vec3 cubePositions[5] = {
-                glm::vec3(0.0f,  0.5f, 0.0f),
-                glm::vec3(2.0f, 0.5f, 2.0f),
-                glm::vec3(2.0f, 0.5f, -2.0f),
-                glm::vec3(-2.0f, 0.5f, -2.0f),
-                glm::vec3(-2.0f, 0.5, 2.0f),
-        };
         glBindVertexArray(cubeVAO);
         for (int i = 0; i < 5; ++i) {
             // Compute model transformations for each cube
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
-        // Start to draw planes
-        // Draw grasses
-        glm::vec3 grassPositions[4] = {
-                glm::vec3(2.0f, 0.5f, 0.0f),
-                glm::vec3(0.0f, 0.5f, 2.0f),
-                glm::vec3(-2.0f, 0.5f, 0.0f),
-                glm::vec3(0.0f, 0.5f, -2.0f),
-        };
-        glBindVertexArray(planeVAO);
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                glm::mat4 model = glm::mat4(1.0f);
-
-                model = glm::translate(model, grassPositions[i]);
-                model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-                objectShader.setMat4("model", model);
-                grassTexture.useTextureUnit(0);
-                // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
-                // from interpolating near texture borders
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-            }
-        }
-
         // Draw the ground
-        glBindVertexArray(groundVAO);
+        glBindVertexArray(planeVAO);
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
-        objectShader.use();
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // Draw the transparent window
-        // It must be drawn in the last so that all other objects can be blended with them
-        // Also, if multiple transparent windows are involved, we MUST sort them and draw them
-        // from farther to nearest to avoid depth testing issues.
-        glBindVertexArray(planeVAO);
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.8f, 0.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        transparentWindowShader.use();
-        transparentWindowShader.setMat4("view", view);
-        transparentWindowShader.setMat4("projection", projection);
-        transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
-        transparentWindowTexture.useTextureUnit(0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
-
-        screenShader.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         // Rendering Ends here
 
@@ -381,9 +286,13 @@ GLFWwindow *init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // For the window to run in Mac OS X
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    // For anti-aliasing effects
+    glfwWindowHint(GLFW_SAMPLES, 4);
 
     // Create a window object
-    GLFWwindow *window = glfwCreateWindow(800, 600, "Lighting Scene", nullptr, nullptr);
+    GLFWwindow *window = glfwCreateWindow(800, 600, "Clustered Lighting", nullptr, nullptr);
     if (window == nullptr) {
         std::cout << "Failed to create GLFW window!" << std::endl;
         glfwTerminate();
@@ -399,7 +308,7 @@ GLFWwindow *init()
     }
 
     // Tell OpenGL the size of rendering window
-    glViewport(0, 0, gScreenWidth, gScreenHeight);
+    glViewport(0, 0, gScreenWidth * 2, gScreenHeight * 2);
 
     // Set the windows resize callback function
     glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
@@ -1,9 +1,14 @@
 //
-// Created by hehao on 18-2-7.
+// Deferred shading version of the MultipleLights scene.
+// A geometry pass writes the G-buffer (see GBuffer.h), then every light is
+// accumulated only over the pixels it can reach: point lights and the
+// spotlight as bounding spheres, the directional light as a full screen quad.
 //
 
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <cmath>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -20,6 +25,10 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
+#include "GBuffer.h"
+#include "GpuTimer.h"
+#include "LightCluster.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -29,6 +38,8 @@ float gLastFrame = 0.0f;
 
 Camera gCamera;
 
+bool gEmission = false;
+
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
 GLFWwindow *init();
@@ -39,6 +50,14 @@ void processInput(GLFWwindow *window);
 // Mouse input is handled in this function
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
+// Build a unit sphere used as light volume. Returns the VAO, index count in indexCount
+unsigned int generateSphere(int segments, int rings, int &indexCount);
+
+// Set every member of the Light struct in DeferredLighting.frag
+void setLight(Shader &shader, int type, glm::vec3 position, glm::vec3 direction,
+              glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+              float constant, float linear, float quadratic, float radius,
+              float innerCone = 0.0f, float outerCone = 0.0f);
 
 int main()
 {
@@ -48,26 +67,32 @@ int main()
         return -1;
     }
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture emissionMap("textures/container2_emission.jpg", TEXTURE_COLOR, &jobs);
 
     // Load shaders
-    Shader objectShader("shaders/MultipleLights.vert", "shaders/Discard.frag");
-    objectShader.use();
-    objectShader.setInt("material.diffuse", 0);
-    objectShader.setInt("material.specular", 1);
-    objectShader.setInt("material.emission", 2);
-
-    Shader transparentWindowShader("shaders/MultipleLights.vert", "shaders/BasicFrag.frag");
-    transparentWindowShader.use();
-    transparentWindowShader.setInt("material.diffuse", 0);
-    transparentWindowShader.setInt("material.specular", 1);
-    transparentWindowShader.setInt("material.emission", 2);
-
-    Shader screenShader("shaders/ScreenShaderDefault.vert", "shaders/ScreenShaderEdgeDetection.frag");
+    // The geometry pass uses the same material conventions as MultipleLights
+    Shader geometryShader("shaders/MultipleLights.vert", "shaders/GBuffer.frag");
+    geometryShader.use();
+    geometryShader.setInt("material.diffuse", 0);
+    geometryShader.setInt("material.specular", 1);
+    geometryShader.setInt("material.emission", 2);
+
+    Shader volumeShader("shaders/DeferredLightVolume.vert", "shaders/DeferredLighting.frag");
+    Shader fullScreenShader("shaders/ScreenShaderDefault.vert", "shaders/DeferredLighting.frag");
+    Shader *lightShaders[2] = { &volumeShader, &fullScreenShader };
+    for (int i = 0; i < 2; ++i) {
+        lightShaders[i]->use();
+        lightShaders[i]->setInt("gAlbedoSpec", 0);
+        lightShaders[i]->setInt("gNormal", 1);
+        lightShaders[i]->setInt("gDepth", 2);
+    }
+
+    Shader screenShader("shaders/ScreenShaderDefault.vert", "shaders/ScreenShaderDefault.frag");
     screenShader.use();
     screenShader.setInt("screenTexture", 0);
 
@@ -139,8 +164,8 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // Vertices data to describe a ground
-    float groundVertices[] = {
+    // Vertices data to describe a plane
+    float planeVertices[] = {
             // Positions    // Normals        // Texture coordinates
             -0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
             0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 10.0f, 0.0f,
@@ -149,30 +174,6 @@ int main()
             0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 10.0f, 0.0f,
             0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 10.0f, 10.0f,
     };
-    unsigned int groundVBO;
-    glGenBuffers(1, &groundVBO);
-    unsigned int groundVAO;
-    glGenVertexArrays(1, &groundVAO);
-    glBindVertexArray(groundVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, groundVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3*sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    // texture coorinate to describe a plane
-    float planeVertices[] = {
-            // Positions    // Normals        // Texture coordinates
-            -0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-            0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-            -0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-            -0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-            0.5f, 0.0f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-            0.5f, 0.0f,  0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
-    };
     unsigned int planeVBO;
     glGenBuffers(1, &planeVBO);
     unsigned int planeVAO;
@@ -187,7 +188,6 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
     float quadVertices[] = {
             // positions   // texCoords
             -1.0f,  1.0f,  0.0f, 1.0f,
@@ -210,42 +210,45 @@ int main()
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2*sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    // Initialize a customized frame buffer
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    // Generate texture;
-    unsigned int texColorBuffer;
-    glGenTextures(1, &texColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, gScreenWidth, gScreenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Attach it to currently bind framebuffer
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
-
-    // Create a render buffer object to store depth and stencil buffer
-    unsigned int RBO;
-    glGenRenderbuffers(1, &RBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, RBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, gScreenWidth, gScreenHeight);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    // Bind the render buffer object to framebuffer
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, RBO);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cout << "Error: Incomplete framebuffer!" << std::endl;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    int sphereIndexCount;
+    unsigned int sphereVAO = generateSphere(16, 8, sphereIndexCount);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    GBuffer gBuffer(framebufferWidth, framebufferHeight);
+    GpuTimer lightTimer;
+
+    glEnable(GL_DEPTH_TEST);
 
     gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
+    glm::vec3 lightColor = glm::vec3(1.0f);
+    glm::vec3 cubePositions[5] = {
+            glm::vec3(0.0f,  0.5f, 0.0f),
+            glm::vec3(2.0f, 0.5f, 2.0f),
+            glm::vec3(2.0f, 0.5f, -2.0f),
+            glm::vec3(-2.0f, 0.5f, -2.0f),
+            glm::vec3(-2.0f, 0.5, 2.0f),
+    };
 
+    // Small colored point lights circling the cubes
+    const int pointLightCount = 64;
+    std::vector<glm::vec3> pointLightColors;
+    srand(1);
+    for (int i = 0; i < pointLightCount; ++i) {
+        pointLightColors.emplace_back(rand() % 100 / 100.0f, rand() % 100 / 100.0f,
+                                      rand() % 100 / 100.0f);
+    }
+    const float pointConstant = 1.0f, pointLinear = 0.35f, pointQuadratic = 0.44f;
+    const float pointRadius = LightClusterGrid::attenuationRadius(pointConstant, pointLinear,
+                                                                  pointQuadratic);
+    // The spotlight of MultipleLights has a very long reach, clamp its volume
+    const float spotRadius = std::min(LightClusterGrid::attenuationRadius(1.0f, 0.022f, 0.0010f),
+                                      50.0f);
+    // The sphere mesh is inscribed in the unit sphere, so scale it up a bit
+    // to make sure it covers every pixel the light reaches
+    const float volumeScale = 1.0f / cosf(glm::radians(180.0f / 8));
+
+    int timedFrames = 0;
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
@@ -256,80 +259,44 @@ int main()
         // Handle user input
         processInput(window);
 
-        // All the rendering starts from here
-
-        // We change to the custom framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        gBuffer.resize(framebufferWidth, framebufferHeight);
 
         // Set up view and projection matrix
         glm::mat4 view = gCamera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom),
                                                 (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
 
-        // Draw the cubes
-        objectShader.use();
-        objectShader.setMat4("view", view);
-        objectShader.setMat4("projection", projection);
-        objectShader.setVec3("viewPos", gCamera.Position);
+        // All the rendering starts from here
+        // Geometry pass: material attributes only, no lighting
+        gBuffer.beginGeometryPass();
+        geometryShader.use();
+        geometryShader.setMat4("view", view);
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setFloat("material.shininess", 32.0f);
 
         ambientMap.useTextureUnit(0);
         specularMap.useTextureUnit(1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, gEmission ? emissionMap.ID : 0);
 
         // Draw cubes
-        glm::vec3 cubePositions[5] = {
-                glm::vec3(0.0f,  0.5f, 0.0f),
-                glm::vec3(2.0f, 0.5f, 2.0f),
-                glm::vec3(2.0f, 0.5f, -2.0f),
-                glm::vec3(-2.0f, 0.5f, -2.0f),
-                glm::vec3(-2.0f, 0.5, 2.0f),
-        };
         glBindVertexArray(cubeVAO);
         for (int i = 0; i < 5; ++i) {
             // Compute model transformations for each cube
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            geometryShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
-        // Start to draw planes
-        // Draw grasses
-        glm::vec3 grassPositions[4] = {
-                glm::vec3(2.0f, 0.5f, 0.0f),
-                glm::vec3(0.0f, 0.5f, 2.0f),
-                glm::vec3(-2.0f, 0.5f, 0.0f),
-                glm::vec3(0.0f, 0.5f, -2.0f),
-        };
-        glBindVertexArray(planeVAO);
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                glm::mat4 model = glm::mat4(1.0f);
-
-                model = glm::translate(model, grassPositions[i]);
-                model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-                objectShader.setMat4("model", model);
-                grassTexture.useTextureUnit(0);
-                // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
-                // from interpolating near texture borders
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-            }
-        }
-
         // Draw the ground
-        glBindVertexArray(groundVAO);
+        glBindVertexArray(planeVAO);
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
-        objectShader.use();
-        objectShader.setMat4("model", planeModel);
+        geometryShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
@@ -338,32 +305,77 @@ int main()
         glBindTexture(GL_TEXTURE_2D, 0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        // Draw the transparent window
-        // It must be drawn in the last so that all other objects can be blended with them
-        // Also, if multiple transparent windows are involved, we MUST sort them and draw them
-        // from farther to nearest to avoid depth testing issues.
-        glBindVertexArray(planeVAO);
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.8f, 0.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        transparentWindowShader.use();
-        transparentWindowShader.setMat4("view", view);
-        transparentWindowShader.setMat4("projection", projection);
-        transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
-        transparentWindowTexture.useTextureUnit(0);
+        // Light pass: cost is pixels covered by each light volume,
+        // independent of how much geometry was overdrawn above
+        lightTimer.begin();
+        gBuffer.beginLightPass();
+        gBuffer.bindTextures(0);
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+        for (int i = 0; i < 2; ++i) {
+            lightShaders[i]->use();
+            lightShaders[i]->setMat4("inverseViewProjection", inverseViewProjection);
+            lightShaders[i]->setVec2("screenSize", glm::vec2(framebufferWidth, framebufferHeight));
+            lightShaders[i]->setVec3("viewPos", gCamera.Position);
+        }
+
+        // The directional light touches every pixel
+        glBindVertexArray(quadVAO);
+        setLight(fullScreenShader, 1, glm::vec3(0.0f), glm::vec3(-1.0f, -1.0f, 0.0f),
+                 lightColor * 0.05f, lightColor * 0.3f, lightColor, 1.0f, 0.0f, 0.0f, 0.0f);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
+        // Point lights and the spotlight are drawn as spheres. Only back faces
+        // are rasterized so the volume still works with the camera inside it.
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        volumeShader.use();
+        volumeShader.setMat4("view", view);
+        volumeShader.setMat4("projection", projection);
+        glBindVertexArray(sphereVAO);
+        for (int i = 0; i < pointLightCount; ++i) {
+            float angle = currentFrame * 0.5f + glm::radians(360.0f) * i / pointLightCount;
+            float distance = 2.0f + 2.5f * (i % 4);
+            glm::vec3 position(distance * sinf(angle), 0.3f, distance * cosf(angle));
+            glm::vec3 color = pointLightColors[i];
+            setLight(volumeShader, 0, position, glm::vec3(0.0f), color * 0.05f, color, color,
+                     pointConstant, pointLinear, pointQuadratic, pointRadius);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+            model = glm::scale(model, glm::vec3(pointRadius * volumeScale));
+            volumeShader.setMat4("model", model);
+            glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+        }
+
+        glm::vec3 spotLightPosition = glm::vec3(0.0f, 3.0f, 0.0f);
+        glm::vec3 spotLightTarget = glm::vec3(1.5f*cosf((float)glfwGetTime()), 0.0f,
+                                              1.5f*sinf((float)glfwGetTime()));
+        setLight(volumeShader, 2, spotLightPosition, spotLightTarget - spotLightPosition,
+                 lightColor * 0.1f, lightColor * 0.5f, lightColor, 1.0f, 0.022f, 0.0010f,
+                 spotRadius, cosf(glm::radians(15.0f)), cosf(glm::radians(20.0f)));
+        glm::mat4 spotModel = glm::translate(glm::mat4(1.0f), spotLightPosition);
+        spotModel = glm::scale(spotModel, glm::vec3(spotRadius * volumeScale));
+        volumeShader.setMat4("model", spotModel);
+        glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+        gBuffer.endLightPass();
+        lightTimer.end();
+
+        if (++timedFrames == 300) {
+            std::cout << pointLightCount + 2 << " lights, light pass: "
+                      << lightTimer.averageMilliseconds() << " ms (GPU)" << std::endl;
+            lightTimer.reset();
+            timedFrames = 0;
+        }
 
+        // Show the accumulated lighting
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+        glDisable(GL_DEPTH_TEST);
         screenShader.use();
         glBindVertexArray(quadVAO);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+        glBindTexture(GL_TEXTURE_2D, gBuffer.accumulation);
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        glEnable(GL_DEPTH_TEST);
         // Rendering Ends here
 
         glfwSwapBuffers(window);
@@ -381,9 +393,13 @@ GLFWwindow *init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // For the window to run in Mac OS X
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    // For anti-aliasing effects
+    glfwWindowHint(GLFW_SAMPLES, 4);
 
     // Create a window object
-    GLFWwindow *window = glfwCreateWindow(800, 600, "Lighting Scene", nullptr, nullptr);
+    GLFWwindow *window = glfwCreateWindow(800, 600, "Deferred Shading", nullptr, nullptr);
     if (window == nullptr) {
         std::cout << "Failed to create GLFW window!" << std::endl;
         glfwTerminate();
@@ -399,7 +415,7 @@ GLFWwindow *init()
     }
 
     // Tell OpenGL the size of rendering window
-    glViewport(0, 0, gScreenWidth, gScreenHeight);
+    glViewport(0, 0, gScreenWidth * 2, gScreenHeight * 2);
 
     // Set the windows resize callback function
     glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
@@ -437,6 +453,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
         gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
     }
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+        gEmission = !gEmission;
+    }
 }
 
 void mouseCallback(GLFWwindow *window, double xpos, double ypos)
@@ -464,4 +483,66 @@ void mouseCallback(GLFWwindow *window, double xpos, double ypos)
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY)
 {
     gCamera.ProcessMouseScroll((float)offsetY);
-}
\ No newline at end of file
+}
+unsigned int generateSphere(int segments, int rings, int &indexCount)
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    for (int r = 0; r <= rings; ++r) {
+        float phi = glm::radians(180.0f) * r / rings;
+        for (int s = 0; s <= segments; ++s) {
+            float theta = glm::radians(360.0f) * s / segments;
+            vertices.push_back(sinf(phi) * cosf(theta));
+            vertices.push_back(cosf(phi));
+            vertices.push_back(sinf(phi) * sinf(theta));
+        }
+    }
+    // Wind the triangles counter-clockwise when seen from outside
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            unsigned int a = r * (segments + 1) + s;
+            unsigned int b = a + segments + 1;
+            indices.push_back(a);
+            indices.push_back(a + 1);
+            indices.push_back(b);
+            indices.push_back(b);
+            indices.push_back(a + 1);
+            indices.push_back(b + 1);
+        }
+    }
+    indexCount = (int)indices.size();
+
+    unsigned int VAO, VBO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 &indices[0], GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    return VAO;
+}
+
+void setLight(Shader &shader, int type, glm::vec3 position, glm::vec3 direction,
+              glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+              float constant, float linear, float quadratic, float radius,
+              float innerCone, float outerCone)
+{
+    shader.setInt("light.type", type);
+    shader.setVec3("light.position", position);
+    shader.setVec3("light.direction", direction);
+    shader.setVec3("light.ambient", ambient);
+    shader.setVec3("light.diffuse", diffuse);
+    shader.setVec3("light.specular", specular);
+    shader.setFloat("light.constant", constant);
+    shader.setFloat("light.linear", linear);
+    shader.setFloat("light.quadratic", quadratic);
+    shader.setFloat("light.radius", radius);
+    shader.setFloat("light.innerCone", innerCone);
+    shader.setFloat("light.outerCone", outerCone);
+}
@@ -19,7 +19,9 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Camera.h"
+#include "GoldenRun.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -28,6 +30,8 @@ float gDeltaTime = 0.0f;
 float gLastFrame = 0.0f;
 
 Camera gCamera;
+// Fixed time runs that write a reference image, see GoldenRun.h
+GoldenRun gGolden;
 
 bool gFunky = false;
 
@@ -42,16 +46,19 @@ void processInput(GLFWwindow *window);
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
 
-int main()
+int main(int argc, char *argv[])
 {
+    gGolden.parse(argc, argv);
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
         return -1;
     }
 
-    Texture texBrickWall("textures/brickwall.jpg");
-    Texture texBrickWallNormal("textures/brickwall_normal.jpg");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture texBrickWall("textures/brickwall.jpg", TEXTURE_COLOR, &jobs);
+    Texture texBrickWallNormal("textures/brickwall_normal.jpg", TEXTURE_NORMAL, &jobs);
 
     // Load Object Shader
     Shader objectShader("shaders/NormalMapping.vert", "shaders/NormalMapping.frag");
@@ -97,7 +104,7 @@ int main()
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
-        auto currentFrame = (float)glfwGetTime();
+        auto currentFrame = gGolden.time();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
@@ -107,7 +114,11 @@ int main()
         // All the rendering starts from here
         glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, gScreenWidth * 2, gScreenHeight * 2);
+        // The framebuffer is twice the window on a Retina display, the same
+        // size elsewhere
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
 
         // Set up view and projection matrix
         glm::mat4 view = gCamera.GetViewMatrix();
@@ -119,7 +130,7 @@ int main()
         objectShader.setVec4("light.pos", glm::vec4(lightSource, 1.0f));
         objectShader.setMat4("view", view);
         objectShader.setMat4("projection", projection);
-        objectShader.setMat4("model", model);
+        objectShader.setModelMatrix(model);
         objectShader.setVec4("viewPos", glm::vec4(gCamera.Position, 1.0f));
         texBrickWall.useTextureUnit(0);
         texBrickWallNormal.useTextureUnit(1);
@@ -127,6 +138,8 @@ int main()
         glDrawArrays(GL_TRIANGLES, 0, 6);
         // Rendering Ends here
 
+        if (gGolden.frameDone())
+            break;
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -147,6 +160,7 @@ GLFWwindow *init()
     // For anti-aliasing effects
     glfwWindowHint(GLFW_SAMPLES, 4);
 
+    gGolden.hintWindow(4);
     // Create a window object
     GLFWwindow *window = glfwCreateWindow(800, 600, "Lighting Scene", nullptr, nullptr);
     if (window == nullptr) {
@@ -162,9 +176,12 @@ GLFWwindow *init()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return nullptr;
     }
+    gGolden.begin(window);
 
     // Tell OpenGL the size of rendering window
-    glViewport(0, 0, gScreenWidth * 2, gScreenHeight * 2);
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    glViewport(0, 0, framebufferWidth, framebufferHeight);
 
     // Set the windows resize callback function
     glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
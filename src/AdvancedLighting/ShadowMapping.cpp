@@ -19,7 +19,11 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Camera.h"
+#include "GoldenRun.h"
 #include "Texture.h"
+#include "JobPool.h"
+#include "ShadowMap.h"
+#include "GpuTimer.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -28,9 +32,17 @@ float gDeltaTime = 0.0f;
 float gLastFrame = 0.0f;
 
 Camera gCamera;
+// Fixed time runs that write a reference image, see GoldenRun.h
+GoldenRun gGolden;
 
 bool gFunky = false;
 
+ShadowMap::Filter gShadowFilter = ShadowMap::PCF_4TAP;
+// Number of frames each filter is timed for when comparing them
+const int BENCHMARK_FRAMES = 200;
+// Index of the filter under test, -1 if no comparison is running
+int gBenchmarkFilter = -1;
+
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
 GLFWwindow *init();
@@ -42,18 +54,21 @@ void processInput(GLFWwindow *window);
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
 
-int main()
+int main(int argc, char *argv[])
 {
+    gGolden.parse(argc, argv);
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
         return -1;
     }
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture emissionMap("textures/container2_emission.jpg");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture emissionMap("textures/container2_emission.jpg", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     // Load light source shader
@@ -66,6 +81,7 @@ int main()
     objectShader.setInt("material.diffuse", 0);
     objectShader.setInt("material.specular", 1);
     objectShader.setInt("shadowMap", 2);
+    objectShader.setInt("shadowDepthMap", 3);
 
     Shader depthShader("shaders/DepthShader.vert", "shaders/DepthShader.frag");
 
@@ -172,27 +188,11 @@ int main()
     glEnableVertexAttribArray(2);
 
     // Set up shadow map
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-    const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    // Set up depth map
-    unsigned int depthMap;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-                 SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    // Bind the depth map to frame buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ShadowMap shadowMap(1024, 1024);
+    // Measures the lit pass, which is where the shadow filter runs
+    GpuTimer lightingTimer;
+    float benchmarkStart = 0.0f;
+    int benchmarkFrame = 0;
 
     glEnable(GL_DEPTH_TEST);
     // Enable gamma correction
@@ -215,7 +215,7 @@ int main()
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
-        auto currentFrame = (float)glfwGetTime();
+        auto currentFrame = gGolden.time();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
@@ -232,9 +232,7 @@ int main()
         depthShader.use();
         depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
         // Draw cubes
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
+        shadowMap.beginDepthPass();
         glBindVertexArray(cubeVAO);
         for (int i = 0; i < 5; ++i) {
             // Compute model transformations for each cube
@@ -249,12 +247,16 @@ int main()
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
         depthShader.setMat4("model", planeModel);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        shadowMap.endDepthPass();
 
         // All the rendering starts from here
         glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, gScreenWidth * 2, gScreenHeight * 2);
+        // The framebuffer is twice the window on a Retina display, the same
+        // size elsewhere
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
 
         // Set up view and projection matrix
         glm::mat4 view = gCamera.GetViewMatrix();
@@ -280,19 +282,20 @@ int main()
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
         // Draw the cubes
+        lightingTimer.begin();
         objectShader.use();
         objectShader.setMat4("view", view);
         objectShader.setMat4("projection", projection);
         objectShader.setVec3("viewPos", gCamera.Position);
         objectShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+        objectShader.setInt("shadowFilter", gShadowFilter);
 
         // Set up material properties
         objectShader.setFloat("material.shininess", 32.0f);
 
         ambientMap.useTextureUnit(0);
         specularMap.useTextureUnit(1);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
+        shadowMap.bindTextures(2, 3);
 
         // Draw cubes
         glBindVertexArray(cubeVAO);
@@ -301,7 +304,7 @@ int main()
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -310,14 +313,39 @@ int main()
         glBindVertexArray(planeVAO);
         planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, 0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        shadowMap.unbindTextures(2, 3);
+        lightingTimer.end();
         // Rendering Ends here
 
+        // Compare the filters by timing each of them for BENCHMARK_FRAMES frames.
+        // The timer's results arrive QUERY_COUNT frames late, so it is only
+        // reset once the frames of the previous filter are all collected.
+        if (gBenchmarkFilter >= 0) {
+            if (benchmarkFrame == 0)
+                gShadowFilter = (ShadowMap::Filter)gBenchmarkFilter;
+            if (benchmarkFrame == GpuTimer::QUERY_COUNT) {
+                lightingTimer.reset();
+                benchmarkStart = currentFrame;
+            }
+            if (++benchmarkFrame == GpuTimer::QUERY_COUNT + BENCHMARK_FRAMES) {
+                std::cout << ShadowMap::filterName(gShadowFilter) << ": "
+                          << lightingTimer.averageMilliseconds() << " ms lit pass (GPU), "
+                          << 1000.0f * (currentFrame - benchmarkStart) / BENCHMARK_FRAMES
+                          << " ms frame" << std::endl;
+                benchmarkFrame = 0;
+                if (++gBenchmarkFilter == ShadowMap::FILTER_COUNT)
+                    gBenchmarkFilter = -1;
+            }
+        }
+
+        if (gGolden.frameDone())
+            break;
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -338,6 +366,7 @@ GLFWwindow *init()
     // For anti-aliasing effects
     glfwWindowHint(GLFW_SAMPLES, 4);
 
+    gGolden.hintWindow(4);
     // Create a window object
     GLFWwindow *window = glfwCreateWindow(800, 600, "Lighting Scene", nullptr, nullptr);
     if (window == nullptr) {
@@ -353,9 +382,12 @@ GLFWwindow *init()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return nullptr;
     }
+    gGolden.begin(window);
 
     // Tell OpenGL the size of rendering window
-    glViewport(0, 0, gScreenWidth * 2, gScreenHeight * 2);
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    glViewport(0, 0, framebufferWidth, framebufferHeight);
 
     // Set the windows resize callback function
     glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
@@ -396,6 +428,20 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
         gFunky = !gFunky;
     }
+
+    // Select a shadow filter, or press B to time all of them
+    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
+        gShadowFilter = ShadowMap::PCF_4TAP;
+    }
+    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
+        gShadowFilter = ShadowMap::POISSON_16;
+    }
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
+        gShadowFilter = ShadowMap::PCSS;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && gBenchmarkFilter < 0) {
+        gBenchmarkFilter = 0;
+    }
 }
 
 void mouseCallback(GLFWwindow *window, double xpos, double ypos)
@@ -4,6 +4,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <thread>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -20,6 +23,15 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "GpuInstanceCuller.h"
+#include "LodSelector.h"
+#include "JobPool.h"
+#include "OcclusionCuller.h"
+#include "Bvh.h"
+#include "FramePipeline.h"
+#include "FrameCapture.h"
+#define ALLOCATIONTRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -29,6 +41,56 @@ float gLastFrame = 0.0f;
 
 Camera gCamera;
 
+// 1 draws every asteroid at full detail, 2 culls them on the GPU, 3 culls
+// them on the CPU and picks a level of detail per asteroid.
+// V checks the GPU culling result against the CPU reference.
+enum DrawMode { DRAW_ALL, DRAW_GPU_CULLED, DRAW_LOD };
+const char *DRAW_MODE_NAMES[] = { "All asteroids", "GPU culled", "CPU culled with LOD" };
+DrawMode gDrawMode = DRAW_GPU_CULLED;
+bool gValidateCulling = false;
+// O also skips the asteroids hidden behind the planet in mode 3
+bool gOcclusionCulling = true;
+// P picks the asteroid in the middle of the screen through the BVH
+bool gPick = false;
+// M sets the asteroids orbiting the planet, every matrix changes each frame
+bool gOrbit = false;
+// T switches between a render thread drawing frame N while the main thread
+// simulates frame N + 1, and simulating and drawing one after the other
+bool gPipelined = true;
+// F12 saves a screenshot, C starts or stops capturing every frame
+bool gScreenshot = false;
+bool gCapture = false;
+
+// Asteroids in the field unless a count is given as the first argument,
+// e.g. AsteroidField 20000 to load the culling and LOD paths
+const int DEFAULT_ASTEROIDS = 500;
+
+// Model matrix columns then normal matrix columns of an asteroid, as the
+// instance stream and the texture buffer of the culled paths read them
+const int INSTANCE_VEC4S = 7;
+
+// Everything the render thread needs to draw one frame
+struct FramePacket {
+    glm::mat4 view, projection;
+    glm::vec3 viewPos, spotLightTarget;
+    int width, height;
+    // Read back into screenshots/ after drawing
+    bool capture;
+    unsigned int frameNumber;
+    int framebufferWidth, framebufferHeight;
+    DrawMode drawMode;
+    bool validateCulling, occlusionCulling;
+    // Interleaved instance data and bounding spheres, only filled in when
+    // the asteroids moved this frame
+    bool instancesMoved;
+    std::vector<glm::vec4> instanceData, spheres;
+    // Visible asteroids sorted by level of detail, in DRAW_LOD
+    std::vector<unsigned int> lodOrder, lodStart;
+    // Simulation side statistics
+    double simulateMilliseconds, occlusionMilliseconds;
+    unsigned long long asteroidsHidden, allocations;
+};
+
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
 GLFWwindow *init();
@@ -39,11 +101,18 @@ void processInput(GLFWwindow *window);
 // Mouse input is handled in this function
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 // Generate a cube map using the 6 file paths in the vector,
 // Sequence: Right, left, top, bottom, back, front
 unsigned int generateCubeMap(std::vector<std::string> facePaths);
-
-int main()
+// Write the INSTANCE_VEC4S vec4s of one asteroid to out
+void packInstance(const glm::mat4 &model, const PackedNormalMatrix &normal, glm::vec4 *out);
+// Set the point light at lightSource, the directional light and the spot
+// light aimed at spotLightTarget, shared by every shader of the scene
+void setSceneLights(Shader &shader, const glm::vec3 &lightSource, const glm::vec3 &lightColor,
+                    const glm::vec3 &spotLightTarget);
+
+int main(int argc, char *argv[])
 {
     GLFWwindow *window = init();
     if (window == nullptr) {
@@ -76,8 +145,14 @@ int main()
     };
     unsigned int skyboxTexture = generateCubeMap(skyboxPaths);
 
-    Model planetModel("models/planet/planet.obj");
-    Model asteroidModel("models/rock/rock.obj");
+    // Every job of the demo runs on this pool: model import, placing and
+    // moving the asteroids, occlusion culling and picking levels of detail
+    JobPool jobs;
+    Model planetModel("models/planet/planet.obj", ModelOptions(&jobs));
+    // Full detail plus three simplified levels
+    ModelOptions asteroidOptions(&jobs);
+    asteroidOptions.lodLevels = 4;
+    Model asteroidModel("models/rock/rock.obj", asteroidOptions);
 
     // Initialize skybox
     float skyboxVertices[] = {
@@ -141,12 +216,15 @@ int main()
 
     // Initialize asteroid field data
     srand((unsigned int)time(nullptr));
-    const int amount = 500;
-    glm::mat4 asteroidMatrices[amount];
+    const int amount = argc > 1 ? std::max(atoi(argv[1]), 1) : DEFAULT_ASTEROIDS;
+    std::vector<glm::mat4> asteroidMatrices(amount);
     std::vector<glm::vec3> asteroidPos;
     std::vector<glm::vec3> asteroidRotationAxis;
     std::vector<float> asteroidAngleOffset;
     std::vector<glm::vec3> asteroidScale;
+    // Radians per second around the planet and around their own axis
+    std::vector<float> asteroidOrbitSpeed;
+    std::vector<float> asteroidSpin;
 
     for (int i = 0; i < amount; ++i) {
         float r = 10.0f, x = ((rand() % 2000) / 100.0f) - 10.0f;
@@ -156,41 +234,193 @@ int main()
         asteroidRotationAxis.emplace_back(rand()%100/100.0f,rand()%100/100.0f,rand()%100/100.0f);
         asteroidAngleOffset.push_back(rand() % 9000 / 100.0f);
         asteroidScale.emplace_back((rand()%300)/1800.0f);
-
-        // Caculate a unique model matrix for every asteroid
-        glm::mat4 model = glm::mat4(1.0f);
+        asteroidOrbitSpeed.push_back(0.02f + rand() % 100 / 2000.0f);
+        asteroidSpin.push_back(0.2f + rand() % 100 / 100.0f);
+    }
+    // Model matrix of asteroid i after orbiting for `time` seconds, the
+    // original placement at 0
+    auto placeAsteroid = [&](size_t i, float time) {
+        glm::mat4 model = glm::rotate(glm::mat4(1.0f), asteroidOrbitSpeed[i] * time, glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::translate(model, asteroidPos[i]);
-        model = glm::rotate(model, glm::radians(asteroidAngleOffset[i]),
+        model = glm::rotate(model, glm::radians(asteroidAngleOffset[i]) + asteroidSpin[i] * time,
                             asteroidRotationAxis[i]);
-        model = glm::scale(model, asteroidScale[i]);
-        asteroidMatrices[i] = model;
-    }
-    // Load the model data into OpenGL
-    unsigned int modelBuffer;
-    glGenBuffers(1, &modelBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, modelBuffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &asteroidMatrices[0], GL_STATIC_DRAW);
+        return glm::scale(model, asteroidScale[i]);
+    };
+    // Caculate a unique model matrix for every asteroid, in parallel now
+    // that the random numbers are drawn
+    jobs.parallelFor(amount, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            asteroidMatrices[i] = placeAsteroid(i, 0.0f);
+    });
+    // Normal matrices are computed here instead of inverting the model
+    // matrix for every vertex
+    std::vector<PackedNormalMatrix> asteroidNormalMatrices(amount);
+    jobs.parallelFor(amount, 1024, [&](size_t begin, size_t end) {
+        computeNormalMatrices(&asteroidMatrices[begin], &asteroidNormalMatrices[begin], end - begin);
+    });
+
+    // Model and normal matrix of every asteroid interleaved, 7 vec4 each.
+    // The same buffer is an instance stream for drawing all asteroids and a
+    // texture buffer the culled paths fetch from, so moving asteroids only
+    // means one upload.
+    std::vector<glm::vec4> instanceData(amount * INSTANCE_VEC4S);
+    for (int i = 0; i < amount; ++i)
+        packInstance(asteroidMatrices[i], asteroidNormalMatrices[i], &instanceData[i * INSTANCE_VEC4S]);
+    unsigned int instanceDataBuffer, instanceDataTexture;
+    glGenBuffers(1, &instanceDataBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceDataBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(glm::vec4), instanceData.data(),
+                 GL_DYNAMIC_DRAW);
     for (int i = 0; i < asteroidModel.meshes.size(); ++i) {
         unsigned int VAO = asteroidModel.meshes[i].VAO;
         glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceDataBuffer);
         GLsizei vec4sz = sizeof(glm::vec4);
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4sz, (void*)0);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4sz, (void*)(vec4sz));
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4sz, (void*)(vec4sz*2));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4sz, (void*)(vec4sz*3));
+        // Model matrix in locations 3 to 6, normal matrix in 7 to 9
+        for (int j = 0; j < INSTANCE_VEC4S; ++j) {
+            glEnableVertexAttribArray(3 + j);
+            glVertexAttribPointer(3 + j, j < 4 ? 4 : 3, GL_FLOAT, GL_FALSE, INSTANCE_VEC4S * vec4sz,
+                                  (void*)(j * vec4sz));
+            glVertexAttribDivisor(3 + j, 1);
+        }
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenTextures(1, &instanceDataTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceDataBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // GPU driven path: asteroid data in the texture buffer, the culling pass
+    // picks the visible ones and fills in the indirect draw commands
+    Shader culledInstanceShader("shaders/AsteroidFieldCulled.vert", "shaders/MultipleLights.frag");
+    culledInstanceShader.use();
+    culledInstanceShader.setInt("material.diffuse", 0);
+    culledInstanceShader.setInt("material.specular", 1);
+    culledInstanceShader.setInt("material.emission", 2);
+    culledInstanceShader.setInt("instanceData", 4);
+
+    // One sphere around all rock meshes, placed by every asteroid matrix
+    glm::vec4 rockSphere = boundingSphere(asteroidModel.meshes[0].vertices);
+    for (unsigned int i = 1; i < asteroidModel.meshes.size(); ++i)
+        rockSphere = mergeSpheres(rockSphere, boundingSphere(asteroidModel.meshes[i].vertices));
+    std::vector<glm::vec4> asteroidSpheres(amount);
+    jobs.parallelFor(amount, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            asteroidSpheres[i] = transformSphere(asteroidMatrices[i], rockSphere);
+    });
+
+    // The BVH is built once, and refitted before a pick when the asteroids
+    // have moved since the last one
+    std::vector<Aabb> asteroidBoxes(amount);
+    auto boxAsteroids = [&]() {
+        for (int i = 0; i < amount; ++i) {
+            glm::vec3 center(asteroidSpheres[i]);
+            asteroidBoxes[i].lo = center - glm::vec3(asteroidSpheres[i].w);
+            asteroidBoxes[i].hi = center + glm::vec3(asteroidSpheres[i].w);
+        }
+    };
+    boxAsteroids();
+    auto bvhStart = std::chrono::high_resolution_clock::now();
+    Bvh asteroidBvh;
+    asteroidBvh.build(asteroidBoxes);
+    double bvhMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - bvhStart).count();
+    bool bvhStale = false;
+    // Asteroids the point light reaches with at least 80% of its strength:
+    // 1 / (1 + 0.022 d + 0.001 d^2) >= 0.8
+    float lightReach = (-0.022f + std::sqrt(0.022f * 0.022f + 4.0f * 0.001f * 0.25f)) / (2.0f * 0.001f);
+    std::vector<unsigned int> litAsteroids;
+    bvhStart = std::chrono::high_resolution_clock::now();
+    asteroidBvh.querySphere(glm::vec4(lightSource, lightReach), litAsteroids);
+    double queryMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - bvhStart).count();
+    std::cout << "BVH over " << amount << " asteroids built in " << bvhMilliseconds << " ms, "
+              << litAsteroids.size() << " asteroids within " << lightReach << " of the light found in "
+              << queryMilliseconds << " ms" << std::endl;
+
+    GpuInstanceCuller *culler = nullptr;
+    std::vector<unsigned int> culledVAOs;
+    if (GpuInstanceCuller::supported()) {
+        std::vector<DrawElementsIndirectCommand> commands;
+        for (unsigned int i = 0; i < asteroidModel.meshes.size(); ++i) {
+            DrawElementsIndirectCommand command = { asteroidModel.meshes[i].lod(0).indexCount, 0, 0, 0, 0 };
+            commands.push_back(command);
+        }
+        culler = new GpuInstanceCuller(asteroidSpheres, commands);
+        // Separate VAOs, the instanced ones above use locations 3 to 9
+        for (unsigned int i = 0; i < asteroidModel.meshes.size(); ++i) {
+            unsigned int VAO;
+            glGenVertexArrays(1, &VAO);
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, asteroidModel.meshes[i].VBO);
+            setVertexAttributes();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asteroidModel.meshes[i].EBO);
+            culler->bindVisibleIndices(4);
+            culledVAOs.push_back(VAO);
+        }
+        glBindVertexArray(0);
+    } else {
+        std::cout << "Indirect draws need OpenGL 4.0, drawing every asteroid" << std::endl;
+        gDrawMode = DRAW_ALL;
+    }
 
-        glVertexAttribDivisor(3, 1);
+    // LOD path: the visible asteroids sorted by level, one instanced draw
+    // per level and mesh. Level 0 down to a 40 pixel radius, then one more
+    // level every time the size halves.
+    unsigned int lodLevels = 1;
+    for (unsigned int i = 0; i < asteroidModel.meshes.size(); ++i)
+        lodLevels = std::max(lodLevels, asteroidModel.meshes[i].lodCount());
+    std::vector<float> lodThresholds;
+    for (unsigned int l = 1; l < lodLevels; ++l)
+        lodThresholds.push_back(40.0f / (1 << (l - 1)));
+    LodSelector lodSelector(amount, lodThresholds);
+    unsigned int lodIndexBuffer;
+    glGenBuffers(1, &lodIndexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, lodIndexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+    std::vector<unsigned int> lodVAOs;
+    for (unsigned int i = 0; i < asteroidModel.meshes.size(); ++i) {
+        unsigned int VAO;
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, asteroidModel.meshes[i].VBO);
+        setVertexAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asteroidModel.meshes[i].EBO);
+        // Pointed at the start of each level before drawing it
+        glBindBuffer(GL_ARRAY_BUFFER, lodIndexBuffer);
+        glEnableVertexAttribArray(4);
+        glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
         glVertexAttribDivisor(4, 1);
-        glVertexAttribDivisor(5, 1);
-        glVertexAttribDivisor(6, 1);
+        lodVAOs.push_back(VAO);
     }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The planet rasterized on the CPU as the only occluder
+    OcclusionCuller occlusionCuller(jobs);
+    std::vector<uint8_t> asteroidVisible;
+
+    std::cout << "Press 1, 2 or 3 to draw all asteroids, cull them on the GPU, or cull them "
+              << "and pick levels of detail on the CPU. V checks GPU culling against the CPU, "
+              << "O toggles occlusion culling by the planet in mode 3, P picks the asteroid in the middle "
+              << "of the screen, M starts or stops the orbits, T switches between drawing on a render "
+              << "thread and drawing right after each simulation step, F12 saves a screenshot and C captures "
+              << "every frame" << std::endl;
+    float orbitTime = 0.0f;
+    unsigned int frameNumber = 0;
+    // Frame N + 1 is simulated while frame N is drawn
+    FramePipeline<FramePacket> pipeline(2);
+
+    // Simulation side of a frame, on the main thread because GLFW input
+    // has to be handled there: input, camera, moving the asteroids,
+    // culling and LOD selection. Fills a packet and makes no GL call.
+    auto simulateFrame = [&](FramePacket &packet) {
+        auto simulateStart = std::chrono::high_resolution_clock::now();
+        // Heap allocations made by a frame (swap and event polling
+        // excluded), which should settle at 0
+        unsigned long long allocationsBefore = heapAllocations();
 
-    // Game loop
-    while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
         auto currentFrame = (float)glfwGetTime();
         gDeltaTime = currentFrame - gLastFrame;
@@ -200,9 +430,119 @@ int main()
         processInput(window);
 
         // Set up view and projection matrix
-        glm::mat4 view = gCamera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom),
-                                                (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
+        packet.view = gCamera.GetViewMatrix();
+        packet.projection = glm::perspective(glm::radians(gCamera.Zoom),
+                                             (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
+        packet.viewPos = gCamera.Position;
+        packet.spotLightTarget = glm::vec3(1.5f*cosf(currentFrame), 0.0f, 1.5f*sinf(currentFrame));
+        packet.width = gScreenWidth;
+        packet.height = gScreenHeight;
+        packet.capture = gCapture || gScreenshot;
+        gScreenshot = false;
+        packet.frameNumber = frameNumber++;
+        glfwGetFramebufferSize(window, &packet.framebufferWidth, &packet.framebufferHeight);
+        packet.drawMode = gDrawMode == DRAW_GPU_CULLED && !culler ? DRAW_ALL : gDrawMode;
+        packet.validateCulling = packet.drawMode == DRAW_GPU_CULLED && gValidateCulling;
+        if (packet.validateCulling)
+            gValidateCulling = false;
+        glm::mat4 viewProjection = packet.projection * packet.view;
+
+        packet.instancesMoved = gOrbit;
+        if (gOrbit) {
+            orbitTime += gDeltaTime;
+            packet.instanceData.resize(amount * INSTANCE_VEC4S);
+            packet.spheres.resize(amount);
+            jobs.parallelFor(amount, 1024, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    asteroidMatrices[i] = placeAsteroid(i, orbitTime);
+                computeNormalMatrices(&asteroidMatrices[begin], &asteroidNormalMatrices[begin], end - begin);
+                for (size_t i = begin; i < end; ++i) {
+                    packInstance(asteroidMatrices[i], asteroidNormalMatrices[i],
+                                 &packet.instanceData[i * INSTANCE_VEC4S]);
+                    asteroidSpheres[i] = transformSphere(asteroidMatrices[i], rockSphere);
+                    packet.spheres[i] = asteroidSpheres[i];
+                }
+            });
+            bvhStale = true;
+        }
+
+        if (gPick) {
+            gPick = false;
+            if (bvhStale) {
+                boxAsteroids();
+                for (int i = 0; i < amount; ++i)
+                    asteroidBvh.update(i, asteroidBoxes[i]);
+                asteroidBvh.refit();
+                bvhStale = false;
+            }
+            glm::vec3 direction = gCamera.GetCursorRay(gScreenWidth * 0.5, gScreenHeight * 0.5,
+                                                       gScreenWidth, gScreenHeight);
+            float distance = 1.0e30f;
+            int picked = asteroidBvh.raycast(gCamera.Position, direction, distance);
+            if (picked < 0)
+                std::cout << "No asteroid under the crosshair" << std::endl;
+            else
+                std::cout << "Picked asteroid " << picked << " at distance " << distance << std::endl;
+        }
+
+        packet.asteroidsHidden = 0;
+        if (packet.drawMode == DRAW_LOD) {
+            const std::vector<uint8_t> *visible = nullptr;
+            if (gOcclusionCulling) {
+                occlusionCuller.beginFrame(viewProjection);
+                for (unsigned int i = 0; i < planetModel.meshes.size(); ++i)
+                    occlusionCuller.addOccluder(planetModel.meshes[i].vertices, planetModel.meshes[i].indices,
+                                                planetModel.meshes[i].lod(0).indexCount, glm::mat4(1.0f));
+                occlusionCuller.render();
+                occlusionCuller.cullSpheres(asteroidSpheres, asteroidVisible);
+                visible = &asteroidVisible;
+            }
+            lodSelector.update(asteroidSpheres, extractFrustum(viewProjection), gCamera.Position,
+                               LodSelector::pixelScale(glm::radians(gCamera.Zoom), gScreenHeight),
+                               packet.lodOrder, packet.lodStart, visible, &jobs);
+            packet.asteroidsHidden = lodSelector.hidden;
+        }
+        packet.occlusionCulling = gOcclusionCulling;
+        packet.occlusionMilliseconds = gOcclusionCulling ? occlusionCuller.renderMilliseconds : 0.0;
+        packet.allocations = heapAllocations() - allocationsBefore;
+        packet.simulateMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - simulateStart).count();
+    };
+
+    // Render side: only reads the packet and issues the GL calls, on
+    // whichever thread has the context
+    int viewportWidth = gScreenWidth, viewportHeight = gScreenHeight;
+    // Spheres the GPU culler has, for validating it
+    std::vector<glm::vec4> culledSpheres = asteroidSpheres;
+    double simulateMilliseconds = 0.0, renderMilliseconds = 0.0;
+    int statsFrames = 0;
+    unsigned long long lodTriangles = 0, asteroidsHidden = 0, frameAllocations = 0;
+    auto statsStart = std::chrono::high_resolution_clock::now();
+    // Reads happen on the render side, the files are written by two
+    // threads of its own
+    FrameCapture *frameCapture = new FrameCapture();
+    unsigned long long capturedBefore = 0;
+    auto renderFrame = [&](const FramePacket &packet, bool onRenderThread) {
+        auto renderStart = std::chrono::high_resolution_clock::now();
+        unsigned long long allocationsBefore = heapAllocations();
+        if (packet.width != viewportWidth || packet.height != viewportHeight) {
+            viewportWidth = packet.width;
+            viewportHeight = packet.height;
+            glViewport(0, 0, viewportWidth, viewportHeight);
+        }
+        if (packet.instancesMoved) {
+            // Respecified rather than overwritten, so the driver does not
+            // wait for draws of the previous frame still reading it
+            glBindBuffer(GL_ARRAY_BUFFER, instanceDataBuffer);
+            glBufferData(GL_ARRAY_BUFFER, packet.instanceData.size() * sizeof(glm::vec4),
+                         packet.instanceData.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            if (culler)
+                culler->updateSpheres(packet.spheres);
+            culledSpheres = packet.spheres;
+        }
+        const glm::mat4 &view = packet.view, &projection = packet.projection;
+        const glm::vec3 &spotLightTarget = packet.spotLightTarget;
 
         // All the rendering starts from here
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -222,91 +562,198 @@ int main()
         glDepthMask(GL_TRUE);
 
         objectShader.use();
-        glm::vec3 spotLightTarget = glm::vec3(1.5f*cosf((float)glfwGetTime()), 0.0f,
-                                              1.5f*sinf((float)glfwGetTime()));
-
         objectShader.setMat4("view", view);
         objectShader.setMat4("projection", projection);
-        objectShader.setVec3("viewPos", gCamera.Position);
+        objectShader.setVec3("viewPos", packet.viewPos);
 
         // Set up material properties
         objectShader.setFloat("material.shininess", 32.0f);
-
-        objectShader.setVec3("light.position", lightSource);
-        objectShader.setVec3("light.ambient", lightColor * glm::vec3(0.3f));
-        objectShader.setVec3("light.diffuse", lightColor * glm::vec3(0.5f));
-        objectShader.setVec3("light.specular", lightColor * glm::vec3(1.0f));
-        objectShader.setFloat("light.constant", 1.0f);
-        objectShader.setFloat("light.linear", 0.022f);
-        objectShader.setFloat("light.quadratic", 0.0010f);
-
-        objectShader.setVec3("dirLight.direction", glm::vec3(-1.0f, -1.0f, 0.0f));
-        objectShader.setVec3("dirLight.ambient", lightColor * glm::vec3(0.05f));
-        objectShader.setVec3("dirLight.diffuse", lightColor * glm::vec3(0.3f));
-        objectShader.setVec3("dirLight.specular", lightColor * glm::vec3(1.0f));
-
-        objectShader.setVec3("spotLight.position", glm::vec3(0.0f, 3.0f, 0.0f));
-        objectShader.setVec3("spotLight.direction", spotLightTarget - glm::vec3(0.0f, 3.0f, 0.0f));
-        objectShader.setVec3("spotLight.ambient", lightColor * glm::vec3(0.1f));
-        objectShader.setVec3("spotLight.diffuse", lightColor * glm::vec3(0.5f));
-        objectShader.setVec3("spotLight.specular", lightColor * glm::vec3(1.0f));
-        objectShader.setFloat("spotLight.constant", 1.0f);
-        objectShader.setFloat("spotLight.linear", 0.022f);
-        objectShader.setFloat("spotLight.quadratic", 0.0010f);
-        objectShader.setFloat("spotLight.innerCone", cosf(glm::radians(15.0f)));
-        objectShader.setFloat("spotLight.outerCone", cosf(glm::radians(20.0f)));
+        setSceneLights(objectShader, lightSource, lightColor, spotLightTarget);
 
         glm::mat4 model = glm::mat4(1.0f);
-        objectShader.setMat4("model", model);
+        objectShader.setModelMatrix(model);
 
         planetModel.Draw(objectShader);
 
         instanceShader.use();
         instanceShader.setMat4("view", view);
         instanceShader.setMat4("projection", projection);
-        instanceShader.setVec3("viewPos", gCamera.Position);
+        instanceShader.setVec3("viewPos", packet.viewPos);
 
         // Set up material properties
         instanceShader.setFloat("material.shininess", 32.0f);
+        setSceneLights(instanceShader, lightSource, lightColor, spotLightTarget);
+
+        if (packet.drawMode == DRAW_ALL) {
+            for(unsigned int i = 0; i < asteroidModel.meshes.size(); i++)
+            {
+                glBindVertexArray(asteroidModel.meshes[i].VAO);
+                glDrawElementsInstanced(
+                        GL_TRIANGLES, asteroidModel.meshes[i].lod(0).indexCount, GL_UNSIGNED_INT, 0, amount
+                );
+            }
+        } else {
+            if (packet.drawMode == DRAW_GPU_CULLED) {
+                culler->cull(projection * view);
+            } else {
+                glBindBuffer(GL_ARRAY_BUFFER, lodIndexBuffer);
+                glBufferData(GL_ARRAY_BUFFER, amount * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, packet.lodOrder.size() * sizeof(GLuint),
+                                packet.lodOrder.data());
+            }
+
+            culledInstanceShader.use();
+            culledInstanceShader.setMat4("view", view);
+            culledInstanceShader.setMat4("projection", projection);
+            culledInstanceShader.setVec3("viewPos", packet.viewPos);
+            culledInstanceShader.setFloat("material.shininess", 32.0f);
+            setSceneLights(culledInstanceShader, lightSource, lightColor, spotLightTarget);
+
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_BUFFER, instanceDataTexture);
+            glActiveTexture(GL_TEXTURE0);
+            if (packet.drawMode == DRAW_GPU_CULLED) {
+                for (unsigned int i = 0; i < culledVAOs.size(); i++) {
+                    glBindVertexArray(culledVAOs[i]);
+                    culler->draw(i);
+                }
+            } else {
+                for (unsigned int i = 0; i < lodVAOs.size(); i++) {
+                    glBindVertexArray(lodVAOs[i]);
+                    for (unsigned int l = 0; l < lodSelector.levelCount(); ++l) {
+                        GLsizei count = (GLsizei)(packet.lodStart[l + 1] - packet.lodStart[l]);
+                        if (count == 0)
+                            continue;
+                        MeshLod lod = asteroidModel.meshes[i].lod(l);
+                        glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint),
+                                               (void*)(packet.lodStart[l] * sizeof(GLuint)));
+                        glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                                                (void*)(lod.firstIndex * sizeof(unsigned int)), count);
+                        lodTriangles += (unsigned long long)count * (lod.indexCount / 3);
+                    }
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+            glBindVertexArray(0);
+
+            if (packet.validateCulling) {
+                std::vector<unsigned int> gpuVisible, cpuVisible;
+                culler->readVisible(gpuVisible);
+                Frustum frustum = extractFrustum(projection * view);
+                cullSpheres(culledSpheres, frustum, cpuVisible);
+                // Spheres within rounding distance of a plane may go either way
+                std::vector<unsigned int> differences;
+                std::set_symmetric_difference(gpuVisible.begin(), gpuVisible.end(),
+                                              cpuVisible.begin(), cpuVisible.end(),
+                                              std::back_inserter(differences));
+                unsigned int mismatches = 0;
+                for (unsigned int i = 0; i < differences.size(); ++i) {
+                    if (std::abs(sphereFrustumDistance(frustum, culledSpheres[differences[i]])) > 1.0e-4f)
+                        ++mismatches;
+                }
+                std::cout << "GPU culling: " << gpuVisible.size() << " visible, CPU reference: "
+                          << cpuVisible.size() << " visible, " << mismatches << " mismatches" << std::endl;
+            }
+        }
 
-        instanceShader.setVec3("light.position", lightSource);
-        instanceShader.setVec3("light.ambient", lightColor * glm::vec3(0.3f));
-        instanceShader.setVec3("light.diffuse", lightColor * glm::vec3(0.5f));
-        instanceShader.setVec3("light.specular", lightColor * glm::vec3(1.0f));
-        instanceShader.setFloat("light.constant", 1.0f);
-        instanceShader.setFloat("light.linear", 0.022f);
-        instanceShader.setFloat("light.quadratic", 0.0010f);
-
-        instanceShader.setVec3("dirLight.direction", glm::vec3(-1.0f, -1.0f, 0.0f));
-        instanceShader.setVec3("dirLight.ambient", lightColor * glm::vec3(0.05f));
-        instanceShader.setVec3("dirLight.diffuse", lightColor * glm::vec3(0.3f));
-        instanceShader.setVec3("dirLight.specular", lightColor * glm::vec3(1.0f));
-
-        instanceShader.setVec3("spotLight.position", glm::vec3(0.0f, 3.0f, 0.0f));
-        instanceShader.setVec3("spotLight.direction", spotLightTarget - glm::vec3(0.0f, 3.0f, 0.0f));
-        instanceShader.setVec3("spotLight.ambient", lightColor * glm::vec3(0.1f));
-        instanceShader.setVec3("spotLight.diffuse", lightColor * glm::vec3(0.5f));
-        instanceShader.setVec3("spotLight.specular", lightColor * glm::vec3(1.0f));
-        instanceShader.setFloat("spotLight.constant", 1.0f);
-        instanceShader.setFloat("spotLight.linear", 0.022f);
-        instanceShader.setFloat("spotLight.quadratic", 0.0010f);
-        instanceShader.setFloat("spotLight.innerCone", cosf(glm::radians(15.0f)));
-        instanceShader.setFloat("spotLight.outerCone", cosf(glm::radians(20.0f)));
-
-        for(unsigned int i = 0; i < asteroidModel.meshes.size(); i++)
-        {
-            glBindVertexArray(asteroidModel.meshes[i].VAO);
-            glDrawElementsInstanced(
-                    GL_TRIANGLES, asteroidModel.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount
-            );
+        // Read back now, written out by the capture threads a frame or two
+        // later
+        if (packet.capture) {
+            char path[64];
+            snprintf(path, sizeof(path), "screenshots/AsteroidField_%05u.png", packet.frameNumber);
+            frameCapture->capture(packet.framebufferWidth, packet.framebufferHeight, path);
+        }
+        frameCapture->poll();
+
+        renderMilliseconds += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - renderStart).count();
+        simulateMilliseconds += packet.simulateMilliseconds;
+        asteroidsHidden += packet.asteroidsHidden;
+        frameAllocations += packet.allocations + heapAllocations() - allocationsBefore;
+        if (++statsFrames == 200) {
+            double seconds = std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - statsStart).count();
+            std::cout << DRAW_MODE_NAMES[packet.drawMode]
+                      << (onRenderThread ? ", render thread: " : ", one thread: ") << statsFrames / seconds
+                      << " frames per second, " << simulateMilliseconds / statsFrames << " ms simulation and "
+                      << renderMilliseconds / statsFrames << " ms GL submission per frame for " << amount
+                      << (packet.instancesMoved ? " moving" : "") << " asteroids";
+            if (onRenderThread) {
+                double simulationWait, renderWait;
+                pipeline.takeWaitTimes(simulationWait, renderWait);
+                std::cout << " (simulation waited " << simulationWait / statsFrames << " ms, render thread "
+                          << renderWait / statsFrames << " ms)";
+            }
+            if (packet.drawMode == DRAW_LOD)
+                std::cout << ", " << lodTriangles / statsFrames << " triangles per frame";
+            if (packet.drawMode == DRAW_LOD && packet.occlusionCulling)
+                std::cout << ", " << asteroidsHidden / statsFrames << " asteroids hidden by the planet ("
+                          << packet.occlusionMilliseconds << " ms to rasterize it)";
+            if (frameCapture->captured() > capturedBefore)
+                std::cout << ", " << frameCapture->captured() - capturedBefore << " frames captured ("
+                          << frameCapture->stalls() << " waits for the GPU, "
+                          << frameCapture->writers().dropped() << " dropped so far)";
+            capturedBefore = frameCapture->captured();
+            std::cout << ", " << frameAllocations / (float)statsFrames << " heap allocations per frame" << std::endl;
+            simulateMilliseconds = renderMilliseconds = 0.0;
+            statsFrames = 0;
+            lodTriangles = 0;
+            asteroidsHidden = 0;
+            frameAllocations = 0;
+            statsStart = std::chrono::high_resolution_clock::now();
         }
+    };
 
-        // Rendering Ends here
+    // The render thread takes the context over while it runs. Swapping is
+    // allowed from any thread, event polling stays on the main thread.
+    std::thread renderThread;
+    auto startRenderThread = [&]() {
+        glfwMakeContextCurrent(nullptr);
+        pipeline.open();
+        renderThread = std::thread([&]() {
+            glfwMakeContextCurrent(window);
+            while (const FramePacket *packet = pipeline.beginRead()) {
+                renderFrame(*packet, true);
+                glfwSwapBuffers(window);
+                pipeline.endRead();
+            }
+            glfwMakeContextCurrent(nullptr);
+        });
+    };
+    // Draws what is still queued, then gives the context back
+    auto stopRenderThread = [&]() {
+        pipeline.close();
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+    };
+    FramePacket serialPacket;
 
-        glfwSwapBuffers(window);
+    // Game loop
+    while (!glfwWindowShouldClose(window)) {
+        if (gPipelined != renderThread.joinable()) {
+            if (gPipelined)
+                startRenderThread();
+            else
+                stopRenderThread();
+        }
+        if (gPipelined) {
+            // Built while the render thread draws the previous frame
+            FramePacket *packet = pipeline.beginWrite();
+            simulateFrame(*packet);
+            pipeline.endWrite();
+        } else {
+            simulateFrame(serialPacket);
+            renderFrame(serialPacket, false);
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
+    if (renderThread.joinable())
+        stopRenderThread();
 
+    frameCapture->finish();
+    delete frameCapture;
+    delete culler;
     glfwTerminate();
     return 0;
 }
@@ -347,15 +794,17 @@ GLFWwindow *init()
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetScrollCallback(window, scrollCallback);
+    glfwSetKeyCallback(window, keyCallback);
 
     return window;
 }
 
 void frameBufferSizeCallback(GLFWwindow *window, int width, int height)
 {
+    // The context may be on the render thread, the viewport follows with
+    // the next frame packet
     gScreenWidth = width;
     gScreenHeight = height;
-    glViewport(0, 0, width, height);
 }
 
 void processInput(GLFWwindow *window)
@@ -405,6 +854,75 @@ void scrollCallback(GLFWwindow *window, double offsetX, double offsetY)
     gCamera.ProcessMouseScroll((float)offsetY);
 }
 
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    if (key >= GLFW_KEY_1 && key <= GLFW_KEY_3) {
+        gDrawMode = (DrawMode)(key - GLFW_KEY_1);
+        std::cout << DRAW_MODE_NAMES[gDrawMode] << std::endl;
+    }
+    if (key == GLFW_KEY_V)
+        gValidateCulling = true;
+    if (key == GLFW_KEY_O) {
+        gOcclusionCulling = !gOcclusionCulling;
+        std::cout << (gOcclusionCulling ? "Occlusion culling on" : "Occlusion culling off") << std::endl;
+    }
+    if (key == GLFW_KEY_P)
+        gPick = true;
+    if (key == GLFW_KEY_M) {
+        gOrbit = !gOrbit;
+        std::cout << (gOrbit ? "Asteroids orbiting" : "Asteroids stopped") << std::endl;
+    }
+    if (key == GLFW_KEY_F12)
+        gScreenshot = true;
+    if (key == GLFW_KEY_C) {
+        gCapture = !gCapture;
+        std::cout << (gCapture ? "Capturing every frame to screenshots/" : "Capture stopped") << std::endl;
+    }
+    if (key == GLFW_KEY_T) {
+        gPipelined = !gPipelined;
+        std::cout << (gPipelined ? "Drawing on a render thread" : "Simulating and drawing on one thread")
+                  << std::endl;
+    }
+}
+
+void packInstance(const glm::mat4 &model, const PackedNormalMatrix &normal, glm::vec4 *out)
+{
+    for (int j = 0; j < 4; ++j)
+        out[j] = model[j];
+    for (int j = 0; j < 3; ++j)
+        out[4 + j] = normal.columns[j];
+}
+
+void setSceneLights(Shader &shader, const glm::vec3 &lightSource, const glm::vec3 &lightColor,
+                    const glm::vec3 &spotLightTarget)
+{
+    shader.setVec3("light.position", lightSource);
+    shader.setVec3("light.ambient", lightColor * glm::vec3(0.3f));
+    shader.setVec3("light.diffuse", lightColor * glm::vec3(0.5f));
+    shader.setVec3("light.specular", lightColor * glm::vec3(1.0f));
+    shader.setFloat("light.constant", 1.0f);
+    shader.setFloat("light.linear", 0.022f);
+    shader.setFloat("light.quadratic", 0.0010f);
+
+    shader.setVec3("dirLight.direction", glm::vec3(-1.0f, -1.0f, 0.0f));
+    shader.setVec3("dirLight.ambient", lightColor * glm::vec3(0.05f));
+    shader.setVec3("dirLight.diffuse", lightColor * glm::vec3(0.3f));
+    shader.setVec3("dirLight.specular", lightColor * glm::vec3(1.0f));
+
+    shader.setVec3("spotLight.position", glm::vec3(0.0f, 3.0f, 0.0f));
+    shader.setVec3("spotLight.direction", spotLightTarget - glm::vec3(0.0f, 3.0f, 0.0f));
+    shader.setVec3("spotLight.ambient", lightColor * glm::vec3(0.1f));
+    shader.setVec3("spotLight.diffuse", lightColor * glm::vec3(0.5f));
+    shader.setVec3("spotLight.specular", lightColor * glm::vec3(1.0f));
+    shader.setFloat("spotLight.constant", 1.0f);
+    shader.setFloat("spotLight.linear", 0.022f);
+    shader.setFloat("spotLight.quadratic", 0.0010f);
+    shader.setFloat("spotLight.innerCone", cosf(glm::radians(15.0f)));
+    shader.setFloat("spotLight.outerCone", cosf(glm::radians(20.0f)));
+}
+
 unsigned int generateCubeMap(std::vector<std::string> facePaths)
 {
     unsigned int tid;
@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <cstring>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -22,6 +24,11 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
+#include "PackedTexture.h"
+#include "FrameArena.h"
+#define ALLOCATIONTRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -42,19 +49,46 @@ void processInput(GLFWwindow *window);
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
 
-int main()
+struct SortedWindow {
+    float distance2;
+    int index;
+};
+
+// World space vertex of the packed batches, with the region of its texture
+struct PackedVertex {
+    glm::vec3 position;
+    glm::vec2 texCoord;
+    int region;
+};
+
+// count vertices of (position, normal, texture coordinate) data placed at
+// model, written to out
+void transformPackedVertices(const float *vertices, int count, const glm::mat4 &model, int region,
+                             PackedVertex *out);
+void appendPackedVertices(std::vector<PackedVertex> &batch, const float *vertices, int count,
+                          const glm::mat4 &model, int region);
+// VAO of a PackedVertex buffer
+unsigned int packedVertexArray(unsigned int VBO);
+
+// Without --unpacked every texture goes into one texture array and the
+// scene is two draw calls: everything opaque, then the sorted windows
+int main(int argc, char *argv[])
 {
+    bool packed = !(argc > 1 && std::strcmp(argv[1], "--unpacked") == 0);
+
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
         return -1;
     }
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture grassTexture("textures/grass.png", TEXTURE_COLOR, &jobs);
+    Texture transparentWindowTexture("textures/blending_transparent_window.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader objectShader("shaders/MultipleLights.vert", "shaders/Discard.frag");
@@ -193,7 +227,93 @@ int main()
     gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
 
     // Game loop
+    // Blended windows, sorted from far to near every frame into a list
+    // from the frame arena
+    const glm::vec3 windowPositions[] = {
+            glm::vec3(3.0f, 0.8f, 0.0f),
+            glm::vec3(3.6f, 0.8f, 0.7f),
+            glm::vec3(4.2f, 0.8f, -0.5f),
+            glm::vec3(-3.0f, 0.8f, 0.4f),
+    };
+    const int windowCount = sizeof(windowPositions) / sizeof(windowPositions[0]);
+
+    // Where everything is, the same every frame
+    const glm::vec3 cubePositions[5] = {
+            glm::vec3(0.0f,  0.5f, 0.0f),
+            glm::vec3(2.0f, 0.5f, 2.0f),
+            glm::vec3(2.0f, 0.5f, -2.0f),
+            glm::vec3(-2.0f, 0.5f, -2.0f),
+            glm::vec3(-2.0f, 0.5, 2.0f),
+    };
+    const glm::vec3 grassPositions[4] = {
+            glm::vec3(2.0f, 0.5f, 0.0f),
+            glm::vec3(0.0f, 0.5f, 2.0f),
+            glm::vec3(-2.0f, 0.5f, 0.0f),
+            glm::vec3(0.0f, 0.5f, -2.0f),
+    };
+    glm::mat4 cubeModels[5], grassModels[16], windowModels[windowCount];
+    for (int i = 0; i < 5; ++i)
+        cubeModels[i] = glm::translate(glm::mat4(1.0f), cubePositions[i]);
+    for (int i = 0; i < 16; ++i) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), grassPositions[i / 4]);
+        model = glm::rotate(model, glm::radians(45.0f) * (i % 4), glm::vec3(0.0f, 1.0f, 0.0f));
+        grassModels[i] = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    }
+    glm::mat4 groundModel = glm::scale(glm::mat4(1.0f), glm::vec3(10.0f));
+    for (int i = 0; i < windowCount; ++i) {
+        windowModels[i] = glm::translate(glm::mat4(1.0f), windowPositions[i]);
+        windowModels[i] = glm::rotate(windowModels[i], glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    // The packed scene: one texture array, the opaque objects baked into
+    // one static buffer and the windows rewritten in sorted order each frame
+    TexturePacker packer;
+    int groundRegion = packer.add("textures/ground.jpg", true);
+    int containerRegion = packer.add("textures/container2.png");
+    // Drawn with the 0.1 alpha test of the opaque batch
+    int grassRegion = packer.add("textures/grass.png", false, 0.1f);
+    int windowRegion = packer.add("textures/blending_transparent_window.png");
+    packer.pack();
+    unsigned int packedTexture = TextureArrayFromPacked(packer);
+    std::cout << packer.regionCount() << " textures packed into " << packer.layerCount() << " layers of "
+              << packer.layerSize() << "x" << packer.layerSize() << ", " << (int)(packer.usage() * 100.0f)
+              << "% used" << std::endl;
+
+    Shader packedShader("shaders/PackedMaterial.vert", "shaders/PackedMaterial.frag");
+    packedShader.use();
+    packedShader.setInt("packedTexture", 0);
+    setPackedRegions(packedShader, packer);
+
+    std::vector<PackedVertex> opaqueVertices;
+    for (int i = 0; i < 5; ++i)
+        appendPackedVertices(opaqueVertices, cubeVertices, 36, cubeModels[i], containerRegion);
+    for (int i = 0; i < 16; ++i)
+        appendPackedVertices(opaqueVertices, planeVertices, 6, grassModels[i], grassRegion);
+    appendPackedVertices(opaqueVertices, groundVertices, 6, groundModel, groundRegion);
+    size_t opaqueVertexCount = opaqueVertices.size();
+    unsigned int opaqueVBO;
+    glGenBuffers(1, &opaqueVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, opaqueVBO);
+    glBufferData(GL_ARRAY_BUFFER, opaqueVertices.size() * sizeof(PackedVertex), opaqueVertices.data(),
+                 GL_STATIC_DRAW);
+    unsigned int opaqueVAO = packedVertexArray(opaqueVBO);
+
+    PackedVertex windowVertices[windowCount * 6];
+    unsigned int windowVBO;
+    glGenBuffers(1, &windowVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, windowVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(windowVertices), nullptr, GL_DYNAMIC_DRAW);
+    unsigned int windowVAO = packedVertexArray(windowVBO);
+
+    int drawCalls = 0, textureBinds = 0;
+    FrameArena frameArena(64 * 1024);
+    unsigned long long frameAllocations = 0;
+    int statsFrames = 0;
+
     while (!glfwWindowShouldClose(window)) {
+        frameArena.beginFrame();
+        unsigned long long allocationsBefore = heapAllocations();
+
         // Calculate how much time since last frame
         auto currentFrame = (float)glfwGetTime();
         gDeltaTime = currentFrame - gLastFrame;
@@ -211,95 +331,123 @@ int main()
         glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom),
                                                 (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
 
-        // Draw the cubes
-        objectShader.use();
-        objectShader.setMat4("view", view);
-        objectShader.setMat4("projection", projection);
-        objectShader.setVec3("viewPos", gCamera.Position);
-
-        ambientMap.useTextureUnit(0);
-        specularMap.useTextureUnit(1);
-
-        // Draw cubes
-        glm::vec3 cubePositions[5] = {
-                glm::vec3(0.0f,  0.5f, 0.0f),
-                glm::vec3(2.0f, 0.5f, 2.0f),
-                glm::vec3(2.0f, 0.5f, -2.0f),
-                glm::vec3(-2.0f, 0.5f, -2.0f),
-                glm::vec3(-2.0f, 0.5, 2.0f),
-        };
-        glBindVertexArray(cubeVAO);
-        for (int i = 0; i < 5; ++i) {
-            // Compute model transformations for each cube
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-
-            objectShader.setMat4("model", model);
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        // The transparent windows must be drawn in the last so that all other objects can be blended with
+        // them. Also, since multiple transparent windows are involved, we MUST sort them and draw them
+        // from farther to nearest to avoid depth testing issues.
+        FrameVector<SortedWindow> sortedWindows = frameArena.vector<SortedWindow>();
+        sortedWindows.reserve(windowCount);
+        for (int i = 0; i < windowCount; ++i) {
+            glm::vec3 d = windowPositions[i] - gCamera.Position;
+            SortedWindow entry = { glm::dot(d, d), i };
+            sortedWindows.push_back(entry);
         }
+        std::sort(sortedWindows.begin(), sortedWindows.end(),
+                  [](const SortedWindow &a, const SortedWindow &b) { return a.distance2 > b.distance2; });
+
+        drawCalls = 0;
+        textureBinds = 0;
+        if (packed) {
+            packedShader.use();
+            packedShader.setMat4("view", view);
+            packedShader.setMat4("projection", projection);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, packedTexture);
+            ++textureBinds;
+
+            // Cubes, grass and ground
+            packedShader.setFloat("alphaCutoff", 0.1f);
+            glBindVertexArray(opaqueVAO);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)opaqueVertexCount);
+            ++drawCalls;
+
+            // The windows, written far to near into their buffer
+            for (unsigned int i = 0; i < sortedWindows.size(); ++i) {
+                transformPackedVertices(planeVertices, 6, windowModels[sortedWindows[i].index], windowRegion,
+                                        &windowVertices[i * 6]);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, windowVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(windowVertices), windowVertices);
+            packedShader.setFloat("alphaCutoff", 0.0f);
+            glBindVertexArray(windowVAO);
+            glDrawArrays(GL_TRIANGLES, 0, windowCount * 6);
+            ++drawCalls;
+        } else {
+            // Draw the cubes
+            objectShader.use();
+            objectShader.setMat4("view", view);
+            objectShader.setMat4("projection", projection);
+            objectShader.setVec3("viewPos", gCamera.Position);
+
+            ambientMap.useTextureUnit(0);
+            specularMap.useTextureUnit(1);
+            textureBinds += 2;
+
+            // Draw cubes
+            glBindVertexArray(cubeVAO);
+            for (int i = 0; i < 5; ++i) {
+                objectShader.setModelMatrix(cubeModels[i]);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                ++drawCalls;
+            }
 
-        // Start to draw planes
-        // Draw grasses
-        glm::vec3 grassPositions[4] = {
-                glm::vec3(2.0f, 0.5f, 0.0f),
-                glm::vec3(0.0f, 0.5f, 2.0f),
-                glm::vec3(-2.0f, 0.5f, 0.0f),
-                glm::vec3(0.0f, 0.5f, -2.0f),
-        };
-        glBindVertexArray(planeVAO);
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                glm::mat4 model = glm::mat4(1.0f);
-
-                model = glm::translate(model, grassPositions[i]);
-                model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-                objectShader.setMat4("model", model);
-                grassTexture.useTextureUnit(0);
-                // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
-                // from interpolating near texture borders
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            // Start to draw planes
+            // Draw grasses
+            glBindVertexArray(planeVAO);
+            for (int i = 0; i < 4; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    objectShader.setModelMatrix(grassModels[i * 4 + j]);
+                    grassTexture.useTextureUnit(0);
+                    // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
+                    // from interpolating near texture borders
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                    ++textureBinds;
+                    ++drawCalls;
+                }
+            }
+
+            // Draw the ground
+            glBindVertexArray(groundVAO);
+            objectShader.use();
+            objectShader.setModelMatrix(groundModel);
+            groundTexture.useTextureUnit(0);
+            // Use 0 to set the active texture to default texture
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            textureBinds += 3;
+            ++drawCalls;
+
+            glBindVertexArray(planeVAO);
+            transparentWindowShader.use();
+            transparentWindowShader.setMat4("view", view);
+            transparentWindowShader.setMat4("projection", projection);
+            transparentWindowShader.setVec3("viewPos", gCamera.Position);
+            transparentWindowTexture.useTextureUnit(0);
+            ++textureBinds;
+            for (unsigned int i = 0; i < sortedWindows.size(); ++i) {
+                transparentWindowShader.setModelMatrix(windowModels[sortedWindows[i].index]);
                 glDrawArrays(GL_TRIANGLES, 0, 6);
+                ++drawCalls;
             }
         }
 
-        // Draw the ground
-        glBindVertexArray(groundVAO);
-        glm::mat4 planeModel = glm::mat4(1.0f);
-        planeModel = glm::scale(planeModel, glm::vec3(10.0f));
-        objectShader.use();
-        objectShader.setMat4("model", planeModel);
-        groundTexture.useTextureUnit(0);
-        // Use 0 to set the active texture to default texture
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // Draw the transparent window
-        // It must be drawn in the last so that all other objects can be blended with them
-        // Also, if multiple transparent windows are involved, we MUST sort them and draw them
-        // from farther to nearest to avoid depth testing issues.
-        glBindVertexArray(planeVAO);
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.8f, 0.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        transparentWindowShader.use();
-        transparentWindowShader.setMat4("view", view);
-        transparentWindowShader.setMat4("projection", projection);
-        transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
-        transparentWindowTexture.useTextureUnit(0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
         // Rendering Ends here
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        frameAllocations += heapAllocations() - allocationsBefore;
+        if (++statsFrames == 200) {
+            std::cout << drawCalls << " draw calls and " << textureBinds << " texture binds per frame, "
+                      << frameAllocations / (float)statsFrames << " heap allocations per frame, "
+                      << frameArena.arena().used() << " bytes from the frame arena" << std::endl;
+            frameAllocations = 0;
+            statsFrames = 0;
+        }
     }
 
     glfwTerminate();
@@ -397,4 +545,38 @@ void mouseCallback(GLFWwindow *window, double xpos, double ypos)
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY)
 {
     gCamera.ProcessMouseScroll((float)offsetY);
+}
+
+void transformPackedVertices(const float *vertices, int count, const glm::mat4 &model, int region,
+                             PackedVertex *out)
+{
+    for (int i = 0; i < count; ++i) {
+        const float *vertex = vertices + i * 8;
+        out[i].position = glm::vec3(model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+        out[i].texCoord = glm::vec2(vertex[6], vertex[7]);
+        out[i].region = region;
+    }
+}
+
+void appendPackedVertices(std::vector<PackedVertex> &batch, const float *vertices, int count,
+                          const glm::mat4 &model, int region)
+{
+    batch.resize(batch.size() + count);
+    transformPackedVertices(vertices, count, model, region, &batch[batch.size() - count]);
+}
+
+unsigned int packedVertexArray(unsigned int VBO)
+{
+    unsigned int VAO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoord));
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(3, 1, GL_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, region));
+    glEnableVertexAttribArray(3);
+    glBindVertexArray(0);
+    return VAO;
 }
\ No newline at end of file
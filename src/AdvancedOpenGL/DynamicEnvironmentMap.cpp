@@ -20,6 +20,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -61,11 +62,13 @@ int main()
     };
     unsigned int skyboxTexture = generateCubeMap(skyboxPaths);
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture grassTexture("textures/grass.png", TEXTURE_COLOR, &jobs);
+    Texture transparentWindowTexture("textures/blending_transparent_window.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader objectShader("shaders/MultipleLights.vert", "shaders/Discard.frag");
@@ -313,7 +316,7 @@ int main()
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -335,7 +338,7 @@ int main()
                 model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
                 model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-                objectShader.setMat4("model", model);
+                objectShader.setModelMatrix(model);
                 grassTexture.useTextureUnit(0);
                 // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
                 // from interpolating near texture borders
@@ -350,7 +353,7 @@ int main()
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
         objectShader.use();
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
@@ -371,7 +374,7 @@ int main()
         transparentWindowShader.setMat4("view", view);
         transparentWindowShader.setMat4("projection", projection);
         transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
+        transparentWindowShader.setModelMatrix(model);
         transparentWindowTexture.useTextureUnit(0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
@@ -19,7 +19,12 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Camera.h"
+#include "GoldenRun.h"
 #include "Texture.h"
+#include "OcclusionCuller.h"
+#include "JobPool.h"
+#define ALLOCATIONTRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -28,13 +33,16 @@ float gDeltaTime = 0.0f;
 float gLastFrame = 0.0f;
 
 Camera gCamera;
+// Fixed time runs that write a reference image, see GoldenRun.h
+GoldenRun gGolden;
 
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
 GLFWwindow *init();
-// Do all the rendering stuff to the specific framebuffer
+// Do all the rendering stuff to the specific framebuffer. withReflectiveBox
+// tells the occlusion culler the reflective box is drawn afterwards.
 // returns -1 on error
-int render(unsigned int framebuffer, Camera *camera, int width, int height);
+int render(unsigned int framebuffer, Camera *camera, int width, int height, bool withReflectiveBox = false);
 // Sometimes user might resize the window. so the OpenGL viewport should be adjusted as well.
 void frameBufferSizeCallback(GLFWwindow *window, int width, int height);
 // User input is handled in this function
@@ -42,6 +50,7 @@ void processInput(GLFWwindow *window);
 // Mouse input is handled in this function
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 // Generate a cube map using the 6 file paths in the vector,
 // Sequence: Right, left, top, bottom, back, front
 unsigned int generateCubeMap(std::vector<std::string> facePaths);
@@ -69,8 +78,17 @@ Shader *dynamicRefractionShader;
 
 unsigned int cubeVAO, groundVAO, planeVAO, skyboxVAO;
 
-int main()
+// The cubes are rasterized on the CPU and hide the cubes, grass and window
+// behind them in every pass. O toggles it.
+JobPool *jobs;
+OcclusionCuller *occlusionCuller;
+bool gOcclusionCulling = true;
+float *occluderCubeVertices;
+unsigned int gDrawsTested = 0, gDrawsSkipped = 0;
+
+int main(int argc, char *argv[])
 {
+    gGolden.parse(argc, argv);
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
@@ -78,11 +96,13 @@ int main()
     }
 
     skyboxTexture            = generateCubeMap(skyboxPaths);
-    groundTexture            = new Texture("textures/ground.jpg");
-    ambientMap               = new Texture("textures/container2.png");
-    specularMap              = new Texture("textures/container2_specular.png");
-    grassTexture             = new Texture("textures/grass.png");
-    transparentWindowTexture = new Texture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures, and later culls the scene
+    jobs = new JobPool();
+    groundTexture            = new Texture("textures/ground.jpg", TEXTURE_COLOR, jobs);
+    ambientMap               = new Texture("textures/container2.png", TEXTURE_COLOR, jobs);
+    specularMap              = new Texture("textures/container2_specular.png", TEXTURE_SPECULAR, jobs);
+    grassTexture             = new Texture("textures/grass.png", TEXTURE_COLOR, jobs);
+    transparentWindowTexture = new Texture("textures/blending_transparent_window.png", TEXTURE_COLOR, jobs);
 
     objectShader            = new Shader("shaders/MultipleLights.vert", "shaders/Discard.frag");
     transparentWindowShader = new Shader("shaders/MultipleLights.vert", "shaders/BasicFrag.frag");
@@ -298,36 +318,54 @@ int main()
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, gGolden.framebuffer());
+
+    occlusionCuller = new OcclusionCuller(*jobs);
+    occluderCubeVertices = cubeVertices;
+    std::cout << "Press O to toggle occlusion culling" << std::endl;
+    int statsFrames = 0;
 
     gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
 
+    // The cube map cameras never move, set them up once
+    Camera camPos[6] = {
+            Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0.0f),         //posX
+            Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 180.0f),       //negX
+            Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0.0f, 90.0f),  //posY
+            Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0.0f, -90.0f), //negY
+            Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 90.0f),        //posZ
+            Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), -90.0f),       //negZ
+    };
+    for (unsigned int i = 0; i < 6; ++i)
+        camPos[i].Zoom = 90.0f;
+    unsigned long long frameAllocations = 0;
+
     // Game loop
     while (!glfwWindowShouldClose(window)) {
+        unsigned long long allocationsBefore = heapAllocations();
+
         // Calculate how much time since last frame
-        auto currentFrame = (float)glfwGetTime();
+        auto currentFrame = gGolden.time();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
         // Handle user input
         processInput(window);
 
-        Camera camPos[6] = {
-                Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0.0f),         //posX
-                Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 180.0f),       //negX
-                Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0.0f, 90.0f),  //posY
-                Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0.0f, -90.0f), //negY
-                Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), 90.0f),        //posZ
-                Camera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), -90.0f),       //negZ
-        };
         for (unsigned int i = 0; i < 6; ++i)
-        {
-            camPos[i].Zoom = 90.0f;
             render(framebuffers[i], &camPos[i], 1024, 1024);
-        }
 
         // Render to default framebuffer
-        render(0, &gCamera, gScreenWidth, gScreenHeight);
+        render(gGolden.framebuffer(), &gCamera, gScreenWidth, gScreenHeight, true);
+        if (++statsFrames == 200) {
+            std::cout << (gOcclusionCulling ? "Occlusion culling: " : "No occlusion culling: ")
+                      << gDrawsSkipped / (float)statsFrames << " of " << gDrawsTested / (float)statsFrames
+                      << " draws skipped per frame, " << frameAllocations / (float)statsFrames
+                      << " heap allocations per frame" << std::endl;
+            statsFrames = 0;
+            gDrawsTested = gDrawsSkipped = 0;
+            frameAllocations = 0;
+        }
 
         // Draw the reflective box
         glBindVertexArray(cubeVAO);
@@ -337,7 +375,7 @@ int main()
         glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom),
                                                 (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
         dynamicRefractionShader->use();
-        dynamicRefractionShader->setMat4("model", model);
+        dynamicRefractionShader->setModelMatrix(model);
         dynamicRefractionShader->setMat4("view", view);
         dynamicRefractionShader->setMat4("projection", projection);
         dynamicRefractionShader->setVec3("viewPos", gCamera.Position);
@@ -347,15 +385,30 @@ int main()
         glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapColorBuffer);
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
+        if (gGolden.frameDone())
+            break;
         glfwSwapBuffers(window);
         glfwPollEvents();
+        frameAllocations += heapAllocations() - allocationsBefore;
     }
 
+    delete occlusionCuller;
+    delete jobs;
     glfwTerminate();
     return 0;
 }
 
-int render(unsigned int framebuffer, Camera *camera, int width, int height)
+// Tell whether a world space box may be visible in the current pass
+bool mayBeVisible(const glm::vec3 &center, const glm::vec3 &extent)
+{
+    ++gDrawsTested;
+    if (!gOcclusionCulling || occlusionCuller->boxVisible(center - extent, center + extent))
+        return true;
+    ++gDrawsSkipped;
+    return false;
+}
+
+int render(unsigned int framebuffer, Camera *camera, int width, int height, bool withReflectiveBox)
 {
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     glViewport(0, 0, width, height);
@@ -401,13 +454,26 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
             glm::vec3(-2.0f, 0.5f, -2.0f),
             glm::vec3(-2.0f, 0.5, 2.0f),
     };
+    if (gOcclusionCulling) {
+        // The cube data is not wound consistently, so two sided
+        occlusionCuller->beginFrame(projection * view);
+        for (int i = 0; i < 5; ++i)
+            occlusionCuller->addOccluder(occluderCubeVertices, 8 * sizeof(float), nullptr, 36,
+                                         glm::translate(glm::mat4(1.0f), cubePositions[i]), true);
+        if (withReflectiveBox)
+            occlusionCuller->addOccluder(occluderCubeVertices, 8 * sizeof(float), nullptr, 36,
+                                         glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f)), true);
+        occlusionCuller->render();
+    }
     glBindVertexArray(cubeVAO);
     for (int i = 0; i < 5; ++i) {
+        if (!mayBeVisible(cubePositions[i], glm::vec3(0.5f)))
+            continue;
         // Compute model transformations for each cube
         model = glm::mat4(1.0f);
         model = glm::translate(model, cubePositions[i]);
 
-        objectShader->setMat4("model", model);
+        objectShader->setModelMatrix(model);
 
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
@@ -422,6 +488,9 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
     };
     glBindVertexArray(planeVAO);
     for (int i = 0; i < 4; ++i) {
+        // The four planes of a bunch turn around its center
+        if (!mayBeVisible(grassPositions[i], glm::vec3(0.5f)))
+            continue;
         for (int j = 0; j < 4; ++j) {
             model = glm::mat4(1.0f);
 
@@ -429,7 +498,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
             model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
             model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-            objectShader->setMat4("model", model);
+            objectShader->setModelMatrix(model);
             grassTexture->useTextureUnit(0);
             // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
             // from interpolating near texture borders
@@ -444,7 +513,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
     model = glm::mat4(1.0f);
     model = glm::scale(model, glm::vec3(10.0f));
     objectShader->use();
-    objectShader->setMat4("model", model);
+    objectShader->setModelMatrix(model);
     groundTexture->useTextureUnit(0);
     // Use 0 to set the active texture to default texture
     glActiveTexture(GL_TEXTURE1);
@@ -457,6 +526,8 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
     // It must be drawn in the last so that all other objects can be blended with them
     // Also, if multiple transparent windows are involved, we MUST sort them and draw them
     // from farther to nearest to avoid depth testing issues.
+    if (!mayBeVisible(glm::vec3(3.0f, 0.8f, 0.0f), glm::vec3(0.5f)))
+        return 0;
     glBindVertexArray(planeVAO);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(3.0f, 0.8f, 0.0f));
@@ -465,7 +536,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
     transparentWindowShader->setMat4("view", view);
     transparentWindowShader->setMat4("projection", projection);
     transparentWindowShader->setVec3("viewPos", camera->Position);
-    transparentWindowShader->setMat4("model", model);
+    transparentWindowShader->setModelMatrix(model);
     transparentWindowTexture->useTextureUnit(0);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
@@ -480,6 +551,7 @@ GLFWwindow *init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    gGolden.hintWindow();
     // Create a window object
     GLFWwindow *window = glfwCreateWindow(800, 600, "Simple Scene", nullptr, nullptr);
     if (window == nullptr) {
@@ -495,6 +567,7 @@ GLFWwindow *init()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return nullptr;
     }
+    gGolden.begin(window);
 
     // Tell OpenGL the size of rendering window
     glViewport(0, 0, gScreenWidth, gScreenHeight);
@@ -506,6 +579,7 @@ GLFWwindow *init()
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetScrollCallback(window, scrollCallback);
+    glfwSetKeyCallback(window, keyCallback);
 
     return window;
 }
@@ -592,4 +666,12 @@ unsigned int generateCubeMap(std::vector<std::string> facePaths)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     return tid;
-}
\ No newline at end of file
+}
+
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+        gOcclusionCulling = !gOcclusionCulling;
+        std::cout << (gOcclusionCulling ? "Occlusion culling on" : "Occlusion culling off") << std::endl;
+    }
+}
@@ -20,6 +20,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -78,11 +79,13 @@ int main()
     }
 
     skyboxTexture            = generateCubeMap(skyboxPaths);
-    groundTexture            = new Texture("textures/ground.jpg");
-    ambientMap               = new Texture("textures/container2.png");
-    specularMap              = new Texture("textures/container2_specular.png");
-    grassTexture             = new Texture("textures/grass.png");
-    transparentWindowTexture = new Texture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    groundTexture            = new Texture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    ambientMap               = new Texture("textures/container2.png", TEXTURE_COLOR, &jobs);
+    specularMap              = new Texture("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    grassTexture             = new Texture("textures/grass.png", TEXTURE_COLOR, &jobs);
+    transparentWindowTexture = new Texture("textures/blending_transparent_window.png", TEXTURE_COLOR, &jobs);
 
     objectShader            = new Shader("shaders/MultipleLights.vert", "shaders/Discard.frag");
     transparentWindowShader = new Shader("shaders/MultipleLights.vert", "shaders/BasicFrag.frag");
@@ -337,7 +340,7 @@ int main()
         glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom),
                                                 (float)gScreenWidth / gScreenHeight, 0.1f, 100.0f);
         dynamicRefractionShader->use();
-        dynamicRefractionShader->setMat4("model", model);
+        dynamicRefractionShader->setModelMatrix(model);
         dynamicRefractionShader->setMat4("view", view);
         dynamicRefractionShader->setMat4("projection", projection);
         dynamicRefractionShader->setVec3("viewPos", gCamera.Position);
@@ -407,7 +410,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
         model = glm::mat4(1.0f);
         model = glm::translate(model, cubePositions[i]);
 
-        objectShader->setMat4("model", model);
+        objectShader->setModelMatrix(model);
 
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
@@ -429,7 +432,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
             model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
             model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-            objectShader->setMat4("model", model);
+            objectShader->setModelMatrix(model);
             grassTexture->useTextureUnit(0);
             // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
             // from interpolating near texture borders
@@ -444,7 +447,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
     model = glm::mat4(1.0f);
     model = glm::scale(model, glm::vec3(10.0f));
     objectShader->use();
-    objectShader->setMat4("model", model);
+    objectShader->setModelMatrix(model);
     groundTexture->useTextureUnit(0);
     // Use 0 to set the active texture to default texture
     glActiveTexture(GL_TEXTURE1);
@@ -465,7 +468,7 @@ int render(unsigned int framebuffer, Camera *camera, int width, int height)
     transparentWindowShader->setMat4("view", view);
     transparentWindowShader->setMat4("projection", projection);
     transparentWindowShader->setVec3("viewPos", camera->Position);
-    transparentWindowShader->setMat4("model", model);
+    transparentWindowShader->setModelMatrix(model);
     transparentWindowTexture->useTextureUnit(0);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
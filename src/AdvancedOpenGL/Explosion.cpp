@@ -20,6 +20,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -56,7 +57,8 @@ int main()
     objectShader.setInt("material.specular", 1);
     objectShader.setInt("material.emission", 2);
 
-    Model nanosuitModel("models/nanosuit/nanosuit.obj");
+    JobPool jobs;
+    Model nanosuitModel("models/nanosuit/nanosuit.obj", ModelOptions(&jobs));
 
     glEnable(GL_DEPTH_TEST);
 
@@ -122,7 +124,7 @@ int main()
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.1f));
-        objectShader.setMat4("model", model);
+        objectShader.setModelMatrix(model);
 
         nanosuitModel.Draw(objectShader);
 
@@ -20,6 +20,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -51,10 +52,12 @@ int main()
         return -1;
     }
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture emissionMap("textures/container2_emission.jpg");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture emissionMap("textures/container2_emission.jpg", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     // Load light source shader
@@ -284,7 +287,7 @@ int main()
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -293,7 +296,7 @@ int main()
         glBindVertexArray(planeVAO);
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cstdio>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -23,6 +24,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -64,11 +66,13 @@ int main()
     };
     unsigned int skyboxTexture = generateCubeMap(skyboxPaths);
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture grassTexture("textures/grass.png", TEXTURE_COLOR, &jobs);
+    Texture transparentWindowTexture("textures/blending_transparent_window.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader objectShader("shaders/Instancing.vert", "shaders/Discard.frag");
@@ -315,7 +319,11 @@ int main()
             // Compute model transformations for each cube
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
-            objectShader.setMat4("model[" + std::to_string(i) + "]" , model);
+            char name[32];
+            snprintf(name, sizeof(name), "model[%d]", i);
+            objectShader.setMat4(name, model);
+            snprintf(name, sizeof(name), "normalMatrix[%d]", i);
+            objectShader.setMat3(name, normalMatrix(model));
         }
         glBindVertexArray(cubeVAO);
         glDrawArraysInstanced(GL_TRIANGLES, 0, 36, 5);
@@ -337,7 +345,7 @@ int main()
                 model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
                 model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-                objectShader.setMat4("model", model);
+                objectShader.setModelMatrix(model);
                 grassTexture.useTextureUnit(0);
                 // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
                 // from interpolating near texture borders
@@ -352,7 +360,7 @@ int main()
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
         objectShader.use();
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
@@ -373,7 +381,7 @@ int main()
         transparentWindowShader.setMat4("view", view);
         transparentWindowShader.setMat4("projection", projection);
         transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
+        transparentWindowShader.setModelMatrix(model);
         transparentWindowTexture.useTextureUnit(0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
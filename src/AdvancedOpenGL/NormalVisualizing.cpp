@@ -16,6 +16,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -54,7 +55,8 @@ int main()
     Shader normalVectorShader("shaders/VisualizingNormal.vert", "shaders/VisualizingNormal.frag",
                                 "shaders/VisualizingNormal.geom");
 
-    Model nanosuitModel("models/nanosuit/nanosuit.obj");
+    JobPool jobs;
+    Model nanosuitModel("models/nanosuit/nanosuit.obj", ModelOptions(&jobs));
 
     glEnable(GL_DEPTH_TEST);
 
@@ -120,14 +122,14 @@ int main()
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.1f));
-        objectShader.setMat4("model", model);
+        objectShader.setModelMatrix(model);
 
         nanosuitModel.Draw(objectShader);
 
         normalVectorShader.use();
         normalVectorShader.setMat4("view", view);
         normalVectorShader.setMat4("projection", projection);
-        normalVectorShader.setMat4("model", model);
+        normalVectorShader.setModelMatrix(model);
         nanosuitModel.Draw(normalVectorShader);
         // Rendering Ends here
 
@@ -22,6 +22,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -62,8 +63,9 @@ int main()
     objectShader.setInt("material.specular", 1);
     objectShader.setInt("material.emission", 2);
 
-    Model nanosuitModel("models/nanosuit/nanosuit.obj");
-    Model nanosuitWireFrame("models/nanosuit/nanosuit.obj");
+    JobPool jobs;
+    Model nanosuitModel("models/nanosuit/nanosuit.obj", ModelOptions(&jobs));
+    Model nanosuitWireFrame("models/nanosuit/nanosuit.obj", ModelOptions(&jobs));
 
     gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
     glm::vec3 lightSource = glm::vec3(1.2f, 0.5f, 1.0f);
@@ -119,7 +121,7 @@ int main()
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::scale(model, glm::vec3(0.1f));
-        objectShader.setMat4("model", model);
+        objectShader.setModelMatrix(model);
 
         // Draw original object
         glStencilFunc(GL_ALWAYS, 1, 0xFF);
@@ -1,8 +1,12 @@
 //
-// Created by hehao on 18-2-7.
+// All the post processing effects in one program.
+// Toggle effects with keys 1-6, see gEffects below.
+// --effects Blur,GrayScale picks the effects to start with, "none" for none.
+// [ and ] halve and double the blur radius.
 //
 
 #include <iostream>
+#include <string>
 #include <algorithm>
 
 // GLM Math Library
@@ -19,7 +23,11 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Camera.h"
+#include "GoldenRun.h"
 #include "Texture.h"
+#include "JobPool.h"
+#include "PostProcessChain.h"
+#include "BlurEffect.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -28,6 +36,36 @@ float gDeltaTime = 0.0f;
 float gLastFrame = 0.0f;
 
 Camera gCamera;
+// Fixed time runs that write a reference image, see GoldenRun.h
+GoldenRun gGolden;
+
+// Effects in the order they are applied. Pixel effects that end up next to
+// each other are fused into a single pass by PostProcessChain.
+enum EffectKind {
+    PIXEL_EFFECT,
+    SHADER_EFFECT,
+    // The Gaussian blur, see BlurEffect.h
+    BLUR_EFFECT
+};
+struct EffectOption {
+    const char *name;
+    EffectKind kind;
+    // GLSL snippet for pixel effects, fragment shader path for shader effects
+    const char *source;
+    bool enabled;
+};
+EffectOption gEffects[] = {
+        { "Sharpen", SHADER_EFFECT, "shaders/ScreenShaderKernelEffect.frag", false },
+        { "Blur", BLUR_EFFECT, nullptr, false },
+        { "EdgeDetection", SHADER_EFFECT, "shaders/ScreenShaderEdgeDetection.frag", false },
+        { "Inversion", PIXEL_EFFECT, "color = 1.0 - color;", true },
+        { "GrayScale", PIXEL_EFFECT, "color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));", false },
+        { "Contrast", PIXEL_EFFECT, "color = clamp((color - 0.5) * 1.4 + 0.5, 0.0, 1.0);", false },
+};
+const int EFFECT_COUNT = sizeof(gEffects) / sizeof(gEffects[0]);
+bool gEffectsChanged = true;
+// Blur radius in framebuffer pixels
+float gBlurRadius = 8.0f;
 
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
@@ -39,20 +77,30 @@ void processInput(GLFWwindow *window);
 // Mouse input is handled in this function
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
+// Keys 1-6 toggle the effects, [ and ] change the blur radius
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-int main()
+int main(int argc, char *argv[])
 {
+    gGolden.parse(argc, argv);
+    if (const char *effects = gGolden.option("effects")) {
+        std::string list = std::string(",") + effects + ",";
+        for (int i = 0; i < EFFECT_COUNT; ++i)
+            gEffects[i].enabled = list.find(std::string(",") + gEffects[i].name + ",") != std::string::npos;
+    }
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
         return -1;
     }
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture grassTexture("textures/grass.png", TEXTURE_COLOR, &jobs);
+    Texture transparentWindowTexture("textures/blending_transparent_window.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader objectShader("shaders/MultipleLights.vert", "shaders/Discard.frag");
@@ -67,10 +115,6 @@ int main()
     transparentWindowShader.setInt("material.specular", 1);
     transparentWindowShader.setInt("material.emission", 2);
 
-    Shader screenShader("shaders/ScreenShaderDefault.vert", "shaders/ScreenShaderBlur.frag");
-    screenShader.use();
-    screenShader.setInt("screenTexture", 0);
-
     // A set of cubeVertices to describe a cube(with normal vectors)
     float cubeVertices[] = {
             // positions          // normals           // texture coords
@@ -187,69 +231,22 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6*sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
-    float quadVertices[] = {
-            // positions   // texCoords
-            -1.0f,  1.0f,  0.0f, 1.0f,
-            -1.0f, -1.0f,  0.0f, 0.0f,
-            1.0f, -1.0f,  1.0f, 0.0f,
-
-            -1.0f,  1.0f,  0.0f, 1.0f,
-            1.0f, -1.0f,  1.0f, 0.0f,
-            1.0f,  1.0f,  1.0f, 1.0f
-    };
-    unsigned int quadVBO;
-    glGenBuffers(1, &quadVBO);
-    unsigned int quadVAO;
-    glGenVertexArrays(1, &quadVAO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2*sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Initialize a customized frame buffer
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    // Generate texture;
-    unsigned int texColorBuffer;
-    glGenTextures(1, &texColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, gScreenWidth, gScreenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Attach it to currently bind framebuffer
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
-
-    // Create a render buffer object to store depth and stencil buffer
-    unsigned int RBO;
-    glGenRenderbuffers(1, &RBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, RBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, gScreenWidth, gScreenHeight);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    // Bind the render buffer object to framebuffer
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, RBO);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cout << "Error: Incomplete framebuffer!" << std::endl;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // The scene is rendered into the chain, which then runs the enabled effects
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    PostProcessChain postProcess(framebufferWidth, framebufferHeight);
+    BlurEffect blur(gBlurRadius);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     gCamera.Position = glm::vec3(0.0f, 1.5f, 3.0f);
 
+    int timedFrames = 0;
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
-        auto currentFrame = (float)glfwGetTime();
+        auto currentFrame = gGolden.time();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
@@ -258,8 +255,30 @@ int main()
 
         // All the rendering starts from here
 
+        if (gEffectsChanged) {
+            postProcess.clearEffects();
+            for (int i = 0; i < EFFECT_COUNT; ++i) {
+                if (!gEffects[i].enabled)
+                    continue;
+                if (gEffects[i].kind == PIXEL_EFFECT)
+                    postProcess.addPixelEffect(gEffects[i].name, gEffects[i].source);
+                else if (gEffects[i].kind == SHADER_EFFECT)
+                    postProcess.addShaderEffect(gEffects[i].name, gEffects[i].source);
+                else
+                    postProcess.addCustomEffect(gEffects[i].name, &blur);
+            }
+            gEffectsChanged = false;
+            timedFrames = 0;
+        }
+        if (blur.radius != gBlurRadius) {
+            blur.radius = gBlurRadius;
+            timedFrames = 0;
+        }
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        postProcess.resize(framebufferWidth, framebufferHeight);
+
         // We change to the custom framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        postProcess.beginScene();
         glEnable(GL_DEPTH_TEST);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -292,7 +311,7 @@ int main()
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -314,7 +333,7 @@ int main()
                 model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
                 model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-                objectShader.setMat4("model", model);
+                objectShader.setModelMatrix(model);
                 grassTexture.useTextureUnit(0);
                 // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
                 // from interpolating near texture borders
@@ -329,7 +348,7 @@ int main()
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
         objectShader.use();
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
@@ -350,22 +369,21 @@ int main()
         transparentWindowShader.setMat4("view", view);
         transparentWindowShader.setMat4("projection", projection);
         transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
+        transparentWindowShader.setModelMatrix(model);
         transparentWindowTexture.useTextureUnit(0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
-
-        screenShader.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        postProcess.apply();
         // Rendering Ends here
 
+        if (++timedFrames == 300) {
+            std::cout << "Post processing GPU time per pass:" << std::endl;
+            postProcess.printTimings();
+            timedFrames = 0;
+        }
+
+        if (gGolden.frameDone())
+            break;
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -382,8 +400,9 @@ GLFWwindow *init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    gGolden.hintWindow();
     // Create a window object
-    GLFWwindow *window = glfwCreateWindow(800, 600, "Lighting Scene", nullptr, nullptr);
+    GLFWwindow *window = glfwCreateWindow(800, 600, "Post Processing", nullptr, nullptr);
     if (window == nullptr) {
         std::cout << "Failed to create GLFW window!" << std::endl;
         glfwTerminate();
@@ -397,6 +416,7 @@ GLFWwindow *init()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return nullptr;
     }
+    gGolden.begin(window);
 
     // Tell OpenGL the size of rendering window
     glViewport(0, 0, gScreenWidth, gScreenHeight);
@@ -408,6 +428,7 @@ GLFWwindow *init()
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetScrollCallback(window, scrollCallback);
+    glfwSetKeyCallback(window, keyCallback);
 
     return window;
 }
@@ -464,4 +485,20 @@ void mouseCallback(GLFWwindow *window, double xpos, double ypos)
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY)
 {
     gCamera.ProcessMouseScroll((float)offsetY);
+}
+
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    int index = key - GLFW_KEY_1;
+    if (index >= 0 && index < EFFECT_COUNT) {
+        gEffects[index].enabled = !gEffects[index].enabled;
+        gEffectsChanged = true;
+    }
+    if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) {
+        gBlurRadius = key == GLFW_KEY_LEFT_BRACKET ? std::max(gBlurRadius * 0.5f, 1.0f)
+                                                   : std::min(gBlurRadius * 2.0f, 256.0f);
+        std::cout << "Blur radius: " << gBlurRadius << " px" << std::endl;
+    }
 }
\ No newline at end of file
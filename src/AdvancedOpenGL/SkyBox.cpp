@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <memory>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -19,7 +20,10 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Camera.h"
+#include "GoldenRun.h"
 #include "Texture.h"
+#include "TextureStreamer.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -28,6 +32,8 @@ float gDeltaTime = 0.0f;
 float gLastFrame = 0.0f;
 
 Camera gCamera;
+// Fixed time runs that write a reference image, see GoldenRun.h
+GoldenRun gGolden;
 
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
@@ -43,8 +49,9 @@ void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
 // Sequence: Right, left, top, bottom, back, front
 unsigned int generateCubeMap(std::vector<std::string> facePaths);
 
-int main()
+int main(int argc, char *argv[])
 {
+    gGolden.parse(argc, argv);
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
@@ -59,13 +66,23 @@ int main()
             "textures/TropicalSunnyDay/TropicalSunnyDayFront2048.png",
             "textures/TropicalSunnyDay/TropicalSunnyDayBack2048.png",
     };
-    unsigned int skyboxTexture = generateCubeMap(skyboxPaths);
+    // --stream MB streams the sky box in from the texture cache with that much GPU memory
+    JobPool jobs;
+    std::unique_ptr<TextureStreamer> streamer;
+    int skybox = -1;
+    if (gGolden.option("stream")) {
+        streamer.reset(new TextureStreamer((size_t)std::max(atoi(gGolden.option("stream")), 1) << 20, jobs));
+        skybox = streamer->addCubeMap(skyboxPaths);
+    }
+    unsigned int skyboxTexture = skybox >= 0 ? streamer->id(skybox) : generateCubeMap(skyboxPaths);
+    float frameTimeSum = 0.0f, worstFrameTime = 0.0f;
+    int streamFrames = 0;
 
-    Texture groundTexture("textures/ground.jpg");
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture grassTexture("textures/grass.png");
-    Texture transparentWindowTexture("textures/blending_transparent_window.png");
+    Texture groundTexture("textures/ground.jpg", TEXTURE_COLOR, &jobs);
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture grassTexture("textures/grass.png", TEXTURE_COLOR, &jobs);
+    Texture transparentWindowTexture("textures/blending_transparent_window.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader objectShader("shaders/MultipleLights.vert", "shaders/Discard.frag");
@@ -262,7 +279,7 @@ int main()
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
-        auto currentFrame = (float)glfwGetTime();
+        auto currentFrame = gGolden.time();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
@@ -287,7 +304,7 @@ int main()
         glDepthMask(GL_FALSE);
         glBindVertexArray(skyBoxVAO);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, skyboxTexture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glDepthMask(GL_TRUE);
 
@@ -314,7 +331,7 @@ int main()
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -336,7 +353,7 @@ int main()
                 model = glm::rotate(model, glm::radians(45.0f) * j, glm::vec3(0.0f, 1.0f, 0.0f));
                 model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-                objectShader.setMat4("model", model);
+                objectShader.setModelMatrix(model);
                 grassTexture.useTextureUnit(0);
                 // We set current texture to GL_CLAMP_TO_EDGE to prevent artifacts around the edge
                 // from interpolating near texture borders
@@ -351,7 +368,7 @@ int main()
         glm::mat4 planeModel = glm::mat4(1.0f);
         planeModel = glm::scale(planeModel, glm::vec3(10.0f));
         objectShader.use();
-        objectShader.setMat4("model", planeModel);
+        objectShader.setModelMatrix(planeModel);
         groundTexture.useTextureUnit(0);
         // Use 0 to set the active texture to default texture
         glActiveTexture(GL_TEXTURE1);
@@ -372,12 +389,33 @@ int main()
         transparentWindowShader.setMat4("view", view);
         transparentWindowShader.setMat4("projection", projection);
         transparentWindowShader.setVec3("viewPos", gCamera.Position);
-        transparentWindowShader.setMat4("model", model);
+        transparentWindowShader.setModelMatrix(model);
         transparentWindowTexture.useTextureUnit(0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
+        if (skybox >= 0) {
+            // The faces are one unit away and two units wide, so half a texture coordinate per unit
+            streamer->request(skybox, mipForDistance(0.5f, streamer->size(skybox), 1.0f,
+                                                     screenPixelsPerUnit(gScreenHeight, glm::radians(gCamera.Zoom))));
+            streamer->update();
+            frameTimeSum += gDeltaTime;
+            worstFrameTime = std::max(worstFrameTime, gDeltaTime);
+            if (++streamFrames == 200) {
+                const MipResidency &residency = streamer->state();
+                std::cout << "Sky box: level " << residency.residentLevel(skybox) << ", "
+                          << residency.residentBytes() / (1024.0 * 1024.0) << " MB resident of "
+                          << residency.budgetBytes() / (1024.0 * 1024.0) << " MB; frames "
+                          << frameTimeSum / streamFrames * 1000.0f << " ms average, " << worstFrameTime * 1000.0f
+                          << " ms worst" << std::endl;
+                frameTimeSum = worstFrameTime = 0.0f;
+                streamFrames = 0;
+            }
+        }
+
         // Rendering Ends here
 
+        if (gGolden.frameDone())
+            break;
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -398,6 +436,7 @@ GLFWwindow *init()
     // Enable anti-aliasing
     glfwWindowHint(GLFW_SAMPLES, 4);
 
+    gGolden.hintWindow(4);
     // Create a window object
     GLFWwindow *window = glfwCreateWindow(800, 600, "Lighting Scene", nullptr, nullptr);
     if (window == nullptr) {
@@ -413,6 +452,7 @@ GLFWwindow *init()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return nullptr;
     }
+    gGolden.begin(window);
 
     // Tell OpenGL the size of rendering window
     glViewport(0, 0, gScreenWidth, gScreenHeight);
@@ -0,0 +1,126 @@
+//
+// Level of detail for the asteroid field, without an OpenGL context:
+//   - builds the LOD chain of the rock (or the OBJ given as the first
+//     argument) and checks every generated level only uses valid, distinct
+//     corners,
+//   - flies a camera through a ring of 100k asteroids and counts the
+//     triangles submitted per frame when drawing everything at full detail,
+//     after frustum culling, and after culling plus LOD selection,
+//   - counts LOD switches per frame with and without hysteresis.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MeshSimplifier.h"
+#include "LodSelector.h"
+#include "BenchCommon.h"
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "models/rock/rock.obj";
+    const int amount = argc > 2 ? atoi(argv[2]) : 100000;
+    const int frames = 200;
+
+    std::vector<BenchVertex> vertices;
+    std::vector<unsigned int> indices;
+    if (!loadObj(path, vertices, indices)) {
+        std::cout << "Failed to open " << path << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<MeshLod> lods = generateLods(vertices, indices, 4);
+    double lodMs = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+
+    bool failed = false;
+    std::cout << path << ": " << lods.size() << " levels in " << lodMs << " ms" << std::endl;
+    for (unsigned int l = 0; l < lods.size(); ++l) {
+        unsigned int bad = 0;
+        // Level 0 is the input as it is
+        unsigned int end = l > 0 ? lods[l].firstIndex + lods[l].indexCount : 0;
+        for (unsigned int i = lods[l].firstIndex; i < end; i += 3) {
+            unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (a >= vertices.size() || b >= vertices.size() || c >= vertices.size() ||
+                vertices[a].position == vertices[b].position || vertices[b].position == vertices[c].position ||
+                vertices[c].position == vertices[a].position)
+                ++bad;
+        }
+        std::cout << "  LOD" << l << ": " << lods[l].indexCount / 3 << " triangles, error "
+                  << lods[l].error << std::endl;
+        if (bad) {
+            std::cout << "  " << bad << " invalid triangles" << std::endl;
+            failed = true;
+        }
+    }
+
+    // Ring of asteroids around the origin, like AsteroidField
+    srand(1);
+    glm::vec4 meshSphere = boundingSphere(vertices);
+    std::vector<glm::vec4> spheres(amount);
+    for (int i = 0; i < amount; ++i) {
+        float angle = (float)i / amount * 360.0f;
+        float radius = 150.0f;
+        glm::vec3 pos(std::sin(glm::radians(angle)) * radius + randomFloat(-25.0f, 25.0f),
+                      randomFloat(-2.5f, 2.5f),
+                      std::cos(glm::radians(angle)) * radius + randomFloat(-25.0f, 25.0f));
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+        model = glm::rotate(model, randomFloat(0.0f, 6.28f), glm::vec3(0.4f, 0.6f, 0.8f));
+        model = glm::scale(model, glm::vec3(randomFloat(0.05f, 0.25f)));
+        spheres[i] = transformSphere(model, meshSphere);
+    }
+
+    std::vector<float> thresholds;
+    for (unsigned int l = 1; l < lods.size(); ++l)
+        thresholds.push_back(40.0f / (1 << (l - 1)));
+    LodSelector selector(amount, thresholds, 0.15f), noHysteresis(amount, thresholds, 0.0f);
+    const float fovy = glm::radians(45.0f);
+    const float pixelScale = LodSelector::pixelScale(fovy, 1080);
+    glm::mat4 projection = glm::perspective(fovy, 1920.0f / 1080.0f, 0.1f, 1000.0f);
+
+    double fullTriangles = 0.0, culledTriangles = 0.0, lodTriangles = 0.0, selectMs = 0.0;
+    unsigned long long switches = 0, switchesWithout = 0;
+    std::vector<unsigned int> order, levelStart, order2, levelStart2;
+    for (int f = 0; f < frames; ++f) {
+        // Fly along the ring, looking ahead and a little inwards
+        float angle = glm::radians(f * 0.25f);
+        glm::vec3 eye(std::sin(angle) * 160.0f, 3.0f, std::cos(angle) * 160.0f);
+        glm::vec3 ahead(std::sin(angle + 0.3f) * 140.0f, 0.0f, std::cos(angle + 0.3f) * 140.0f);
+        glm::mat4 view = glm::lookAt(eye, ahead, glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = extractFrustum(projection * view);
+
+        auto selectStart = std::chrono::high_resolution_clock::now();
+        selector.update(spheres, frustum, eye, pixelScale, order, levelStart);
+        selectMs += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - selectStart).count();
+        noHysteresis.update(spheres, frustum, eye, pixelScale, order2, levelStart2);
+        // The first frame only sets up the levels
+        if (f > 0) {
+            switches += selector.switches;
+            switchesWithout += noHysteresis.switches;
+        }
+
+        fullTriangles += (double)amount * (lods[0].indexCount / 3);
+        culledTriangles += (double)order.size() * (lods[0].indexCount / 3);
+        for (unsigned int l = 0; l < lods.size(); ++l)
+            lodTriangles += (double)(levelStart[l + 1] - levelStart[l]) * (lods[l].indexCount / 3);
+    }
+
+    std::cout << amount << " asteroids, " << frames << " frames at 1080p" << std::endl;
+    std::cout << "  full detail:      " << fullTriangles / frames / 1.0e6 << " M triangles/frame" << std::endl;
+    std::cout << "  frustum culled:   " << culledTriangles / frames / 1.0e6 << " M triangles/frame" << std::endl;
+    std::cout << "  culled + LOD:     " << lodTriangles / frames / 1.0e6 << " M triangles/frame ("
+              << fullTriangles / std::max(lodTriangles, 1.0) << "x fewer than full detail, "
+              << culledTriangles / std::max(lodTriangles, 1.0) << "x fewer than culled)" << std::endl;
+    std::cout << "  selection:        " << selectMs / frames << " ms/frame" << std::endl;
+    std::cout << "  LOD switches:     " << (double)switches / (frames - 1) << " per frame with hysteresis, "
+              << (double)switchesWithout / (frames - 1) << " without" << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+//
+// Helpers the benchmarks share: timing, random numbers and a small OBJ
+// loader for the meshes under models/, so they run without assimp.
+//
+
+#ifndef PROJECT_BENCHCOMMON_H
+#define PROJECT_BENCHCOMMON_H
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+inline double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// In [lo, hi) in steps of 1/10000 of the range, from rand() so srand
+// makes runs repeat
+inline float randomFloat(float lo, float hi)
+{
+    return lo + (hi - lo) * (rand() % 10000) / 10000.0f;
+}
+
+// What the mesh code under include/ reads from a vertex. tangent is the
+// packed tangent of TangentSpace.h, 0 until generated.
+struct BenchVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+    uint32_t tangent;
+};
+
+// Triangles of an OBJ file, faces fanned out. Every corner is a vertex of
+// its own unless joinIdentical, then corners with the same v/vt/vn share
+// one, like assimp's aiProcess_JoinIdenticalVertices.
+inline bool loadObj(const char *path, std::vector<BenchVertex> &vertices, std::vector<unsigned int> &indices,
+                    bool joinIdentical = false)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::map<std::string, unsigned int> corners;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string type;
+        in >> type;
+        if (type == "v") {
+            glm::vec3 p;
+            in >> p.x >> p.y >> p.z;
+            positions.push_back(p);
+        } else if (type == "vn") {
+            glm::vec3 n;
+            in >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        } else if (type == "vt") {
+            glm::vec2 t;
+            in >> t.x >> t.y;
+            texCoords.push_back(glm::vec2(t.x, 1.0f - t.y));
+        } else if (type == "f") {
+            std::vector<unsigned int> face;
+            std::string corner;
+            while (in >> corner) {
+                auto found = joinIdentical ? corners.find(corner) : corners.end();
+                if (found == corners.end()) {
+                    BenchVertex v;
+                    int p = 0, t = 0, n = 0;
+                    sscanf(corner.c_str(), "%d/%d/%d", &p, &t, &n);
+                    v.position = positions[p - 1];
+                    v.texCoord = t > 0 ? texCoords[t - 1] : glm::vec2(0.0f);
+                    v.normal = n > 0 ? normals[n - 1] : glm::vec3(0.0f, 1.0f, 0.0f);
+                    v.tangent = 0;
+                    if (joinIdentical)
+                        corners[corner] = (unsigned int)vertices.size();
+                    face.push_back((unsigned int)vertices.size());
+                    vertices.push_back(v);
+                } else {
+                    face.push_back(found->second);
+                }
+            }
+            for (unsigned int i = 2; i < face.size(); ++i) {
+                indices.push_back(face[0]);
+                indices.push_back(face[i - 1]);
+                indices.push_back(face[i]);
+            }
+        }
+    }
+    return true;
+}
+
+#endif //PROJECT_BENCHCOMMON_H
@@ -0,0 +1,87 @@
+//
+// Checks the GPU blur passes against an exact Gaussian on the CPU.
+// Radii that run at full resolution must match to float precision, the
+// downsampled path is reported as PSNR against the exact blur. Also prints
+// the texture fetches per pixel of both, which is what the GPU pays for.
+// Does not need an OpenGL context.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+
+#include "BlurKernel.h"
+
+// Noise, hard edges and a few small bright spots, the worst case for a blur
+CpuImage makeTestImage(int width, int height)
+{
+    srand(1);
+    CpuImage image(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float checker = ((x / 32 + y / 32) % 2) ? 0.8f : 0.2f;
+            float noise = rand() % 1000 / 1000.0f;
+            image.at(x, y) = glm::vec3(checker, 0.7f * checker + 0.3f * noise, noise);
+        }
+    }
+    for (int i = 0; i < 20; ++i)
+        image.at(rand() % width, rand() % height) = glm::vec3(1.0f);
+    return image;
+}
+
+// Fetches per output pixel of the GPU path
+int gpuFetches(float radius)
+{
+    int levels = BlurKernel::pyramidLevels(radius);
+    BlurKernel kernel = BlurKernel::linearSampled((int)std::ceil(radius / (1 << levels)));
+    float fetches = 2.0f * (2 * kernel.offsets.size() - 1) / (1 << (2 * levels));
+    for (int i = 1; i <= levels; ++i)
+        fetches += 5.0f / (1 << (2 * i)) + 8.0f / (1 << (2 * (i - 1)));
+    return (int)std::ceil(fetches);
+}
+
+int main()
+{
+    // Odd sizes on purpose, the offsets must follow the real texture size
+    const int sizes[2][2] = { { 640, 360 }, { 333, 251 } };
+    const float radii[] = { 1.0f, 3.0f, 8.0f, 16.0f, 32.0f, 64.0f };
+    // Minimum PSNR of the downsampled path against the exact Gaussian
+    const double minPSNR = 30.0;
+    bool failed = false;
+
+    for (int s = 0; s < 2; ++s) {
+        CpuImage image = makeTestImage(sizes[s][0], sizes[s][1]);
+        std::cout << sizes[s][0] << "x" << sizes[s][1] << std::endl;
+        for (float radius : radii) {
+            CpuImage reference = blurReference(image, (int)radius);
+            CpuImage result = blurPyramid(image, radius);
+            int levels = BlurKernel::pyramidLevels(radius);
+
+            std::cout << "  radius " << std::setw(3) << radius << ": "
+                      << std::setw(3) << 2 * (2 * (int)radius + 1) << " -> "
+                      << std::setw(2) << gpuFetches(radius) << " fetches per pixel, ";
+            if (levels == 0) {
+                float maxError = 0.0f;
+                for (unsigned int i = 0; i < result.pixels.size(); ++i) {
+                    glm::vec3 d = glm::abs(result.pixels[i] - reference.pixels[i]);
+                    maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
+                }
+                std::cout << "max error " << maxError << std::endl;
+                if (maxError > 1.0e-4f)
+                    failed = true;
+            } else {
+                double psnr = imagePSNR(result, reference);
+                std::cout << levels << " levels, " << psnr << " dB" << std::endl;
+                if (psnr < minPSNR)
+                    failed = true;
+            }
+        }
+    }
+    if (failed) {
+        std::cout << "Mismatch against the reference Gaussian" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+// BVH over the boxes of 1M asteroids (the count can be given as the first
+// argument), without an OpenGL context:
+//   - SAH build time and cost,
+//   - every asteroid orbits a little each frame: refit time, and how far
+//     the cost of the refitted tree drifts from a rebuilt one,
+//   - frustum, sphere and ray queries, checked against testing every box
+//     and timed against it.
+//
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bvh.h"
+#include "BenchCommon.h"
+
+bool boxInFrustum(const Frustum &frustum, const Aabb &box)
+{
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4 &plane = frustum.planes[p];
+        glm::vec3 corner(plane.x >= 0.0f ? box.hi.x : box.lo.x, plane.y >= 0.0f ? box.hi.y : box.lo.y,
+                         plane.z >= 0.0f ? box.hi.z : box.lo.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool boxTouchesSphere(const Aabb &box, const glm::vec4 &sphere)
+{
+    glm::vec3 c(sphere);
+    glm::vec3 d = glm::max(glm::max(box.lo - c, c - box.hi), glm::vec3(0.0f));
+    return glm::dot(d, d) <= sphere.w * sphere.w;
+}
+
+// Entry distance of the ray into the box, negative for a miss
+float rayBox(const glm::vec3 &origin, const glm::vec3 &direction, const Aabb &box)
+{
+    float enter = 0.0f, exit = 1.0e30f;
+    for (int i = 0; i < 3; ++i) {
+        float inverse = 1.0f / (std::fabs(direction[i]) > 1.0e-20f ? direction[i] : 1.0e-20f);
+        float t0 = (box.lo[i] - origin[i]) * inverse, t1 = (box.hi[i] - origin[i]) * inverse;
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter <= exit ? enter : -1.0f;
+}
+
+int main(int argc, char *argv[])
+{
+    const int amount = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int frames = 10;
+
+    // Ring of asteroids like AsteroidLod, each orbiting at its own speed
+    srand(1);
+    std::vector<float> angles(amount), radii(amount), heights(amount), speeds(amount), sizes(amount);
+    std::vector<Aabb> boxes(amount);
+    for (int i = 0; i < amount; ++i) {
+        angles[i] = randomFloat(0.0f, 6.2832f);
+        radii[i] = 150.0f + randomFloat(-25.0f, 25.0f);
+        heights[i] = randomFloat(-2.5f, 2.5f);
+        // Radians per frame, a full orbit takes 2 to 10 minutes at 60 fps
+        speeds[i] = randomFloat(0.00017f, 0.00087f);
+        sizes[i] = randomFloat(0.05f, 0.25f);
+    }
+    auto place = [&](int i) {
+        glm::vec3 center(std::sin(angles[i]) * radii[i], heights[i], std::cos(angles[i]) * radii[i]);
+        boxes[i].lo = center - glm::vec3(sizes[i]);
+        boxes[i].hi = center + glm::vec3(sizes[i]);
+    };
+    for (int i = 0; i < amount; ++i)
+        place(i);
+
+    Bvh bvh;
+    auto start = std::chrono::high_resolution_clock::now();
+    bvh.build(boxes);
+    double buildMs = millisecondsSince(start);
+    float builtCost = bvh.sahCost();
+    std::cout << amount << " asteroids: " << bvh.nodes.size() << " nodes of " << sizeof(BvhNode)
+              << " bytes, built in " << buildMs << " ms, SAH cost " << builtCost << std::endl;
+
+    double refitMs = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int i = 0; i < amount; ++i) {
+            angles[i] += speeds[i];
+            place(i);
+            bvh.update(i, boxes[i]);
+        }
+        start = std::chrono::high_resolution_clock::now();
+        bvh.refit();
+        refitMs += millisecondsSince(start);
+    }
+    float refitCost = bvh.sahCost();
+    Bvh rebuilt;
+    rebuilt.build(boxes);
+    std::cout << "  refit: " << refitMs / frames << " ms per frame, after " << frames
+              << " frames of orbiting the cost is " << refitCost << " against " << rebuilt.sahCost()
+              << " rebuilt" << std::endl;
+
+    bool failed = false;
+    unsigned int wrong = 0;
+    double bvhMs[3] = {}, linearMs[3] = {};
+    size_t found[3] = {};
+    const int queries = 20;
+    std::vector<unsigned int> result, expected;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    for (int q = 0; q < queries; ++q) {
+        float angle = randomFloat(0.0f, 6.2832f);
+        glm::vec3 eye(std::sin(angle) * 150.0f, randomFloat(-1.0f, 1.0f), std::cos(angle) * 150.0f);
+        glm::vec3 direction = glm::normalize(glm::vec3(std::cos(angle), randomFloat(-0.05f, 0.05f),
+                                                       -std::sin(angle)));
+
+        // Frustum along the ring
+        Frustum frustum = extractFrustum(projection * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+        start = std::chrono::high_resolution_clock::now();
+        bvh.queryFrustum(frustum, result);
+        bvhMs[0] += millisecondsSince(start);
+        start = std::chrono::high_resolution_clock::now();
+        expected.clear();
+        for (int i = 0; i < amount; ++i) {
+            if (boxInFrustum(frustum, boxes[i]))
+                expected.push_back(i);
+        }
+        linearMs[0] += millisecondsSince(start);
+        std::sort(result.begin(), result.end());
+        wrong += result != expected;
+        found[0] += result.size();
+
+        // Light of radius 5 next to the camera
+        glm::vec4 light(eye + direction * 3.0f, 5.0f);
+        start = std::chrono::high_resolution_clock::now();
+        bvh.querySphere(light, result);
+        bvhMs[1] += millisecondsSince(start);
+        start = std::chrono::high_resolution_clock::now();
+        expected.clear();
+        for (int i = 0; i < amount; ++i) {
+            if (boxTouchesSphere(boxes[i], light))
+                expected.push_back(i);
+        }
+        linearMs[1] += millisecondsSince(start);
+        std::sort(result.begin(), result.end());
+        wrong += result != expected;
+        found[1] += result.size();
+
+        // Pick along the view direction
+        float t = 1.0e30f;
+        start = std::chrono::high_resolution_clock::now();
+        int picked = bvh.raycast(eye, direction, t);
+        bvhMs[2] += millisecondsSince(start);
+        start = std::chrono::high_resolution_clock::now();
+        int nearest = -1;
+        float nearestT = 1.0e30f;
+        for (int i = 0; i < amount; ++i) {
+            float hit = rayBox(eye, direction, boxes[i]);
+            if (hit >= 0.0f && hit < nearestT) {
+                nearestT = hit;
+                nearest = i;
+            }
+        }
+        linearMs[2] += millisecondsSince(start);
+        if ((picked < 0) != (nearest < 0) || (nearest >= 0 && std::fabs(t - nearestT) > 1.0e-4f * nearestT))
+            ++wrong;
+        found[2] += picked >= 0;
+    }
+    if (wrong) {
+        std::cout << wrong << " queries differ from testing every box" << std::endl;
+        failed = true;
+    }
+    const char *names[3] = { "frustum", "sphere", "ray" };
+    for (int k = 0; k < 3; ++k) {
+        std::cout << "  " << names[k] << " query: " << bvhMs[k] / queries << " ms, every box: "
+                  << linearMs[k] / queries << " ms, " << (double)found[k] / queries
+                  << (k == 2 ? " hits" : " objects") << " on average" << std::endl;
+    }
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+//
+// Frame arena and allocation tracking, without an OpenGL context.
+//   - LinearArena keeps alignment, falls back to the heap when full and
+//     grows on the next reset so the same frame then fits,
+//   - FrameArena keeps last frame's data intact while this frame is built,
+//   - a steady state AsteroidField style frame (Hi-Z occlusion of 20k
+//     asteroids by a sphere, LOD selection on a job pool, an arena list
+//     of the asteroids in the frustum) makes no heap allocation once the
+//     camera has gone round once,
+// and times per frame containers from the heap against the arena.
+//
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrameArena.h"
+#include "OcclusionCuller.h"
+#include "LodSelector.h"
+#include "InstanceCulling.h"
+#include "JobPool.h"
+#define ALLOCATIONTRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
+#include "BenchCommon.h"
+
+void uvSphere(float radius, int rings, int segments, std::vector<BenchVertex> &vertices,
+              std::vector<unsigned int> &indices)
+{
+    for (int r = 0; r <= rings; ++r) {
+        float phi = 3.14159265f * r / rings;
+        for (int s = 0; s <= segments; ++s) {
+            float theta = 6.2831853f * s / segments;
+            glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            BenchVertex v = { radius * normal, normal, glm::vec2(0.0f), 0 };
+            vertices.push_back(v);
+        }
+    }
+    // Counter clockwise seen from outside
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+            unsigned int quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+bool checkArena()
+{
+    bool ok = true;
+    LinearArena arena(256);
+    for (int i = 0; i < 16; ++i) {
+        size_t alignment = (size_t)1 << (i % 5);
+        uintptr_t p = (uintptr_t)arena.allocate(3 + i, alignment);
+        ok = ok && p % alignment == 0;
+    }
+    // Over the block, then the same frame has to fit after the reset
+    for (int i = 0; i < 64; ++i) {
+        double *values = arena.allocateArray<double>(8);
+        ok = ok && (uintptr_t)values % alignof(double) == 0;
+        for (int j = 0; j < 8; ++j)
+            values[j] = j;
+    }
+    ok = ok && arena.overflowed() > 0;
+    size_t peak = arena.used();
+    arena.reset();
+    ok = ok && arena.blockSize() >= peak && arena.used() == 0;
+    for (int i = 0; i < 64; ++i)
+        arena.allocateArray<double>(8);
+    ok = ok && arena.overflowed() == 0;
+    if (!ok)
+        std::cout << "LinearArena alignment or growth is wrong" << std::endl;
+
+    // Last frame's list stays readable while this frame's is built
+    FrameArena frames(1024);
+    frames.beginFrame();
+    FrameVector<int> previous = frames.vector<int>();
+    previous.reserve(100);
+    for (int i = 0; i < 100; ++i)
+        previous.push_back(i);
+    frames.beginFrame();
+    FrameVector<int> current = frames.vector<int>();
+    current.reserve(100);
+    for (int i = 0; i < 100; ++i)
+        current.push_back(-i);
+    bool intact = true;
+    for (int i = 0; i < 100; ++i)
+        intact = intact && previous[i] == i && current[i] == -i;
+    if (!intact)
+        std::cout << "FrameArena overwrote the previous frame" << std::endl;
+    return ok && intact;
+}
+
+int main(int argc, char *argv[])
+{
+    const int amount = argc > 1 ? atoi(argv[1]) : 20000;
+    bool failed = !checkArena();
+
+    // Ring of asteroids around the planet, like AsteroidField
+    srand(1);
+    std::vector<glm::vec4> spheres(amount);
+    for (int i = 0; i < amount; ++i) {
+        float angle = randomFloat(0.0f, 6.2832f);
+        spheres[i] = glm::vec4(std::sin(angle) * 10.0f + randomFloat(-1.0f, 1.0f), randomFloat(-0.5f, 0.5f),
+                               std::cos(angle) * 10.0f + randomFloat(-1.0f, 1.0f), randomFloat(0.02f, 0.15f));
+    }
+    std::vector<BenchVertex> planet;
+    std::vector<unsigned int> planetIndices;
+    uvSphere(3.0f, 32, 64, planet, planetIndices);
+
+    // At least a few threads, so jobs really get stolen and recycled
+    JobPool jobs(std::max(std::thread::hardware_concurrency(), 4u));
+    OcclusionCuller occlusionCuller(jobs);
+    std::vector<float> thresholds;
+    thresholds.push_back(40.0f);
+    thresholds.push_back(20.0f);
+    LodSelector lodSelector(amount, thresholds);
+    std::vector<unsigned int> lodOrder, lodStart;
+    std::vector<uint8_t> visible;
+    FrameArena frameArena;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 256.0f / 192.0f, 0.1f, 100.0f);
+    const float pixelScale = LodSelector::pixelScale(glm::radians(45.0f), 1080);
+
+    // Two laps of the same orbit, the first one warms everything up
+    const int framesPerLap = 120;
+    unsigned long long steadyAllocations = 0, hiddenTotal = 0;
+    for (int frame = 0; frame < 2 * framesPerLap; ++frame) {
+        unsigned long long before = heapAllocations();
+        frameArena.beginFrame();
+        float angle = 6.2831853f * (frame % framesPerLap) / framesPerLap;
+        glm::vec3 eye(std::sin(angle) * 16.0f, 2.0f, std::cos(angle) * 16.0f);
+        glm::mat4 viewProjection = projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = extractFrustum(viewProjection);
+
+        occlusionCuller.beginFrame(viewProjection);
+        occlusionCuller.addOccluder(planet, planetIndices, (unsigned int)planetIndices.size(), glm::mat4(1.0f));
+        occlusionCuller.render();
+        occlusionCuller.cullSpheres(spheres, visible);
+        lodSelector.update(spheres, frustum, eye, pixelScale, lodOrder, lodStart, &visible, &jobs);
+        FrameVector<unsigned int> inFrustum = frameArena.vector<unsigned int>();
+        inFrustum.reserve(amount);
+        cullSpheres(spheres, frustum, inFrustum);
+        hiddenTotal += inFrustum.size() - lodOrder.size();
+
+        if (frame >= framesPerLap)
+            steadyAllocations += heapAllocations() - before;
+    }
+    if (steadyAllocations > 0) {
+        std::cout << steadyAllocations << " heap allocations in " << framesPerLap << " steady state frames"
+                  << std::endl;
+        failed = true;
+    }
+
+    // Per frame lists: one list of nearby asteroids per cell of a 16x16
+    // grid over the ring, then sorted by distance, from the heap and from
+    // the arena
+    const int cells = 256, frames = 50;
+    double heapMs = 0.0, arenaMs = 0.0;
+    unsigned long long heapCalls = 0, arenaCalls = 0, checksum[2] = { 0, 0 };
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int frame = 0; frame < frames; ++frame) {
+            frameArena.beginFrame();
+            unsigned long long before = heapAllocations();
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int c = 0; c < cells; ++c) {
+                float x = -12.0f + 24.0f * (c % 16) / 16.0f, z = -12.0f + 24.0f * (c / 16) / 16.0f;
+                auto nearby = [&](size_t i) {
+                    glm::vec2 d(spheres[i].x - x, spheres[i].z - z);
+                    return glm::dot(d, d) < 4.0f;
+                };
+                auto closer = [&](unsigned int a, unsigned int b) {
+                    return std::fabs(spheres[a].x - x) < std::fabs(spheres[b].x - x);
+                };
+                if (pass == 0) {
+                    std::vector<unsigned int> list;
+                    for (int i = 0; i < amount; i += 4)
+                        if (nearby(i))
+                            list.push_back(i);
+                    std::sort(list.begin(), list.end(), closer);
+                    checksum[0] += list.empty() ? 0 : list[0] + list.size();
+                } else {
+                    FrameVector<unsigned int> list = frameArena.vector<unsigned int>();
+                    list.reserve(amount / 4);
+                    for (int i = 0; i < amount; i += 4)
+                        if (nearby(i))
+                            list.push_back(i);
+                    std::sort(list.begin(), list.end(), closer);
+                    checksum[1] += list.empty() ? 0 : list[0] + list.size();
+                }
+            }
+            (pass == 0 ? heapMs : arenaMs) += millisecondsSince(start);
+            (pass == 0 ? heapCalls : arenaCalls) += heapAllocations() - before;
+        }
+    }
+    if (checksum[0] != checksum[1]) {
+        std::cout << "Arena lists differ from heap lists" << std::endl;
+        failed = true;
+    }
+
+    std::cout << amount << " asteroids, " << jobs.threadCount() << " threads" << std::endl;
+    std::cout << "  steady state frame: " << steadyAllocations / (double)framesPerLap << " heap allocations, "
+              << hiddenTotal / (2.0 * framesPerLap) << " asteroids hidden on average" << std::endl;
+    std::cout << "  " << cells << " sorted lists per frame: heap " << heapMs / frames << " ms and "
+              << heapCalls / (double)frames << " allocations, arena " << arenaMs / frames << " ms and "
+              << arenaCalls / (double)frames << " allocations" << std::endl;
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+//
+// Capture writers, without an OpenGL context.
+//   - PNG files read back through stb_image give the pixels that went in,
+//     flipped and with alpha dropped the way captures are written, for
+//     sizes on both sides of a stored deflate block,
+//   - raw dumps are the pixels byte for byte,
+//   - CaptureWriter writes or drops every frame it is offered, and stops
+//     handing out frames while maxQueued are in flight,
+//   - a steady stream of captures does not allocate.
+// Throughput: 1080p frames offered at 60 per second and as fast as the
+// writers take them, PNG and raw, with the time the encoding takes.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "FrameCapture.h"
+#define ALLOCATIONTRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
+#include "BenchCommon.h"
+
+void fillPixels(std::vector<unsigned char> &pixels, int width, int height, unsigned int seed)
+{
+    pixels.resize((size_t)width * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        // Gradients with a little noise, roughly like a rendered frame
+        pixels[i] = (unsigned char)((i / 4 % width) * 255 / width + (seed >> 29));
+    }
+}
+
+// Returns false when the file does not decode to the expected pixels
+bool pngRoundTrip(const std::string &path, int width, int height, int outChannels)
+{
+    std::vector<unsigned char> pixels;
+    fillPixels(pixels, width, height, (unsigned int)(width * 31 + height));
+    if (!writePng(path.c_str(), width, height, 4, pixels.data(), true, outChannels))
+        return false;
+    int w, h, n;
+    unsigned char *decoded = stbi_load(path.c_str(), &w, &h, &n, 0);
+    bool ok = decoded && w == width && h == height && n == outChannels;
+    for (int y = 0; y < height && ok; ++y) {
+        for (int x = 0; x < width && ok; ++x) {
+            const unsigned char *in = &pixels[((size_t)(height - 1 - y) * width + x) * 4];
+            const unsigned char *out = &decoded[((size_t)y * width + x) * outChannels];
+            for (int c = 0; c < outChannels; ++c)
+                ok = ok && in[c] == out[c];
+        }
+    }
+    stbi_image_free(decoded);
+    std::remove(path.c_str());
+    return ok;
+}
+
+bool rawRoundTrip(const std::string &path)
+{
+    std::vector<unsigned char> pixels, read(64 * 48 * 4);
+    fillPixels(pixels, 64, 48, 7);
+    if (!writeRaw(path.c_str(), 64, 48, 4, pixels.data()))
+        return false;
+    FILE *file = fopen(path.c_str(), "rb");
+    bool ok = file && fread(read.data(), 1, read.size(), file) == read.size() && fgetc(file) == EOF;
+    if (file)
+        fclose(file);
+    std::remove(path.c_str());
+    return ok && read == pixels;
+}
+
+struct StreamResult {
+    double milliseconds, writeMilliseconds;
+    unsigned long long written, dropped, allocations;
+};
+
+// Offers frames to a writer every interval milliseconds, or as fast as
+// it takes them (interval 0, retrying until a frame is accepted, which
+// does not count as dropping it), cycling through a few file names
+StreamResult captureStream(const std::string &directory, CaptureFormat format, int frames, double interval,
+                           const std::vector<unsigned char> &pixels, int width, int height)
+{
+    CaptureWriter writer(2, 8);
+    StreamResult result = { 0.0, 0.0, 0, 0, 0 };
+    char path[512];
+    auto fill = [&](CapturedFrame *frame, int f) {
+        snprintf(path, sizeof(path), "%s/capture_%d.%s", directory.c_str(), f % 4,
+                 format == CAPTURE_PNG ? "png" : "raw");
+        frame->path = path;
+        frame->width = width;
+        frame->height = height;
+        frame->format = format;
+        frame->pixels.resize(pixels.size());
+        std::memcpy(frame->pixels.data(), pixels.data(), pixels.size());
+    };
+    auto offer = [&](int f) {
+        CapturedFrame *frame = writer.acquire();
+        if (!frame)
+            return false;
+        fill(frame, f);
+        writer.submit(frame);
+        return true;
+    };
+    // Every frame object gets its memory first, all 8 in flight at once
+    CapturedFrame *warmup[8];
+    for (int f = 0; f < 8; ++f) {
+        warmup[f] = writer.acquire();
+        fill(warmup[f], f);
+    }
+    for (int f = 0; f < 8; ++f)
+        writer.submit(warmup[f]);
+    writer.finish();
+
+    unsigned long long writtenBefore = writer.written(), droppedBefore = writer.dropped();
+    double writeBefore = writer.writeMilliseconds();
+    unsigned long long allocationsBefore = heapAllocations();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        if (interval > 0.0) {
+            offer(f);
+            while (millisecondsSince(start) < (f + 1) * interval)
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        } else {
+            while (!offer(f))
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    writer.finish();
+    result.milliseconds = millisecondsSince(start);
+    result.allocations = heapAllocations() - allocationsBefore;
+    result.written = writer.written() - writtenBefore;
+    result.dropped = writer.dropped() - droppedBefore;
+    result.writeMilliseconds = writer.writeMilliseconds() - writeBefore;
+    for (int f = 0; f < 4; ++f) {
+        snprintf(path, sizeof(path), "%s/capture_%d.%s", directory.c_str(), f,
+                 format == CAPTURE_PNG ? "png" : "raw");
+        std::remove(path);
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    // Captures go through real files, in the current directory by default
+    const std::string directory = argc > 1 ? argv[1] : ".";
+    const int frames = argc > 2 ? atoi(argv[2]) : 120;
+    bool failed = false;
+
+    const int sizes[][2] = { { 1, 1 }, { 7, 5 }, { 200, 113 }, { 300, 300 }, { 1920, 1080 } };
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for (int channels = 3; channels <= 4; ++channels) {
+            if (!pngRoundTrip(directory + "/roundtrip.png", sizes[i][0], sizes[i][1], channels)) {
+                std::cout << "PNG " << sizes[i][0] << "x" << sizes[i][1] << " with " << channels
+                          << " channels does not read back" << std::endl;
+                failed = true;
+            }
+        }
+    }
+    if (!rawRoundTrip(directory + "/roundtrip.raw")) {
+        std::cout << "Raw dump does not read back" << std::endl;
+        failed = true;
+    }
+
+    // Frames are never lost without being counted, and nothing beyond
+    // maxQueued is handed out
+    {
+        CaptureWriter writer(1, 2);
+        std::vector<unsigned char> pixels;
+        fillPixels(pixels, 640, 480, 1);
+        unsigned int offered = 0, accepted = 0;
+        char path[512];
+        for (int f = 0; f < 40; ++f) {
+            ++offered;
+            CapturedFrame *frame = writer.acquire();
+            if (!frame)
+                continue;
+            ++accepted;
+            snprintf(path, sizeof(path), "%s/limit_%d.raw", directory.c_str(), f % 2);
+            frame->path = path;
+            frame->width = 640;
+            frame->height = 480;
+            frame->format = CAPTURE_RAW;
+            frame->pixels = pixels;
+            writer.submit(frame);
+        }
+        writer.finish();
+        if (writer.written() != accepted || writer.dropped() != offered - accepted || accepted < 2) {
+            std::cout << "CaptureWriter wrote " << writer.written() << " and dropped " << writer.dropped()
+                      << " of " << offered << " frames, accepted " << accepted << std::endl;
+            failed = true;
+        }
+        for (int f = 0; f < 2; ++f) {
+            snprintf(path, sizeof(path), "%s/limit_%d.raw", directory.c_str(), f);
+            std::remove(path);
+        }
+    }
+
+    const int width = 1920, height = 1080;
+    std::vector<unsigned char> pixels;
+    fillPixels(pixels, width, height, 3);
+    double megabytes = pixels.size() / 1.0e6;
+    std::cout << width << "x" << height << " RGBA frames, 2 writer threads, at most 8 in flight" << std::endl;
+    const char *names[] = { "PNG", "raw" };
+    for (int format = 0; format < 2; ++format) {
+        for (int paced = 1; paced >= 0; --paced) {
+            StreamResult r = captureStream(directory, (CaptureFormat)format, frames, paced ? 1000.0 / 60.0 : 0.0,
+                                           pixels, width, height);
+            unsigned long long lost = paced ? r.dropped : 0;
+            if (r.written + lost != (unsigned long long)frames || r.allocations > 0) {
+                std::cout << "  " << r.written << " written and " << r.dropped << " dropped of " << frames
+                          << " frames, " << r.allocations << " heap allocations" << std::endl;
+                failed = true;
+            }
+            std::cout << "  " << names[format] << (paced ? ", offered at 60 fps: " : ", as fast as possible: ")
+                      << r.written * 1000.0 / r.milliseconds << " frames per second written, ";
+            if (paced)
+                std::cout << r.dropped << " dropped, ";
+            std::cout << r.writeMilliseconds / std::max(r.written, 1ull) << " ms per frame ("
+                      << megabytes * r.written * 1000.0 / r.writeMilliseconds << " MB/s per writer)" << std::endl;
+        }
+    }
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,312 @@
+//
+// Simulation / render thread pipeline, without an OpenGL context.
+//   - packets come out in the order they went in, none is skipped or
+//     seen twice, and a packet is never rewritten while it is read, with
+//     both sides running at random speeds,
+//   - close() lets the consumer finish what is queued and open() starts
+//     over, as AsteroidField does when switching modes,
+//   - a steady state pipelined frame makes no heap allocation.
+// Throughput: AsteroidField frames with every asteroid orbiting. The
+// simulation moves them (model and normal matrices, spheres) and picks
+// levels of detail on a job pool. The render stand-in does what the GL
+// side does with the CPU: copies the instance data and the LOD lists into
+// "buffers" and walks the draw list, then sleeps for the time a driver
+// blocks the GL thread in swap or on a fence (the second argument, in
+// milliseconds). Frames per second with both on one thread, then with the
+// render stand-in on its own thread. The blocked time is what a render
+// thread hides even on one core; the CPU work only overlaps with more.
+// The speedup is therefore set mostly by the driver time passed in, it is
+// a model and not what AsteroidField gains: that is only measured by
+// AsteroidField itself, which prints its frames per second with the render
+// thread on and off (T) while the asteroids orbit (M).
+//
+// Usage: FramePipeline [asteroids] [driver ms]
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FramePipeline.h"
+#include "JobPool.h"
+#include "LodSelector.h"
+#include "InstanceCulling.h"
+#include "NormalMatrix.h"
+#define ALLOCATIONTRACKER_IMPLEMENTATION
+#include "AllocationTracker.h"
+#include "BenchCommon.h"
+
+// Default time the render stand-in blocks per frame, a quarter of a
+// 60 Hz frame
+const double DRIVER_MILLISECONDS = 4.0;
+
+struct TestPacket {
+    unsigned int frame;
+    std::vector<unsigned int> data;
+};
+
+// Returns how many packets came out wrong
+unsigned int orderedHandoff(unsigned int depth, unsigned int frames)
+{
+    FramePipeline<TestPacket> pipeline(depth);
+    unsigned int wrong = 0;
+    for (int round = 0; round < 2; ++round) {
+        std::thread consumer([&pipeline, &wrong, round, frames]() {
+            unsigned int expected = round * frames;
+            uint32_t random = 12345u + round;
+            while (const TestPacket *packet = pipeline.beginRead()) {
+                bool ok = packet->frame == expected && packet->data.size() == 64;
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                if (random % 4 == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(random % 200));
+                // Still the same contents after the pause
+                for (unsigned int i = 0; i < packet->data.size() && ok; ++i)
+                    ok = packet->data[i] == packet->frame * 64 + i;
+                wrong += !ok;
+                ++expected;
+                pipeline.endRead();
+            }
+            wrong += expected != (round + 1) * frames;
+        });
+        for (unsigned int f = round * frames; f < (round + 1) * frames; ++f) {
+            TestPacket *packet = pipeline.beginWrite();
+            packet->frame = f;
+            packet->data.resize(64);
+            for (unsigned int i = 0; i < 64; ++i)
+                packet->data[i] = f * 64 + i;
+            if (rand() % 4 == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(rand() % 200));
+            pipeline.endWrite();
+        }
+        pipeline.close();
+        consumer.join();
+        pipeline.open();
+    }
+    return wrong;
+}
+
+struct Orbit {
+    glm::vec3 position, axis;
+    float angle, orbitSpeed, spin, scale;
+};
+
+struct AsteroidPacket {
+    unsigned int frame;
+    glm::mat4 viewProjection;
+    std::vector<glm::vec4> instanceData;
+    std::vector<unsigned int> lodOrder, lodStart;
+};
+
+// State of the simulation thread
+struct AsteroidScene {
+    std::vector<Orbit> orbits;
+    std::vector<glm::mat4> models;
+    std::vector<PackedNormalMatrix> normals;
+    std::vector<glm::vec4> spheres;
+    LodSelector lodSelector;
+    // Bounds of the rock model before scaling
+    glm::vec4 rockSphere;
+    glm::mat4 projection;
+    float pixelScale;
+
+    AsteroidScene(int amount, const std::vector<float> &thresholds)
+            : orbits(amount), models(amount), normals(amount), spheres(amount), lodSelector(amount, thresholds),
+              rockSphere(0.0f, 0.0f, 0.0f, 1.8f),
+              projection(glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f)),
+              pixelScale(LodSelector::pixelScale(glm::radians(45.0f), 600))
+    {
+        for (int i = 0; i < amount; ++i) {
+            Orbit &o = orbits[i];
+            float angle = randomFloat(0.0f, 6.2832f);
+            o.position = glm::vec3(std::sin(angle) * 10.0f + randomFloat(-1.0f, 1.0f), randomFloat(-0.5f, 0.5f),
+                                   std::cos(angle) * 10.0f + randomFloat(-1.0f, 1.0f));
+            o.axis = glm::normalize(glm::vec3(randomFloat(0.1f, 1.0f), randomFloat(0.1f, 1.0f),
+                                              randomFloat(0.1f, 1.0f)));
+            o.angle = randomFloat(0.0f, 6.2832f);
+            o.orbitSpeed = randomFloat(0.02f, 0.07f);
+            o.spin = randomFloat(0.2f, 1.2f);
+            o.scale = randomFloat(0.02f, 0.15f);
+        }
+    }
+
+    void simulate(unsigned int frame, JobPool &jobs, AsteroidPacket &packet)
+    {
+        float time = frame / 60.0f;
+        size_t amount = orbits.size();
+        packet.frame = frame;
+        packet.instanceData.resize(amount * 7);
+        jobs.parallelFor(amount, 1024, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const Orbit &o = orbits[i];
+                glm::mat4 model = glm::rotate(glm::mat4(1.0f), o.orbitSpeed * time, glm::vec3(0.0f, 1.0f, 0.0f));
+                model = glm::translate(model, o.position);
+                model = glm::rotate(model, o.angle + o.spin * time, o.axis);
+                models[i] = glm::scale(model, glm::vec3(o.scale));
+            }
+            computeNormalMatrices(&models[begin], &normals[begin], end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                glm::vec4 *out = &packet.instanceData[i * 7];
+                for (int j = 0; j < 4; ++j)
+                    out[j] = models[i][j];
+                for (int j = 0; j < 3; ++j)
+                    out[4 + j] = normals[i].columns[j];
+                spheres[i] = transformSphere(models[i], rockSphere);
+            }
+        });
+        // Camera circling the ring
+        float angle = time * 0.3f;
+        glm::vec3 eye(std::sin(angle) * 16.0f, 2.0f, std::cos(angle) * 16.0f);
+        packet.viewProjection = projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        lodSelector.update(spheres, extractFrustum(packet.viewProjection), eye, pixelScale, packet.lodOrder,
+                           packet.lodStart, nullptr, &jobs);
+    }
+};
+
+// What the render thread does for a frame: upload copies, one pass over
+// the draw list and the wait on the driver
+struct RenderStandIn {
+    std::vector<glm::vec4> instanceBuffer;
+    std::vector<unsigned int> lodBuffer;
+    unsigned int lastFrame;
+    unsigned long long drawn, outOfOrder;
+    // Keeps the pass over the draw list from being optimized away
+    float checksum;
+    std::chrono::microseconds driverWait;
+
+    RenderStandIn(int amount, double driverMilliseconds)
+            : instanceBuffer(amount * 7), lodBuffer(amount), lastFrame(0), drawn(0), outOfOrder(0),
+              checksum(0.0f), driverWait((long long)(driverMilliseconds * 1000.0))
+    {
+    }
+
+    void render(const AsteroidPacket &packet)
+    {
+        outOfOrder += drawn > 0 && packet.frame != lastFrame + 1;
+        lastFrame = packet.frame;
+        std::memcpy(instanceBuffer.data(), packet.instanceData.data(),
+                    packet.instanceData.size() * sizeof(glm::vec4));
+        std::memcpy(lodBuffer.data(), packet.lodOrder.data(), packet.lodOrder.size() * sizeof(unsigned int));
+        // The instances of every level, transformed as a vertex shader
+        // would place their centre, stands in for the driver's validation
+        glm::vec4 sum(0.0f);
+        for (size_t l = 0; l + 1 < packet.lodStart.size(); ++l) {
+            for (unsigned int k = packet.lodStart[l]; k < packet.lodStart[l + 1]; ++k) {
+                const glm::vec4 *instance = &instanceBuffer[lodBuffer[k] * 7];
+                sum += packet.viewProjection * instance[3];
+            }
+        }
+        checksum += sum.x;
+        // Blocked, not spinning, like glfwSwapBuffers or glClientWaitSync
+        std::this_thread::sleep_for(driverWait);
+        ++drawn;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    const int amount = argc > 1 ? atoi(argv[1]) : 20000;
+    const double driverMilliseconds = argc > 2 ? std::max(atof(argv[2]), 0.0) : DRIVER_MILLISECONDS;
+    const unsigned int frames = 300;
+    bool failed = false;
+
+    unsigned int handoffWrong = orderedHandoff(2, 2000) + orderedHandoff(3, 2000);
+    if (handoffWrong) {
+        std::cout << handoffWrong << " packets out of order, skipped or changed while read" << std::endl;
+        failed = true;
+    }
+
+    srand(1);
+    std::vector<float> thresholds;
+    thresholds.push_back(40.0f);
+    thresholds.push_back(20.0f);
+    thresholds.push_back(10.0f);
+    // One thread for the render side, the rest simulate
+    unsigned int hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    JobPool jobs(std::max(hardware - 1, 1u));
+    AsteroidScene scene(amount, thresholds);
+
+    // One thread: simulate, then draw
+    double serialMs, pipelinedMs;
+    {
+        AsteroidPacket packet;
+        RenderStandIn renderer(amount, driverMilliseconds);
+        for (unsigned int f = 0; f < 10; ++f) {
+            scene.simulate(f, jobs, packet);
+            renderer.render(packet);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int f = 10; f < 10 + frames; ++f) {
+            scene.simulate(f, jobs, packet);
+            renderer.render(packet);
+        }
+        serialMs = millisecondsSince(start) / frames;
+    }
+
+    // Render thread: frame N drawn while N + 1 is simulated
+    unsigned long long steadyAllocations = 0, outOfOrder = 0, drawn = 0;
+    double simulationWait, renderWait;
+    {
+        FramePipeline<AsteroidPacket> pipeline(2);
+        RenderStandIn renderer(amount, driverMilliseconds);
+        std::thread renderThread([&]() {
+            while (const AsteroidPacket *packet = pipeline.beginRead()) {
+                renderer.render(*packet);
+                pipeline.endRead();
+            }
+        });
+        // Warm up every packet of the ring first
+        for (unsigned int f = 0; f < 10; ++f) {
+            AsteroidPacket *packet = pipeline.beginWrite();
+            scene.simulate(f, jobs, *packet);
+            pipeline.endWrite();
+        }
+        pipeline.takeWaitTimes(simulationWait, renderWait);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int f = 10; f < 10 + frames; ++f) {
+            unsigned long long before = heapAllocations();
+            AsteroidPacket *packet = pipeline.beginWrite();
+            scene.simulate(f, jobs, *packet);
+            pipeline.endWrite();
+            steadyAllocations += heapAllocations() - before;
+        }
+        pipeline.close();
+        renderThread.join();
+        pipelinedMs = millisecondsSince(start) / frames;
+        pipeline.takeWaitTimes(simulationWait, renderWait);
+        outOfOrder = renderer.outOfOrder;
+        drawn = renderer.drawn;
+    }
+    if (outOfOrder > 0 || drawn != 10 + frames) {
+        std::cout << outOfOrder << " frames drawn out of order, " << drawn << " of " << 10 + frames << " drawn"
+                  << std::endl;
+        failed = true;
+    }
+    if (steadyAllocations > 0) {
+        std::cout << steadyAllocations << " heap allocations in " << frames << " pipelined frames" << std::endl;
+        failed = true;
+    }
+
+    std::cout << amount << " orbiting asteroids, " << jobs.threadCount() << " simulation threads and a render "
+              << "thread blocking " << driverMilliseconds << " ms per frame, " << hardware << " hardware threads"
+              << std::endl;
+    std::cout << "  one thread:    " << serialMs << " ms per frame, " << 1000.0 / serialMs << " frames per second"
+              << std::endl;
+    std::cout << "  render thread: " << pipelinedMs << " ms per frame, " << 1000.0 / pipelinedMs
+              << " frames per second, " << serialMs / pipelinedMs << "x modelled (simulation waited "
+              << simulationWait / frames << " ms, render " << renderWait / frames << " ms per frame)" << std::endl;
+    std::cout << "  the render stand-in's blocking is made up, run AsteroidField with T on and off for the "
+              << "real gain" << std::endl;
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
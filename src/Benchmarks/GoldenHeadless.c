@@ -0,0 +1,198 @@
+//
+// The GLFW calls of the golden image demos answered by an EGL context
+// without any surface (EGL_MESA_platform_surfaceless), for golden runs on
+// machines without an X server. Built instead of GLFW with
+//
+//     cmake -DGOLDEN_HEADLESS=ON
+//
+// see CMakeLists.txt. Golden mode renders into a framebuffer object of
+// its own (GoldenRun.h), so a context is all the demos need: windows are
+// only a size, there is no input, swapping does nothing and no callback
+// is ever called.
+//
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLFW/glfw3.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct GLFWwindow {
+    int width, height;
+    int shouldClose;
+    EGLContext context;
+};
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static int contextMajor = 3, contextMinor = 3;
+static GLFWwindow *currentWindow = NULL;
+static double startTime = 0.0;
+
+static double secondsNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+int glfwInit(void)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay) {
+        fprintf(stderr, "EGL has no eglGetPlatformDisplayEXT\n");
+        return GLFW_FALSE;
+    }
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        fprintf(stderr, "No surfaceless EGL display: 0x%x\n", eglGetError());
+        return GLFW_FALSE;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+    startTime = secondsNow();
+    return GLFW_TRUE;
+}
+
+void glfwTerminate(void)
+{
+    currentWindow = NULL;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglTerminate(display);
+}
+
+void glfwWindowHint(int hint, int value)
+{
+    if (hint == GLFW_CONTEXT_VERSION_MAJOR)
+        contextMajor = value;
+    else if (hint == GLFW_CONTEXT_VERSION_MINOR)
+        contextMinor = value;
+}
+
+GLFWwindow *glfwCreateWindow(int width, int height, const char *title, GLFWmonitor *monitor, GLFWwindow *share)
+{
+    (void)title;
+    (void)monitor;
+    (void)share;
+    // A core profile context with no config needs EGL_KHR_no_config_context
+    EGLint attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, contextMajor,
+            EGL_CONTEXT_MINOR_VERSION, contextMinor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, EGL_TRUE,
+            EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT) {
+        fprintf(stderr, "Failed to create a surfaceless OpenGL %d.%d context: 0x%x\n", contextMajor,
+                contextMinor, eglGetError());
+        return NULL;
+    }
+    GLFWwindow *window = (GLFWwindow*)calloc(1, sizeof(GLFWwindow));
+    window->width = width;
+    window->height = height;
+    window->context = context;
+    return window;
+}
+
+void glfwMakeContextCurrent(GLFWwindow *window)
+{
+    currentWindow = window;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, window ? window->context : EGL_NO_CONTEXT);
+}
+
+GLFWwindow *glfwGetCurrentContext(void)
+{
+    return currentWindow;
+}
+
+GLFWglproc glfwGetProcAddress(const char *name)
+{
+    return (GLFWglproc)eglGetProcAddress(name);
+}
+
+void glfwGetFramebufferSize(GLFWwindow *window, int *width, int *height)
+{
+    if (width)
+        *width = window->width;
+    if (height)
+        *height = window->height;
+}
+
+void glfwGetWindowSize(GLFWwindow *window, int *width, int *height)
+{
+    glfwGetFramebufferSize(window, width, height);
+}
+
+double glfwGetTime(void)
+{
+    return secondsNow() - startTime;
+}
+
+int glfwWindowShouldClose(GLFWwindow *window)
+{
+    return window->shouldClose;
+}
+
+void glfwSetWindowShouldClose(GLFWwindow *window, int value)
+{
+    window->shouldClose = value;
+}
+
+int glfwGetKey(GLFWwindow *window, int key)
+{
+    (void)window;
+    (void)key;
+    return GLFW_RELEASE;
+}
+
+void glfwPollEvents(void)
+{
+}
+
+void glfwSwapBuffers(GLFWwindow *window)
+{
+    (void)window;
+}
+
+void glfwSwapInterval(int interval)
+{
+    (void)interval;
+}
+
+void glfwSetInputMode(GLFWwindow *window, int mode, int value)
+{
+    (void)window;
+    (void)mode;
+    (void)value;
+}
+
+GLFWframebuffersizefun glfwSetFramebufferSizeCallback(GLFWwindow *window, GLFWframebuffersizefun callback)
+{
+    (void)window;
+    (void)callback;
+    return NULL;
+}
+
+GLFWcursorposfun glfwSetCursorPosCallback(GLFWwindow *window, GLFWcursorposfun callback)
+{
+    (void)window;
+    (void)callback;
+    return NULL;
+}
+
+GLFWscrollfun glfwSetScrollCallback(GLFWwindow *window, GLFWscrollfun callback)
+{
+    (void)window;
+    (void)callback;
+    return NULL;
+}
+
+GLFWkeyfun glfwSetKeyCallback(GLFWwindow *window, GLFWkeyfun callback)
+{
+    (void)window;
+    (void)callback;
+    return NULL;
+}
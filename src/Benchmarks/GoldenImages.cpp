@@ -0,0 +1,402 @@
+//
+// Golden image regression run over the demos. Every case starts a demo in
+// its golden mode (see GoldenRun.h): fixed camera, clock stopped, frames
+// rendered offscreen, last frame written to a PNG. The image is compared with the
+// reference of the case in CIE Lab: a pixel is off when its colour
+// difference (delta E 1976) to the reference pixel and to all of that
+// pixel's neighbours is above --delta (2.3 is about one just noticeable
+// difference), which forgives an edge moving by a pixel. A case fails when
+// more than --fraction of its pixels are off; a picture of them is left
+// next to the output. Frame times are printed and written to timings.csv,
+// next to the reference ones when those were recorded.
+//
+// Runs the demos with Mesa's llvmpipe unless LIBGL_ALWAYS_SOFTWARE or
+// GALLIUM_DRIVER say otherwise, so it does not need a GPU, but GLFW needs
+// an X server, e.g.
+//
+//     xvfb-run -s "-screen 0 1024x768x24" ./GoldenImages
+//
+// Without one, build the demos with -DGOLDEN_HEADLESS=ON, which puts them
+// on a surfaceless EGL context instead of GLFW:
+//
+//     cmake -S . -B headless -DGOLDEN_HEADLESS=ON && cmake --build headless
+//     headless/GoldenImages --bin headless
+//
+// Either way from the directory with shaders/, textures/ and models/.
+// --update writes the new images and timings as the references. The ones
+// under golden/ were recorded the headless way on llvmpipe (Mesa 22.3,
+// LLVM 15) at 800x600; their frame times are from one core and only mean
+// anything next to other llvmpipe runs.
+//
+//     GoldenImages [--bin .] [--reference golden] [--output golden_output]
+//                  [--frames 30] [--delta 2.3] [--fraction 0.001]
+//                  [--only Name] [--update]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "ImageWriter.h"
+
+struct GoldenCase {
+    const char *name;
+    const char *program;
+    const char *arguments;
+};
+
+const GoldenCase CASES[] = {
+        { "Phong", "Phong", "" },
+        { "Gouraud", "Gouraud", "" },
+        { "ShadowMapping", "ShadowMapping", "" },
+        { "NormalMapping", "NormalMapping", "" },
+        { "SkyBox", "SkyBox", "" },
+        { "DynamicReflection", "DynamicReflection", "" },
+        { "PostProcessing-None", "PostProcessing", "--effects none" },
+        { "PostProcessing-Sharpen", "PostProcessing", "--effects Sharpen" },
+        { "PostProcessing-Blur", "PostProcessing", "--effects Blur" },
+        { "PostProcessing-EdgeDetection", "PostProcessing", "--effects EdgeDetection" },
+        { "PostProcessing-Inversion", "PostProcessing", "--effects Inversion" },
+        { "PostProcessing-GrayScale", "PostProcessing", "--effects GrayScale" },
+        { "PostProcessing-Contrast", "PostProcessing", "--effects Contrast" },
+        // Every kind of pass in one chain. EdgeDetection is left out: the
+        // blur leaves it hardly any edges, Contrast crushes those to black
+        // and Inversion turns the frame plain white, which a broken chain
+        // matches as well.
+        { "PostProcessing-Chain", "PostProcessing", "--effects Sharpen,Blur,Inversion,GrayScale,Contrast" },
+};
+const int CASE_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+
+struct Image {
+    int width = 0, height = 0;
+    // RGB, top row first
+    std::vector<unsigned char> pixels;
+};
+
+bool loadImage(const std::string &path, Image &image)
+{
+    int n;
+    unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &n, 3);
+    if (!data)
+        return false;
+    image.pixels.assign(data, data + (size_t)image.width * image.height * 3);
+    stbi_image_free(data);
+    return true;
+}
+
+// sRGB pixels to CIE Lab under D65
+std::vector<float> toLab(const Image &image)
+{
+    static float linear[256];
+    static bool tableBuilt = false;
+    if (!tableBuilt) {
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        tableBuilt = true;
+    }
+    auto f = [](float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f; };
+    size_t count = (size_t)image.width * image.height;
+    std::vector<float> lab(count * 3);
+    for (size_t i = 0; i < count; ++i) {
+        float r = linear[image.pixels[i * 3]], g = linear[image.pixels[i * 3 + 1]];
+        float b = linear[image.pixels[i * 3 + 2]];
+        float x = f((0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f);
+        float y = f(0.2126f * r + 0.7152f * g + 0.0722f * b);
+        float z = f((0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f);
+        lab[i * 3] = 116.0f * y - 16.0f;
+        lab[i * 3 + 1] = 500.0f * (x - y);
+        lab[i * 3 + 2] = 200.0f * (y - z);
+    }
+    return lab;
+}
+
+struct Comparison {
+    double meanDelta, maxDelta, offFraction;
+};
+
+// Fills diff with the reference in dim gray and the pixels that are off
+// in red
+Comparison compareImages(const Image &image, const Image &reference, float maxDelta, std::vector<unsigned char> &diff)
+{
+    const int width = image.width, height = image.height;
+    std::vector<float> lab = toLab(image), referenceLab = toLab(reference);
+    auto delta = [&](size_t i, size_t j) {
+        float dl = lab[i * 3] - referenceLab[j * 3], da = lab[i * 3 + 1] - referenceLab[j * 3 + 1];
+        float db = lab[i * 3 + 2] - referenceLab[j * 3 + 2];
+        return std::sqrt(dl * dl + da * da + db * db);
+    };
+    Comparison result = { 0.0, 0.0, 0.0 };
+    size_t off = 0;
+    diff.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = (size_t)y * width + x;
+            float d = delta(i, i);
+            result.meanDelta += d;
+            result.maxDelta = std::max(result.maxDelta, (double)d);
+            bool isOff = d > maxDelta;
+            for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1) && isOff; ++ny) {
+                for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1) && isOff; ++nx)
+                    isOff = delta(i, (size_t)ny * width + nx) > maxDelta;
+            }
+            unsigned char gray = (unsigned char)(referenceLab[i * 3] * 0.3f * 2.55f);
+            diff[i * 3] = isOff ? 255 : gray;
+            diff[i * 3 + 1] = isOff ? 0 : gray;
+            diff[i * 3 + 2] = isOff ? 0 : gray;
+            off += isOff;
+        }
+    }
+    size_t count = (size_t)width * height;
+    result.meanDelta /= count;
+    result.offFraction = (double)off / count;
+    return result;
+}
+
+// References are kept in git, so unlike the captures of the demos they are
+// written compressed: every row Paeth filtered, then deflated by zlib
+bool writeReference(const std::string &path, const Image &image)
+{
+    const size_t stride = (size_t)image.width * 3;
+    std::vector<unsigned char> filtered((stride + 1) * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        const unsigned char *row = &image.pixels[y * stride];
+        const unsigned char *above = y > 0 ? row - stride : nullptr;
+        unsigned char *out = &filtered[y * (stride + 1)];
+        *out++ = 4;
+        for (size_t x = 0; x < stride; ++x) {
+            int a = x >= 3 ? row[x - 3] : 0, b = above ? above[x] : 0, c = above && x >= 3 ? above[x - 3] : 0;
+            int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+            int predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+            out[x] = (unsigned char)(row[x] - predictor);
+        }
+    }
+    uLongf deflatedSize = compressBound(filtered.size());
+    std::vector<unsigned char> deflated(deflatedSize);
+    if (compress2(deflated.data(), &deflatedSize, filtered.data(), filtered.size(), 9) != Z_OK)
+        return false;
+
+    std::ofstream file(path, std::ios::binary);
+    auto chunk = [&](const char *type, const unsigned char *data, uint32_t size) {
+        unsigned char word[4];
+        PngStream::putBigEndian(word, size);
+        file.write((const char*)word, 4);
+        file.write(type, 4);
+        file.write((const char*)data, size);
+        uLong crc = crc32(0, (const Bytef*)type, 4);
+        // A null buffer would restart the CRC rather than leave it
+        if (size > 0)
+            crc = crc32(crc, data, size);
+        PngStream::putBigEndian(word, (uint32_t)crc);
+        file.write((const char*)word, 4);
+    };
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write((const char*)signature, 8);
+    // 8 bit truecolour
+    unsigned char header[13] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 2, 0, 0, 0 };
+    PngStream::putBigEndian(header, (uint32_t)image.width);
+    PngStream::putBigEndian(header + 4, (uint32_t)image.height);
+    chunk("IHDR", header, 13);
+    chunk("IDAT", deflated.data(), (uint32_t)deflatedSize);
+    chunk("IEND", nullptr, 0);
+    return (bool)file;
+}
+
+// Frame times by case name from a timings.csv, empty when there is none
+std::vector<std::pair<std::string, double>> readTimings(const std::string &path)
+{
+    std::vector<std::pair<std::string, double>> timings;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t comma = line.find(',');
+        if (comma != std::string::npos && line.compare(0, comma, "case") != 0)
+            timings.emplace_back(line.substr(0, comma), std::atof(line.c_str() + comma + 1));
+    }
+    return timings;
+}
+
+struct RunResult {
+    bool ok;
+    double frameMilliseconds, minMilliseconds;
+    std::string log;
+};
+
+RunResult runDemo(const std::string &bin, const GoldenCase &golden, const std::string &image, int frames)
+{
+    RunResult result = { false, -1.0, -1.0, "" };
+    std::ostringstream command;
+    command << "\"" << bin << "/" << golden.program << "\" --golden \"" << image << "\" --frames " << frames
+            << " " << golden.arguments << " 2>&1";
+    FILE *pipe = popen(command.str().c_str(), "r");
+    if (!pipe) {
+        result.log = "could not start " + command.str();
+        return result;
+    }
+    char line[1024];
+    const char *prefix = "golden frame time: ";
+    while (fgets(line, sizeof(line), pipe)) {
+        result.log += line;
+        if (std::strncmp(line, prefix, std::strlen(prefix)) == 0) {
+            result.frameMilliseconds = std::atof(line + std::strlen(prefix));
+            const char *min = std::strstr(line, "(min ");
+            if (min)
+                result.minMilliseconds = std::atof(min + 5);
+        }
+    }
+    int status = pclose(pipe);
+    result.ok = status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && result.frameMilliseconds >= 0.0;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string bin = ".", referenceDirectory = "golden", outputDirectory = "golden_output";
+    const char *only = nullptr;
+    int frames = 30;
+    float maxDelta = 2.3f;
+    double maxOffFraction = 0.001;
+    bool update = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--update") {
+            update = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            std::cout << "Missing value for " << argument << std::endl;
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (argument == "--bin")
+            bin = value;
+        else if (argument == "--reference")
+            referenceDirectory = value;
+        else if (argument == "--output")
+            outputDirectory = value;
+        else if (argument == "--frames")
+            frames = std::max(2, std::atoi(value));
+        else if (argument == "--delta")
+            maxDelta = (float)std::atof(value);
+        else if (argument == "--fraction")
+            maxOffFraction = std::atof(value);
+        else if (argument == "--only")
+            only = value;
+        else {
+            std::cout << "Unknown argument " << argument << std::endl;
+            return 2;
+        }
+    }
+
+    // Software rendering, the same pixels on every machine
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+    setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+    if (!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+        std::cout << "No display to open windows on: run under xvfb-run unless the demos were built with "
+                     "GOLDEN_HEADLESS" << std::endl;
+    mkdir(outputDirectory.c_str(), 0755);
+    if (update)
+        mkdir(referenceDirectory.c_str(), 0755);
+
+    auto referenceTimings = readTimings(referenceDirectory + "/timings.csv");
+    std::vector<std::pair<std::string, double>> newTimings;
+    std::ofstream timings(outputDirectory + "/timings.csv");
+    timings << "case,mean ms,min ms" << std::endl;
+    int failures = 0, ran = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int c = 0; c < CASE_COUNT; ++c) {
+        const GoldenCase &golden = CASES[c];
+        if (only && std::strcmp(only, golden.name) != 0)
+            continue;
+        ++ran;
+        std::string image = outputDirectory + "/" + golden.name + ".png";
+        std::string reference = referenceDirectory + "/" + golden.name + ".png";
+        std::remove(image.c_str());
+        RunResult run = runDemo(bin, golden, image, frames);
+        std::cout << std::left << std::setw(30) << golden.name << std::right;
+        Image output, expected;
+        if (!run.ok || !loadImage(image, output)) {
+            std::cout << "FAILED to render" << std::endl << run.log;
+            ++failures;
+            continue;
+        }
+        timings << golden.name << "," << run.frameMilliseconds << "," << run.minMilliseconds << std::endl;
+        newTimings.emplace_back(golden.name, run.frameMilliseconds);
+        std::cout << std::setw(8) << run.frameMilliseconds << " ms per frame";
+        for (unsigned int i = 0; i < referenceTimings.size(); ++i) {
+            if (referenceTimings[i].first == golden.name && referenceTimings[i].second > 0.0)
+                std::cout << " (reference " << referenceTimings[i].second << " ms)";
+        }
+
+        if (update) {
+            if (writeReference(reference, output)) {
+                std::cout << "  reference updated" << std::endl;
+            } else {
+                std::cout << "  FAILED to write " << reference << std::endl;
+                ++failures;
+            }
+            continue;
+        }
+        if (!loadImage(reference, expected)) {
+            std::cout << "  FAILED, no reference " << reference << ", run with --update" << std::endl;
+            ++failures;
+            continue;
+        }
+        if (output.width != expected.width || output.height != expected.height) {
+            std::cout << "  FAILED, " << output.width << "x" << output.height << " against a " << expected.width
+                      << "x" << expected.height << " reference" << std::endl;
+            ++failures;
+            continue;
+        }
+        std::vector<unsigned char> diff;
+        Comparison comparison = compareImages(output, expected, maxDelta, diff);
+        bool passed = comparison.offFraction <= maxOffFraction;
+        std::cout << "  delta E mean " << comparison.meanDelta << " max " << comparison.maxDelta << ", "
+                  << comparison.offFraction * 100.0 << "% off";
+        std::string diffPath = outputDirectory + "/" + golden.name + "_diff.png";
+        if (passed) {
+            std::remove(diffPath.c_str());
+            std::cout << "  passed" << std::endl;
+        } else {
+            writePng(diffPath.c_str(), output.width, output.height, 3, diff.data());
+            std::cout << "  FAILED, see " << diffPath << std::endl;
+            ++failures;
+        }
+    }
+    if (update) {
+        // Cases left out with --only keep their reference times, cases that
+        // are gone lose them
+        for (unsigned int i = 0; i < referenceTimings.size(); ++i) {
+            bool replaced = false, known = false;
+            for (unsigned int j = 0; j < newTimings.size(); ++j)
+                replaced = replaced || newTimings[j].first == referenceTimings[i].first;
+            for (int c = 0; c < CASE_COUNT; ++c)
+                known = known || referenceTimings[i].first == CASES[c].name;
+            if (!replaced && known)
+                newTimings.push_back(referenceTimings[i]);
+        }
+        std::ofstream file(referenceDirectory + "/timings.csv");
+        file << "case,mean ms" << std::endl;
+        for (unsigned int i = 0; i < newTimings.size(); ++i)
+            file << newTimings[i].first << "," << newTimings[i].second << std::endl;
+    }
+
+    if (ran == 0)
+        std::cout << "No case named " << (only ? only : "") << std::endl;
+    std::cout << (failures || ran == 0 ? "FAILED" : "All images match") << std::endl;
+    return failures || ran == 0 ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+//
+// The GPU instance culling of GpuInstanceCuller.h replayed on the CPU,
+// without an OpenGL context, against the cullSpheres reference:
+//   - the test of shaders/InstanceCull.geom, written the way the shader
+//     evaluates it, keeps the same asteroids as cullSpheres for cameras
+//     outside, on and above the ring, apart from spheres within rounding
+//     distance of a plane (the 1e-4 the V check of AsteroidField allows),
+//   - transform feedback appends the survivors in vertex order, which is
+//     the increasing index order cullSpheres returns,
+//   - the count blended into the R32F pixel, 2^-32 per survivor, reads
+//     back through GL_UNSIGNED_INT as the exact count, up to 2^24.
+// Then cullSpheres is timed for the default field of AsteroidField and
+// for a field of 20000.
+//
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "InstanceCulling.h"
+#include "BenchCommon.h"
+
+// Frames each field is culled for when timing
+const int TIMED_FRAMES = 200;
+
+// Bounding spheres placed like the asteroids of AsteroidField, a ring of
+// radius 10 around the planet
+std::vector<glm::vec4> asteroidSpheres(int count)
+{
+    std::vector<glm::vec4> spheres(count);
+    for (int i = 0; i < count; ++i) {
+        float x = randomFloat(-10.0f, 10.0f);
+        glm::vec3 position(x, 0.0f, (i % 2 ? -1.0f : 1.0f) * std::sqrt(100.0f - x * x));
+        position += glm::vec3(randomFloat(0.0f, 1.0f), randomFloat(0.0f, 1.0f), randomFloat(0.0f, 1.0f));
+        spheres[i] = glm::vec4(position, randomFloat(0.0f, 0.3f));
+    }
+    return spheres;
+}
+
+// InstanceCull.vert and .geom over every sphere, appending survivors the
+// way transform feedback does, and the blended count pixel
+void shaderCull(const std::vector<glm::vec4> &spheres, const Frustum &frustum, std::vector<unsigned int> &visible,
+                float &countPixel)
+{
+    const float SURVIVOR = std::ldexp(1.0f, -32);
+    visible.clear();
+    countPixel = 0.0f;
+    for (unsigned int vertexID = 0; vertexID < spheres.size(); ++vertexID) {
+        const glm::vec4 &sphere = spheres[vertexID];
+        bool culled = false;
+        for (int i = 0; i < 6 && !culled; ++i) {
+            const glm::vec4 &plane = frustum.planes[i];
+            culled = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w < 0.0f;
+        }
+        if (!culled) {
+            visible.push_back(vertexID);
+            countPixel += SURVIVOR;
+        }
+    }
+}
+
+// glReadPixels of a float pixel as GL_UNSIGNED_INT: clamped to [0, 1] and
+// scaled to 2^32 - 1
+uint32_t readCount(float pixel)
+{
+    return (uint32_t)std::llround(std::min(std::max((double)pixel, 0.0), 1.0) * 4294967295.0);
+}
+
+bool matchChecks()
+{
+    bool ok = true;
+    std::vector<glm::vec4> spheres = asteroidSpheres(20000);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    struct View {
+        const char *name;
+        glm::vec3 eye, target;
+    };
+    const View views[] = {
+            { "start of the demo", glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 9.0f) },
+            { "outside the ring", glm::vec3(0.0f, 2.0f, 30.0f), glm::vec3(0.0f) },
+            { "on the ring", glm::vec3(10.0f, 0.5f, 0.0f), glm::vec3(0.0f, 0.5f, 10.0f) },
+            { "above the planet", glm::vec3(0.0f, 25.0f, 0.1f), glm::vec3(0.0f) },
+            { "looking away", glm::vec3(0.0f, 0.0f, 40.0f), glm::vec3(0.0f, 0.0f, 50.0f) },
+    };
+    std::vector<unsigned int> cpuVisible, gpuVisible, differences;
+    for (const View &view : views) {
+        Frustum frustum = extractFrustum(projection * glm::lookAt(view.eye, view.target, glm::vec3(0, 1, 0)));
+        cullSpheres(spheres, frustum, cpuVisible);
+        float countPixel;
+        shaderCull(spheres, frustum, gpuVisible, countPixel);
+
+        differences.clear();
+        std::set_symmetric_difference(gpuVisible.begin(), gpuVisible.end(), cpuVisible.begin(), cpuVisible.end(),
+                                      std::back_inserter(differences));
+        unsigned int mismatches = 0;
+        for (unsigned int i = 0; i < differences.size(); ++i) {
+            if (std::abs(sphereFrustumDistance(frustum, spheres[differences[i]])) > 1.0e-4f)
+                ++mismatches;
+        }
+        bool ordered = std::is_sorted(gpuVisible.begin(), gpuVisible.end());
+        uint32_t count = readCount(countPixel);
+        std::cout << "  " << view.name << ": " << cpuVisible.size() << " visible, " << gpuVisible.size()
+                  << " from the shader path, count pixel reads " << count << std::endl;
+        if (mismatches > 0 || !ordered || count != gpuVisible.size()) {
+            std::cout << "  " << mismatches << " mismatches" << (ordered ? "" : ", out of order") << std::endl;
+            ok = false;
+        }
+    }
+
+    // The largest count the pixel holds exactly; one more survivor is lost
+    // in the rounding of the blend
+    const float SURVIVOR = std::ldexp(1.0f, -32);
+    float countPixel = 0.0f;
+    uint32_t limit = 1u << 24;
+    for (uint32_t i = 0; i < limit; ++i)
+        countPixel += SURVIVOR;
+    uint32_t atLimit = readCount(countPixel), pastLimit = readCount(countPixel + SURVIVOR);
+    std::cout << "  2^24 survivors read back as " << atLimit << ", one more as " << pastLimit << std::endl;
+    if (atLimit != limit) {
+        std::cout << "  the count is not exact up to 2^24" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+void timeCulling(int count)
+{
+    std::vector<glm::vec4> spheres = asteroidSpheres(count);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    std::vector<unsigned int> visible;
+    size_t kept = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < TIMED_FRAMES; ++frame) {
+        float angle = 6.2831853f * frame / TIMED_FRAMES;
+        glm::vec3 eye(std::sin(angle) * 12.0f, 1.0f, std::cos(angle) * 12.0f);
+        cullSpheres(spheres, extractFrustum(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0, 1, 0))),
+                    visible);
+        kept += visible.size();
+    }
+    double milliseconds = millisecondsSince(start) / TIMED_FRAMES;
+    std::cout << "cullSpheres over " << count << " asteroids: " << milliseconds << " ms per frame, "
+              << kept / TIMED_FRAMES << " visible on average" << std::endl;
+}
+
+int main()
+{
+    srand(5);
+    std::cout << "Shader path against cullSpheres over 20000 asteroids:" << std::endl;
+    bool failed = !matchChecks();
+    timeCulling(500);
+    timeCulling(20000);
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+//
+// Work stealing job system checks and scaling, without an OpenGL context.
+// Correctness under contention:
+//   - one owner pushes and takes while three threads steal from the same
+//     deque, every item has to come out exactly once,
+//   - forEach visits every index exactly once over many batches,
+//   - jobs spawning children on their parent's counter, three levels
+//     deep, are all done when wait on the root counter returns,
+//   - threads outside the pool submit and wait concurrently,
+//   - a parallelFor inside every job of a forEach (waiting inside jobs).
+// Scaling: model and normal matrices of 1M orbiting asteroids, like the
+// AsteroidField instance update, on 1 .. N threads.
+//
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "JobPool.h"
+#include "NormalMatrix.h"
+#include "BenchCommon.h"
+
+// Returns how many items did not come out exactly once
+unsigned int dequeContention(unsigned int items, unsigned int thieves)
+{
+    // Small ring so it has to grow while thieves read from it
+    WorkStealingDeque<uint32_t> deque(16);
+    std::vector<std::atomic<unsigned int> > seen(items);
+    for (unsigned int i = 0; i < items; ++i)
+        seen[i].store(0);
+    std::atomic<bool> pushing(true);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < thieves; ++t) {
+        threads.emplace_back([&]() {
+            uint32_t item;
+            while (pushing.load() || !deque.empty()) {
+                if (deque.steal(item))
+                    seen[item].fetch_add(1);
+            }
+        });
+    }
+    uint32_t item;
+    for (unsigned int i = 0; i < items; ++i) {
+        deque.push(i);
+        // Take back about a third, so owner and thieves race for the
+        // last item often
+        if (i % 3 == 0 && deque.take(item))
+            seen[item].fetch_add(1);
+    }
+    while (deque.take(item))
+        seen[item].fetch_add(1);
+    pushing.store(false);
+    for (unsigned int t = 0; t < threads.size(); ++t)
+        threads[t].join();
+    unsigned int wrong = 0;
+    for (unsigned int i = 0; i < items; ++i)
+        wrong += seen[i].load() != 1;
+    return wrong;
+}
+
+unsigned int forEachCoverage(JobPool &pool, unsigned int count, unsigned int batches)
+{
+    std::vector<std::atomic<unsigned int> > visits(count);
+    for (unsigned int i = 0; i < count; ++i)
+        visits[i].store(0);
+    for (unsigned int b = 0; b < batches; ++b)
+        pool.forEach(count, [&](size_t i) { visits[i].fetch_add(1, std::memory_order_relaxed); });
+    unsigned int wrong = 0;
+    for (unsigned int i = 0; i < count; ++i)
+        wrong += visits[i].load() != batches;
+    return wrong;
+}
+
+void spawnTree(JobPool &pool, JobCounter &counter, std::atomic<unsigned int> &leaves, int depth)
+{
+    if (depth == 0) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    for (int c = 0; c < 16; ++c)
+        pool.run(counter, [&pool, &counter, &leaves, depth]() { spawnTree(pool, counter, leaves, depth - 1); });
+}
+
+// Returns how many leaves were missing when wait returned
+unsigned int parentChild(JobPool &pool)
+{
+    unsigned int missing = 0;
+    for (int round = 0; round < 20; ++round) {
+        JobCounter counter;
+        std::atomic<unsigned int> leaves(0);
+        spawnTree(pool, counter, leaves, 3);
+        pool.wait(counter);
+        missing += 16 * 16 * 16 - leaves.load();
+    }
+    return missing;
+}
+
+unsigned int outsideSubmitters(JobPool &pool, unsigned int submitters)
+{
+    std::atomic<unsigned int> wrong(0);
+    std::vector<std::thread> threads;
+    for (unsigned int s = 0; s < submitters; ++s) {
+        threads.emplace_back([&pool, &wrong]() {
+            for (int round = 0; round < 50; ++round) {
+                JobCounter counter;
+                std::atomic<unsigned int> ran(0);
+                for (int j = 0; j < 100; ++j)
+                    pool.run(counter, [&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+                pool.wait(counter);
+                wrong.fetch_add(100 - ran.load());
+            }
+        });
+    }
+    for (unsigned int s = 0; s < threads.size(); ++s)
+        threads[s].join();
+    return wrong.load();
+}
+
+unsigned int nestedLoops(JobPool &pool)
+{
+    const unsigned int outer = 64, inner = 10000;
+    std::vector<unsigned long long> sums(outer, 0);
+    pool.forEach(outer, [&](size_t o) {
+        std::atomic<unsigned long long> sum(0);
+        pool.parallelFor(inner, 256, [&](size_t begin, size_t end) {
+            unsigned long long local = 0;
+            for (size_t i = begin; i < end; ++i)
+                local += i;
+            sum.fetch_add(local);
+        });
+        sums[o] = sum.load();
+    });
+    unsigned int wrong = 0;
+    for (unsigned int o = 0; o < outer; ++o)
+        wrong += sums[o] != (unsigned long long)inner * (inner - 1) / 2;
+    return wrong;
+}
+
+struct Orbit {
+    float radius, angle, speed, height, spin, scale;
+    glm::vec3 axis;
+};
+
+void updateAsteroids(const std::vector<Orbit> &orbits, float time, size_t begin, size_t end,
+                     glm::mat4 *models, PackedNormalMatrix *normals)
+{
+    for (size_t i = begin; i < end; ++i) {
+        const Orbit &o = orbits[i];
+        float angle = o.angle + o.speed * time;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(std::sin(angle) * o.radius, o.height,
+                                                                     std::cos(angle) * o.radius));
+        model = glm::rotate(model, o.spin * time, o.axis);
+        models[i] = glm::scale(model, glm::vec3(o.scale));
+    }
+    computeNormalMatrices(models + begin, normals + begin, end - begin);
+}
+
+int main(int argc, char *argv[])
+{
+    const int amount = argc > 1 ? atoi(argv[1]) : 1000000;
+    const unsigned int hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    // Always try a few threads, even on small machines, to exercise stealing
+    const unsigned int maxThreads = std::max(hardware, 4u);
+    bool failed = false;
+
+    unsigned int dequeWrong = dequeContention(2000000, 3);
+    unsigned int coverageWrong = 0, treeMissing = 0, outsideWrong = 0, nestedWrong = 0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+        JobPool pool(threads);
+        coverageWrong += forEachCoverage(pool, 10000, 100);
+        treeMissing += parentChild(pool);
+        outsideWrong += outsideSubmitters(pool, 4);
+        nestedWrong += nestedLoops(pool);
+    }
+    if (dequeWrong || coverageWrong || treeMissing || outsideWrong || nestedWrong) {
+        std::cout << dequeWrong << " deque items not taken exactly once, " << coverageWrong
+                  << " forEach indices not visited once per batch, " << treeMissing
+                  << " child jobs unfinished after wait, " << outsideWrong
+                  << " jobs from outside threads unfinished, " << nestedWrong << " nested loops wrong"
+                  << std::endl;
+        failed = true;
+    }
+
+    srand(1);
+    std::vector<Orbit> orbits(amount);
+    for (int i = 0; i < amount; ++i) {
+        Orbit &o = orbits[i];
+        o.radius = 150.0f + randomFloat(-25.0f, 25.0f);
+        o.angle = randomFloat(0.0f, 6.2832f);
+        o.speed = randomFloat(0.01f, 0.05f);
+        o.height = randomFloat(-2.5f, 2.5f);
+        o.spin = randomFloat(0.1f, 1.0f);
+        o.scale = randomFloat(0.05f, 0.25f);
+        o.axis = glm::normalize(glm::vec3(randomFloat(0.1f, 1.0f), randomFloat(0.1f, 1.0f), randomFloat(0.1f, 1.0f)));
+    }
+    std::vector<glm::mat4> models(amount), reference(amount);
+    std::vector<PackedNormalMatrix> normals(amount), referenceNormals(amount);
+    updateAsteroids(orbits, 1.0f, 0, amount, reference.data(), referenceNormals.data());
+
+    std::cout << amount << " asteroid transforms, " << hardware << " hardware threads" << std::endl;
+    const int frames = 10;
+    double singleMs = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; ++threads) {
+        JobPool pool(threads);
+        auto update = [&](float time) {
+            pool.parallelFor(amount, 4096, [&](size_t begin, size_t end) {
+                updateAsteroids(orbits, time, begin, end, models.data(), normals.data());
+            });
+        };
+        update(0.0f);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int f = 0; f < frames; ++f)
+            update(1.0f);
+        double ms = millisecondsSince(start) / frames;
+        if (threads == 1)
+            singleMs = ms;
+        // Normal matrices may take the SSE or the scalar path depending
+        // on where the ranges split
+        bool same = true;
+        for (int i = 0; i < amount && same; ++i) {
+            same = models[i] == reference[i];
+            for (int c = 0; c < 3; ++c) {
+                glm::vec4 d = glm::abs(normals[i].columns[c] - referenceNormals[i].columns[c]);
+                float size = glm::length(referenceNormals[i].columns[c]);
+                same = same && std::max(std::max(d.x, d.y), d.z) <= 1.0e-5f * size;
+            }
+        }
+        if (!same) {
+            std::cout << "  " << threads << " threads give different matrices than one" << std::endl;
+            failed = true;
+        }
+        std::cout << "  " << threads << " threads: " << ms << " ms per update, speedup " << singleMs / ms
+                  << ", efficiency " << 100.0 * singleMs / ms / threads << "%" << std::endl;
+    }
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+//
+// Measures how long LightClusterGrid takes to bin 10k point lights,
+// and checks every cluster's lights against a brute force sphere/AABB test.
+// Does not need an OpenGL context.
+//
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "LightCluster.h"
+
+// Scalar reference: test every light against every cluster. Returns the
+// lights of each cluster in ascending order, clusters ordered like
+// LightClusterGrid::clusterRanges.
+std::vector<std::vector<unsigned int> > binBruteForce(const glm::mat4 &view, const std::vector<ClusterLight> &lights,
+                                                      float fovY, float aspect, float near, float far)
+{
+    glm::mat4 invProjection = glm::inverse(glm::perspective(fovY, aspect, near, far));
+    const int tx = LightClusterGrid::TILES_X, ty = LightClusterGrid::TILES_Y;
+    std::vector<std::vector<unsigned int> > clusters(LightClusterGrid::CLUSTER_COUNT);
+    for (int z = 0; z < LightClusterGrid::SLICES; ++z) {
+        float sliceNear = near * std::pow(far / near, (float)z / LightClusterGrid::SLICES);
+        float sliceFar = near * std::pow(far / near, (float)(z + 1) / LightClusterGrid::SLICES);
+        for (int y = 0; y < ty; ++y) {
+            for (int x = 0; x < tx; ++x) {
+                glm::vec3 lo(1.0e30f), hi(-1.0e30f);
+                for (int corner = 0; corner < 4; ++corner) {
+                    glm::vec4 p = invProjection * glm::vec4(-1.0f + 2.0f * (x + (corner & 1)) / tx,
+                                                            -1.0f + 2.0f * (y + (corner >> 1)) / ty,
+                                                            -1.0f, 1.0f);
+                    glm::vec3 dir = glm::vec3(p) / -p.z;
+                    lo = glm::min(lo, glm::min(dir * sliceNear, dir * sliceFar));
+                    hi = glm::max(hi, glm::max(dir * sliceNear, dir * sliceFar));
+                }
+                std::vector<unsigned int> &cluster = clusters[(z * ty + y) * tx + x];
+                for (unsigned int i = 0; i < lights.size(); ++i) {
+                    glm::vec3 c = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+                    glm::vec3 d = glm::max(lo - c, glm::vec3(0.0f)) + glm::max(c - hi, glm::vec3(0.0f));
+                    if (glm::dot(d, d) <= lights[i].radius * lights[i].radius)
+                        cluster.push_back(i);
+                }
+            }
+        }
+    }
+    return clusters;
+}
+
+// Every cluster's (offset, count) has to cover the next part of
+// lightIndices and hold the same lights as the reference, in any order
+bool matchesReference(const LightClusterGrid &grid, const std::vector<std::vector<unsigned int> > &reference)
+{
+    unsigned int offset = 0;
+    for (int c = 0; c < LightClusterGrid::CLUSTER_COUNT; ++c) {
+        unsigned int first = grid.clusterRanges[2 * c], count = grid.clusterRanges[2 * c + 1];
+        if (first != offset || count != reference[c].size() || first + count > grid.lightIndices.size()) {
+            std::cout << "Mismatch in cluster " << c << ": offset " << first << ", " << count
+                      << " lights, brute force found " << reference[c].size() << std::endl;
+            return false;
+        }
+        std::vector<unsigned int> binned(grid.lightIndices.begin() + first,
+                                         grid.lightIndices.begin() + first + count);
+        std::sort(binned.begin(), binned.end());
+        if (binned != reference[c]) {
+            std::cout << "Mismatch in cluster " << c << ": different lights than brute force" << std::endl;
+            return false;
+        }
+        offset += count;
+    }
+    if (offset != grid.lightIndices.size()) {
+        std::cout << "Mismatch: " << grid.lightIndices.size() - offset << " entries outside every cluster"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int lightCount = argc > 1 ? atoi(argv[1]) : 10000;
+    const int iterations = 100;
+    const float fovY = glm::radians(45.0f), aspect = 16.0f / 9.0f;
+    const float near = 0.1f, far = 100.0f;
+
+    srand(1);
+    std::vector<ClusterLight> lights;
+    for (int i = 0; i < lightCount; ++i) {
+        ClusterLight light;
+        light.position = glm::vec3(rand() % 10000 / 50.0f - 100.0f, rand() % 1000 / 100.0f,
+                                   rand() % 10000 / 50.0f - 100.0f);
+        light.ambient = light.diffuse = light.specular = glm::vec3(1.0f);
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.quadratic = 1.8f;
+        light.radius = LightClusterGrid::attenuationRadius(light.constant, light.linear,
+                                                           light.quadratic);
+        lights.push_back(light);
+    }
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(0.0f, 3.0f, -10.0f),
+                                 glm::vec3(0.0f, 1.0f, 0.0f));
+
+    LightClusterGrid grid;
+    grid.setProjection(fovY, aspect, near, far);
+    // Warm up so the vectors reach their steady state capacity
+    grid.build(view, lights);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        grid.build(view, lights);
+    auto end = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+
+    std::vector<std::vector<unsigned int> > reference = binBruteForce(view, lights, fovY, aspect, near, far);
+    std::cout << "Binned " << lightCount << " lights into " << LightClusterGrid::CLUSTER_COUNT
+              << " clusters: " << ms << " ms per build, "
+              << grid.lightIndices.size() << " entries" << std::endl;
+    if (!matchesReference(grid, reference))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,170 @@
+//
+// Builds meshlets for the nanosuit (or the OBJ given as the first argument)
+// and checks them, without an OpenGL context:
+//   - every input triangle is in exactly one meshlet, with its winding,
+//   - no meshlet has more than 64 vertices or 124 triangles,
+//   - building twice gives the same result,
+//   - bounding spheres hold their vertices,
+//   - from 1000 random viewpoints no meshlet rejected by its cone has a
+//     front facing triangle and none rejected by the frustum has a vertex
+//     inside it.
+// Also reports the build time and how much culling removes per view.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Meshlets.h"
+#include "BenchCommon.h"
+
+// Triangles rotated to start at their smallest index, then sorted
+std::vector<glm::uvec3> canonicalTriangles(const std::vector<unsigned int> &indices)
+{
+    std::vector<glm::uvec3> triangles;
+    for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+        glm::uvec3 t(indices[i], indices[i + 1], indices[i + 2]);
+        while (t.x > t.y || t.x > t.z)
+            t = glm::uvec3(t.y, t.z, t.x);
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end(), [](const glm::uvec3 &a, const glm::uvec3 &b) {
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    });
+    return triangles;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "models/nanosuit/nanosuit.obj";
+    std::vector<BenchVertex> vertices;
+    std::vector<unsigned int> original;
+    if (!loadObj(path, vertices, original, true)) {
+        std::cout << "Failed to open " << path << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned int> indices = original;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<Meshlet> meshlets = buildMeshlets(vertices, indices);
+    double buildMs = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+
+    bool failed = false;
+    if (canonicalTriangles(indices) != canonicalTriangles(original)) {
+        std::cout << "Meshlets do not cover every triangle exactly once" << std::endl;
+        failed = true;
+    }
+
+    std::vector<unsigned int> again = original;
+    std::vector<Meshlet> meshletsAgain = buildMeshlets(vertices, again);
+    bool same = again == indices && meshletsAgain.size() == meshlets.size();
+    for (unsigned int i = 0; same && i < meshlets.size(); ++i)
+        same = meshlets[i].firstIndex == meshletsAgain[i].firstIndex &&
+               meshlets[i].sphere == meshletsAgain[i].sphere &&
+               meshlets[i].coneApex == meshletsAgain[i].coneApex &&
+               meshlets[i].coneCutoff == meshletsAgain[i].coneCutoff;
+    if (!same) {
+        std::cout << "Building twice gave different meshlets" << std::endl;
+        failed = true;
+    }
+
+    unsigned int covered = 0, oversized = 0, outside = 0, cullable = 0;
+    double vertexSum = 0.0;
+    for (unsigned int m = 0; m < meshlets.size(); ++m) {
+        const Meshlet &meshlet = meshlets[m];
+        if (meshlet.firstIndex != covered)
+            failed = true;
+        covered += meshlet.indexCount;
+        if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.indexCount / 3 > MESHLET_MAX_TRIANGLES)
+            ++oversized;
+        vertexSum += meshlet.vertexCount;
+        if (meshlet.coneCutoff <= 1.0f)
+            ++cullable;
+        for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i) {
+            if (glm::length(vertices[indices[i]].position - glm::vec3(meshlet.sphere)) > meshlet.sphere.w * 1.0001f + 1.0e-6f)
+                ++outside;
+        }
+    }
+    if (covered != indices.size() || oversized || outside) {
+        std::cout << "Ranges cover " << covered << " of " << indices.size() << " indices, " << oversized
+                  << " meshlets too large, " << outside << " vertices outside their sphere" << std::endl;
+        failed = true;
+    }
+
+    // Random viewpoints around the model, looking at it
+    glm::vec3 lo = vertices[0].position, hi = lo;
+    for (unsigned int i = 1; i < vertices.size(); ++i) {
+        lo = glm::min(lo, vertices[i].position);
+        hi = glm::max(hi, vertices[i].position);
+    }
+    glm::vec3 center = 0.5f * (lo + hi);
+    float radius = 0.5f * glm::length(hi - lo);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.01f * radius, 100.0f * radius);
+
+    srand(1);
+    const int views = 1000;
+    unsigned int wrongCone = 0, wrongFrustum = 0;
+    double trianglesTotal = 0.0, trianglesDrawn = 0.0, coneCulled = 0.0, rangeSum = 0.0, cullMs = 0.0;
+    std::vector<IndexRange> ranges;
+    for (int v = 0; v < views; ++v) {
+        glm::vec3 direction = glm::normalize(glm::vec3(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f),
+                                                       randomFloat(-1.0f, 1.0f)) + glm::vec3(0.0f, 0.0f, 1.0e-3f));
+        glm::vec3 eye = center + direction * radius * randomFloat(0.6f, 3.0f);
+        glm::vec3 target = center + glm::vec3(randomFloat(-0.5f, 0.5f), randomFloat(-0.5f, 0.5f),
+                                              randomFloat(-0.5f, 0.5f)) * radius;
+        Frustum frustum = extractFrustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        auto cullStart = std::chrono::high_resolution_clock::now();
+        cullMeshlets(meshlets, frustum, eye, ranges);
+        cullMs += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - cullStart).count();
+        rangeSum += ranges.size();
+        trianglesTotal += indices.size() / 3;
+        for (unsigned int r = 0; r < ranges.size(); ++r)
+            trianglesDrawn += ranges[r].indexCount / 3;
+
+        for (unsigned int m = 0; m < meshlets.size(); ++m) {
+            const Meshlet &meshlet = meshlets[m];
+            bool inFrustum = sphereInFrustum(frustum, meshlet.sphere);
+            bool facesAway = meshletFacesAway(meshlet, eye);
+            if (inFrustum && facesAway)
+                coneCulled += meshlet.indexCount / 3;
+            for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                glm::vec3 a = vertices[indices[i]].position, b = vertices[indices[i + 1]].position,
+                          c = vertices[indices[i + 2]].position;
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float scale = glm::length(n) * glm::length(a - eye);
+                if (facesAway && glm::dot(n, eye - a) > 1.0e-4f * scale)
+                    ++wrongCone;
+                if (!inFrustum && (sphereFrustumDistance(frustum, glm::vec4(a, 0.0f)) > 1.0e-4f * radius ||
+                                   sphereFrustumDistance(frustum, glm::vec4(b, 0.0f)) > 1.0e-4f * radius ||
+                                   sphereFrustumDistance(frustum, glm::vec4(c, 0.0f)) > 1.0e-4f * radius))
+                    ++wrongFrustum;
+            }
+        }
+    }
+    if (wrongCone || wrongFrustum) {
+        std::cout << wrongCone << " front facing triangles cone culled, " << wrongFrustum
+                  << " visible triangles frustum culled" << std::endl;
+        failed = true;
+    }
+
+    std::cout << path << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles" << std::endl;
+    std::cout << "  " << meshlets.size() << " meshlets in " << buildMs << " ms, "
+              << vertexSum / meshlets.size() << " vertices and "
+              << indices.size() / 3.0 / meshlets.size() << " triangles on average, "
+              << 100.0 * cullable / meshlets.size() << "% with a usable cone" << std::endl;
+    std::cout << "  per view: " << cullMs / views << " ms to cull, "
+              << 100.0 * (1.0 - trianglesDrawn / trianglesTotal) << "% of triangles culled ("
+              << 100.0 * coneCulled / trianglesTotal << "% by cones), " << rangeSum / views
+              << " index ranges" << std::endl;
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+//
+// Mip levels built on the CPU (MipChain.h), without an OpenGL context.
+//   - level 1 of a black and white sRGB checker is the sRGB value of 50%
+//     light, 188, not the 128 of averaging the stored values (Kaiser
+//     rings a little at that frequency and gets a few steps of slack),
+//   - a flat image stays flat down to 1x1 with either filter,
+//   - box filtering of linear, opaque data is the plain 2x2 average that
+//     glGenerateMipmap gives,
+//   - grass.png alpha tested at 0.1 keeps the coverage of level 0 on every
+//     level of 16x16 or more. Without the cutoff it drifts: at a cutoff
+//     this low the blades get thicker level by level.
+// Then every PNG and JPG under textures/ goes through both filters, as
+// sRGB and as linear data, and is reported in millions of level 0 pixels
+// per second on a JobPool of one thread and of every hardware thread.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <dirent.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "TextureCache.h"
+#include "JobPool.h"
+#include "BenchCommon.h"
+
+// Runs of each image and setting, the fastest counts
+const int RUNS = 3;
+
+std::vector<uint8_t> flatImage(int width, int height, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    std::vector<uint8_t> rgba((size_t)width * height * 4);
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        rgba[i] = r;
+        rgba[i + 1] = g;
+        rgba[i + 2] = b;
+        rgba[i + 3] = a;
+    }
+    return rgba;
+}
+
+bool gammaChecks()
+{
+    bool ok = true;
+    std::vector<uint8_t> checker = flatImage(64, 64, 0, 0, 0, 255);
+    for (int y = 0; y < 64; ++y) {
+        for (int x = 0; x < 64; ++x) {
+            if ((x + y) % 2)
+                std::fill(&checker[((size_t)y * 64 + x) * 4], &checker[((size_t)y * 64 + x) * 4 + 3], 255);
+        }
+    }
+    std::vector<std::vector<uint8_t> > levels;
+    for (int filter = MIP_BOX; filter <= MIP_KAISER; ++filter) {
+        MipOptions options = { (MipFilter)filter, true, 0.0f };
+        buildMipChain(checker.data(), 64, 64, options, levels);
+        int worst = 0;
+        for (size_t i = 0; i < levels[1].size(); i += 4)
+            worst = std::max(worst, std::abs((int)levels[1][i] - 188));
+        if (worst > (filter == MIP_BOX ? 1 : 6)) {
+            std::cout << "Level 1 of the sRGB checker is off 188 by " << worst << (filter ? " (Kaiser)" : " (box)")
+                      << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool flatChecks()
+{
+    bool ok = true;
+    // Not a power of two, so odd sizes and the 1 texel wide levels show
+    std::vector<uint8_t> flat = flatImage(100, 37, 200, 90, 17, 160);
+    std::vector<std::vector<uint8_t> > levels;
+    for (int filter = MIP_BOX; filter <= MIP_KAISER; ++filter) {
+        for (int srgb = 0; srgb < 2; ++srgb) {
+            MipOptions options = { (MipFilter)filter, srgb != 0, 0.0f };
+            buildMipChain(flat.data(), 100, 37, options, levels);
+            int worst = 0;
+            for (unsigned int l = 0; l < levels.size(); ++l) {
+                for (size_t i = 0; i < levels[l].size(); ++i)
+                    worst = std::max(worst, std::abs((int)levels[l][i] - (int)flat[i % 4]));
+            }
+            if (levels.size() != 7 || levels.back().size() != 4 || worst > 1) {
+                std::cout << "A flat image is off by " << worst << " in " << levels.size() << " levels"
+                          << (filter ? " (Kaiser" : " (box") << (srgb ? ", sRGB)" : ")") << std::endl;
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+bool boxChecks()
+{
+    std::vector<uint8_t> noise = flatImage(128, 128, 0, 0, 0, 255);
+    srand(11);
+    for (size_t i = 0; i < noise.size(); ++i)
+        noise[i] = i % 4 == 3 ? 255 : (uint8_t)(rand() % 256);
+    std::vector<std::vector<uint8_t> > levels;
+    MipOptions options = { MIP_BOX, false, 0.0f };
+    buildMipChain(noise.data(), 128, 128, options, levels);
+    int worst = 0;
+    for (int y = 0; y < 64; ++y) {
+        for (int x = 0; x < 64; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                int sum = 0;
+                for (int d = 0; d < 4; ++d)
+                    sum += noise[((size_t)(2 * y + d / 2) * 128 + 2 * x + d % 2) * 4 + c];
+                worst = std::max(worst, std::abs((int)levels[1][((size_t)y * 64 + x) * 4 + c] - (sum + 2) / 4));
+            }
+        }
+    }
+    if (worst > 1) {
+        std::cout << "Box filtering of linear data is off the 2x2 average by " << worst << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool coverageChecks()
+{
+    const float CUTOFF = 0.1f;
+    int width, height, components;
+    unsigned char *data = stbi_load("textures/grass.png", &width, &height, &components, 0);
+    if (!data) {
+        std::cout << "Failed to load textures/grass.png" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> rgba = expandToRgba(data, width, height, components);
+    stbi_image_free(data);
+
+    std::vector<std::vector<uint8_t> > kept, plain;
+    MipOptions options = { MIP_KAISER, true, CUTOFF };
+    buildMipChain(rgba.data(), width, height, options, kept);
+    options.alphaCutoff = 0.0f;
+    buildMipChain(rgba.data(), width, height, options, plain);
+
+    bool ok = true;
+    float coverage = alphaCoverage(kept[0].data(), width, width, height, CUTOFF);
+    std::cout << "grass.png coverage at " << CUTOFF << ", kept / not kept:" << std::endl;
+    std::cout << std::setprecision(3);
+    for (unsigned int l = 0; l < kept.size(); ++l) {
+        int w = std::max(width >> l, 1), h = std::max(height >> l, 1);
+        float withCutoff = alphaCoverage(kept[l].data(), w, w, h, CUTOFF);
+        float without = alphaCoverage(plain[l].data(), w, w, h, CUTOFF);
+        std::cout << "  level " << l << " (" << w << "x" << h << "): " << withCutoff << " / " << without << std::endl;
+        if (w >= 16 && h >= 16 && std::fabs(withCutoff - coverage) > 0.02f) {
+            std::cout << "  coverage of level " << l << " is not kept" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+std::vector<std::string> listImages(const std::string &directory)
+{
+    std::vector<std::string> paths;
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return paths;
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        std::string extension = name.size() > 4 ? name.substr(name.size() - 4) : "";
+        if (extension == ".png" || extension == ".jpg")
+            paths.push_back(directory + "/" + name);
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+int main()
+{
+    bool failed = !gammaChecks();
+    failed = !flatChecks() || failed;
+    failed = !boxChecks() || failed;
+    failed = !coverageChecks() || failed;
+
+    std::vector<std::string> paths = listImages("textures");
+    std::vector<std::vector<uint8_t> > images;
+    std::vector<std::pair<int, int> > sizes;
+    double megapixels = 0.0;
+    for (unsigned int i = 0; i < paths.size(); ++i) {
+        int width, height, components;
+        unsigned char *data = stbi_load(paths[i].c_str(), &width, &height, &components, 0);
+        if (!data) {
+            std::cout << "Failed to load " << paths[i] << std::endl;
+            failed = true;
+            continue;
+        }
+        images.push_back(expandToRgba(data, width, height, components));
+        sizes.push_back(std::make_pair(width, height));
+        megapixels += width * height / 1.0e6;
+        stbi_image_free(data);
+    }
+
+    unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << images.size() << " images under textures/, " << megapixels << " MPix at level 0:" << std::endl;
+    std::vector<std::vector<uint8_t> > levels;
+    for (int filter = MIP_BOX; filter <= MIP_KAISER; ++filter) {
+        for (int srgb = 1; srgb >= 0; --srgb) {
+            std::cout << "  " << (filter ? "Kaiser" : "box   ") << (srgb ? " sRGB  " : " linear");
+            for (unsigned int threads = 1; ; threads = hardwareThreads) {
+                JobPool pool(threads);
+                double fastest = 0.0;
+                for (int run = 0; run < RUNS; ++run) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    for (unsigned int i = 0; i < images.size(); ++i) {
+                        MipOptions options = { (MipFilter)filter, srgb != 0, 0.0f };
+                        buildMipChain(images[i].data(), sizes[i].first, sizes[i].second, options, levels, &pool);
+                    }
+                    double milliseconds = millisecondsSince(start);
+                    fastest = run == 0 ? milliseconds : std::min(fastest, milliseconds);
+                }
+                std::cout << "  " << std::setw(7) << megapixels / (fastest / 1000.0) << " MPix/s on " << threads
+                          << (threads == 1 ? " thread" : " threads");
+                if (threads == hardwareThreads)
+                    break;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
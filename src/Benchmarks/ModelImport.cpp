@@ -0,0 +1,93 @@
+//
+// Import time of ModelImporter (the CPU side of Model) against the number
+// of threads, on the nanosuit and on a generated OBJ with 100 meshes.
+// Usage: ModelImport [max threads], run from the repository root.
+// Does not need an OpenGL context.
+//
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+
+#include "ModelImporter.h"
+
+// 100 UV spheres, one object each, with normals and texture coordinates
+void writeSyntheticObj(const char *path, int meshCount, int rings, int segments)
+{
+    std::ofstream file(path);
+    int base = 1;
+    for (int m = 0; m < meshCount; ++m) {
+        file << "o Sphere" << m << "\n";
+        glm::vec3 center((m % 10) * 3.0f, (m / 10) * 3.0f, 0.0f);
+        for (int r = 0; r <= rings; ++r) {
+            float theta = 3.14159265f * r / rings;
+            for (int s = 0; s <= segments; ++s) {
+                float phi = 2.0f * 3.14159265f * s / segments;
+                glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta),
+                            std::sin(theta) * std::sin(phi));
+                glm::vec3 p = center + n;
+                file << "v " << p.x << " " << p.y << " " << p.z << "\n";
+                file << "vn " << n.x << " " << n.y << " " << n.z << "\n";
+                file << "vt " << (float)s / segments << " " << (float)r / rings << "\n";
+            }
+        }
+        for (int r = 0; r < rings; ++r) {
+            for (int s = 0; s < segments; ++s) {
+                int a = base + r * (segments + 1) + s, b = a + segments + 1;
+                file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " "
+                     << b + 1 << "/" << b + 1 << "/" << b + 1 << " "
+                     << a + 1 << "/" << a + 1 << "/" << a + 1 << "\n";
+            }
+        }
+        base += (rings + 1) * (segments + 1);
+    }
+}
+
+void benchmark(const char *path, unsigned int maxThreads)
+{
+    std::cout << path << std::endl;
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+        // Best of three, the first run also warms the file cache
+        double best = 1.0e30, read = 0.0, convert = 0.0, tangents = 0.0;
+        size_t vertices = 0, meshes = 0, images = 0;
+        JobPool pool(threads);
+        for (int run = 0; run < 3; ++run) {
+            ModelImporter importer;
+            if (!importer.import(path, &pool))
+                return;
+            double total = importer.readMilliseconds + importer.convertMilliseconds;
+            if (total < best) {
+                best = total;
+                read = importer.readMilliseconds;
+                convert = importer.convertMilliseconds;
+                tangents = importer.tangentMilliseconds;
+            }
+            meshes = importer.meshes.size();
+            images = importer.images.size();
+            vertices = 0;
+            for (unsigned int i = 0; i < importer.meshes.size(); ++i)
+                vertices += importer.meshes[i].vertices.size();
+        }
+        if (threads == 1)
+            std::cout << "  " << meshes << " meshes, " << vertices << " vertices, "
+                      << images << " images" << std::endl;
+        std::cout << "  " << threads << " threads: " << best << " ms (assimp " << read
+                  << " ms, meshes and images " << convert << " ms, tangents " << tangents
+                  << " ms summed over jobs)" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int maxThreads = argc > 1 ? (unsigned int)atoi(argv[1])
+                                       : std::max(std::thread::hardware_concurrency(), 1u);
+    benchmark("models/nanosuit/nanosuit.obj", maxThreads);
+
+    const char *synthetic = "ModelImportSynthetic.obj";
+    writeSyntheticObj(synthetic, 100, 32, 64);
+    benchmark(synthetic, maxThreads);
+    std::remove(synthetic);
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+// Compares three ways to get normal matrices for 1M model matrices:
+// what the shaders used to do per vertex (mat3(transpose(inverse(model)))),
+// the scalar cofactor version and the SSE batch from NormalMatrix.h.
+// Also checks that the batch matches the full inverse.
+// Does not need an OpenGL context.
+//
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "NormalMatrix.h"
+#include "BenchCommon.h"
+
+template <typename F>
+double timeMilliseconds(int iterations, F f)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int iterations = 10;
+
+    // Translation, rotation and non uniform scale, like the asteroid field
+    srand(1);
+    std::vector<glm::mat4> models(count);
+    for (int i = 0; i < count; ++i) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(randomFloat(-50.0f, 50.0f),
+                                                                    randomFloat(-5.0f, 5.0f),
+                                                                    randomFloat(-50.0f, 50.0f)));
+        model = glm::rotate(model, randomFloat(0.0f, 6.28f),
+                            glm::normalize(glm::vec3(randomFloat(-1.0f, 1.0f), 1.0f,
+                                                     randomFloat(-1.0f, 1.0f))));
+        models[i] = glm::scale(model, glm::vec3(randomFloat(0.1f, 2.0f), randomFloat(0.1f, 2.0f),
+                                                randomFloat(0.1f, 2.0f)));
+    }
+
+    std::vector<glm::mat3> reference(count), scalar(count);
+    std::vector<PackedNormalMatrix> batch(count);
+    double inverseMs = timeMilliseconds(iterations, [&]() {
+        for (int i = 0; i < count; ++i)
+            reference[i] = glm::mat3(glm::transpose(glm::inverse(models[i])));
+    });
+    double scalarMs = timeMilliseconds(iterations, [&]() {
+        for (int i = 0; i < count; ++i)
+            scalar[i] = normalMatrix(models[i]);
+    });
+    double batchMs = timeMilliseconds(iterations, [&]() {
+        computeNormalMatrices(models.data(), batch.data(), count);
+    });
+
+    // Relative error, the matrices have very different scales
+    float maxError = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        glm::mat3 n = batch[i].toMat3();
+        for (int c = 0; c < 3; ++c) {
+            glm::vec3 d = glm::abs(n[c] - reference[i][c]) / (glm::abs(reference[i][c]) + 1.0f);
+            maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
+        }
+    }
+
+    std::cout << count << " normal matrices:" << std::endl;
+    std::cout << "  transpose(inverse(mat4)): " << inverseMs << " ms" << std::endl;
+    std::cout << "  cofactor, scalar:         " << scalarMs << " ms" << std::endl;
+#ifdef NORMALMATRIX_USE_SSE
+    std::cout << "  cofactor, SSE batch:      " << batchMs << " ms" << std::endl;
+#else
+    std::cout << "  cofactor, batch (no SSE): " << batchMs << " ms" << std::endl;
+#endif
+    std::cout << "  max relative error: " << maxError << std::endl;
+    if (maxError > 1.0e-4f) {
+        std::cout << "Mismatch against the full inverse" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+//
+// Software occlusion culling of the asteroid field, without an OpenGL
+// context. The planet is the occluder, 100k asteroids in a ring around it
+// are tested, from several cameras on the ring looking across the planet:
+//   - the depth buffer is the same bits with one thread and with all of
+//     them, and lies between a reference rasterization that only counts
+//     pixel centers clearly inside a triangle and one that also counts
+//     those just outside,
+//   - every Hi-Z texel is the farthest of the texels below it,
+//   - for a sample of the asteroids reported hidden, the ray through every
+//     pixel center they cover hits the planet before the asteroid,
+// and reports the render and test times and how many asteroids inside the
+// frustum are hidden.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionCuller.h"
+#include "InstanceCulling.h"
+#include "BenchCommon.h"
+
+// Distance along the ray to the nearest triangle, or a negative number
+double rayHit(const glm::dvec3 &origin, const glm::dvec3 &direction, const std::vector<BenchVertex> &vertices,
+              const std::vector<unsigned int> &indices)
+{
+    double nearest = -1.0;
+    for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+        glm::dvec3 a(vertices[indices[i]].position), b(vertices[indices[i + 1]].position),
+                   c(vertices[indices[i + 2]].position);
+        glm::dvec3 ab = b - a, ac = c - a, p = glm::cross(direction, ac);
+        double determinant = glm::dot(ab, p);
+        if (std::fabs(determinant) < 1.0e-14)
+            continue;
+        glm::dvec3 s = origin - a;
+        double u = glm::dot(s, p) / determinant;
+        glm::dvec3 q = glm::cross(s, ab);
+        double v = glm::dot(direction, q) / determinant;
+        if (u < 0.0 || v < 0.0 || u + v > 1.0)
+            continue;
+        double t = glm::dot(ac, q) / determinant;
+        if (t > 0.0 && (nearest < 0.0 || t < nearest))
+            nearest = t;
+    }
+    return nearest;
+}
+
+int main(int argc, char *argv[])
+{
+    const int amount = argc > 1 ? atoi(argv[1]) : 100000;
+    std::vector<BenchVertex> planet, rock;
+    std::vector<unsigned int> planetIndices, rockIndices;
+    if (!loadObj("models/planet/planet.obj", planet, planetIndices) ||
+        !loadObj("models/rock/rock.obj", rock, rockIndices)) {
+        std::cout << "Failed to open the planet or rock model" << std::endl;
+        return 1;
+    }
+
+    // Ring of asteroids around the planet, like AsteroidField
+    srand(1);
+    glm::vec4 rockSphere = boundingSphere(rock);
+    std::vector<glm::vec4> spheres(amount);
+    for (int i = 0; i < amount; ++i) {
+        float angle = randomFloat(0.0f, 6.2832f);
+        glm::vec3 pos(std::sin(angle) * 10.0f + randomFloat(-1.0f, 1.0f), randomFloat(-0.5f, 0.5f),
+                      std::cos(angle) * 10.0f + randomFloat(-1.0f, 1.0f));
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+        model = glm::rotate(model, randomFloat(0.0f, 6.28f), glm::vec3(0.4f, 0.6f, 0.8f));
+        model = glm::scale(model, glm::vec3(randomFloat(0.0f, 300.0f) / 1800.0f));
+        spheres[i] = transformSphere(model, rockSphere);
+    }
+
+    JobPool jobs, serialJobs(1);
+    OcclusionCuller culler(jobs), serial(serialJobs);
+    const float aspect = (float)culler.width() / culler.height();
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+    bool failed = false;
+    const int cameras = 8;
+    double renderMs = 0.0, serialMs = 0.0, testMs = 0.0, inFrustumTotal = 0.0, hiddenTotal = 0.0;
+    unsigned int raysChecked = 0, raysWrong = 0, depthWrong = 0, pyramidWrong = 0, threadsDiffer = 0;
+    std::vector<uint8_t> visible;
+    std::vector<unsigned int> candidates;
+    for (int c = 0; c < cameras; ++c) {
+        float angle = 6.2832f * c / cameras;
+        glm::vec3 eye(std::sin(angle) * 12.0f, 0.4f + 0.3f * (c % 3), std::cos(angle) * 12.0f);
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+
+        culler.beginFrame(viewProjection);
+        culler.addOccluder(planet, planetIndices, (unsigned int)planetIndices.size(), glm::mat4(1.0f));
+        culler.render();
+        renderMs += culler.renderMilliseconds;
+        serial.beginFrame(viewProjection);
+        serial.addOccluder(planet, planetIndices, (unsigned int)planetIndices.size(), glm::mat4(1.0f));
+        serial.render();
+        serialMs += serial.renderMilliseconds;
+        for (unsigned int l = 0; l < culler.levelCount(); ++l)
+            threadsDiffer += culler.level(l) != serial.level(l);
+
+        // Frustum first, like the demos, then occlusion
+        cullSpheres(spheres, extractFrustum(viewProjection), candidates);
+        auto start = std::chrono::high_resolution_clock::now();
+        culler.cullSpheres(spheres, visible);
+        testMs += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        unsigned int hidden = 0;
+        for (unsigned int i = 0; i < candidates.size(); ++i)
+            hidden += !visible[candidates[i]];
+        inFrustumTotal += candidates.size();
+        hiddenTotal += hidden;
+
+        // Reference depth, sandwiched between strict and loose coverage
+        int w = culler.width(), h = culler.height();
+        std::vector<float> strict((size_t)w * h, 1.0f), loose((size_t)w * h, 1.0f);
+        for (unsigned int i = 0; i + 2 < planetIndices.size(); i += 3) {
+            glm::dvec3 p[3];
+            for (int k = 0; k < 3; ++k) {
+                glm::vec4 clip = viewProjection * glm::vec4(planet[planetIndices[i + k]].position, 1.0f);
+                p[k] = glm::dvec3((clip.x / clip.w * 0.5 + 0.5) * w, (clip.y / clip.w * 0.5 + 0.5) * h,
+                                  clip.z / clip.w);
+            }
+            double area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+            if (area <= 0.0)
+                continue;
+            int x0 = std::max(0, (int)std::floor(std::min(p[0].x, std::min(p[1].x, p[2].x))) - 1);
+            int x1 = std::min(w - 1, (int)std::ceil(std::max(p[0].x, std::max(p[1].x, p[2].x))) + 1);
+            int y0 = std::max(0, (int)std::floor(std::min(p[0].y, std::min(p[1].y, p[2].y))) - 1);
+            int y1 = std::min(h - 1, (int)std::ceil(std::max(p[0].y, std::max(p[1].y, p[2].y))) + 1);
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    double px = x + 0.5, py = y + 0.5, b[3];
+                    for (int k = 0; k < 3; ++k) {
+                        const glm::dvec3 &s = p[(k + 1) % 3], &e = p[(k + 2) % 3];
+                        b[k] = ((e.x - s.x) * (py - s.y) - (e.y - s.y) * (px - s.x)) / area;
+                    }
+                    double z = b[0] * p[0].z + b[1] * p[1].z + b[2] * p[2].z;
+                    double lowest = std::min(b[0], std::min(b[1], b[2]));
+                    size_t index = (size_t)y * w + x;
+                    if (lowest > 1.0e-4)
+                        strict[index] = std::min(strict[index], (float)z);
+                    if (lowest > -1.0e-4)
+                        loose[index] = std::min(loose[index], (float)z);
+                }
+            }
+        }
+        const std::vector<float> &depth = culler.level(0);
+        for (size_t i = 0; i < depth.size(); ++i) {
+            if (depth[i] < loose[i] - 1.0e-5f || depth[i] > strict[i] + 1.0e-5f)
+                ++depthWrong;
+        }
+
+        for (unsigned int l = 1; l < culler.levelCount(); ++l) {
+            const std::vector<float> &below = culler.level(l - 1), &level = culler.level(l);
+            int bw = culler.levelWidth(l - 1), bh = culler.levelHeight(l - 1);
+            for (int y = 0; y < culler.levelHeight(l); ++y) {
+                for (int x = 0; x < culler.levelWidth(l); ++x) {
+                    float farthest = 0.0f;
+                    for (int dy = 0; dy < 2; ++dy) {
+                        for (int dx = 0; dx < 2; ++dx)
+                            farthest = std::max(farthest, below[(size_t)std::min(2 * y + dy, bh - 1) * bw +
+                                                                std::min(2 * x + dx, bw - 1)]);
+                    }
+                    pyramidWrong += level[(size_t)y * culler.levelWidth(l) + x] != farthest;
+                }
+            }
+        }
+
+        // Rays through the pixel centers of hidden asteroids
+        glm::mat4 inverse = glm::inverse(viewProjection);
+        unsigned int sampled = 0;
+        for (unsigned int i = 0; i < candidates.size() && sampled < 100; i += 7) {
+            const glm::vec4 &sphere = spheres[candidates[i]];
+            if (visible[candidates[i]])
+                continue;
+            ++sampled;
+            glm::vec4 clip = viewProjection * glm::vec4(glm::vec3(sphere), 1.0f);
+            int cx = (int)((clip.x / clip.w * 0.5f + 0.5f) * w), cy = (int)((clip.y / clip.w * 0.5f + 0.5f) * h);
+            for (int y = std::max(0, cy - 3); y <= std::min(h - 1, cy + 3); ++y) {
+                for (int x = std::max(0, cx - 3); x <= std::min(w - 1, cx + 3); ++x) {
+                    glm::vec4 target = inverse * glm::vec4((x + 0.5f) / w * 2.0f - 1.0f,
+                                                           (y + 0.5f) / h * 2.0f - 1.0f, 1.0f, 1.0f);
+                    glm::dvec3 origin(eye), direction = glm::normalize(glm::dvec3(glm::vec3(target) / target.w) - origin);
+                    glm::dvec3 toCenter = glm::dvec3(glm::vec3(sphere)) - origin;
+                    double along = glm::dot(toCenter, direction);
+                    double miss2 = glm::dot(toCenter, toCenter) - along * along;
+                    double r2 = (double)sphere.w * sphere.w;
+                    if (miss2 > r2)
+                        continue;
+                    double entry = along - std::sqrt(r2 - miss2);
+                    double hit = rayHit(origin, direction, planet, planetIndices);
+                    ++raysChecked;
+                    if (hit < 0.0 || hit > entry + 1.0e-4)
+                        ++raysWrong;
+                }
+            }
+        }
+    }
+
+    if (threadsDiffer || depthWrong || pyramidWrong || raysWrong) {
+        std::cout << threadsDiffer << " levels differ between thread counts, " << depthWrong
+                  << " depth pixels off the reference, " << pyramidWrong << " wrong Hi-Z texels, "
+                  << raysWrong << " of " << raysChecked << " rays into hidden asteroids miss the planet"
+                  << std::endl;
+        failed = true;
+    }
+    std::cout << planetIndices.size() / 3 << " occluder triangles into " << culler.width() << "x"
+              << culler.height() << ", " << amount << " asteroids, " << cameras << " cameras" << std::endl;
+    std::cout << "  render: " << serialMs / cameras << " ms on 1 thread, " << renderMs / cameras << " ms on "
+              << culler.threadCount() << std::endl;
+    std::cout << "  Hi-Z test of every asteroid: " << testMs / cameras << " ms" << std::endl;
+    std::cout << "  " << inFrustumTotal / cameras << " asteroids in the frustum, "
+              << 100.0 * hiddenTotal / std::max(inFrustumTotal, 1.0) << "% of them hidden by the planet, "
+              << raysChecked << " rays checked" << std::endl;
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+//
+// Updates a 100k node SceneGraph where 1% of the nodes get a new local
+// transform every frame, once incrementally (only the dirty subtrees) and
+// once by recomputing every node, and checks both give the same world
+// matrices. Does not need an OpenGL context.
+//
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SceneGraph.h"
+#include "BenchCommon.h"
+
+glm::mat4 randomTransform()
+{
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(randomFloat(-2.0f, 2.0f),
+                                                            randomFloat(-2.0f, 2.0f),
+                                                            randomFloat(-2.0f, 2.0f)));
+    m = glm::rotate(m, randomFloat(0.0f, 6.28f), glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)));
+    return glm::scale(m, glm::vec3(randomFloat(0.9f, 1.1f)));
+}
+
+// Random tree in depth first order: each node is a child of the previous
+// node or of one of its ancestors, up to maxDepth deep
+void buildTree(SceneGraph &scene, int count, int maxDepth)
+{
+    std::vector<int> path;
+    for (int i = 0; i < count; ++i) {
+        if (!path.empty()) {
+            int pop = (int)path.size() >= maxDepth ? 1 + rand() % maxDepth : rand() % 3;
+            while (pop-- > 0 && !path.empty())
+                path.pop_back();
+        }
+        int parent = path.empty() ? -1 : path.back();
+        path.push_back(scene.addNode(parent, randomTransform()));
+    }
+    scene.updateAll();
+}
+
+int main(int argc, char *argv[])
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 100000;
+    const int frames = 100;
+    const int dirtyPerFrame = count / 100;
+
+    srand(1);
+    SceneGraph scene;
+    buildTree(scene, count, 16);
+
+    // The same edits for both runs
+    std::vector<unsigned int> edits(frames * dirtyPerFrame);
+    std::vector<glm::mat4> transforms(edits.size());
+    for (size_t i = 0; i < edits.size(); ++i) {
+        edits[i] = rand() % count;
+        transforms[i] = randomTransform();
+    }
+
+    SceneGraph full = scene;
+    double incrementalMs = 0.0, fullMs = 0.0;
+    unsigned long long recomputed = 0;
+    bool match = true;
+    for (int f = 0; f < frames; ++f) {
+        for (int i = f * dirtyPerFrame; i < (f + 1) * dirtyPerFrame; ++i) {
+            scene.setLocal(edits[i], transforms[i]);
+            full.setLocal(edits[i], transforms[i]);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        recomputed += scene.update();
+        auto middle = std::chrono::high_resolution_clock::now();
+        full.updateAll();
+        auto end = std::chrono::high_resolution_clock::now();
+        incrementalMs += std::chrono::duration<double, std::milli>(middle - start).count();
+        fullMs += std::chrono::duration<double, std::milli>(end - middle).count();
+
+        for (int i = 0; i < count && match; ++i) {
+            if (scene.world[i] != full.world[i]) {
+                std::cout << "Frame " << f << ": node " << i << " differs" << std::endl;
+                match = false;
+            }
+        }
+    }
+
+    std::cout << count << " nodes, " << dirtyPerFrame << " dirty per frame, " << frames << " frames" << std::endl;
+    std::cout << "Full update:        " << fullMs / frames << " ms/frame" << std::endl;
+    std::cout << "Incremental update: " << incrementalMs / frames << " ms/frame, "
+              << recomputed / frames << " nodes recomputed per frame" << std::endl;
+    std::cout << (match ? "Incremental matches full update" : "MISMATCH") << std::endl;
+    return match ? 0 : 1;
+}
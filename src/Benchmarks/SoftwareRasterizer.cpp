@@ -0,0 +1,315 @@
+//
+// The CPU renderer, SoftwareRasterizer.h.
+// Checks:
+//   - two meshes, one jittered and one with every edge through pixel
+//     centres, drawn a triangle at a time: every pixel is covered by
+//     exactly one triangle,
+//   - the nearer of two overlapping quads wins in either draw order,
+//   - texture coordinates along a floor going into the distance match the
+//     ones found by intersecting each pixel's view ray with the floor,
+//     which affine interpolation misses by far,
+//   - every thread count renders the nanosuit to the same pixels.
+// Throughput: the nanosuits of ModelLoading/nanosuit.cpp at 800x600
+// against the number of threads, as triangles and shaded pixels per
+// second. Usage: SoftwareRasterizer [frames] [image.png], run from the
+// repository root.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "ModelImporter.h"
+#include "ImageWriter.h"
+#include "SoftwareRasterizer.h"
+#include "BenchCommon.h"
+
+// Lights that add nothing, so a pixel is its emission texel
+MultipleLights darkLights()
+{
+    MultipleLights lights = MultipleLights();
+    lights.viewPos = glm::vec3(0.0f, 0.0f, 10.0f);
+    lights.dirLight.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    lights.spotLight.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    lights.spotLight.innerCone = 0.9f;
+    lights.spotLight.outerCone = 0.8f;
+    return lights;
+}
+
+Vertex makeVertex(glm::vec3 position, glm::vec2 uv)
+{
+    Vertex v = { position, glm::vec3(0.0f, 0.0f, 1.0f), uv, 0 };
+    return v;
+}
+
+// A width x height pixel grid of quads with two triangles each, over all
+// of NDC and a bit more. Vertices on pixel centres, or jittered within
+// 0.45 of a cell, so neighbours never cross and no triangle flips over.
+void makeGrid(int width, int height, int cells, bool jitter, std::vector<Vertex> &vertices,
+              std::vector<unsigned int> &indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (int y = 0; y <= cells; ++y) {
+        for (int x = 0; x <= cells; ++x) {
+            // Window position, pixel centres are at + 0.5
+            float wx = -4.0f + (width + 8.0f) * x / cells, wy = -4.0f + (height + 8.0f) * y / cells;
+            if (jitter && x > 0 && x < cells && y > 0 && y < cells) {
+                wx += randomFloat(-0.5f, 0.5f) * width / cells * 0.45f;
+                wy += randomFloat(-0.5f, 0.5f) * height / cells * 0.45f;
+            } else {
+                wx = std::floor(wx) + 0.5f;
+                wy = std::floor(wy) + 0.5f;
+            }
+            vertices.push_back(makeVertex(glm::vec3(wx / width * 2.0f - 1.0f, wy / height * 2.0f - 1.0f, 0.0f),
+                                          glm::vec2(0.5f)));
+        }
+    }
+    for (int y = 0; y < cells; ++y) {
+        for (int x = 0; x < cells; ++x) {
+            unsigned int a = y * (cells + 1) + x, b = a + 1, c = a + cells + 1, d = c + 1;
+            // Alternating diagonals, and both windings
+            unsigned int quad[6] = { a, b, d, a, d, c };
+            if ((x + y) % 2)
+                quad[0] = a, quad[1] = b, quad[2] = c, quad[3] = b, quad[4] = d, quad[5] = c;
+            if (x % 3 == 0)
+                std::swap(quad[1], quad[2]);
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+bool exactCoverage(SoftwareRasterizer &raster, bool jitter)
+{
+    const unsigned char white[3] = { 255, 255, 255 };
+    SoftwareTexture texture = { 1, 1, 3, white };
+    SoftwareMaterial material = { nullptr, nullptr, &texture, 1.0f };
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    makeGrid(raster.width(), raster.height(), 9, jitter, vertices, indices);
+    std::vector<int> coverage(raster.pixels().size(), 0);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        raster.draw(vertices, &indices[i], 3, glm::mat4(1.0f), material);
+        raster.render(glm::mat4(1.0f), glm::mat4(1.0f), darkLights(), glm::vec3(0.0f));
+        for (size_t p = 0; p < coverage.size(); ++p)
+            coverage[p] += (raster.pixels()[p] & 0xFFFFFF) != 0;
+    }
+    int holes = 0, twice = 0;
+    for (size_t p = 0; p < coverage.size(); ++p) {
+        holes += coverage[p] == 0;
+        twice += coverage[p] > 1;
+    }
+    if (holes || twice) {
+        std::cout << (jitter ? "Jittered" : "Pixel centred") << " grid: " << holes << " pixels not covered, "
+                  << twice << " covered more than once" << std::endl;
+    }
+    return holes == 0 && twice == 0;
+}
+
+bool nearerWins(SoftwareRasterizer &raster)
+{
+    const unsigned char red[3] = { 255, 0, 0 }, blue[3] = { 0, 0, 255 };
+    SoftwareTexture redTexture = { 1, 1, 3, red }, blueTexture = { 1, 1, 3, blue };
+    SoftwareMaterial near = { nullptr, nullptr, &redTexture, 1.0f }, far = { nullptr, nullptr, &blueTexture, 1.0f };
+    std::vector<Vertex> nearQuad, farQuad;
+    for (int i = 0; i < 4; ++i) {
+        glm::vec2 corner(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f);
+        nearQuad.push_back(makeVertex(glm::vec3(corner, -0.2f), glm::vec2(0.5f)));
+        farQuad.push_back(makeVertex(glm::vec3(corner + 0.25f, 0.3f), glm::vec2(0.5f)));
+    }
+    const unsigned int indices[6] = { 0, 1, 3, 0, 3, 2 };
+    bool ok = true;
+    for (int order = 0; order < 2; ++order) {
+        raster.draw(order ? farQuad : nearQuad, indices, 6, glm::mat4(1.0f), order ? far : near);
+        raster.draw(order ? nearQuad : farQuad, indices, 6, glm::mat4(1.0f), order ? near : far);
+        raster.render(glm::mat4(1.0f), glm::mat4(1.0f), darkLights(), glm::vec3(0.0f));
+        size_t centre = (size_t)(raster.height() * 3 / 5) * raster.width() + raster.width() * 3 / 5;
+        ok = ok && (raster.pixels()[centre] & 0xFFFFFF) == 0x0000FF;
+    }
+    if (!ok)
+        std::cout << "The farther quad was drawn over the nearer one" << std::endl;
+    return ok;
+}
+
+bool perspectiveCorrect(SoftwareRasterizer &raster)
+{
+    // Texel i has red i, so red follows u closely away from the ends
+    std::vector<unsigned char> ramp(256 * 3, 0);
+    for (int i = 0; i < 256; ++i)
+        ramp[i * 3] = (unsigned char)i;
+    SoftwareTexture texture = { 256, 1, 3, ramp.data() };
+    SoftwareMaterial material = { nullptr, nullptr, &texture, 1.0f };
+    // Floor at y = -1 from z = -1 to z = -40, u from 0.05 to 0.95 with depth
+    std::vector<Vertex> floor;
+    const float nearZ = -1.0f, farZ = -40.0f;
+    for (int i = 0; i < 4; ++i) {
+        float z = i & 2 ? farZ : nearZ;
+        floor.push_back(makeVertex(glm::vec3(i & 1 ? 8.0f : -8.0f, -1.0f, z), glm::vec2(i & 2 ? 0.95f : 0.05f, 0.5f)));
+        floor.back().normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    const unsigned int indices[6] = { 0, 1, 3, 0, 3, 2 };
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)raster.width() / raster.height(), 0.1f,
+                                            100.0f);
+    raster.draw(floor, indices, 6, glm::mat4(1.0f), material);
+    raster.render(glm::mat4(1.0f), projection, darkLights(), glm::vec3(0.0f));
+
+    glm::mat4 inverse = glm::inverse(projection);
+    int checked = 0, wrong = 0;
+    const int x = raster.width() / 2;
+    for (int y = 0; y < raster.height(); ++y) {
+        float ndcX = (x + 0.5f) / raster.width() * 2.0f - 1.0f, ndcY = (y + 0.5f) / raster.height() * 2.0f - 1.0f;
+        glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+        glm::vec3 ray = glm::vec3(farPoint) / farPoint.w;
+        if (ray.y >= 0.0f)
+            continue;
+        float z = ray.z * (-1.0f / ray.y);
+        if (z > nearZ || z < farZ)
+            continue;
+        float u = 0.05f + 0.9f * (z - nearZ) / (farZ - nearZ);
+        // Stay clear of the texels next to the wrap
+        if (u < 0.06f || u > 0.94f)
+            continue;
+        float expected = (u * 256.0f - 0.5f) / 255.0f * 255.0f;
+        float red = (float)(raster.pixels()[(size_t)y * raster.width() + x] & 0xFF);
+        ++checked;
+        if (std::fabs(red - expected) > 1.5f) {
+            if (wrong++ == 0)
+                std::cout << "Row " << y << ": u " << u << " should give " << expected << ", got " << red
+                          << std::endl;
+        }
+    }
+    if (wrong || checked < raster.height() / 4)
+        std::cout << wrong << " of " << checked << " floor pixels interpolated wrongly" << std::endl;
+    return wrong == 0 && checked >= raster.height() / 4;
+}
+
+// The five nanosuits and lights of ModelLoading/nanosuit.cpp at time 1
+struct NanosuitScene {
+    ModelImporter importer;
+    std::vector<SoftwareTexture> textures;
+    std::vector<SoftwareMaterial> materials;
+    std::vector<glm::mat4> placements;
+    glm::mat4 view, projection;
+    MultipleLights lights;
+
+    bool load(int width, int height)
+    {
+        if (!importer.import("models/nanosuit/nanosuit.obj"))
+            return false;
+        for (size_t i = 0; i < importer.images.size(); ++i) {
+            const ImportedImage &image = importer.images[i];
+            SoftwareTexture texture = { image.width, image.height, image.components, image.data };
+            textures.push_back(texture);
+        }
+        for (size_t m = 0; m < importer.meshes.size(); ++m) {
+            SoftwareMaterial material = { nullptr, nullptr, nullptr, 32.0f };
+            const auto &meshTextures = importer.meshes[m].textures;
+            for (size_t t = 0; t < meshTextures.size(); ++t) {
+                const SoftwareTexture *texture = textures[meshTextures[t].first].data ? &textures[meshTextures[t].first]
+                                                                                       : nullptr;
+                if (meshTextures[t].second == "texture_diffuse" && !material.diffuse)
+                    material.diffuse = texture;
+                else if (meshTextures[t].second == "texture_specular" && !material.specular)
+                    material.specular = texture;
+            }
+            materials.push_back(material);
+        }
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f)), glm::vec3(0.1f));
+        for (int i = 0; i < 5; ++i)
+            placements.push_back(model * glm::translate(glm::mat4(1.0f), glm::vec3(10.0f * (i - 2), 0.0f, 0.0f)));
+
+        // The demo's camera only sees their heads, this one fills the frame
+        glm::vec3 position(0.0f, -0.2f, 3.2f);
+        view = glm::lookAt(position, glm::vec3(0.0f, -0.25f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+        glm::vec3 lightColor(1.0f);
+        lights.viewPos = position;
+        lights.light = { glm::vec3(1.2f, 0.5f, 1.0f), lightColor * 0.1f, lightColor * 0.5f, lightColor,
+                         1.0f, 0.022f, 0.0010f };
+        lights.dirLight = { glm::vec3(-1.0f, -1.0f, 0.0f), lightColor * 0.05f, lightColor * 0.3f, lightColor };
+        glm::vec3 spotLightTarget(1.5f * std::cos(1.0f), 0.0f, 1.5f * std::sin(1.0f));
+        lights.spotLight = { glm::vec3(0.0f, 3.0f, 0.0f), spotLightTarget - glm::vec3(0.0f, 3.0f, 0.0f),
+                             lightColor * 0.1f, lightColor * 0.5f, lightColor, 1.0f, 0.022f, 0.0010f,
+                             std::cos(glm::radians(15.0f)), std::cos(glm::radians(20.0f)) };
+        return true;
+    }
+
+    void render(SoftwareRasterizer &raster)
+    {
+        for (size_t p = 0; p < placements.size(); ++p) {
+            for (size_t m = 0; m < importer.meshes.size(); ++m) {
+                const ImportedMesh &mesh = importer.meshes[m];
+                // Level 0 only, the whole mesh without meshlet culling
+                size_t count = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+                raster.draw(mesh.vertices, mesh.indices.data(), count, placements[p], materials[m]);
+            }
+        }
+        raster.render(view, projection, lights, glm::vec3(0.1f));
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    const int frames = argc > 1 ? std::max(atoi(argv[1]), 1) : 10;
+    const char *imagePath = argc > 2 ? argv[2] : nullptr;
+    bool failed = false;
+    srand(3);
+    {
+        JobPool jobs;
+        SoftwareRasterizer raster(157, 103, jobs);
+        failed |= !exactCoverage(raster, false);
+        failed |= !exactCoverage(raster, true);
+        failed |= !nearerWins(raster);
+        failed |= !perspectiveCorrect(raster);
+    }
+
+    const int width = 800, height = 600;
+    NanosuitScene scene;
+    if (!scene.load(width, height)) {
+        std::cout << "FAILED to load models/nanosuit/nanosuit.obj, run from the repository root" << std::endl;
+        return 1;
+    }
+    unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> reference;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Nanosuit scene, " << width << "x" << height << ", " << frames << " frames" << std::endl;
+    for (unsigned int threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        JobPool jobs(threads);
+        SoftwareRasterizer raster(width, height, jobs);
+        scene.render(raster);
+        double vertex = 0.0, setup = 0.0, rasterize = 0.0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int f = 0; f < frames; ++f) {
+            scene.render(raster);
+            vertex += raster.stats.vertexMilliseconds;
+            setup += raster.stats.setupMilliseconds;
+            rasterize += raster.stats.rasterMilliseconds;
+        }
+        double seconds = millisecondsSince(start) / 1000.0;
+        const SoftwareRasterStats &s = raster.stats;
+        if (threads == 1) {
+            reference = raster.pixels();
+            std::cout << "  " << s.triangles << " triangles, " << s.trianglesSetUp << " after clipping, "
+                      << s.fragments << " depth test passes, " << s.pixelsShaded << " pixels shaded" << std::endl;
+            if (imagePath)
+                writePng(imagePath, width, height, 4, (const unsigned char *)reference.data(), true, 3);
+        } else if (raster.pixels() != reference) {
+            std::cout << "  " << threads << " threads render different pixels than 1" << std::endl;
+            failed = true;
+        }
+        std::cout << "  " << threads << (threads == 1 ? " thread:  " : " threads: ") << seconds * 1000.0 / frames
+                  << " ms per frame (vertices " << vertex / frames << ", setup and binning " << setup / frames
+                  << ", tiles " << rasterize / frames << "), " << s.triangles * frames / seconds / 1.0e6
+                  << " M triangles/s, " << s.pixelsShaded * frames / seconds / 1.0e6 << " M pixels/s" << std::endl;
+        if (threads == maxThreads)
+            break;
+    }
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
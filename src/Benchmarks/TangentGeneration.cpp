@@ -0,0 +1,102 @@
+//
+// Times generateTangents on the nanosuit with one and with all hardware
+// threads (or the count given as the second argument), and checks the result:
+//   - tangents are unit length and perpendicular to the normal,
+//   - the threaded result is identical to the single threaded one,
+//   - the tangent frame agrees with the UV direction of the faces.
+// Reads the OBJ directly (one vertex per face corner, V flipped, like
+// Model.h with assimp), so it needs neither assimp nor an OpenGL context.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+
+#include "TangentSpace.h"
+#include "JobPool.h"
+#include "BenchCommon.h"
+
+double bestMilliseconds(std::vector<BenchVertex> &vertices, const std::vector<unsigned int> &indices,
+                        unsigned int threads)
+{
+    JobPool pool(threads);
+    double best = 1.0e30;
+    for (int i = 0; i < 20; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        generateTangents(vertices, indices, &pool);
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "models/nanosuit/nanosuit.obj";
+    std::vector<BenchVertex> vertices;
+    std::vector<unsigned int> indices;
+    if (!loadObj(path, vertices, indices)) {
+        std::cout << "Failed to open " << path << std::endl;
+        return 1;
+    }
+
+    unsigned int threads = argc > 2 ? (unsigned int)atoi(argv[2])
+                                    : std::max(std::thread::hardware_concurrency(), 1u);
+    double singleMs = bestMilliseconds(vertices, indices, 1);
+    std::vector<BenchVertex> single = vertices;
+    double threadedMs = bestMilliseconds(vertices, indices, threads);
+
+    bool failed = false;
+    unsigned int mismatches = 0, badLength = 0, notPerpendicular = 0;
+    for (unsigned int i = 0; i < vertices.size(); ++i) {
+        if (vertices[i].tangent != single[i].tangent)
+            ++mismatches;
+        glm::vec4 t = unpackTangent(vertices[i].tangent);
+        if (std::abs(glm::length(glm::vec3(t)) - 1.0f) > 0.01f)
+            ++badLength;
+        if (std::abs(glm::dot(glm::vec3(t), glm::normalize(vertices[i].normal))) > 0.01f)
+            ++notPerpendicular;
+    }
+
+    // The per vertex frame should point along +u and +v of every face with usable UVs
+    unsigned int faces = 0, agreeing = 0;
+    for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+        const BenchVertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]],
+                          &c = vertices[indices[i + 2]];
+        glm::vec3 e1 = b.position - a.position, e2 = c.position - a.position;
+        glm::vec2 d1 = b.texCoord - a.texCoord, d2 = c.texCoord - a.texCoord;
+        float det = d1.x * d2.y - d2.x * d1.y;
+        if (std::abs(det) < 1.0e-8f)
+            continue;
+        glm::vec3 faceT = (e1 * d2.y - e2 * d1.y) / det;
+        glm::vec3 faceB = (e2 * d1.x - e1 * d2.x) / det;
+        glm::vec4 t = unpackTangent(a.tangent);
+        glm::vec3 n = glm::normalize(a.normal);
+        glm::vec3 bitangent = glm::cross(n, glm::vec3(t)) * t.w;
+        ++faces;
+        if (glm::dot(glm::vec3(t), faceT) > 0.0f && glm::dot(bitangent, faceB) > 0.0f)
+            ++agreeing;
+    }
+
+    std::cout << path << ": " << vertices.size() << " vertices, " << indices.size() / 3
+              << " triangles" << std::endl;
+    std::cout << "  1 thread:   " << singleMs << " ms" << std::endl;
+    std::cout << "  " << threads << " threads: " << threadedMs << " ms" << std::endl;
+    std::cout << "  frames agreeing with face UVs: " << 100.0 * agreeing / std::max(faces, 1u)
+              << "%" << std::endl;
+    if (mismatches || badLength || notPerpendicular) {
+        std::cout << "  " << mismatches << " differ between thread counts, " << badLength
+                  << " not unit length, " << notPerpendicular << " not perpendicular" << std::endl;
+        failed = true;
+    }
+    if (agreeing < faces * 0.95) {
+        std::cout << "  too many frames disagree with the UVs" << std::endl;
+        failed = true;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+//
+// Block compression and the texture cache, without an OpenGL context.
+//   - a flat block comes back within the RGB565 rounding, a block of two
+//     565 colors and a BC4 block of two values come back exactly, and a
+//     BC4 ramp is within half a step everywhere,
+//   - a KTX file reads back level by level as written, for a size that
+//     is not a multiple of 4, and loadCompressedTexture takes a fresh
+//     cache file instead of compressing again.
+// Then every PNG and JPG under textures/ and models/ is compressed the way
+// the demos would (normal maps BC5, grey specular maps BC4, the rest BC1
+// or BC3 with alpha) and reported with its GPU memory uncompressed (RGBA8
+// with mipmaps) and compressed, the time to decode the source, to
+// compress the mip chain and to read the cache file back, and the PSNR of
+// level 0.
+//
+//     TextureCompression [cache directory]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "TextureCache.h"
+#include "BenchCommon.h"
+
+// Lowest PSNR of level 0 that still counts as working
+const double MIN_PSNR = 25.0;
+
+// Largest difference of any channel in mask between the block and what it
+// decodes to
+int blockError(BlockFormat format, const uint8_t rgba[64])
+{
+    uint8_t encoded[16], decoded[64];
+    encodeBlock(format, rgba, encoded);
+    decodeBlock(format, encoded, decoded);
+    int worst = 0, mask = blockChannelMask(format);
+    for (int i = 0; i < 64; ++i) {
+        if (mask & 1 << (i % 4))
+            worst = std::max(worst, std::abs((int)rgba[i] - (int)decoded[i]));
+    }
+    return worst;
+}
+
+bool blockChecks()
+{
+    bool ok = true;
+    uint8_t block[64];
+    for (int i = 0; i < 16; ++i) {
+        block[4 * i] = 200;
+        block[4 * i + 1] = 99;
+        block[4 * i + 2] = 13;
+        block[4 * i + 3] = 255;
+    }
+    if (blockError(BLOCK_BC1, block) > 4) {
+        std::cout << "Flat BC1 block is off by " << blockError(BLOCK_BC1, block) << std::endl;
+        ok = false;
+    }
+
+    // Both colors are exact in RGB565, (255, 0, 0) and (0, 255, 66)
+    for (int i = 0; i < 16; ++i) {
+        bool left = i % 4 < 2;
+        block[4 * i] = left ? 255 : 0;
+        block[4 * i + 1] = left ? 0 : 255;
+        block[4 * i + 2] = left ? 0 : 66;
+        block[4 * i + 3] = left ? 255 : 0;
+    }
+    if (blockError(BLOCK_BC1, block) != 0 || blockError(BLOCK_BC3, block) != 0) {
+        std::cout << "Two color block is off by " << blockError(BLOCK_BC1, block) << " in BC1 and "
+                  << blockError(BLOCK_BC3, block) << " in BC3" << std::endl;
+        ok = false;
+    }
+    if (blockError(BLOCK_BC4, block) != 0 || blockError(BLOCK_BC5, block) != 0) {
+        std::cout << "Two value block is off by " << blockError(BLOCK_BC4, block) << " in BC4 and "
+                  << blockError(BLOCK_BC5, block) << " in BC5" << std::endl;
+        ok = false;
+    }
+
+    // Steps of 17 between 0 and 255 against levels 36.4 apart
+    for (int i = 0; i < 16; ++i)
+        block[4 * i] = (uint8_t)(i * 17);
+    if (blockError(BLOCK_BC4, block) > 19) {
+        std::cout << "BC4 ramp is off by " << blockError(BLOCK_BC4, block) << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+bool cacheChecks(const std::string &cacheDirectory)
+{
+    const int width = 37, height = 23;
+    std::vector<unsigned char> pixels((size_t)width * height * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            unsigned char *p = &pixels[((size_t)y * width + x) * 3];
+            p[0] = (unsigned char)(x * 7);
+            p[1] = (unsigned char)(y * 11);
+            p[2] = (unsigned char)((x * y) & 0xFF);
+        }
+    }
+    CompressedImage image, read;
+    compressTexture(pixels.data(), width, height, 3, TEXTURE_COLOR, image);
+    std::string path = cacheDirectory + "/roundtrip.ktx";
+    mkdir(cacheDirectory.c_str(), 0755);
+    bool ok = image.format == BLOCK_BC1 && image.levels.size() == 6 && writeKtx(path, image) &&
+              readKtx(path, read) && read.format == image.format && read.width == width && read.height == height &&
+              read.levels == image.levels;
+    std::remove(path.c_str());
+    if (!ok) {
+        std::cout << "KTX file of a " << width << "x" << height << " image does not read back" << std::endl;
+        return false;
+    }
+
+    // A cache file that is newer than the source is taken as it is, so a
+    // marker level written into it has to come back
+    const char *source = "textures/container2.png";
+    CompressedImage first, second;
+    if (!loadCompressedTexture(source, TEXTURE_COLOR, false, first, cacheDirectory)) {
+        std::cout << "Could not load " << source << ", run from the repository root" << std::endl;
+        return false;
+    }
+    first.levels.back()[0] ^= 0xFF;
+    std::string cachePath = textureCachePath(cacheDirectory, source, TEXTURE_COLOR, false);
+    ok = writeKtx(cachePath, first) && loadCompressedTexture(source, TEXTURE_COLOR, false, second, cacheDirectory) &&
+         second.levels == first.levels && second.psnr == 0.0;
+    std::remove(cachePath.c_str());
+    if (!ok)
+        std::cout << "loadCompressedTexture did not use the cached " << source << std::endl;
+    return ok;
+}
+
+void findImages(const std::string &directory, std::vector<std::string> &paths)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return;
+    std::vector<std::string> names;
+    while (dirent *entry = readdir(dir))
+        names.push_back(entry->d_name);
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        const std::string &name = names[i];
+        if (name[0] == '.')
+            continue;
+        std::string path = directory + '/' + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+            findImages(path, paths);
+            continue;
+        }
+        std::string extension = name.substr(name.find_last_of('.') + 1);
+        if (extension == "png" || extension == "jpg")
+            paths.push_back(path);
+    }
+}
+
+TextureUsage usageFromName(const std::string &path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    if (name.find("ddn") != std::string::npos || name.find("normal") != std::string::npos)
+        return TEXTURE_NORMAL;
+    if (name.find("spec") != std::string::npos)
+        return TEXTURE_SPECULAR;
+    return TEXTURE_COLOR;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string cacheDirectory = argc > 1 ? argv[1] : "texture_cache";
+    bool failed = !blockChecks();
+    failed = !cacheChecks(cacheDirectory) || failed;
+
+    std::vector<std::string> paths;
+    findImages("textures", paths);
+    findImages("models", paths);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(56) << "texture" << std::right << std::setw(11) << "size"
+              << std::setw(7) << "format" << std::setw(10) << "RGBA8 MB" << std::setw(8) << "BC MB"
+              << std::setw(11) << "decode ms" << std::setw(13) << "compress ms" << std::setw(10) << "cache ms"
+              << std::setw(10) << "PSNR dB" << std::endl;
+    double totalUncompressed = 0.0, totalCompressed = 0.0, totalDecode = 0.0, totalCompress = 0.0;
+    double totalCache = 0.0, totalPixels = 0.0, worstPsnr = 99.0;
+    for (unsigned int i = 0; i < paths.size(); ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        int width, height, components;
+        unsigned char *data = stbi_load(paths[i].c_str(), &width, &height, &components, 0);
+        double decodeMilliseconds = millisecondsSince(start);
+        if (!data) {
+            std::cout << "Could not decode " << paths[i] << std::endl;
+            failed = true;
+            continue;
+        }
+        CompressedImage image;
+        start = std::chrono::high_resolution_clock::now();
+        compressTexture(data, width, height, components, usageFromName(paths[i]), image);
+        double compressMilliseconds = millisecondsSince(start);
+        stbi_image_free(data);
+
+        std::string cachePath = textureCachePath(cacheDirectory, paths[i], usageFromName(paths[i]), false);
+        CompressedImage cached;
+        bool written = writeKtx(cachePath, image);
+        start = std::chrono::high_resolution_clock::now();
+        bool read = written && readKtx(cachePath, cached);
+        double cacheMilliseconds = millisecondsSince(start);
+        if (!read || cached.levels != image.levels) {
+            std::cout << "Cache file of " << paths[i] << " does not read back" << std::endl;
+            failed = true;
+        }
+
+        // What glTexImage2D and glGenerateMipmap would take, drivers store
+        // RGB8 as four bytes per pixel too
+        double uncompressed = (double)width * height * 4.0 * 4.0 / 3.0 / (1024.0 * 1024.0);
+        double compressed = image.bytes() / (1024.0 * 1024.0);
+        std::ostringstream size;
+        size << width << "x" << height;
+        std::cout << std::left << std::setw(56) << paths[i] << std::right << std::setw(11) << size.str()
+                  << std::setw(7) << blockFormatName(image.format) << std::setw(10) << uncompressed
+                  << std::setw(8) << compressed << std::setw(11) << decodeMilliseconds
+                  << std::setw(13) << compressMilliseconds << std::setw(10) << cacheMilliseconds
+                  << std::setw(10) << image.psnr << std::endl;
+        if (image.psnr < MIN_PSNR) {
+            std::cout << "  PSNR below " << MIN_PSNR << " dB" << std::endl;
+            failed = true;
+        }
+        totalUncompressed += uncompressed;
+        totalCompressed += compressed;
+        totalDecode += decodeMilliseconds;
+        totalCompress += compressMilliseconds;
+        totalCache += cacheMilliseconds;
+        totalPixels += (double)width * height * 4.0 / 3.0;
+        worstPsnr = std::min(worstPsnr, image.psnr);
+    }
+    std::cout << paths.size() << " textures: " << totalUncompressed << " MB uncompressed, " << totalCompressed
+              << " MB compressed (" << totalUncompressed / std::max(totalCompressed, 1e-9) << "x smaller), "
+              << "lowest PSNR " << worstPsnr << " dB" << std::endl;
+    std::cout << "Loading: " << totalDecode << " ms to decode the sources against " << totalCache
+              << " ms to read the cache; compressing took " << totalCompress << " ms ("
+              << std::setprecision(2) << totalPixels / 1000.0 / std::max(totalCompress, 1e-9)
+              << " MPix/s on one thread, mip levels included)" << std::endl;
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+//
+// Texture array and atlas packing, without an OpenGL context.
+//   - solid images of many sizes packed into atlas layers do not overlap,
+//     and bilinear samples at their centers, edges and corners give back
+//     only their own color at every level down to PackedRegion::maxLevel,
+//   - a repeating image fills its own layer and wraps into itself.
+// Then the Blending textures and every small texture under textures/ are
+// packed and reported with the layers used, how much of them the images
+// cover and the time to pack, mip levels included. Images of 512 texels
+// need more than half of a 1024 layer once they have a border, so the
+// small ones are packed into 2048 layers as well.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "TexturePacker.h"
+#include "BenchCommon.h"
+
+// Bilinear sample of one layer of a packed level at (u, v), wrapping
+// like GL_REPEAT
+glm::vec4 sample(const TexturePacker &packer, int level, int layer, float u, float v)
+{
+    int size = std::max(packer.layerSize() >> level, 1);
+    const uint8_t *pixels = &packer.level(level)[(size_t)layer * size * size * 4];
+    float x = u * size - 0.5f, y = v * size - 0.5f;
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    float fx = x - x0, fy = y - y0;
+    glm::vec4 result(0.0f);
+    for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+            float weight = (dx ? fx : 1.0f - fx) * (dy ? fy : 1.0f - fy);
+            int sx = ((x0 + dx) % size + size) % size, sy = ((y0 + dy) % size + size) % size;
+            const uint8_t *p = &pixels[((size_t)sy * size + sx) * 4];
+            result += weight * glm::vec4(p[0], p[1], p[2], p[3]);
+        }
+    }
+    return result;
+}
+
+bool packingChecks()
+{
+    bool ok = true;
+    TexturePacker packer(512, 4);
+    std::vector<glm::ivec2> sizes;
+    std::vector<glm::vec4> colors;
+    srand(7);
+    for (int i = 0; i < 40; ++i) {
+        glm::ivec2 size(8 + rand() % 120, 8 + rand() % 120);
+        glm::vec4 color(rand() % 256, rand() % 256, rand() % 256, 255.0f);
+        std::vector<uint8_t> rgba((size_t)size.x * size.y * 4);
+        for (size_t p = 0; p < rgba.size(); p += 4) {
+            for (int c = 0; c < 4; ++c)
+                rgba[p + c] = (uint8_t)color[c];
+        }
+        packer.addImage(rgba, size.x, size.y);
+        sizes.push_back(size);
+        colors.push_back(color);
+    }
+    // A repeating gradient, so wrapping shows
+    std::vector<uint8_t> gradient(256 * 256 * 4);
+    for (int y = 0; y < 256; ++y) {
+        for (int x = 0; x < 256; ++x) {
+            uint8_t *p = &gradient[((size_t)y * 256 + x) * 4];
+            p[0] = (uint8_t)x;
+            p[1] = (uint8_t)y;
+            p[2] = 0;
+            p[3] = 255;
+        }
+    }
+    int repeating = packer.addImage(gradient, 256, 256, true);
+    packer.pack();
+
+    for (unsigned int i = 0; i < sizes.size(); ++i) {
+        const PackedRegion &a = packer.region((int)i);
+        for (unsigned int j = i + 1; j < sizes.size(); ++j) {
+            const PackedRegion &b = packer.region((int)j);
+            if (a.layer == b.layer && a.rect.x < b.rect.x + b.rect.z && b.rect.x < a.rect.x + a.rect.z &&
+                a.rect.y < b.rect.y + b.rect.w && b.rect.y < a.rect.y + a.rect.w) {
+                std::cout << "Images " << i << " and " << j << " overlap" << std::endl;
+                ok = false;
+            }
+        }
+        float worst = 0.0f;
+        for (int level = 0; level <= a.maxLevel; ++level) {
+            for (int corner = 0; corner < 9; ++corner) {
+                float u = a.rect.x + a.rect.z * (corner % 3) * 0.5f, v = a.rect.y + a.rect.w * (corner / 3) * 0.5f;
+                glm::vec4 difference = glm::abs(sample(packer, level, a.layer, u, v) - colors[i]);
+                worst = std::max(worst, std::max(std::max(difference.x, difference.y), difference.z));
+            }
+        }
+        if (worst > 1.0f) {
+            std::cout << "Image " << i << " (" << sizes[i].x << "x" << sizes[i].y << ") bleeds by " << worst
+                      << " down to level " << a.maxLevel << std::endl;
+            ok = false;
+        }
+    }
+    const PackedRegion &region = packer.region(repeating);
+    glm::vec4 inside = sample(packer, 0, region.layer, 100.5f / 512.0f, 30.5f / 512.0f);
+    glm::vec4 wrapped = sample(packer, 0, region.layer, 1.0f + 100.5f / 512.0f, -1.0f + 30.5f / 512.0f);
+    if (!region.repeat || region.rect != glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) || inside != wrapped ||
+        std::fabs(inside.x - 50.0f) > 1.0f || std::fabs(inside.y - 15.0f) > 1.0f) {
+        std::cout << "The repeating image does not fill its layer" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+struct PackResult {
+    int layers, images;
+    float usage;
+    double milliseconds;
+};
+
+PackResult packFiles(const std::vector<std::string> &paths, const std::vector<bool> &repeat, int layerSize)
+{
+    TexturePacker packer(layerSize);
+    auto start = std::chrono::high_resolution_clock::now();
+    PackResult result = { 0, 0, 0.0f, 0.0 };
+    for (unsigned int i = 0; i < paths.size(); ++i)
+        result.images += packer.add(paths[i], repeat[i]) >= 0 ? 1 : 0;
+    double decoding = millisecondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+    packer.pack();
+    result.milliseconds = millisecondsSince(start);
+    result.layers = packer.layerCount();
+    result.usage = packer.usage();
+    std::cout << "  " << result.images << " images into " << result.layers << " layers of " << packer.layerSize()
+              << "x" << packer.layerSize() << ", " << std::setprecision(0) << result.usage * 100.0f
+              << "% covered; decoding " << std::setprecision(1) << decoding << " ms, packing with mip levels "
+              << result.milliseconds << " ms" << std::endl;
+    return result;
+}
+
+int main()
+{
+    bool failed = !packingChecks();
+    std::cout << std::fixed;
+
+    std::cout << "Blending (the ground repeats):" << std::endl;
+    std::vector<std::string> blending = { "textures/ground.jpg", "textures/container2.png", "textures/grass.png",
+                                          "textures/blending_transparent_window.png" };
+    PackResult result = packFiles(blending, { true, false, false, false }, 1024);
+    failed = failed || result.images != (int)blending.size();
+
+    std::cout << "Every texture of 512x512 or less under textures/:" << std::endl;
+    std::vector<std::string> small = { "textures/awesomeface.png", "textures/blending_transparent_window.png",
+                                       "textures/container.jpg", "textures/container2.png",
+                                       "textures/container2_emission.jpg", "textures/container2_specular.png",
+                                       "textures/grass.png" };
+    for (int layerSize = 1024; layerSize <= 2048; layerSize *= 2) {
+        result = packFiles(small, std::vector<bool>(small.size(), false), layerSize);
+        failed = failed || result.images != (int)small.size();
+    }
+
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
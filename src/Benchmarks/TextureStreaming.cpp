@@ -0,0 +1,301 @@
+//
+// Mip streaming decisions and reads, without an OpenGL context.
+// MipResidency checks:
+//   - a texture that fits the budget ends up at the level it asks for,
+//     one level per load, and the budget is never exceeded on the way,
+//   - two textures that each want the whole budget do not evict each
+//     other while both are seen,
+//   - the least recently seen texture loses its levels first,
+//   - mipForDistance goes one level coarser per doubling of the distance.
+// Then the nanosuit and sky box textures are streamed from the texture
+// cache along a camera path, the way TextureStreamer does it but with the
+// uploads left out: levels are read by two workers while the main thread
+// plans, with 2 ms frames. Reported per budget: the most
+// memory resident, how many frames had every requested level resident,
+// loads and evictions, and the main thread time per frame.
+//
+//     TextureStreaming [cache directory]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "TextureCache.h"
+#include "MipResidency.h"
+#include "JobPool.h"
+#include "BenchCommon.h"
+
+// Level sizes of a square BC1 texture
+std::vector<size_t> bc1Levels(int size)
+{
+    std::vector<size_t> levels;
+    for (int level = 0; level < mipLevelCount(size, size); ++level)
+        levels.push_back(compressedSize(BLOCK_BC1, std::max(size >> level, 1), std::max(size >> level, 1)));
+    return levels;
+}
+
+// Runs frames of requests where every load finishes right away, false
+// when the budget is ever exceeded
+bool runFrames(MipResidency &residency, int frames, const std::vector<std::pair<int, int> > &requests)
+{
+    std::vector<MipLoad> loads, evictions;
+    for (int f = 0; f < frames; ++f) {
+        for (unsigned int i = 0; i < requests.size(); ++i)
+            residency.request(requests[i].first, requests[i].second);
+        residency.plan(4, loads, evictions);
+        if (residency.residentBytes() > residency.budgetBytes())
+            return false;
+        for (unsigned int i = 0; i < loads.size(); ++i)
+            residency.loaded(loads[i].texture);
+        residency.endFrame();
+    }
+    return true;
+}
+
+bool residencyChecks()
+{
+    bool ok = true;
+    const std::vector<size_t> levels = bc1Levels(1024);
+    const size_t tail = levels[4] + levels[5] + levels[6] + levels[7] + levels[8] + levels[9] + levels[10];
+    {
+        MipResidency residency(levels[0] + levels[1] + levels[2] + levels[3] + tail);
+        int texture = residency.add(levels, 4);
+        std::vector<MipLoad> loads, evictions;
+        residency.request(texture, 0);
+        residency.plan(4, loads, evictions);
+        bool oneLevel = loads.size() == 1 && loads[0].level == 3;
+        residency.loaded(texture);
+        residency.endFrame();
+        bool fits = runFrames(residency, 10, std::vector<std::pair<int, int> >(1, std::make_pair(texture, 0)));
+        if (!oneLevel || !fits || residency.residentLevel(texture) != 0 || residency.loadCount() != 4) {
+            std::cout << "A texture that fits did not stream in level by level" << std::endl;
+            ok = false;
+        }
+    }
+    {
+        // Room for one texture at level 0 only
+        MipResidency residency(levels[0] + levels[1] + levels[2] + levels[3] + 2 * tail);
+        int a = residency.add(levels, 4), b = residency.add(levels, 4);
+        std::vector<std::pair<int, int> > both = { { a, 0 }, { b, 0 } };
+        bool fits = runFrames(residency, 50, both);
+        if (!fits || residency.evictionCount() != 0) {
+            std::cout << "Two textures seen at once evicted each other " << residency.evictionCount() << " times"
+                      << std::endl;
+            ok = false;
+        }
+    }
+    {
+        // Room for two of three textures at level 0
+        MipResidency residency(2 * (levels[0] + levels[1] + levels[2] + levels[3]) + 3 * tail);
+        int a = residency.add(levels, 4), b = residency.add(levels, 4), c = residency.add(levels, 4);
+        std::vector<std::pair<int, int> > first = { { a, 0 }, { b, 0 } }, second = { { b, 0 }, { c, 0 } };
+        bool fits = runFrames(residency, 20, first) && runFrames(residency, 20, second);
+        if (!fits || residency.residentLevel(a) != 4 || residency.residentLevel(b) != 0 ||
+            residency.residentLevel(c) != 0) {
+            std::cout << "Levels " << residency.residentLevel(a) << ", " << residency.residentLevel(b) << ", "
+                      << residency.residentLevel(c) << " resident, expected the unused texture to be evicted"
+                      << std::endl;
+            ok = false;
+        }
+    }
+    float pixels = screenPixelsPerUnit(600, glm::radians(45.0f));
+    int near = mipForDistance(0.5f, 1024, 2.0f, pixels), far = mipForDistance(0.5f, 1024, 4.0f, pixels);
+    if (far != near + 1 || mipForDistance(0.5f, 1024, 0.01f, pixels) != 0) {
+        std::cout << "mipForDistance gives levels " << near << " and " << far << " at distances 2 and 4"
+                  << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+struct StreamedSource {
+    std::vector<std::string> cachePaths;
+    int size;
+    bool sky;
+};
+
+struct Read {
+    int texture, level;
+    std::vector<std::string> paths;
+    std::atomic<bool> done;
+    bool failed;
+    size_t bytes;
+
+    Read(int texture, int level, const std::vector<std::string> &paths)
+            : texture(texture), level(level), paths(paths), done(false), failed(false), bytes(0)
+    {
+    }
+};
+
+struct PathResult {
+    size_t peakBytes;
+    int satisfiedFrames;
+    unsigned long long loads, evictions;
+    double mainMilliseconds, worstMainMilliseconds;
+    size_t bytesRead;
+    double seconds;
+};
+
+// For the first half the camera looks down at the suits and walks from 30
+// units to 1 unit away, then it turns to the sky and zooms in from 45 to
+// 15 degrees, so the suit levels have to make room for the sky
+PathResult streamPath(const std::vector<StreamedSource> &sources, const std::vector<std::vector<size_t> > &levelBytes,
+                      size_t budget, int frames)
+{
+    const int TAIL_SIZE = 64;
+    MipResidency residency(budget);
+    for (unsigned int i = 0; i < sources.size(); ++i) {
+        int tail = 0;
+        for (int size = sources[i].size; size > TAIL_SIZE; size /= 2)
+            ++tail;
+        residency.add(levelBytes[i], tail);
+    }
+    JobPool pool(3);
+    JobCounter counter;
+    std::vector<std::unique_ptr<Read> > pending;
+    std::vector<MipLoad> loads, evictions;
+    std::vector<int> wanted(sources.size());
+    PathResult result = { residency.residentBytes(), 0, 0, 0, 0.0, 0.0, 0, 0.0 };
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        float t = (float)f / frames;
+        bool suitsSeen = t < 0.5f;
+        float distance = 30.0f - 29.0f * std::min(t * 2.0f, 1.0f);
+        float fov = suitsSeen ? 45.0f : 45.0f - 30.0f * (t - 0.5f) * 2.0f;
+        float pixels = screenPixelsPerUnit(600, glm::radians(fov));
+
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        bool satisfied = true;
+        for (unsigned int i = 0; i < sources.size(); ++i) {
+            wanted[i] = -1;
+            if (sources[i].sky == suitsSeen)
+                continue;
+            wanted[i] = sources[i].sky ? mipForDistance(0.5f, sources[i].size, 1.0f, pixels)
+                                       : mipForDistance(0.5f, sources[i].size, distance, pixels);
+            residency.request((int)i, wanted[i]);
+        }
+        for (unsigned int i = 0; i < pending.size();) {
+            if (!pending[i]->done.load(std::memory_order_acquire)) {
+                ++i;
+                continue;
+            }
+            result.bytesRead += pending[i]->bytes;
+            if (pending[i]->failed)
+                residency.failed(pending[i]->texture);
+            else
+                residency.loaded(pending[i]->texture);
+            pending.erase(pending.begin() + i);
+        }
+        for (unsigned int i = 0; i < sources.size(); ++i)
+            satisfied = satisfied && (wanted[i] < 0 || residency.residentLevel((int)i) <= wanted[i]);
+        residency.plan(4 - (unsigned int)pending.size(), loads, evictions);
+        for (unsigned int i = 0; i < loads.size(); ++i) {
+            pending.emplace_back(new Read(loads[i].texture, loads[i].level, sources[loads[i].texture].cachePaths));
+            Read *read = pending.back().get();
+            pool.run(counter, [read]() {
+                CompressedImage image;
+                for (unsigned int p = 0; p < read->paths.size() && !read->failed; ++p) {
+                    read->failed = !readKtxLevels(read->paths[p], read->level, read->level, image);
+                    if (!read->failed)
+                        read->bytes += image.levels[read->level].size();
+                }
+                read->done.store(true, std::memory_order_release);
+            });
+        }
+        residency.endFrame();
+        double main = millisecondsSince(frameStart);
+        result.mainMilliseconds += main;
+        result.worstMainMilliseconds = std::max(result.worstMainMilliseconds, main);
+        result.peakBytes = std::max(result.peakBytes, residency.residentBytes());
+        result.satisfiedFrames += satisfied && residency.residentBytes() <= budget ? 1 : 0;
+        // The rest of the frame, drawing
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    pool.wait(counter);
+    result.seconds = millisecondsSince(start) / 1000.0;
+    result.loads = residency.loadCount();
+    result.evictions = residency.evictionCount();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string cacheDirectory = argc > 1 ? argv[1] : "texture_cache";
+    bool failed = !residencyChecks();
+
+    // The textures nanosuit and SkyBox --stream use, cached first if needed
+    const char *suit[] = { "arm_dif", "arm_showroom_ddn", "arm_showroom_spec", "body_dif", "body_showroom_ddn",
+                           "body_showroom_spec", "glass_dif", "glass_ddn", "hand_dif", "hand_showroom_ddn",
+                           "hand_showroom_spec", "helmet_diff", "helmet_showroom_ddn", "helmet_showroom_spec",
+                           "leg_dif", "leg_showroom_ddn", "leg_showroom_spec" };
+    const char *faces[] = { "Left", "Right", "Up", "Down", "Front", "Back" };
+    std::vector<StreamedSource> sources;
+    std::vector<std::vector<size_t> > levelBytes;
+    for (unsigned int i = 0; i < sizeof(suit) / sizeof(suit[0]) + 1; ++i) {
+        bool isSky = i == sizeof(suit) / sizeof(suit[0]);
+        StreamedSource source = { std::vector<std::string>(), 0, isSky };
+        std::vector<size_t> bytes;
+        for (int f = 0; f < (isSky ? 6 : 1); ++f) {
+            std::string name = isSky ? std::string("textures/TropicalSunnyDay/TropicalSunnyDay") + faces[f] + "2048.png"
+                                     : std::string("models/nanosuit/") + suit[i] + ".png";
+            std::string base = name.substr(name.find_last_of('/') + 1);
+            TextureUsage usage = base.find("ddn") != std::string::npos ? TEXTURE_NORMAL
+                                 : base.find("spec") != std::string::npos ? TEXTURE_SPECULAR : TEXTURE_COLOR;
+            CompressedImage header;
+            std::string cachePath = textureCachePath(cacheDirectory, name, usage, false);
+            if (!updateTextureCache(name, usage, false, cacheDirectory) ||
+                !readKtxLevels(cachePath, INT_MAX, -1, header)) {
+                std::cout << "Could not cache " << name << ", run from the repository root" << std::endl;
+                return 1;
+            }
+            source.cachePaths.push_back(cachePath);
+            source.size = std::max(header.width, header.height);
+            bytes.resize(header.levels.size());
+            for (unsigned int level = 0; level < header.levels.size(); ++level)
+                bytes[level] += compressedSize(header.format, std::max(header.width >> level, 1),
+                                               std::max(header.height >> level, 1));
+        }
+        sources.push_back(source);
+        levelBytes.push_back(bytes);
+    }
+
+    size_t full = 0;
+    for (unsigned int i = 0; i < levelBytes.size(); ++i) {
+        for (unsigned int j = 0; j < levelBytes[i].size(); ++j)
+            full += levelBytes[i][j];
+    }
+    const double megabyte = 1024.0 * 1024.0;
+    const int frames = 600;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << sources.size() << " textures, " << full / megabyte << " MB with every level, " << frames
+              << " frames with 2 reader threads" << std::endl;
+    const int budgets[] = { 4, 8, 16, 32 };
+    for (unsigned int b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b) {
+        size_t budget = (size_t)budgets[b] << 20;
+        PathResult r = streamPath(sources, levelBytes, budget, frames);
+        if (r.peakBytes > budget) {
+            std::cout << "  budget exceeded: " << r.peakBytes / megabyte << " MB" << std::endl;
+            failed = true;
+        }
+        std::cout << "  " << std::setw(2) << budgets[b] << " MB budget: peak " << r.peakBytes / megabyte
+                  << " MB resident, " << r.satisfiedFrames * 100.0 / frames << "% of frames with every requested "
+                  << "level resident, " << r.loads << " loads, " << r.evictions << " evictions, "
+                  << r.bytesRead / megabyte / r.seconds << " MB/s read; main thread " << std::setprecision(3)
+                  << r.mainMilliseconds / frames << " ms per frame, " << r.worstMainMilliseconds << " ms worst"
+                  << std::setprecision(2) << std::endl;
+    }
+    std::cout << (failed ? "FAILED" : "All checks passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -22,6 +22,7 @@
 // My own wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -61,8 +62,10 @@ int main()
     */
 
     // Load textures
-    Texture containerTexture("textures/container.jpg");
-    Texture faceTexture("textures/awesomeface.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture containerTexture("textures/container.jpg", TEXTURE_COLOR, &jobs);
+    Texture faceTexture("textures/awesomeface.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader shader("shaders/Box.vert", "shaders/TexturedTriangle.frag");
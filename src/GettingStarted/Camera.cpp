@@ -22,6 +22,7 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Texture.h"
+#include "JobPool.h"
 #include "Camera.h"
 
 int gScreenWidth = 800;
@@ -57,8 +58,10 @@ int main()
     gCamera.Position = glm::vec3(0.0f, 0.0f, 3.0f);
 
     // Load textures
-    Texture containerTexture("textures/container.jpg");
-    Texture faceTexture("textures/awesomeface.png");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture containerTexture("textures/container.jpg", TEXTURE_COLOR, &jobs);
+    Texture faceTexture("textures/awesomeface.png", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     Shader shader("shaders/Box.vert", "shaders/TexturedTriangle.frag");
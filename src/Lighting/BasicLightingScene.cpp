@@ -187,7 +187,7 @@ int main()
             model = glm::rotate(model, glm::radians(30.0f * i), glm::vec3(1.0f, 0.5f, 1.0f));
             if (i == 0) model = glm::scale(model, glm::vec3(1.3f));
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -22,6 +22,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -53,9 +54,11 @@ int main()
         return -1;
     }
 
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture emissionMap("textures/container2_emission.jpg");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture emissionMap("textures/container2_emission.jpg", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     // Load light source shader
@@ -235,7 +238,7 @@ int main()
             model = glm::translate(model, cubePositions[i]);
             model = glm::rotate(model, glm::radians(30.0f * i), glm::vec3(1.0f, 0.5f, 1.0f));
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
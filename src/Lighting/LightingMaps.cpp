@@ -24,6 +24,7 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -55,9 +56,11 @@ int main()
         return -1;
     }
 
-    Texture ambientMap("textures/container2.png");
-    Texture specularMap("textures/container2_specular.png");
-    Texture emissionMap("textures/container2_emission.jpg");
+    // Builds the mip levels of the textures
+    JobPool jobs;
+    Texture ambientMap("textures/container2.png", TEXTURE_COLOR, &jobs);
+    Texture specularMap("textures/container2_specular.png", TEXTURE_SPECULAR, &jobs);
+    Texture emissionMap("textures/container2_emission.jpg", TEXTURE_COLOR, &jobs);
 
     // Load shaders
     // Load light source shader
@@ -234,7 +237,7 @@ int main()
             if (i == 0) model = glm::scale(model, glm::vec3(1.5f));
             else model = glm::scale(model, glm::vec3(0.8f));
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -22,6 +22,7 @@
 // Wrapper classes to make things a little easier
 #include "Shader.h"
 #include "Camera.h"
+#include "GoldenRun.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -30,6 +31,8 @@ float gDeltaTime = 0.0f;
 float gLastFrame = 0.0f;
 
 Camera gCamera;
+// Fixed time runs that write a reference image, see GoldenRun.h
+GoldenRun gGolden;
 
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
@@ -42,8 +45,9 @@ void processInput(GLFWwindow *window);
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
 
-int main()
+int main(int argc, char *argv[])
 {
+    gGolden.parse(argc, argv);
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
@@ -144,7 +148,7 @@ int main()
     // Game loop
     while (!glfwWindowShouldClose(window)) {
         // Calculate how much time since last frame
-        auto currentFrame = (float)glfwGetTime();
+        auto currentFrame = gGolden.time();
         gDeltaTime = currentFrame - gLastFrame;
         gLastFrame = currentFrame;
 
@@ -196,12 +200,14 @@ int main()
             if (i == 0) model = glm::scale(model, glm::vec3(1.3f, 2.0f, 1.0f));
             else model = glm::scale(model, glm::vec3(0.8f, 0.4f, 1.5f));
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
         // Rendering Ends here
 
+        if (gGolden.frameDone())
+            break;
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -218,6 +224,7 @@ GLFWwindow *init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    gGolden.hintWindow();
     // Create a window object
     GLFWwindow *window = glfwCreateWindow(800, 600, "box", nullptr, nullptr);
     if (window == nullptr) {
@@ -233,6 +240,7 @@ GLFWwindow *init()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return nullptr;
     }
+    gGolden.begin(window);
 
     // Tell OpenGL the size of rendering window
     glViewport(0, 0, gScreenWidth, gScreenHeight);
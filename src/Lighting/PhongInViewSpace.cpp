@@ -195,7 +195,7 @@ int main()
             if (i == 0) model = glm::scale(model, glm::vec3(1.3f, 2.0f, 1.0f));
             else model = glm::scale(model, glm::vec3(0.8f, 0.4f, 1.5f));
 
-            objectShader.setMat4("model", model);
+            objectShader.setModelMatrix(model);
 
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 // GLM Math Library
 #include <glm/glm.hpp>
@@ -21,6 +22,8 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "MeshBatch.h"
+#include "JobPool.h"
 
 int gScreenWidth = 800;
 int gScreenHeight = 600;
@@ -30,6 +33,15 @@ float gLastFrame = 0.0f;
 
 Camera gCamera;
 
+// Copies of the nanosuit standing in a row
+const int NANOSUIT_COUNT = 5;
+// B switches between one draw per mesh and the merged MeshBatch
+bool gUseBatch = true;
+// C draws per mesh, skipping meshlets outside the frustum or facing away
+bool gClusterCulling = false;
+// GPU memory for the streamed nanosuit textures unless given on the command line
+const int DEFAULT_TEXTURE_BUDGET_MB = 8;
+
 // Perform necessary initialization.
 // Returns pointer to a initialized window with OpenGL context set up
 GLFWwindow *init();
@@ -40,9 +52,11 @@ void processInput(GLFWwindow *window);
 // Mouse input is handled in this function
 void mouseCallback(GLFWwindow *window, double xpos, double ypos);
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY);
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-int main()
+int main(int argc, char *argv[])
 {
+    int budgetMegabytes = argc > 1 ? std::max(atoi(argv[1]), 1) : DEFAULT_TEXTURE_BUDGET_MB;
     GLFWwindow *window = init();
     if (window == nullptr) {
         std::cout << "Failed to initialize GLFW and OpenGL!" << std::endl;
@@ -55,14 +69,51 @@ int main()
                              "shaders/LightSource.frag");
 
     // Load Object Shader
-    Shader objectShader("shaders/MultipleLights.vert", "shaders/MultipleLights.frag");
+    Shader objectShader("shaders/ModelNormalMapping.vert", "shaders/ModelNormalMapping.frag");
     objectShader.use();
     objectShader.setInt("material.diffuse", 0);
     objectShader.setInt("material.specular", 1);
     objectShader.setInt("material.emission", 2);
 
-    Model nanosuitModel("models/nanosuit/nanosuit.obj");
-    Model nanosuitWireFrame("models/nanosuit/nanosuit.obj");
+    // Block compressed textures, built on the first run and kept in texture_cache/, from where
+    // only the levels the view needs are streamed in
+    const double megabyte = 1024.0 * 1024.0;
+    // One pool for importing and streaming
+    JobPool jobs;
+    TextureStreamer streamer((size_t)budgetMegabytes << 20, jobs);
+    ModelOptions nanosuitOptions(&jobs);
+    nanosuitOptions.meshlets = true;
+    nanosuitOptions.compressTextures = true;
+    nanosuitOptions.streamer = &streamer;
+    Model nanosuitModel("models/nanosuit/nanosuit.obj", nanosuitOptions);
+    Model nanosuitWireFrame("models/nanosuit/nanosuit.obj", ModelOptions(&jobs));
+    std::cout << "Loaded nanosuit: " << nanosuitModel.importMilliseconds << " ms import ("
+              << nanosuitModel.tangentMilliseconds << " ms of it tangents), "
+              << nanosuitModel.uploadMilliseconds << " ms upload, "
+              << streamer.state().residentBytes() / megabyte << " MB of textures resident ("
+              << streamer.state().fullBytes() / megabyte << " MB with every level, "
+              << nanosuitWireFrame.textureBytes / megabyte << " MB uncompressed)" << std::endl;
+
+    // Row of nanosuits, in model units (the model matrix scales by 0.1)
+    std::vector<glm::mat4> placements;
+    for (int i = 0; i < NANOSUIT_COUNT; ++i)
+        placements.push_back(glm::translate(glm::mat4(1.0f),
+                                            glm::vec3(10.0f * (i - NANOSUIT_COUNT / 2), 0.0f, 0.0f)));
+    MeshBatch batch;
+    for (int i = 0; i < NANOSUIT_COUNT; ++i)
+        batch.addModel(nanosuitModel, placements[i]);
+    batch.build();
+    std::cout << "Batch: " << batch.meshCount() << " meshes, " << batch.vertexTotal() << " vertices, "
+              << batch.drawCallCount() << " multi draw calls instead of " << batch.meshCount()
+              << " draw calls" << std::endl;
+    std::cout << "Meshlets: " << nanosuitModel.meshletTotal << " for "
+              << nanosuitModel.triangleTotal << " triangles" << std::endl;
+    std::cout << "Press B to switch between per mesh and batched drawing, C for meshlet culling" << std::endl;
+    double submitMilliseconds = 0.0;
+    int submitFrames = 0;
+    float frameTimeSum = 0.0f, worstFrameTime = 0.0f;
+    double lastUpdateMilliseconds = 0.0;
+    int streamFrames = 0;
 
     glEnable(GL_DEPTH_TEST);
 
@@ -126,9 +177,57 @@ int main()
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.1f));
-        objectShader.setMat4("model", model);
-
-        nanosuitModel.Draw(objectShader);
+        auto submitStart = std::chrono::high_resolution_clock::now();
+        unsigned int meshletsDrawn = 0, trianglesDrawn = 0;
+        if (gClusterCulling) {
+            for (int i = 0; i < NANOSUIT_COUNT; ++i) {
+                nanosuitModel.DrawCulled(objectShader, model * placements[i], projection * view, gCamera.Position);
+                meshletsDrawn += nanosuitModel.meshletsDrawn;
+                trianglesDrawn += nanosuitModel.trianglesDrawn;
+            }
+        } else if (gUseBatch) {
+            batch.draw(objectShader, model);
+        } else {
+            for (int i = 0; i < NANOSUIT_COUNT; ++i)
+                nanosuitModel.Draw(objectShader, model * placements[i]);
+        }
+        submitMilliseconds += std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - submitStart).count();
+        if (++submitFrames == 200 && gClusterCulling) {
+            std::cout << "Meshlet culling: " << meshletsDrawn << " of " << nanosuitModel.meshletTotal * NANOSUIT_COUNT
+                      << " meshlets, " << trianglesDrawn << " of " << nanosuitModel.triangleTotal * NANOSUIT_COUNT
+                      << " triangles, " << submitMilliseconds / submitFrames << " ms CPU to cull and submit"
+                      << std::endl;
+            submitMilliseconds = 0.0;
+            submitFrames = 0;
+        } else if (submitFrames == 200) {
+            std::cout << (gUseBatch ? "Batched: " : "Per mesh: ")
+                      << (gUseBatch ? batch.drawCallCount() : batch.meshCount()) << " draw calls, "
+                      << submitMilliseconds / submitFrames << " ms CPU to submit" << std::endl;
+            submitMilliseconds = 0.0;
+            submitFrames = 0;
+        }
+
+        // Levels for what this view shows, loaded while the next frames are drawn
+        float pixelsPerUnitAtOne = screenPixelsPerUnit(gScreenHeight, glm::radians(gCamera.Zoom));
+        for (int i = 0; i < NANOSUIT_COUNT; ++i)
+            nanosuitModel.RequestTextures(streamer, model * placements[i], projection * view, gCamera.Position,
+                                          pixelsPerUnitAtOne);
+        streamer.update();
+        frameTimeSum += gDeltaTime;
+        worstFrameTime = std::max(worstFrameTime, gDeltaTime);
+        if (++streamFrames == 200) {
+            const MipResidency &residency = streamer.state();
+            std::cout << "Textures: " << residency.residentBytes() / megabyte << " MB resident of "
+                      << budgetMegabytes << " MB, " << streamer.streamedLevels() << " levels streamed in, "
+                      << residency.evictionCount() << " evicted; frames " << frameTimeSum / streamFrames * 1000.0f
+                      << " ms average, " << worstFrameTime * 1000.0f << " ms worst, "
+                      << (streamer.updateMilliseconds() - lastUpdateMilliseconds) / streamFrames
+                      << " ms in the streamer" << std::endl;
+            lastUpdateMilliseconds = streamer.updateMilliseconds();
+            frameTimeSum = worstFrameTime = 0.0f;
+            streamFrames = 0;
+        }
 
         // Rendering Ends here
 
@@ -176,6 +275,7 @@ GLFWwindow *init()
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetScrollCallback(window, scrollCallback);
+    glfwSetKeyCallback(window, keyCallback);
 
     return window;
 }
@@ -232,4 +332,16 @@ void mouseCallback(GLFWwindow *window, double xpos, double ypos)
 void scrollCallback(GLFWwindow *window, double offsetX, double offsetY)
 {
     gCamera.ProcessMouseScroll((float)offsetY);
+}
+
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        gUseBatch = !gUseBatch;
+        std::cout << (gUseBatch ? "Batched drawing" : "Per mesh drawing") << std::endl;
+    }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        gClusterCulling = !gClusterCulling;
+        std::cout << (gClusterCulling ? "Meshlet culling on" : "Meshlet culling off") << std::endl;
+    }
 }
\ No newline at end of file